@@ -0,0 +1,105 @@
+// SealedMessageArchive with a million records: append throughput, random
+// access by record number through the memory-mapped index, a parallel scan
+// of every record in place, and parallel unsealing, alongside the heap the
+// archive uses relative to the size of its index.
+
+#include <cstdio>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <sodium.h>
+#include "lib-seeded.hpp"
+#include "bench-util.hpp"
+
+static void removeArchive(const std::string& path, size_t segmentCount) {
+  for (size_t segment = 0; segment < segmentCount; segment++) {
+    remove((path + "." + std::to_string(segment) + ".records").c_str());
+    remove((path + "." + std::to_string(segment) + ".index").c_str());
+  }
+}
+
+int main() {
+  ensureSodiumInitialized();
+  const std::string path = "bench-archive.tmp";
+  const uint64_t recordCount = 1000000;
+  const UnsealingKey unsealingKey("A1tB2rC3bD4lE5tF6bG1tH1tI1tJ1tK1tL1tM1tN1tO1tP1tR1tS1tT1tU1tV1tW1tX1tY1tZ1t", R"({"type": "UnsealingKey"})");
+  KeyRegistry registry;
+  registry.add(unsealingKey);
+
+  // A few distinct records, appended over and over
+  const size_t distinctRecords = 64;
+  std::vector<PackagedSealedMessage> messages;
+  std::vector<std::vector<unsigned char>> serialized;
+  for (size_t i = 0; i < distinctRecords; i++) {
+    messages.push_back(unsealingKey.getSealingKey().sealWithKeyId(std::vector<unsigned char>(100, (unsigned char) i)));
+    serialized.push_back(messages.back().toEnvelopeBinaryForm().toVector());
+  }
+
+  size_t segmentCount;
+  {
+    SealedMessageArchive archive(path, uint64_t(64) << 20);
+    Bench::printHeader("SealedMessageArchive, " + std::to_string(recordCount) + " records of " +
+      std::to_string(serialized[0].size()) + " bytes");
+    Bench::Clock::time_point start = Bench::Clock::now();
+    for (uint64_t i = 0; i < recordCount; i++) {
+      const std::vector<unsigned char>& record = serialized[i % distinctRecords];
+      archive.appendSerialized(record.data(), record.size());
+    }
+    archive.flush();
+    Bench::printRate("appendSerialized", double(recordCount) / Bench::secondsSince(start));
+    start = Bench::Clock::now();
+    const uint64_t appendCount = 20000;
+    for (uint64_t i = 0; i < appendCount; i++) {
+      archive.append(messages[i % distinctRecords]);
+    }
+    archive.flush();
+    Bench::printRate("append (serializing each message)", double(appendCount) / Bench::secondsSince(start));
+    segmentCount = archive.getSegmentCount();
+  }
+
+  {
+    // Reopen, as a reader would
+    SealedMessageArchive archive(path, uint64_t(64) << 20);
+    const uint64_t total = archive.size();
+    std::printf("  %zu segments; the index is %.1f MB on disk and is not read onto the heap\n",
+      archive.getSegmentCount(), double(total * 8) / 1e6);
+
+    uint64_t next = 0;
+    const unsigned char* record;
+    size_t recordLength;
+    Bench::printRate("getRecord, random (zero-copy)", Bench::operationsPerSecond([&]() {
+      next = (next * 6364136223846793005ULL + 1442695040888963407ULL);
+      archive.getRecord(next % total, record, recordLength);
+    }));
+    Bench::printRate("read, random (copies into a message)", Bench::operationsPerSecond([&]() {
+      next = (next * 6364136223846793005ULL + 1442695040888963407ULL);
+      archive.read(next % total);
+    }));
+
+    std::atomic<uint64_t> bytes(0);
+    Bench::Clock::time_point start = Bench::Clock::now();
+    archive.parallelForEachRecord([&](uint64_t, const unsigned char*, size_t length) {
+      bytes += length;
+    });
+    const double scanSeconds = Bench::secondsSince(start);
+    Bench::printRate("parallelForEachRecord", double(total) / scanSeconds);
+    Bench::printBandwidth("parallelForEachRecord", 1 / scanSeconds, (size_t) bytes.load());
+
+    const uint64_t unsealCount = 50000;
+    std::atomic<uint64_t> unsealed(0);
+    start = Bench::Clock::now();
+    archive.parallelUnseal(registry, [&](uint64_t, Result<SodiumBuffer>& plaintext) {
+      if (plaintext.ok()) {
+        unsealed++;
+      }
+    }, 0, unsealCount);
+    Bench::printRate("parallelUnseal (" + std::to_string(WorkStealingPool::getDefault().getThreadCount()) + " threads)",
+      double(unsealCount) / Bench::secondsSince(start));
+    if (unsealed.load() != unsealCount) {
+      std::printf("  only %llu of %llu records unsealed\n", (unsigned long long) unsealed.load(), (unsigned long long) unsealCount);
+    }
+  }
+
+  removeArchive(path, segmentCount);
+  return 0;
+}
@@ -0,0 +1,60 @@
+// Throughput of unsealing a batch of messages of mixed sizes, one at a
+// time versus with unsealBatch (parallel, work-stealing across cores).
+//
+// Most messages are small, with a few large ones mixed in, so that an
+// even split of the batch across threads would leave some threads idle.
+
+#include <vector>
+#include <sodium.h>
+#include "lib-seeded.hpp"
+#include "bench-util.hpp"
+
+static size_t mixedMessageSize(size_t index) {
+  // 1 in 64 messages is 256KB; the rest range from 64B to 4KB
+  return (index % 64 == 63) ? (256u << 10) : (64u << (index % 7));
+}
+
+template <typename Key>
+static void reportBatchUnseal(
+  const std::string& name,
+  const Key& key,
+  const std::vector<PackagedSealedMessage>& messages,
+  size_t totalBytes
+) {
+  const double serialRate = Bench::operationsPerSecond([&]() {
+    for (const PackagedSealedMessage& message : messages) {
+      key.unseal(message);
+    }
+  }, 1.0);
+  const double batchRate = Bench::operationsPerSecond([&]() {
+    key.unsealBatch(messages);
+  }, 1.0);
+  Bench::printThroughput(name + " unseal (one at a time)", serialRate * messages.size(), totalBytes / messages.size());
+  Bench::printThroughput(name + " unsealBatch", batchRate * messages.size(), totalBytes / messages.size());
+}
+
+int main() {
+  ensureSodiumInitialized();
+  const size_t batchSize = 4096;
+  std::printf("%zu threads in default pool\n", WorkStealingPool::getDefault().getThreadCount());
+
+  const UnsealingKey unsealingKey("bench-batch-unseal seed", "{}");
+  const SealingKey sealingKey = unsealingKey.getSealingKey();
+  const SymmetricKey symmetricKey("bench-batch-unseal seed", "{}");
+
+  std::vector<PackagedSealedMessage> sealedWithPublicKey;
+  std::vector<PackagedSealedMessage> sealedWithSymmetricKey;
+  size_t totalBytes = 0;
+  for (size_t i = 0; i < batchSize; i++) {
+    const std::vector<unsigned char> message(mixedMessageSize(i), (unsigned char) i);
+    totalBytes += message.size();
+    sealedWithPublicKey.push_back(sealingKey.seal(message, "{}"));
+    sealedWithSymmetricKey.push_back(symmetricKey.seal(message, "{}"));
+  }
+
+  Bench::printHeader(std::to_string(batchSize) + " messages, mixed sizes, " + std::to_string(totalBytes >> 20) + "MB total");
+  reportBatchUnseal("UnsealingKey", unsealingKey, sealedWithPublicKey, totalBytes);
+  reportBatchUnseal("SymmetricKey", symmetricKey, sealedWithSymmetricKey, totalBytes);
+
+  return 0;
+}
@@ -0,0 +1,58 @@
+// Encoding binary data for JSON: the hex codec's scalar, SSSE3, and AVX2
+// implementations in GB/s of binary data, base64url, and the end-to-end
+// cost of PackagedSealedMessage::toJson/fromJson with each encoding.
+
+#include <string>
+#include <vector>
+#include <sodium.h>
+#include "lib-seeded.hpp"
+#include "convert.hpp"
+#include "bench-util.hpp"
+
+int main() {
+  ensureSodiumInitialized();
+  const size_t length = 1 << 20;
+  std::vector<unsigned char> bytes(length);
+  randombytes_buf(bytes.data(), bytes.size());
+  std::string hex(2 * length, ' ');
+  std::vector<unsigned char> decoded(length);
+
+  Bench::printHeader("Hex codec, 1MiB (best on this CPU: " + std::string(hexCodecName(bestHexCodec())) + ")");
+  for (HexCodec codec : { HexCodec::Scalar, HexCodec::Ssse3, HexCodec::Avx2 }) {
+    if (!hexCodecIsSupported(codec)) {
+      continue;
+    }
+    const std::string name = hexCodecName(codec);
+    Bench::printBandwidth("encode " + name, Bench::operationsPerSecond([&]() {
+      hexEncode(&hex[0], bytes.data(), length, codec);
+    }), length);
+    Bench::printBandwidth("decode " + name, Bench::operationsPerSecond([&]() {
+      hexDecode(decoded.data(), hex.data(), length, codec);
+    }), length);
+  }
+
+  Bench::printHeader("base64url, 1MiB");
+  const std::string base64Url = toBase64UrlStr(bytes.data(), length);
+  Bench::printBandwidth("encode", Bench::operationsPerSecond([&]() {
+    toBase64UrlStr(bytes.data(), length);
+  }), length);
+  Bench::printBandwidth("decode", Bench::operationsPerSecond([&]() {
+    base64UrlStrToByteVector(base64Url);
+  }), length);
+
+  Bench::printHeader("PackagedSealedMessage JSON, 1MiB ciphertext");
+  const PackagedSealedMessage message(bytes, "{}", "{}");
+  for (BinaryEncoding binaryEncoding : { BinaryEncoding::Hex, BinaryEncoding::Base64Url }) {
+    const std::string name = binaryEncodingName(binaryEncoding);
+    const std::string json = message.toJson(-1, ' ', binaryEncoding);
+    std::printf("  %s JSON is %zu bytes\n", name.c_str(), json.size());
+    Bench::printBandwidth("toJson " + name, Bench::operationsPerSecond([&]() {
+      message.toJson(-1, ' ', binaryEncoding);
+    }), length);
+    Bench::printBandwidth("fromJson " + name, Bench::operationsPerSecond([&]() {
+      PackagedSealedMessage::fromJson(json);
+    }), length);
+  }
+
+  return 0;
+}
@@ -0,0 +1,48 @@
+// Building a ChunkManifest over a blob (parallel on the default pool),
+// and proving and verifying a 4MB range of it, versus verifying an
+// Ed25519ph signature of the whole blob.
+//
+//   bench-chunk-manifest [size-in-MB]
+
+#include <stdlib.h>
+#include <vector>
+#include <sodium.h>
+#include "lib-seeded.hpp"
+#include "bench-util.hpp"
+
+int main(int argc, char** argv) {
+  ensureSodiumInitialized();
+  const size_t megabytes = argc > 1 ? (size_t) strtoull(argv[1], NULL, 10) : 512;
+  const size_t blobSize = megabytes << 20;
+  std::vector<unsigned char> blob(blobSize);
+  randombytes_buf(blob.data(), blob.size());
+  SigningKey signingKey("bench-chunk-manifest", "{}");
+  const SignatureVerificationKey verificationKey = signingKey.getSignatureVerificationKey();
+  std::printf("%zu threads in default pool\n", WorkStealingPool::getDefault().getThreadCount());
+
+  Bench::printHeader(std::to_string(megabytes) + "MB blob, 1MB chunks");
+  Bench::printThroughput("ChunkManifest::build", Bench::operationsPerSecond([&]() {
+    ChunkManifest::build(blob.data(), blob.size(), signingKey);
+  }, 2.0), blobSize);
+  const ChunkManifest manifest = ChunkManifest::build(blob.data(), blob.size(), signingKey);
+
+  const ChunkRangeProof proof = manifest.proveByteRange(blobSize / 2, 4 << 20);
+  const unsigned char* range = blob.data() + proof.getRangeOffset();
+  Bench::printLatency("proveByteRange (4MB)", Bench::operationsPerSecond([&]() {
+    manifest.proveByteRange(blobSize / 2, 4 << 20);
+  }));
+  Bench::printLatency("ChunkRangeProof::verify (4MB)", Bench::operationsPerSecond([&]() {
+    proof.verify(verificationKey, range, (size_t) proof.getRangeLength());
+  }));
+
+  StreamingSigner signer(signingKey);
+  signer.update(blob);
+  const std::vector<unsigned char> signature = signer.finalize();
+  Bench::printLatency("StreamingSignatureVerifier (whole blob)", Bench::operationsPerSecond([&]() {
+    StreamingSignatureVerifier verifier(verificationKey);
+    verifier.update(blob);
+    verifier.verify(signature);
+  }, 2.0));
+
+  return 0;
+}
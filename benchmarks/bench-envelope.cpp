@@ -0,0 +1,53 @@
+// Serialized PackagedSealedMessage formats: the fixed-length list written by
+// toSerializedBinaryForm against the versioned SealedMessageEnvelope, in
+// size and in the cost of parsing far enough to choose an algorithm.
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <sodium.h>
+#include "lib-seeded.hpp"
+#include "bench-util.hpp"
+
+int main() {
+  ensureSodiumInitialized();
+  const std::string derivationOptionsJson = R"({"type": "UnsealingKey", "algorithm": "X25519", "additionalSalt": "1"})";
+  const UnsealingKey unsealingKey("A1tB2rC3bD4lE5tF6bG1tH1tI1tJ1tK1tL1tM1tN1tO1tP1tR1tS1tT1tU1tV1tW1tX1tY1tZ1t", derivationOptionsJson);
+  const std::vector<unsigned char> keyIdHint(8, 0x5a);
+  const DerivationOptionsTable table({ derivationOptionsJson });
+
+  for (size_t plaintextLength : { size_t(32), size_t(1024) }) {
+    const std::vector<unsigned char> plaintext(plaintextLength, 'x');
+    const PackagedSealedMessage message = unsealingKey.getSealingKey().seal(plaintext, "{}");
+    const SodiumBuffer legacy = message.toSerializedBinaryForm();
+    const SodiumBuffer envelope = message.toEnvelopeBinaryForm(SealingAlgorithm::Unspecified, keyIdHint);
+    const SodiumBuffer compact = message.toEnvelopeBinaryForm(SealingAlgorithm::Unspecified, keyIdHint, &table);
+
+    Bench::printHeader("Sealed message, " + std::to_string(plaintextLength) + "-byte plaintext");
+    std::printf("  fixed-length list %zu bytes, envelope %zu bytes (with an 8-byte key ID), with a table ID %zu bytes\n",
+      legacy.length, envelope.length, compact.length);
+
+    Bench::printRate("list: split + parse derivation options", Bench::operationsPerSecond([&]() {
+      const PackagedSealedMessage parsed = PackagedSealedMessage::fromSerializedBinaryForm(legacy);
+      PackagedSealedMessage::sealingAlgorithmFor(parsed.derivationOptionsJson);
+    }));
+    Bench::printRate("list: fromSerializedBinaryForm", Bench::operationsPerSecond([&]() {
+      PackagedSealedMessage::fromSerializedBinaryForm(legacy);
+    }));
+    Bench::printRate("list: tryFromSerializedBinaryForm", Bench::operationsPerSecond([&]() {
+      PackagedSealedMessage::tryFromSerializedBinaryForm(legacy);
+    }));
+    SealedMessageEnvelope view;
+    Bench::printRate("envelope: parse view (zero-copy)", Bench::operationsPerSecond([&]() {
+      SealedMessageEnvelope::parse(envelope.data, envelope.length, view);
+    }));
+    Bench::printRate("envelope: fromSerializedBinaryForm", Bench::operationsPerSecond([&]() {
+      PackagedSealedMessage::fromSerializedBinaryForm(envelope);
+    }));
+    Bench::printRate("envelope with table ID: fromSerializedBinaryForm", Bench::operationsPerSecond([&]() {
+      PackagedSealedMessage::fromSerializedBinaryForm(compact, &table);
+    }));
+  }
+
+  return 0;
+}
@@ -0,0 +1,80 @@
+// Heap allocations per call, and call rate, for signing and verifying
+// through the std::vector APIs and through the SignatureBytes ones, and for
+// copying a SealingKey now that its bytes are held inline.
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+#include <sodium.h>
+#include "lib-seeded.hpp"
+#include "bench-util.hpp"
+
+// Heap accounting: count every allocation made
+static size_t allocations = 0;
+
+void* operator new(size_t length) {
+  void* block = std::malloc(length == 0 ? 1 : length);
+  if (block == NULL) {
+    throw std::bad_alloc();
+  }
+  allocations++;
+  return block;
+}
+
+void operator delete(void* pointer) noexcept {
+  std::free(pointer);
+}
+
+static volatile size_t sink;
+
+static const size_t callsCounted = 1000;
+
+// Report the allocations made per call to operation, then its rate
+template <typename Operation>
+static void report(const std::string& name, Operation operation) {
+  const size_t before = allocations;
+  for (size_t i = 0; i < callsCounted; i++) {
+    operation();
+  }
+  std::printf("%-48s %8.2f allocations/call\n", name.c_str(), double(allocations - before) / callsCounted);
+  Bench::printRate(name, Bench::operationsPerSecond(operation));
+}
+
+int main() {
+  ensureSodiumInitialized();
+  const SigningKey signingKey("bench", R"({"algorithm": "Ed25519"})");
+  const SignatureVerificationKey verificationKey = SigningKey(signingKey).getSignatureVerificationKey();
+  const SealingKey sealingKey = UnsealingKey("bench", R"({"algorithm": "X25519"})").getSealingKey();
+  const std::vector<unsigned char> message(64, 'm');
+  const std::vector<unsigned char> signatureVector = signingKey.generateSignature(message);
+  const SignatureBytes signature = signingKey.generateSignatureBytes(message);
+
+  Bench::printHeader("Signing and verifying a 64-byte message");
+  report("generateSignature (vector)", [&]() {
+    sink = signingKey.generateSignature(message.data(), message.size())[0];
+  });
+  report("generateSignatureBytes (SignatureBytes)", [&]() {
+    sink = signingKey.generateSignatureBytes(message.data(), message.size())[0];
+  });
+  report("verify (vector signature)", [&]() {
+    sink = verificationKey.verify(message.data(), message.size(), signatureVector);
+  });
+  report("verify (SignatureBytes)", [&]() {
+    sink = verificationKey.verify(message.data(), message.size(), signature);
+  });
+
+  Bench::printHeader("Copying a key");
+  report("SealingKey copy", [&]() {
+    const SealingKey copy(sealingKey);
+    sink = copy.sealingKeyBytes[0];
+  });
+  report("getSealingKeyBytes (vector)", [&]() {
+    sink = sealingKey.getSealingKeyBytes()[0];
+  });
+  report("getSealingKeyByteArray (reference)", [&]() {
+    sink = sealingKey.getSealingKeyByteArray()[0];
+  });
+  return 0;
+}
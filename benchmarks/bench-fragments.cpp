@@ -0,0 +1,66 @@
+// Sealing and signing a message held in three buffers (a 64-byte header,
+// a body, and a 32-byte trailer): concatenating them into one buffer first,
+// against passing them as MessageFragments.
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <sodium.h>
+#include "lib-seeded.hpp"
+#include "bench-util.hpp"
+
+static volatile unsigned char sink;
+
+static std::vector<unsigned char> concatenate(const std::vector<MessageFragment>& fragments) {
+  std::vector<unsigned char> message;
+  message.reserve(MessageFragment::totalLength(fragments.data(), fragments.size()));
+  for (const MessageFragment& fragment : fragments) {
+    message.insert(message.end(), fragment.data, fragment.data + fragment.length);
+  }
+  return message;
+}
+
+int main() {
+  ensureSodiumInitialized();
+  const std::string seed = "A1tB2rC3bD4lE5tF6bG1tH1tI1tJ1tK1tL1tM1tN1tO1tP1tR1tS1tT1tU1tV1tW1tX1tY1tZ1t";
+  const SymmetricKey symmetricKey(seed, R"({"type": "SymmetricKey"})");
+  const UnsealingKey unsealingKey(seed, R"({"type": "UnsealingKey"})");
+  const SealingKey sealingKey = unsealingKey.getSealingKey();
+  SigningKey signingKey(seed, R"({"type": "SigningKey"})");
+  const SignatureVerificationKey verificationKey = signingKey.getSignatureVerificationKey();
+
+  const std::vector<unsigned char> header(64, 'h');
+  const std::vector<unsigned char> trailer(32, 't');
+  for (size_t bodyLength : { size_t(256), size_t(4096), size_t(65536), size_t(1) << 20 }) {
+    const std::vector<unsigned char> body(bodyLength, 'b');
+    const std::vector<MessageFragment> fragments = { header, body, trailer };
+    const std::vector<unsigned char> signature = signingKey.generateSignature(concatenate(fragments));
+    Bench::printHeader("Body of " + std::to_string(bodyLength) + " bytes");
+
+    Bench::printRate("SymmetricKey: concatenate, then seal", Bench::operationsPerSecond([&]() {
+      sink = symmetricKey.sealToCiphertextOnly(concatenate(fragments))[0];
+    }));
+    Bench::printRate("SymmetricKey: seal fragments", Bench::operationsPerSecond([&]() {
+      sink = symmetricKey.sealToCiphertextOnly(fragments)[0];
+    }));
+    Bench::printRate("SealingKey: concatenate, then seal", Bench::operationsPerSecond([&]() {
+      sink = sealingKey.sealToCiphertextOnly(concatenate(fragments))[0];
+    }));
+    Bench::printRate("SealingKey: seal fragments", Bench::operationsPerSecond([&]() {
+      sink = sealingKey.sealToCiphertextOnly(fragments)[0];
+    }));
+    Bench::printRate("SigningKey: concatenate, then sign", Bench::operationsPerSecond([&]() {
+      sink = signingKey.generateSignature(concatenate(fragments))[0];
+    }));
+    Bench::printRate("SigningKey: sign fragments", Bench::operationsPerSecond([&]() {
+      sink = signingKey.generateSignature(fragments)[0];
+    }));
+    Bench::printRate("SignatureVerificationKey: concatenate, then verify", Bench::operationsPerSecond([&]() {
+      sink = verificationKey.verify(concatenate(fragments), signature);
+    }));
+    Bench::printRate("SignatureVerificationKey: verify fragments", Bench::operationsPerSecond([&]() {
+      sink = verificationKey.verify(fragments, signature);
+    }));
+  }
+  return 0;
+}
@@ -0,0 +1,37 @@
+// Deriving many keys from one seed: the flat path, which runs the
+// derivation hash function (here Argon2id with its defaults) for every
+// key, versus the hierarchical path, which runs it once for a root Secret
+// and derives each key from the root with keyed BLAKE2b.
+
+#include <string>
+#include <sodium.h>
+#include "lib-seeded.hpp"
+#include "bench-util.hpp"
+
+int main() {
+  ensureSodiumInitialized();
+  const std::string seed = "bench-hierarchical-derivation";
+  const size_t keyCount = 50;
+  size_t next = 0;
+
+  Bench::printHeader("Per key");
+  const double flatPerSecond = Bench::operationsPerSecond([&]() {
+    SigningKey key(seed, "{\"hashFunction\": \"Argon2id\", \"keyIndex\": " + std::to_string(next++) + "}");
+  });
+  Bench::printLatency("SigningKey from seed (Argon2id)", flatPerSecond);
+  const double rootPerSecond = Bench::operationsPerSecond([&]() {
+    Secret root(seed, "{\"hashFunction\": \"Argon2id\", \"lengthInBytes\": 32}");
+  });
+  Bench::printLatency("root Secret from seed (Argon2id)", rootPerSecond);
+  const Secret root(seed, "{\"hashFunction\": \"Argon2id\", \"lengthInBytes\": 32}");
+  const double childPerSecond = Bench::operationsPerSecond([&]() {
+    SigningKey key = SigningKey::deriveFromRootSecret(root, "{\"keyIndex\": " + std::to_string(next++) + "}");
+  });
+  Bench::printLatency("SigningKey from root Secret", childPerSecond);
+
+  Bench::printHeader(std::to_string(keyCount) + " keys");
+  std::printf("%-48s %14.2f ms\n", "flat", 1e3 * keyCount / flatPerSecond);
+  std::printf("%-48s %14.2f ms\n", "hierarchical", 1e3 * (1 / rootPerSecond + keyCount / childPerSecond));
+
+  return 0;
+}
@@ -0,0 +1,102 @@
+// Heap used per key by a registry of 1M SealingKeys that share 20 distinct
+// derivation options strings, with derivationOptionsJson interned, with
+// interning turned off, and with each key holding a std::string copy (as
+// keys did before interning); and the cost of constructing a key each way.
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+#include <sodium.h>
+#include "lib-seeded.hpp"
+#include "bench-util.hpp"
+
+// Heap accounting: every allocation records its size in a header so that
+// the bytes and blocks currently live can be tracked
+static size_t liveBytes = 0;
+static size_t liveBlocks = 0;
+static const size_t headerLength = 16;
+
+void* operator new(size_t length) {
+  unsigned char* block = (unsigned char*) std::malloc(length + headerLength);
+  if (block == NULL) {
+    throw std::bad_alloc();
+  }
+  *(size_t*) block = length;
+  liveBytes += length;
+  liveBlocks++;
+  return block + headerLength;
+}
+
+void operator delete(void* pointer) noexcept {
+  if (pointer == NULL) {
+    return;
+  }
+  unsigned char* block = (unsigned char*) pointer - headerLength;
+  liveBytes -= *(size_t*) block;
+  liveBlocks--;
+  std::free(block);
+}
+
+// The layout of a SealingKey before derivationOptionsJson was interned
+struct SealingKeyWithStringCopy {
+  const std::vector<unsigned char> sealingKeyBytes;
+  const std::string derivationOptionsJson;
+  SealingKeyWithStringCopy(const std::vector<unsigned char>& _sealingKeyBytes, const std::string& _derivationOptionsJson) :
+    sealingKeyBytes(_sealingKeyBytes), derivationOptionsJson(_derivationOptionsJson) {}
+};
+
+static const size_t keyCount = 1000000;
+static const size_t distinctOptionsCount = 20;
+
+// Build keyCount keys and report the heap they hold per key
+template <typename Key>
+static void reportHeapPerKey(const std::string& name, const std::vector<std::string>& options) {
+  const std::vector<unsigned char> keyBytes(crypto_box_PUBLICKEYBYTES, 7);
+  const size_t bytesBefore = liveBytes;
+  const size_t blocksBefore = liveBlocks;
+  {
+    std::vector<Key> keys;
+    keys.reserve(keyCount);
+    for (size_t i = 0; i < keyCount; i++) {
+      keys.emplace_back(keyBytes, options[i % options.size()]);
+    }
+    std::printf("%-48s %10.1f bytes/key %6.2f allocations/key\n",
+      name.c_str(),
+      double(liveBytes - bytesBefore) / keyCount,
+      double(liveBlocks - blocksBefore) / keyCount
+    );
+  }
+}
+
+int main() {
+  ensureSodiumInitialized();
+  std::vector<std::string> options;
+  for (size_t i = 0; i < distinctOptionsCount; i++) {
+    options.push_back(R"({"type": "UnsealingKey", "algorithm": "X25519", "additionalSalt": ")" + std::to_string(i) + R"("})");
+  }
+  Bench::printHeader("Heap held by " + std::to_string(keyCount) + " SealingKeys, " +
+    std::to_string(distinctOptionsCount) + " distinct options of ~" + std::to_string(options[0].size()) + " bytes");
+  reportHeapPerKey<SealingKeyWithStringCopy>("std::string copy per key", options);
+  reportHeapPerKey<SealingKey>("InternedString", options);
+  const std::shared_ptr<InternTable> defaultTable = InternTable::getDefault();
+  InternTable::setDefault(std::shared_ptr<InternTable>());
+  reportHeapPerKey<SealingKey>("InternedString, interning turned off", options);
+  InternTable::setDefault(defaultTable);
+
+  const std::vector<unsigned char> keyBytes(crypto_box_PUBLICKEYBYTES, 7);
+  const SealingKey sealingKey(keyBytes, options[0]);
+  Bench::printHeader("Constructing a key");
+  size_t i = 0;
+  Bench::printRate("std::string copy per key", Bench::operationsPerSecond([&]() {
+    SealingKeyWithStringCopy key(keyBytes, options[i++ % options.size()]);
+  }));
+  Bench::printRate("InternedString, from a std::string", Bench::operationsPerSecond([&]() {
+    SealingKey key(keyBytes, options[i++ % options.size()]);
+  }));
+  Bench::printRate("InternedString, from another key's", Bench::operationsPerSecond([&]() {
+    SealingKey key(keyBytes, sealingKey.derivationOptionsJson);
+  }));
+  return 0;
+}
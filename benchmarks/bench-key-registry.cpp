@@ -0,0 +1,91 @@
+// Routing sealed messages on a server holding 10,000 keys that share the
+// same derivation options: a KeyRegistry lookup by key ID against trial
+// decryption with every candidate key.
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <sodium.h>
+#include "lib-seeded.hpp"
+#include "bench-util.hpp"
+
+// Messages to keys spread evenly across the registry, so that trial
+// decryption finds the right key halfway through on average
+static const size_t keyCount = 10000;
+static const size_t messageCount = 16;
+
+static size_t targetKeyIndex(size_t message) {
+  return (message * keyCount) / messageCount + keyCount / (2 * messageCount);
+}
+
+static void benchmarkRouting(
+  const std::string& keyType,
+  const KeyRegistry& registry,
+  const std::vector<PackagedSealedMessage>& withKeyIds,
+  const std::vector<PackagedSealedMessage>& withoutKeyIds
+) {
+  Bench::printHeader("Unseal with " + std::to_string(keyCount) + " candidate " + keyType + "s");
+  size_t next = 0;
+  Bench::printRate("KeyRegistry, routed by key ID", Bench::operationsPerSecond([&]() {
+    registry.tryUnseal(withKeyIds[next++ % messageCount]);
+  }));
+  next = 0;
+  Bench::printRate("KeyRegistry, trial decryption", Bench::operationsPerSecond([&]() {
+    registry.tryUnseal(withoutKeyIds[next++ % messageCount]);
+  }));
+}
+
+int main() {
+  ensureSodiumInitialized();
+  const std::vector<unsigned char> plaintext(256, 'x');
+
+  // One registry at a time: every secret key is held in a sodium_malloc'd
+  // buffer with guard pages, and the process can only map so many
+  {
+    const std::string derivationOptionsJson = R"({"type": "UnsealingKey"})";
+    KeyRegistry registry;
+    std::vector<PackagedSealedMessage> withKeyIds, withoutKeyIds;
+    size_t message = 0;
+    for (size_t i = 0; i < keyCount; i++) {
+      SodiumBuffer unsealingKeyBytes(crypto_box_SECRETKEYBYTES);
+      std::vector<unsigned char> sealingKeyBytes(crypto_box_PUBLICKEYBYTES);
+      crypto_box_keypair(sealingKeyBytes.data(), unsealingKeyBytes.data);
+      registry.add(UnsealingKey(unsealingKeyBytes, sealingKeyBytes, derivationOptionsJson));
+      if (message < messageCount && i == targetKeyIndex(message)) {
+        const SealingKey sealingKey(sealingKeyBytes, derivationOptionsJson);
+        withKeyIds.push_back(sealingKey.sealWithKeyId(plaintext));
+        withoutKeyIds.push_back(sealingKey.seal(plaintext));
+        message++;
+      }
+    }
+    benchmarkRouting("UnsealingKey", registry, withKeyIds, withoutKeyIds);
+
+    Bench::printHeader("Key ID lookup alone");
+    size_t next = 0;
+    Bench::printRate("findUnsealingKey", Bench::operationsPerSecond([&]() {
+      const std::vector<unsigned char>& keyId = withKeyIds[next++ % messageCount].keyId;
+      registry.findUnsealingKey(keyId.data(), keyId.size());
+    }));
+  }
+
+  {
+    const std::string derivationOptionsJson = R"({"type": "SymmetricKey"})";
+    KeyRegistry registry;
+    std::vector<PackagedSealedMessage> withKeyIds, withoutKeyIds;
+    size_t message = 0;
+    for (size_t i = 0; i < keyCount; i++) {
+      SodiumBuffer keyBytes(crypto_secretbox_KEYBYTES);
+      randombytes_buf(keyBytes.data, keyBytes.length);
+      const SymmetricKey symmetricKey(keyBytes, derivationOptionsJson);
+      registry.add(symmetricKey);
+      if (message < messageCount && i == targetKeyIndex(message)) {
+        withKeyIds.push_back(symmetricKey.sealWithKeyId(plaintext));
+        withoutKeyIds.push_back(symmetricKey.seal(plaintext));
+        message++;
+      }
+    }
+    benchmarkRouting("SymmetricKey", registry, withKeyIds, withoutKeyIds);
+  }
+
+  return 0;
+}
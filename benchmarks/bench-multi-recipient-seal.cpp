@@ -0,0 +1,52 @@
+// Sealing one message for many recipients: one SealingKey::seal per
+// recipient versus a single MultiRecipientSealedMessage.
+
+#include <vector>
+#include <sodium.h>
+#include "lib-seeded.hpp"
+#include "bench-util.hpp"
+
+int main() {
+  ensureSodiumInitialized();
+  const size_t recipientCounts[] = {10, 100, 500};
+  const size_t messageSizes[] = {1024, 65536};
+
+  std::vector<SealingKey> sealingKeys;
+  for (size_t i = 0; i < 500; i++) {
+    sealingKeys.push_back(UnsealingKey("bench-multi-recipient-seal " + std::to_string(i), "{}").getSealingKey());
+  }
+  const UnsealingKey lastRecipient("bench-multi-recipient-seal 499", "{}");
+
+  for (size_t messageSize : messageSizes) {
+    const std::vector<unsigned char> message(messageSize, 0x5a);
+    Bench::printHeader("Seal " + std::to_string(messageSize) + "B message");
+    for (size_t recipientCount : recipientCounts) {
+      const std::vector<SealingKey> recipients(sealingKeys.begin(), sealingKeys.begin() + recipientCount);
+
+      size_t separateBytes = 0;
+      const double separateRate = Bench::operationsPerSecond([&]() {
+        separateBytes = 0;
+        for (const SealingKey& recipient : recipients) {
+          separateBytes += recipient.sealToCiphertextOnly(message.data(), message.size()).size();
+        }
+      });
+      size_t multiRecipientBytes = 0;
+      const double multiRecipientRate = Bench::operationsPerSecond([&]() {
+        multiRecipientBytes = MultiRecipientSealedMessage::seal(message, recipients).toSerializedBinaryForm().length;
+      });
+
+      std::printf("%4zu recipients: separate seals %10.1f msgs/s %10zu bytes   multi-recipient %10.1f msgs/s %10zu bytes\n",
+        recipientCount, separateRate, separateBytes, multiRecipientRate, multiRecipientBytes);
+    }
+  }
+
+  Bench::printHeader("Unseal, message sealed to 500 recipients");
+  const MultiRecipientSealedMessage sealedMessage = MultiRecipientSealedMessage::seal(
+    std::vector<unsigned char>(1024, 0x5a), sealingKeys
+  );
+  Bench::printRate("UnsealingKey::unseal (last recipient)", Bench::operationsPerSecond([&]() {
+    lastRecipient.unseal(sealedMessage);
+  }));
+
+  return 0;
+}
@@ -0,0 +1,41 @@
+// Single-signature verification latency: SignatureVerificationKey::verify
+// (libsodium's crypto_sign_verify_detached) before and after
+// prepareForRepeatedVerification, plus the one-time cost of preparing.
+
+#include <vector>
+#include <sodium.h>
+#include "lib-seeded.hpp"
+#include "bench-util.hpp"
+
+int main() {
+  ensureSodiumInitialized();
+  SigningKey signingKey("bench-prepared-verify", "{}");
+  const SignatureVerificationKey key = signingKey.getSignatureVerificationKey();
+  const SignatureVerificationKey preparedKey = signingKey.getSignatureVerificationKey();
+  if (!PreparedSignatureVerifier::isAccelerated()) {
+    std::printf("(this build falls back to crypto_sign_verify_detached)\n");
+  }
+
+  Bench::printHeader("Preparing a key");
+  Bench::printLatency("PreparedSignatureVerifier constructor", Bench::operationsPerSecond([&]() {
+    PreparedSignatureVerifier verifier(key.signatureVerificationKeyBytes);
+  }));
+  // Prepare one copy of the key, then drop it from the process-wide
+  // cache so that the other copy is verified the unprepared way.
+  preparedKey.prepareForRepeatedVerification();
+  PreparedSignatureVerifier::forgetAll();
+
+  for (size_t messageLength : { 64, 1024 }) {
+    const std::vector<unsigned char> message(messageLength, 0x5a);
+    const std::vector<unsigned char> signature = signingKey.generateSignature(message);
+    Bench::printHeader(std::to_string(messageLength) + "B message");
+    Bench::printLatency("SignatureVerificationKey::verify", Bench::operationsPerSecond([&]() {
+      key.verify(message, signature);
+    }));
+    Bench::printLatency("... after prepareForRepeatedVerification", Bench::operationsPerSecond([&]() {
+      preparedKey.verify(message, signature);
+    }));
+  }
+
+  return 0;
+}
@@ -0,0 +1,132 @@
+// A directory of 1M sealing keys with 20 distinct derivation options: a
+// vector of SealingKey objects indexed by an unordered_map from key bytes,
+// against a PublicKeyStore.  Reports heap bytes per key, load time, and
+// random-lookup throughput (lookups by key bytes and, for the store, by key ID).
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <sodium.h>
+#include "lib-seeded.hpp"
+#include "bench-util.hpp"
+
+// Heap accounting: every allocation records its size in a header so that
+// the bytes currently live can be tracked
+static size_t liveBytes = 0;
+static const size_t headerLength = 16;
+
+void* operator new(size_t length) {
+  unsigned char* block = (unsigned char*) std::malloc(length + headerLength);
+  if (block == NULL) {
+    throw std::bad_alloc();
+  }
+  *(size_t*) block = length;
+  liveBytes += length;
+  return block + headerLength;
+}
+
+void operator delete(void* pointer) noexcept {
+  if (pointer == NULL) {
+    return;
+  }
+  unsigned char* block = (unsigned char*) pointer - headerLength;
+  liveBytes -= *(size_t*) block;
+  std::free(block);
+}
+
+static volatile size_t sink;
+
+static const size_t keyCount = 1000000;
+static const size_t distinctOptionsCount = 20;
+
+static void printBytesPerKey(const std::string& name, size_t bytes) {
+  std::printf("%-48s %14.1f bytes/key\n", name.c_str(), double(bytes) / keyCount);
+}
+
+int main() {
+  ensureSodiumInitialized();
+  std::vector<InternedString> options;
+  for (size_t i = 0; i < distinctOptionsCount; i++) {
+    options.push_back(R"({"type": "UnsealingKey", "algorithm": "X25519", "additionalSalt": ")" + std::to_string(i) + R"("})");
+  }
+  std::vector<unsigned char> allKeyBytes(keyCount * PublicKeyStore::keyBytesLength);
+  randombytes_buf(allKeyBytes.data(), allKeyBytes.size());
+  // Serialized as SealingKey::toSerializedBinaryForm would, but into byte
+  // vectors: a million SodiumBuffers would each take guarded pages of their own
+  std::vector<std::vector<unsigned char>> serializedKeys;
+  serializedKeys.reserve(keyCount);
+  for (size_t i = 0; i < keyCount; i++) {
+    const SodiumBuffer::FixedLengthListItem bytes(allKeyBytes.data() + i * PublicKeyStore::keyBytesLength, PublicKeyStore::keyBytesLength);
+    const InternedString& json = options[i % options.size()];
+    serializedKeys.push_back(std::vector<unsigned char>(SodiumBuffer::fixedLengthListSize(bytes, json.str())));
+    SodiumBuffer::writeFixedLengthList(serializedKeys.back().data(), serializedKeys.back().size(), bytes, json.str());
+  }
+  std::vector<std::vector<unsigned char>> keyIds;
+  keyIds.reserve(keyCount);
+  for (size_t i = 0; i < keyCount; i++) {
+    keyIds.push_back(SealingKey::getKeyId(std::vector<unsigned char>(
+      allKeyBytes.data() + i * PublicKeyStore::keyBytesLength,
+      allKeyBytes.data() + (i + 1) * PublicKeyStore::keyBytesLength
+    )));
+  }
+  // Look keys up in a random order, so that lookups miss the cache as they
+  // would in a large directory
+  std::vector<uint32_t> lookupOrder(keyCount);
+  for (size_t i = 0; i < keyCount; i++) {
+    lookupOrder[i] = uint32_t(i);
+  }
+  for (size_t i = keyCount - 1; i > 0; i--) {
+    std::swap(lookupOrder[i], lookupOrder[randombytes_uniform(uint32_t(i + 1))]);
+  }
+
+  Bench::printHeader(std::to_string(keyCount) + " SealingKeys, " + std::to_string(distinctOptionsCount) + " distinct options");
+  {
+    const size_t before = liveBytes;
+    Bench::Clock::time_point start = Bench::Clock::now();
+    std::vector<SealingKey> keys;
+    keys.reserve(keyCount);
+    std::unordered_map<std::string, size_t> index;
+    index.reserve(keyCount);
+    for (size_t i = 0; i < keyCount; i++) {
+      const unsigned char* itemData[2];
+      size_t itemLengths[2];
+      SodiumBuffer::locateFixedLengthListItems(serializedKeys[i].data(), serializedKeys[i].size(), 2, itemData, itemLengths);
+      keys.push_back(SealingKey(
+        std::vector<unsigned char>(itemData[0], itemData[0] + itemLengths[0]),
+        std::string((const char*) itemData[1], itemLengths[1])
+      ));
+      index[std::string((const char*) keys.back().sealingKeyBytes.data(), keys.back().sealingKeyBytes.size())] = i;
+    }
+    const double seconds = Bench::secondsSince(start);
+    printBytesPerKey("vector<SealingKey> + unordered_map: heap", liveBytes - before);
+    Bench::printRate("vector<SealingKey> + unordered_map: load", keyCount / seconds);
+    size_t next = 0;
+    Bench::printRate("vector<SealingKey> + unordered_map: find", Bench::operationsPerSecond([&]() {
+      const unsigned char* bytes = allKeyBytes.data() + size_t(lookupOrder[next++ % keyCount]) * PublicKeyStore::keyBytesLength;
+      sink = index.find(std::string((const char*) bytes, PublicKeyStore::keyBytesLength))->second;
+    }));
+  }
+  {
+    const size_t before = liveBytes;
+    Bench::Clock::time_point start = Bench::Clock::now();
+    PublicKeyStore store;
+    store.bulkLoad(PublicKeyType::SealingKey, serializedKeys);
+    const double seconds = Bench::secondsSince(start);
+    printBytesPerKey("PublicKeyStore: heap", liveBytes - before);
+    printBytesPerKey("PublicKeyStore: getMemoryUsage", store.getMemoryUsage());
+    Bench::printRate("PublicKeyStore: bulkLoad", keyCount / seconds);
+    size_t next = 0;
+    Bench::printRate("PublicKeyStore: findSealingKey", Bench::operationsPerSecond([&]() {
+      const unsigned char* bytes = allKeyBytes.data() + size_t(lookupOrder[next++ % keyCount]) * PublicKeyStore::keyBytesLength;
+      sink = store.findSealingKey(bytes).getDerivationOptionsJson().size();
+    }));
+    Bench::printRate("PublicKeyStore: findSealingKeyById", Bench::operationsPerSecond([&]() {
+      const std::vector<unsigned char>& keyId = keyIds[lookupOrder[next++ % keyCount]];
+      sink = store.findSealingKeyById(keyId.data(), keyId.size()).getDerivationOptionsJson().size();
+    }));
+  }
+  return 0;
+}
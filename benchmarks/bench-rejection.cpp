@@ -0,0 +1,61 @@
+// Rejecting junk: invalid ciphertexts and malformed JSON rejected per
+// second on one core, by the throwing unseal/fromJson (caught) and by
+// the non-throwing tryUnseal/tryFromJson, which authenticate before
+// allocating a plaintext buffer.
+
+#include <string>
+#include <vector>
+#include <sodium.h>
+#include "lib-seeded.hpp"
+#include "bench-util.hpp"
+
+static std::vector<unsigned char> corrupt(std::vector<unsigned char> ciphertext) {
+  ciphertext[ciphertext.size() - 1] ^= 1;
+  return ciphertext;
+}
+
+int main() {
+  ensureSodiumInitialized();
+  const UnsealingKey unsealingKey("bench-rejection", "{}");
+  const SymmetricKey symmetricKey("bench-rejection", "{}");
+  const std::string unsealingInstructions = "{}";
+
+  for (size_t messageLength : { (size_t) 64, (size_t) 65536 }) {
+    const std::vector<unsigned char> message(messageLength, 0x5a);
+    const std::vector<unsigned char> forgedSealed =
+      corrupt(unsealingKey.getSealingKey().seal(message, unsealingInstructions).ciphertext);
+    const std::vector<unsigned char> forgedSymmetric =
+      corrupt(symmetricKey.seal(message, unsealingInstructions).ciphertext);
+
+    Bench::printHeader("Invalid " + std::to_string(messageLength) + "B ciphertexts rejected, one core");
+    Bench::printRate("UnsealingKey::unseal (throws)", Bench::operationsPerSecond([&]() {
+      try {
+        unsealingKey.unseal(forgedSealed, unsealingInstructions);
+      } catch (...) {}
+    }));
+    Bench::printRate("UnsealingKey::tryUnseal", Bench::operationsPerSecond([&]() {
+      unsealingKey.tryUnseal(forgedSealed.data(), forgedSealed.size(), unsealingInstructions);
+    }));
+    Bench::printRate("SymmetricKey::unseal (throws)", Bench::operationsPerSecond([&]() {
+      try {
+        symmetricKey.unseal(forgedSymmetric, unsealingInstructions);
+      } catch (...) {}
+    }));
+    Bench::printRate("SymmetricKey::tryUnseal", Bench::operationsPerSecond([&]() {
+      symmetricKey.tryUnseal(forgedSymmetric.data(), forgedSymmetric.size(), unsealingInstructions);
+    }));
+  }
+
+  const std::string malformedJson = R"({"ciphertext": "00112233445566778899aabbccddeeffgg"})";
+  Bench::printHeader("Malformed PackagedSealedMessage JSON rejected, one core");
+  Bench::printRate("fromJson (throws)", Bench::operationsPerSecond([&]() {
+    try {
+      PackagedSealedMessage::fromJson(malformedJson);
+    } catch (...) {}
+  }));
+  Bench::printRate("tryFromJson", Bench::operationsPerSecond([&]() {
+    PackagedSealedMessage::tryFromJson(malformedJson);
+  }));
+
+  return 0;
+}
@@ -0,0 +1,65 @@
+// Latency of SealingKey::seal with and without an EphemeralKeyPool.
+//
+// Seals arrive in bursts separated by idle gaps, as they would from a
+// request-driven service.  With a pool installed, the background thread
+// regenerates ephemeral key pairs during the gaps, taking the key
+// generation off the latency-critical path.
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <sodium.h>
+#include "lib-seeded.hpp"
+#include "bench-util.hpp"
+
+static const size_t burstLength = 64;
+static const size_t bursts = 200;
+static const std::chrono::milliseconds gapBetweenBursts(5);
+
+static void reportSealLatency(
+  const std::string& name,
+  const SealingKey& sealingKey,
+  const std::vector<unsigned char>& message
+) {
+  std::vector<double> latencies;
+  latencies.reserve(burstLength * bursts);
+  for (size_t burst = 0; burst < bursts; burst++) {
+    std::this_thread::sleep_for(gapBetweenBursts);
+    for (size_t i = 0; i < burstLength; i++) {
+      const Bench::Clock::time_point start = Bench::Clock::now();
+      const PackagedSealedMessage sealed = sealingKey.seal(message, "{}");
+      latencies.push_back(Bench::secondsSince(start) * 1e6);
+    }
+  }
+  std::sort(latencies.begin(), latencies.end());
+  std::printf("%-48s p50 %8.2f us   p99 %8.2f us   max %8.2f us\n",
+    name.c_str(),
+    latencies[latencies.size() / 2],
+    latencies[(latencies.size() * 99) / 100],
+    latencies.back()
+  );
+}
+
+int main() {
+  ensureSodiumInitialized();
+  const UnsealingKey unsealingKey("bench-seal-latency seed", "{}");
+  const SealingKey sealingKey = unsealingKey.getSealingKey();
+  const std::vector<unsigned char> message(256, 0x5a);
+
+  Bench::printHeader(
+    "SealingKey::seal 256B, bursts of " + std::to_string(burstLength) +
+    " every " + std::to_string(gapBetweenBursts.count()) + "ms"
+  );
+
+  EphemeralKeyPool::setDefault(std::shared_ptr<EphemeralKeyPool>());
+  reportSealLatency("inline ephemeral key generation", sealingKey, message);
+
+  std::shared_ptr<EphemeralKeyPool> pool = std::make_shared<EphemeralKeyPool>(burstLength * 2);
+  EphemeralKeyPool::setDefault(pool);
+  reportSealLatency("EphemeralKeyPool(" + std::to_string(pool->getCapacity()) + ")", sealingKey, message);
+  std::printf("pool hits %llu misses %llu\n", pool->getHits(), pool->getMisses());
+  EphemeralKeyPool::setDefault(std::shared_ptr<EphemeralKeyPool>());
+
+  return 0;
+}
@@ -0,0 +1,46 @@
+// Throughput of sealing and unsealing between two fixed parties:
+// SealingKey::seal / UnsealingKey::unseal (one X25519 operation per message
+// to seal, one to unseal) versus a SealingSession (one X25519 operation
+// when the session is constructed).
+
+#include <vector>
+#include <sodium.h>
+#include "lib-seeded.hpp"
+#include "bench-util.hpp"
+
+int main() {
+  ensureSodiumInitialized();
+  const UnsealingKey senderKey("bench-sealing-session sender", "{}");
+  const UnsealingKey recipientKey("bench-sealing-session recipient", "{}");
+  const SealingKey recipientSealingKey = recipientKey.getSealingKey();
+  const SealingSession senderSession(senderKey, recipientSealingKey);
+  const SealingSession recipientSession(recipientKey, senderKey.getSealingKey());
+
+  Bench::printRate("SealingSession construction", Bench::operationsPerSecond([&]() {
+    SealingSession(senderKey, recipientSealingKey);
+  }));
+
+  const size_t messageSizes[] = {64, 1024, 16384};
+  for (size_t messageSize : messageSizes) {
+    const std::vector<unsigned char> message(messageSize, 0x5a);
+    Bench::printHeader(std::to_string(messageSize) + "B messages");
+
+    Bench::printThroughput("SealingKey::seal", Bench::operationsPerSecond([&]() {
+      recipientSealingKey.seal(message, "{}");
+    }), messageSize);
+    Bench::printThroughput("SealingSession::seal", Bench::operationsPerSecond([&]() {
+      senderSession.seal(message, "{}");
+    }), messageSize);
+
+    const PackagedSealedMessage sealedWithKey = recipientSealingKey.seal(message, "{}");
+    const PackagedSealedMessage sealedWithSession = senderSession.seal(message, "{}");
+    Bench::printThroughput("UnsealingKey::unseal", Bench::operationsPerSecond([&]() {
+      recipientKey.unseal(sealedWithKey);
+    }), messageSize);
+    Bench::printThroughput("SealingSession::unseal", Bench::operationsPerSecond([&]() {
+      recipientSession.unseal(sealedWithSession);
+    }), messageSize);
+  }
+
+  return 0;
+}
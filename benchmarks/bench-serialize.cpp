@@ -0,0 +1,61 @@
+// Serializing keys and sealed messages: copying each field into a temporary
+// SodiumBuffer and combining pointers to them (as toSerializedBinaryForm
+// used to), against toSerializedBinaryForm's single allocation, against
+// serializeInto a buffer the caller reuses.
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <sodium.h>
+#include "lib-seeded.hpp"
+#include "bench-util.hpp"
+
+static volatile unsigned char sink;
+
+template <typename Serializable, typename Fields>
+static void benchSerialize(const std::string& name, const Serializable& serializable, Fields combineFromCopies) {
+  const size_t size = serializable.serializedSize();
+  Bench::printHeader(name + ", " + std::to_string(size) + " bytes");
+  Bench::printRate("copy fields, then combineFixedLengthList", Bench::operationsPerSecond([&]() {
+    sink = combineFromCopies().data[0];
+  }));
+  Bench::printRate("toSerializedBinaryForm", Bench::operationsPerSecond([&]() {
+    sink = serializable.toSerializedBinaryForm().data[0];
+  }));
+  std::vector<unsigned char> out(size);
+  Bench::printRate("serializeInto (reused buffer)", Bench::operationsPerSecond([&]() {
+    serializable.serializeInto(out.data(), out.size());
+    sink = out[0];
+  }));
+}
+
+int main() {
+  ensureSodiumInitialized();
+  const std::string seed = "A1tB2rC3bD4lE5tF6bG1tH1tI1tJ1tK1tL1tM1tN1tO1tP1tR1tS1tT1tU1tV1tW1tX1tY1tZ1t";
+  const SymmetricKey symmetricKey(seed, R"({"type": "SymmetricKey"})");
+  const UnsealingKey unsealingKey(seed, R"({"type": "UnsealingKey"})");
+  const SealingKey sealingKey = unsealingKey.getSealingKey();
+  const PackagedSealedMessage message = symmetricKey.seal(std::vector<unsigned char>(1024, 'x'), R"({"note": "bench"})");
+
+  benchSerialize("SymmetricKey", symmetricKey, [&]() {
+    SodiumBuffer derivationOptionsJson(symmetricKey.derivationOptionsJson);
+    return SodiumBuffer::combineFixedLengthList({ &symmetricKey.keyBytes, &derivationOptionsJson });
+  });
+  benchSerialize("SealingKey", sealingKey, [&]() {
+    SodiumBuffer sealingKeyBytes(sealingKey.sealingKeyBytes);
+    SodiumBuffer derivationOptionsJson(sealingKey.derivationOptionsJson);
+    return SodiumBuffer::combineFixedLengthList({ &sealingKeyBytes, &derivationOptionsJson });
+  });
+  benchSerialize("UnsealingKey", unsealingKey, [&]() {
+    SodiumBuffer sealingKeyBytes(unsealingKey.sealingKeyBytes);
+    SodiumBuffer derivationOptionsJson(unsealingKey.derivationOptionsJson);
+    return SodiumBuffer::combineFixedLengthList({ &unsealingKey.unsealingKeyBytes, &sealingKeyBytes, &derivationOptionsJson });
+  });
+  benchSerialize("PackagedSealedMessage", message, [&]() {
+    SodiumBuffer ciphertext(message.ciphertext);
+    SodiumBuffer derivationOptionsJson(message.derivationOptionsJson);
+    SodiumBuffer unsealingInstructions(message.unsealingInstructions);
+    return SodiumBuffer::combineFixedLengthList({ &ciphertext, &derivationOptionsJson, &unsealingInstructions });
+  });
+  return 0;
+}
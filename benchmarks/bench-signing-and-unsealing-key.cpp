@@ -0,0 +1,28 @@
+// Deriving an identity that can both sign and unseal: a SigningKey and an
+// UnsealingKey derived separately (two runs of the derivation hash
+// function) versus one SigningAndUnsealingKey (one run), for a cheap
+// hash function and for Argon2id with its default memory and passes.
+
+#include <string>
+#include <sodium.h>
+#include "lib-seeded.hpp"
+#include "bench-util.hpp"
+
+int main() {
+  ensureSodiumInitialized();
+  const std::string seed = "bench-signing-and-unsealing-key";
+
+  for (const std::string hashFunction : { "BLAKE2b", "Argon2id" }) {
+    const std::string options = "{\"hashFunction\": \"" + hashFunction + "\"}";
+    Bench::printHeader(hashFunction);
+    Bench::printLatency("SigningKey + UnsealingKey", Bench::operationsPerSecond([&]() {
+      SigningKey signingKey(seed, options);
+      UnsealingKey unsealingKey(seed, options);
+    }));
+    Bench::printLatency("SigningAndUnsealingKey", Bench::operationsPerSecond([&]() {
+      SigningAndUnsealingKey key(seed, options);
+    }));
+  }
+
+  return 0;
+}
@@ -0,0 +1,82 @@
+// Throughput of the libsodium primitives underneath this library.
+//
+// Run once from a build configured with -DSODIUM_ENABLE_SIMD=ON (the default)
+// and once with -DSODIUM_ENABLE_SIMD=OFF to compare the SSE/AVX kernels
+// against the portable reference implementations.
+
+#include <vector>
+#include <sodium.h>
+#include "lib-seeded.hpp"
+#include "bench-util.hpp"
+
+int main() {
+  ensureSodiumInitialized();
+  std::printf("libsodium %s\n", sodium_version_string());
+  std::printf("active implementations: %s\n", getActiveSodiumImplementations().toString().c_str());
+
+  unsigned char key[crypto_secretbox_KEYBYTES];
+  unsigned char nonce[crypto_secretbox_NONCEBYTES];
+  randombytes_buf(key, sizeof key);
+  randombytes_buf(nonce, sizeof nonce);
+
+  Bench::printHeader("secretbox (XSalsa20Poly1305)");
+  const size_t messageSizes[] = {64, 1024, 65536};
+  for (size_t messageSize : messageSizes) {
+    std::vector<unsigned char> message(messageSize, 0x5a);
+    std::vector<unsigned char> ciphertext(messageSize + crypto_secretbox_MACBYTES);
+    Bench::printThroughput(
+      "crypto_secretbox_easy " + std::to_string(messageSize) + "B",
+      Bench::operationsPerSecond([&]() {
+        crypto_secretbox_easy(ciphertext.data(), message.data(), message.size(), nonce, key);
+      }),
+      messageSize
+    );
+  }
+
+  Bench::printHeader("BLAKE2b (crypto_generichash)");
+  for (size_t messageSize : messageSizes) {
+    std::vector<unsigned char> message(messageSize, 0x5a);
+    unsigned char hash[crypto_generichash_BYTES];
+    Bench::printThroughput(
+      "crypto_generichash " + std::to_string(messageSize) + "B",
+      Bench::operationsPerSecond([&]() {
+        crypto_generichash(hash, sizeof hash, message.data(), message.size(), NULL, 0);
+      }),
+      messageSize
+    );
+  }
+
+  Bench::printHeader("Argon2id (crypto_pwhash)");
+  {
+    const unsigned char salt[crypto_pwhash_argon2id_SALTBYTES] = {0};
+    const char password[] = "correct horse battery staple";
+    unsigned char out[32];
+    const size_t memoryLimits[] = {8u << 20, 64u << 20};
+    for (size_t memoryLimit : memoryLimits) {
+      Bench::printRate(
+        "crypto_pwhash argon2id ops=2 mem=" + std::to_string(memoryLimit >> 20) + "MB",
+        Bench::operationsPerSecond([&]() {
+          crypto_pwhash(out, sizeof out, password, sizeof password - 1, salt,
+            2, memoryLimit, crypto_pwhash_ALG_ARGON2ID13);
+        }, 2.0)
+      );
+    }
+  }
+
+  Bench::printHeader("X25519 (crypto_scalarmult)");
+  {
+    unsigned char scalar[crypto_scalarmult_SCALARBYTES];
+    unsigned char point[crypto_scalarmult_BYTES];
+    unsigned char result[crypto_scalarmult_BYTES];
+    randombytes_buf(scalar, sizeof scalar);
+    crypto_scalarmult_base(point, scalar);
+    Bench::printRate("crypto_scalarmult", Bench::operationsPerSecond([&]() {
+      crypto_scalarmult(result, scalar, point);
+    }));
+    Bench::printRate("crypto_scalarmult_base", Bench::operationsPerSecond([&]() {
+      crypto_scalarmult_base(result, scalar);
+    }));
+  }
+
+  return 0;
+}
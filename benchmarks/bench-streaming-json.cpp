@@ -0,0 +1,106 @@
+// PackagedSealedMessage JSON for large ciphertexts: the nlohmann::json
+// document path against the streaming writeJson/readJson, in GB/s of
+// ciphertext and in peak heap use relative to the ciphertext's size.
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <sodium.h>
+#include "lib-seeded.hpp"
+#include "bench-util.hpp"
+
+// Heap accounting: every allocation records its size in a header so that
+// the bytes currently live, and the high-water mark, can be tracked
+static size_t liveBytes = 0;
+static size_t peakBytes = 0;
+static const size_t headerLength = 16;
+
+void* operator new(size_t length) {
+  unsigned char* block = (unsigned char*) std::malloc(length + headerLength);
+  if (block == NULL) {
+    throw std::bad_alloc();
+  }
+  *(size_t*) block = length;
+  liveBytes += length;
+  if (liveBytes > peakBytes) {
+    peakBytes = liveBytes;
+  }
+  return block + headerLength;
+}
+
+void operator delete(void* pointer) noexcept {
+  if (pointer == NULL) {
+    return;
+  }
+  unsigned char* block = (unsigned char*) pointer - headerLength;
+  liveBytes -= *(size_t*) block;
+  std::free(block);
+}
+
+// The peak heap growth while running fn, as a multiple of length
+template <typename Fn>
+double peakMultiple(Fn fn, size_t length) {
+  const size_t baseline = liveBytes;
+  peakBytes = liveBytes;
+  fn();
+  return double(peakBytes - baseline) / double(length);
+}
+
+int main() {
+  ensureSodiumInitialized();
+  const size_t length = 64 << 20;
+  std::vector<unsigned char> ciphertext(length);
+  randombytes_buf(ciphertext.data(), ciphertext.size());
+  const PackagedSealedMessage message(ciphertext, "{}", "{}");
+
+  for (BinaryEncoding binaryEncoding : { BinaryEncoding::Hex, BinaryEncoding::Base64Url }) {
+    const std::string name = binaryEncodingName(binaryEncoding);
+    Bench::printHeader("PackagedSealedMessage JSON, 64MiB ciphertext, " + name);
+    const std::string json = message.toJson(-1, ' ', binaryEncoding);
+
+    const double domWritePeak = peakMultiple([&]() {
+      nlohmann::json asJson = nlohmann::json::parse(message.toJson(1, ' ', binaryEncoding));
+      asJson.dump();
+    }, length);
+    const double domReadPeak = peakMultiple([&]() {
+      nlohmann::json asJson = nlohmann::json::parse(json);
+      encodedStrToByteVector(asJson.at("ciphertext"), binaryEncoding);
+    }, length);
+    const double streamWritePeak = peakMultiple([&]() {
+      message.toJson(-1, ' ', binaryEncoding);
+    }, length);
+    const double streamReadPeak = peakMultiple([&]() {
+      PackagedSealedMessage::fromJson(json);
+    }, length);
+    std::printf("  peak heap, as a multiple of the ciphertext:\n");
+    std::printf("    document write %.2fx, read %.2fx\n", domWritePeak, domReadPeak);
+    std::printf("    streaming write %.2fx (of which %.2fx is the JSON), read %.2fx\n",
+      streamWritePeak, double(json.size()) / double(length), streamReadPeak);
+
+    Bench::printBandwidth("document parse + decode", Bench::operationsPerSecond([&]() {
+      nlohmann::json asJson = nlohmann::json::parse(json);
+      encodedStrToByteVector(asJson.at("ciphertext"), binaryEncoding);
+    }), length);
+    Bench::printBandwidth("toJson (streaming)", Bench::operationsPerSecond([&]() {
+      message.toJson(-1, ' ', binaryEncoding);
+    }), length);
+    Bench::printBandwidth("fromJson (streaming)", Bench::operationsPerSecond([&]() {
+      PackagedSealedMessage::fromJson(json);
+    }), length);
+    Bench::printBandwidth("writeJson to a stream", Bench::operationsPerSecond([&]() {
+      std::ostringstream out;
+      message.writeJson(out, binaryEncoding);
+    }), length);
+    std::istringstream in(json);
+    Bench::printBandwidth("readJson from a stream", Bench::operationsPerSecond([&]() {
+      in.clear();
+      in.seekg(0);
+      PackagedSealedMessage::readJson(in);
+    }), length);
+  }
+
+  return 0;
+}
@@ -0,0 +1,67 @@
+// Ed25519ph signing and verification throughput of a large file, read
+// through a buffer and mapped into memory window by window.
+//
+//   bench-streaming-sign [size-in-MB] [path]
+//
+// The file is created, filled, and removed by the benchmark.  To measure
+// files larger than RAM (so that they cannot sit in the page cache), pass
+// a size larger than physical memory and a path on the disk of interest.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <sodium.h>
+#include "lib-seeded.hpp"
+#include "bench-util.hpp"
+
+namespace {
+  void printGigabytesPerSecond(const std::string& name, uint64_t bytes, double seconds) {
+    std::printf("%-48s %14.3f GB/s\n", name.c_str(), double(bytes) / seconds / 1e9);
+  }
+}
+
+int main(int argc, char** argv) {
+  ensureSodiumInitialized();
+  const uint64_t megabytes = argc > 1 ? strtoull(argv[1], NULL, 10) : 1024;
+  const std::string path = argc > 2 ? argv[2] : "bench-streaming-sign.tmp";
+  const uint64_t fileSize = megabytes << 20;
+
+  {
+    std::vector<unsigned char> chunk(1 << 20);
+    randombytes_buf(chunk.data(), chunk.size());
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == NULL) {
+      std::fprintf(stderr, "Could not create %s\n", path.c_str());
+      return 1;
+    }
+    for (uint64_t written = 0; written < fileSize; written += chunk.size()) {
+      fwrite(chunk.data(), 1, chunk.size(), file);
+    }
+    fclose(file);
+  }
+
+  SigningKey signingKey("bench-streaming-sign", "{}");
+  const SignatureVerificationKey verificationKey = signingKey.getSignatureVerificationKey();
+  Bench::printHeader(std::to_string(megabytes) + "MB file");
+
+  Bench::Clock::time_point start = Bench::Clock::now();
+  StreamingSigner readSigner(signingKey);
+  readSigner.updateFromFile(path);
+  const std::vector<unsigned char> signature = readSigner.finalize();
+  printGigabytesPerSecond("StreamingSigner::updateFromFile", fileSize, Bench::secondsSince(start));
+
+  start = Bench::Clock::now();
+  StreamingSigner mappedSigner(signingKey);
+  mappedSigner.updateFromMemoryMappedFile(path);
+  mappedSigner.finalize();
+  printGigabytesPerSecond("StreamingSigner::updateFromMemoryMappedFile", fileSize, Bench::secondsSince(start));
+
+  start = Bench::Clock::now();
+  StreamingSignatureVerifier verifier(verificationKey);
+  verifier.updateFromMemoryMappedFile(path);
+  const bool valid = verifier.verify(signature);
+  printGigabytesPerSecond("StreamingSignatureVerifier (mapped)", fileSize, Bench::secondsSince(start));
+
+  remove(path.c_str());
+  return valid ? 0 : 1;
+}
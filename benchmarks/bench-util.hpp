@@ -0,0 +1,65 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+// Minimal timing helpers shared by the benchmark programs.
+// Each benchmark runs an operation repeatedly until at least
+// minimumSeconds have elapsed and reports the average rate.
+
+namespace Bench {
+
+  typedef std::chrono::steady_clock Clock;
+
+  inline double secondsSince(const Clock::time_point& start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+  }
+
+  /**
+   * Run fn() repeatedly, in batches, until minimumSeconds have elapsed.
+   * Returns the number of calls per second.
+   */
+  template <typename Fn>
+  double operationsPerSecond(Fn fn, double minimumSeconds = 0.5) {
+    // Warm up caches, lazy initialization, and CPU frequency.
+    fn();
+    size_t iterations = 0;
+    size_t batch = 1;
+    const Clock::time_point start = Clock::now();
+    double elapsed = 0;
+    do {
+      for (size_t i = 0; i < batch; i++) {
+        fn();
+      }
+      iterations += batch;
+      if (batch < (1u << 16)) {
+        batch *= 2;
+      }
+      elapsed = secondsSince(start);
+    } while (elapsed < minimumSeconds);
+    return double(iterations) / elapsed;
+  }
+
+  inline void printHeader(const std::string& title) {
+    std::printf("\n== %s ==\n", title.c_str());
+  }
+
+  inline void printRate(const std::string& name, double opsPerSecond) {
+    std::printf("%-48s %14.1f ops/s\n", name.c_str(), opsPerSecond);
+  }
+
+  inline void printLatency(const std::string& name, double opsPerSecond) {
+    std::printf("%-48s %14.2f us/op\n", name.c_str(), 1e6 / opsPerSecond);
+  }
+
+  inline void printThroughput(const std::string& name, double opsPerSecond, size_t bytesPerOp) {
+    std::printf("%-48s %14.1f ops/s %10.1f MB/s\n",
+      name.c_str(), opsPerSecond, opsPerSecond * double(bytesPerOp) / 1e6);
+  }
+
+  inline void printBandwidth(const std::string& name, double opsPerSecond, size_t bytesPerOp) {
+    std::printf("%-48s %14.2f GB/s\n", name.c_str(), opsPerSecond * double(bytesPerOp) / 1e9);
+  }
+
+}
@@ -0,0 +1,49 @@
+// Verifying signed tokens that are presented repeatedly: a working set of
+// distinct (message, signature) pairs verified round-robin, without a
+// VerificationCache and then with one installed, plus the cost of a miss.
+
+#include <memory>
+#include <vector>
+#include <sodium.h>
+#include "lib-seeded.hpp"
+#include "bench-util.hpp"
+
+int main() {
+  ensureSodiumInitialized();
+  SigningKey signingKey("bench-verification-cache", "{}");
+  const SignatureVerificationKey key = signingKey.getSignatureVerificationKey();
+
+  const size_t tokenCount = 1000;
+  std::vector<std::vector<unsigned char>> tokens;
+  std::vector<std::vector<unsigned char>> signatures;
+  for (size_t i = 0; i < tokenCount; i++) {
+    std::vector<unsigned char> token(256, 0x5a);
+    token[0] = (unsigned char) i;
+    token[1] = (unsigned char) (i >> 8);
+    signatures.push_back(signingKey.generateSignature(token));
+    tokens.push_back(token);
+  }
+
+  size_t next = 0;
+  const auto verifyNextToken = [&]() {
+    key.verify(tokens[next], signatures[next]);
+    next = (next + 1) % tokenCount;
+  };
+
+  Bench::printHeader(std::to_string(tokenCount) + " tokens of 256B, verified round-robin");
+  Bench::printLatency("no cache", Bench::operationsPerSecond(verifyNextToken));
+
+  const std::shared_ptr<VerificationCache> cache = std::make_shared<VerificationCache>();
+  VerificationCache::setDefault(cache);
+  Bench::printLatency("VerificationCache", Bench::operationsPerSecond(verifyNextToken));
+  std::printf("  hit rate %.4f\n", cache->getHitRate());
+
+  // Every lookup misses: the cost of the digest and insertion on top of verification
+  const std::shared_ptr<VerificationCache> tinyCache = std::make_shared<VerificationCache>(1, std::chrono::minutes(5), 1);
+  VerificationCache::setDefault(tinyCache);
+  Bench::printLatency("VerificationCache, always missing", Bench::operationsPerSecond(verifyNextToken));
+  std::printf("  hit rate %.4f\n", tinyCache->getHitRate());
+  VerificationCache::setDefault(nullptr);
+
+  return 0;
+}
@@ -0,0 +1,49 @@
+// Signature verifications per second: SignatureVerificationKey::verify,
+// one at a time, versus verifyBatch for a batch of signatures from a
+// handful of keys.
+
+#include <vector>
+#include <sodium.h>
+#include "lib-seeded.hpp"
+#include "bench-util.hpp"
+
+int main() {
+  ensureSodiumInitialized();
+  const size_t keyCount = 4;
+  const size_t batchSize = 4096;
+  std::printf("%zu threads in default pool\n", WorkStealingPool::getDefault().getThreadCount());
+
+  std::vector<SignatureVerificationKey> keys;
+  std::vector<std::vector<unsigned char>> messages;
+  std::vector<std::vector<unsigned char>> signatures;
+  std::vector<SigningKey> signingKeys;
+  for (size_t k = 0; k < keyCount; k++) {
+    signingKeys.push_back(SigningKey("bench-verify-batch " + std::to_string(k), "{}"));
+    keys.push_back(signingKeys.back().getSignatureVerificationKey());
+  }
+  for (size_t i = 0; i < batchSize; i++) {
+    messages.push_back(std::vector<unsigned char>(128, (unsigned char) i));
+    signatures.push_back(signingKeys[i % keyCount].generateSignature(messages.back()));
+  }
+  std::vector<SignatureVerificationKey::BatchVerificationItem> items;
+  for (size_t i = 0; i < batchSize; i++) {
+    const SignatureVerificationKey& key = keys[i % keyCount];
+    items.push_back({
+      key.signatureVerificationKeyBytes.data(), key.signatureVerificationKeyBytes.size(),
+      messages[i].data(), messages[i].size(),
+      signatures[i].data(), signatures[i].size()
+    });
+  }
+
+  Bench::printHeader(std::to_string(batchSize) + " signatures of 128B messages by " + std::to_string(keyCount) + " keys");
+  Bench::printRate("SignatureVerificationKey::verify", batchSize * Bench::operationsPerSecond([&]() {
+    for (size_t i = 0; i < batchSize; i++) {
+      keys[i % keyCount].verify(messages[i], signatures[i]);
+    }
+  }));
+  Bench::printRate("SignatureVerificationKey::verifyBatch", batchSize * Bench::operationsPerSecond([&]() {
+    SignatureVerificationKey::verifyBatch(items);
+  }));
+
+  return 0;
+}
@@ -0,0 +1,57 @@
+// X25519 operations per second on one core: libsodium's crypto_scalarmult,
+// one at a time, versus x25519Batch (four at a time with AVX2 when available),
+// followed by the batch seal and unseal paths built on it.
+
+#include <vector>
+#include <sodium.h>
+#include "lib-seeded.hpp"
+#include "bench-util.hpp"
+
+int main() {
+  ensureSodiumInitialized();
+  std::printf("x25519Batch vectorized: %s\n", x25519BatchIsVectorized() ? "yes (AVX2, 4 lanes)" : "no");
+
+  const size_t count = 64;
+  std::vector<unsigned char> scalars(count * crypto_scalarmult_SCALARBYTES);
+  std::vector<unsigned char> points(count * crypto_scalarmult_BYTES);
+  std::vector<unsigned char> sharedSecrets(count * crypto_scalarmult_BYTES);
+  std::vector<int> results(count);
+  randombytes_buf(scalars.data(), scalars.size());
+  randombytes_buf(points.data(), points.size());
+
+  Bench::printHeader("X25519, one core");
+  Bench::printRate("crypto_scalarmult", count * Bench::operationsPerSecond([&]() {
+    for (size_t i = 0; i < count; i++) {
+      crypto_scalarmult(&sharedSecrets[i * crypto_scalarmult_BYTES], &scalars[i * crypto_scalarmult_SCALARBYTES], &points[i * crypto_scalarmult_BYTES]);
+    }
+  }));
+  Bench::printRate("x25519Batch", count * Bench::operationsPerSecond([&]() {
+    x25519Batch(sharedSecrets.data(), scalars.data(), points.data(), count, results.data());
+  }));
+
+  const size_t threads = WorkStealingPool::getDefault().getThreadCount();
+  Bench::printHeader("Seal/unseal 256B messages, per core (" + std::to_string(threads) + " threads)");
+  const UnsealingKey unsealingKey("bench-x25519-batch seed", "{}");
+  const SealingKey sealingKey = unsealingKey.getSealingKey();
+  const std::vector<std::vector<unsigned char>> messages(count, std::vector<unsigned char>(256, 0x5a));
+  const std::vector<PackagedSealedMessage> sealedMessages = sealingKey.sealBatch(messages, "{}");
+
+  Bench::printRate("SealingKey::seal", count * Bench::operationsPerSecond([&]() {
+    for (const std::vector<unsigned char>& message : messages) {
+      sealingKey.seal(message, "{}");
+    }
+  }));
+  Bench::printRate("SealingKey::sealBatch", count * Bench::operationsPerSecond([&]() {
+    sealingKey.sealBatch(messages, "{}");
+  }) / threads);
+  Bench::printRate("UnsealingKey::unseal", count * Bench::operationsPerSecond([&]() {
+    for (const PackagedSealedMessage& message : sealedMessages) {
+      unsealingKey.unseal(message);
+    }
+  }));
+  Bench::printRate("UnsealingKey::unsealBatch", count * Bench::operationsPerSecond([&]() {
+    unsealingKey.unsealBatch(sealedMessages);
+  }) / threads);
+
+  return 0;
+}
@@ -29,6 +29,7 @@ project("sodium")
 option(SODIUM_MINIMAL "Only compile the minimum set of functions required for the high-level API" OFF)
 option(SODIUM_ENABLE_BLOCKING_RANDOM "Enable this switch only if /dev/urandom is totally broken on the target platform" OFF)
 option(SODIUM_PRETEND_TO_BE_CONFIGURED "Silence warnings about build system not being properly configured" ON)
+option(SODIUM_ENABLE_SIMD "Compile libsodium's SSE/AVX kernels and let libsodium pick the fastest one at runtime" ON)
 
 set (SODIUM_SRC_BASE ${LIBSODIUM_REPOSITORY_DIR}/src/libsodium)
 
@@ -145,6 +146,109 @@ set_target_properties(${PROJECT_NAME}
         C_STANDARD 99
 )
 
+####################################################
+# SIMD kernels
+#
+# libsodium's autotools build compiles each SSE/AVX kernel with the
+# matching -m flags and tells the dispatchers (and the CPU feature
+# detection in runtime.c) which kernels exist via HAVE_*INTRIN_H.
+# Without these definitions the kernels compile to empty stubs,
+# sodium_runtime_has_*() always reports 0, and every primitive
+# falls back to its portable reference implementation.
+####################################################
+if(SODIUM_ENABLE_SIMD AND NOT EMSCRIPTEN AND
+   CMAKE_SYSTEM_PROCESSOR MATCHES "^(x86_64|AMD64|amd64|x64|i[3-6]86|x86)$")
+    set(SODIUM_SIMD_ENABLED ON)
+else()
+    set(SODIUM_SIMD_ENABLED OFF)
+endif()
+message("SODIUM_SIMD_ENABLED=${SODIUM_SIMD_ENABLED}")
+
+if(SODIUM_SIMD_ENABLED)
+    target_compile_definitions(${PROJECT_NAME}
+        PRIVATE
+            NATIVE_LITTLE_ENDIAN
+            HAVE_EMMINTRIN_H
+            HAVE_PMMINTRIN_H
+            HAVE_TMMINTRIN_H
+            HAVE_SMMINTRIN_H
+            HAVE_AVXINTRIN_H
+            HAVE_AVX2INTRIN_H
+            HAVE_AVX512FINTRIN_H
+            HAVE_WMMINTRIN_H
+        INTERFACE
+            SEEDED_SODIUM_HAVE_SIMD_KERNELS
+    )
+
+    if(NOT MSVC)
+        # MSVC compiles intrinsics without per-file flags and uses __cpuid;
+        # gcc and clang need the cpuid inline assembly and per-file targets.
+        target_compile_definitions(${PROJECT_NAME} PRIVATE HAVE_CPUID)
+
+        set(SODIUM_CFLAGS_SSE2 "-msse2")
+        set(SODIUM_CFLAGS_SSSE3 "${SODIUM_CFLAGS_SSE2} -mssse3")
+        set(SODIUM_CFLAGS_SSE41 "${SODIUM_CFLAGS_SSSE3} -msse4.1")
+        set(SODIUM_CFLAGS_AVX2 "${SODIUM_CFLAGS_SSE41} -mavx -mavx2")
+        set(SODIUM_CFLAGS_AVX512F "${SODIUM_CFLAGS_AVX2} -mavx512f")
+        set(SODIUM_CFLAGS_AESNI "${SODIUM_CFLAGS_SSSE3} -maes -mpclmul")
+
+        set_source_files_properties(
+            ${SODIUM_SRC_BASE}/crypto_onetimeauth/poly1305/sse2/poly1305_sse2.c
+            ${SODIUM_SRC_BASE}/crypto_stream/salsa20/xmm6int/salsa20_xmm6int-sse2.c
+            PROPERTIES COMPILE_FLAGS "${SODIUM_CFLAGS_SSE2}"
+        )
+        set_source_files_properties(
+            ${SODIUM_SRC_BASE}/crypto_generichash/blake2b/ref/blake2b-compress-ssse3.c
+            ${SODIUM_SRC_BASE}/crypto_pwhash/argon2/argon2-fill-block-ssse3.c
+            ${SODIUM_SRC_BASE}/crypto_stream/chacha20/dolbeau/chacha20_dolbeau-ssse3.c
+            PROPERTIES COMPILE_FLAGS "${SODIUM_CFLAGS_SSSE3}"
+        )
+        set_source_files_properties(
+            ${SODIUM_SRC_BASE}/crypto_generichash/blake2b/ref/blake2b-compress-sse41.c
+            PROPERTIES COMPILE_FLAGS "${SODIUM_CFLAGS_SSE41}"
+        )
+        set_source_files_properties(
+            ${SODIUM_SRC_BASE}/crypto_generichash/blake2b/ref/blake2b-compress-avx2.c
+            ${SODIUM_SRC_BASE}/crypto_pwhash/argon2/argon2-fill-block-avx2.c
+            ${SODIUM_SRC_BASE}/crypto_stream/chacha20/dolbeau/chacha20_dolbeau-avx2.c
+            ${SODIUM_SRC_BASE}/crypto_stream/salsa20/xmm6int/salsa20_xmm6int-avx2.c
+            PROPERTIES COMPILE_FLAGS "${SODIUM_CFLAGS_AVX2}"
+        )
+        set_source_files_properties(
+            ${SODIUM_SRC_BASE}/crypto_pwhash/argon2/argon2-fill-block-avx512f.c
+            PROPERTIES COMPILE_FLAGS "${SODIUM_CFLAGS_AVX512F}"
+        )
+        set_source_files_properties(
+            ${SODIUM_SRC_BASE}/crypto_aead/aes256gcm/aesni/aead_aes256gcm_aesni.c
+            PROPERTIES COMPILE_FLAGS "${SODIUM_CFLAGS_AESNI}"
+        )
+
+        if(CMAKE_SIZEOF_VOID_P EQUAL 8)
+            # 64-bit gcc/clang: 128-bit arithmetic (fe51 field code for
+            # X25519/Ed25519, poly1305-donna64 and the SSE2 poly1305),
+            # plus the hand-written amd64 assembly for salsa20 and the
+            # sandy2x (AVX) X25519 ladder. HAVE_AVX_ASM also lets runtime.c
+            # read XCR0 so it can trust the AVX/AVX2/AVX-512 cpuid bits.
+            enable_language(ASM)
+            target_sources(${PROJECT_NAME}
+                PRIVATE
+                    ${SODIUM_SRC_BASE}/crypto_stream/salsa20/xmm6/salsa20_xmm6-asm.S
+                    ${SODIUM_SRC_BASE}/crypto_scalarmult/curve25519/sandy2x/sandy2x.S
+            )
+            target_compile_definitions(${PROJECT_NAME}
+                PRIVATE
+                    HAVE_TI_MODE
+                    HAVE_AMD64_ASM
+                    HAVE_AVX_ASM
+                INTERFACE
+                    SEEDED_SODIUM_HAVE_TI_MODE
+                    SEEDED_SODIUM_HAVE_AMD64_ASM
+                    SEEDED_SODIUM_HAVE_AVX_ASM
+            )
+        endif()
+    endif()
+endif()
+
 target_include_directories(${PROJECT_NAME}
     PUBLIC
         ${SODIUM_SRC_BASE}/include
@@ -0,0 +1,510 @@
+#include <stdint.h>
+#include <string.h>
+#include <stdexcept>
+#include "sodium.h"
+#include "chunk-manifest.hpp"
+#include "memory-mapped-file.hpp"
+#include "work-stealing-pool.hpp"
+
+namespace {
+
+  const unsigned char leafPrefix = 0;
+  const unsigned char nodePrefix = 1;
+  const char manifestMagic[8] = { 'S', 'C', 'M', 'N', 'F', 'S', 'T', '1' };
+  const char proofMagic[8] = { 'S', 'C', 'P', 'R', 'O', 'O', 'F', '1' };
+  const std::string signedStatementPrefix = "seeded-crypto:ChunkManifest:v1";
+  const size_t proofHeaderBytes = 104;
+  // How much of a file buildFromFile maps at once
+  const size_t mappingWindowSize = 64 << 20;
+  const uint64_t minimumParallelNodes = 1024;
+
+  // Header field offsets (see the ChunkManifest documentation)
+  const size_t chunkSizeOffset = 8;
+  const size_t blobSizeOffset = 16;
+  const size_t chunkCountOffset = 24;
+  const size_t rootHashOffset = 32;
+  const size_t signatureOffset = 64;
+
+  void storeLittleEndian(unsigned char* out, uint64_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; i++) {
+      out[i] = (unsigned char) (value >> (8 * i));
+    }
+  }
+
+  uint64_t loadLittleEndian(const unsigned char* in, size_t bytes) {
+    uint64_t value = 0;
+    for (size_t i = bytes; i-- > 0;) {
+      value = (value << 8) | in[i];
+    }
+    return value;
+  }
+
+  uint64_t chunksInBlob(uint64_t blobSize, uint32_t chunkSize) {
+    // An empty blob is a single empty chunk
+    return blobSize == 0 ? 1 : (blobSize - 1) / chunkSize + 1;
+  }
+
+  std::vector<uint64_t> computeLevelSizes(uint64_t leafCount) {
+    std::vector<uint64_t> sizes(1, leafCount);
+    while (sizes.back() > 1) {
+      sizes.push_back((sizes.back() + 1) / 2);
+    }
+    return sizes;
+  }
+
+  std::vector<uint64_t> computeLevelOffsets(const std::vector<uint64_t>& levelSizes) {
+    std::vector<uint64_t> offsets(levelSizes.size(), 0);
+    for (size_t level = 1; level < levelSizes.size(); level++) {
+      offsets[level] = offsets[level - 1] + levelSizes[level - 1];
+    }
+    return offsets;
+  }
+
+  void hashLeaf(unsigned char* out, const unsigned char* chunk, size_t chunkLength) {
+    crypto_generichash_state state;
+    crypto_generichash_init(&state, NULL, 0, ChunkManifest::hashBytes);
+    crypto_generichash_update(&state, &leafPrefix, 1);
+    crypto_generichash_update(&state, chunk, chunkLength);
+    crypto_generichash_final(&state, out, ChunkManifest::hashBytes);
+  }
+
+  void hashNode(unsigned char* out, const unsigned char* left, const unsigned char* right) {
+    crypto_generichash_state state;
+    crypto_generichash_init(&state, NULL, 0, ChunkManifest::hashBytes);
+    crypto_generichash_update(&state, &nodePrefix, 1);
+    crypto_generichash_update(&state, left, ChunkManifest::hashBytes);
+    crypto_generichash_update(&state, right, ChunkManifest::hashBytes);
+    crypto_generichash_final(&state, out, ChunkManifest::hashBytes);
+  }
+
+  // Hash parent nodes from pairs of child nodes; an unpaired last child
+  // is carried up unchanged.
+  void hashLevel(unsigned char* parents, const unsigned char* children, uint64_t childCount) {
+    const uint64_t parentCount = (childCount + 1) / 2;
+    const auto hashParent = [=](size_t parent) {
+      const unsigned char* left = children + 2 * parent * ChunkManifest::hashBytes;
+      unsigned char* out = parents + parent * ChunkManifest::hashBytes;
+      if (2 * parent + 1 < childCount) {
+        hashNode(out, left, left + ChunkManifest::hashBytes);
+      } else {
+        memcpy(out, left, ChunkManifest::hashBytes);
+      }
+    };
+    // Hashing a node takes well under a microsecond, so small levels
+    // (and the few nodes of a range proof) are not worth dispatching.
+    if (parentCount < minimumParallelNodes) {
+      for (size_t parent = 0; parent < parentCount; parent++) {
+        hashParent(parent);
+      }
+    } else {
+      WorkStealingPool::getDefault().parallelFor((size_t) parentCount, hashParent);
+    }
+  }
+
+  // Hash chunks [firstChunk, firstChunk + chunkCount) of a blob, where
+  // data holds the blob's bytes starting at the first of those chunks.
+  void hashLeaves(
+    unsigned char* leaves,
+    const unsigned char* data,
+    uint64_t firstChunk,
+    uint64_t chunkCount,
+    uint64_t blobSize,
+    uint32_t chunkSize
+  ) {
+    WorkStealingPool::getDefault().parallelFor((size_t) chunkCount, [=](size_t i) {
+      const uint64_t start = (firstChunk + i) * chunkSize;
+      const uint64_t end = start + chunkSize < blobSize ? start + chunkSize : blobSize;
+      hashLeaf(
+        leaves + i * ChunkManifest::hashBytes,
+        data + i * (uint64_t) chunkSize,
+        (size_t) (end > start ? end - start : 0)
+      );
+    });
+  }
+
+  std::vector<unsigned char> signedStatement(
+    uint32_t chunkSize,
+    uint64_t blobSize,
+    const unsigned char* rootHash
+  ) {
+    std::vector<unsigned char> statement(signedStatementPrefix.begin(), signedStatementPrefix.end());
+    unsigned char sizes[16];
+    storeLittleEndian(sizes, chunkSize, 8);
+    storeLittleEndian(sizes + 8, blobSize, 8);
+    statement.insert(statement.end(), sizes, sizes + sizeof sizes);
+    statement.insert(statement.end(), rootHash, rootHash + ChunkManifest::hashBytes);
+    return statement;
+  }
+
+  // The number of nodes in a tree with these level sizes, or a value
+  // greater than maximumNodes if there are more than that (the sum is
+  // never computed past maximumNodes, so it cannot overflow)
+  uint64_t countNodes(const std::vector<uint64_t>& levelSizes, uint64_t maximumNodes) {
+    uint64_t nodeCount = 0;
+    for (uint64_t size : levelSizes) {
+      if (size > maximumNodes - nodeCount) {
+        return maximumNodes + 1;
+      }
+      nodeCount += size;
+    }
+    return nodeCount;
+  }
+
+  // Validate a serialized manifest's header and length, returning the
+  // size of each level of its tree
+  std::vector<uint64_t> parseLevelSizes(const unsigned char* serialized, size_t length) {
+    if (length < ChunkManifest::headerBytes || memcmp(serialized, manifestMagic, sizeof manifestMagic) != 0) {
+      throw std::invalid_argument("Not a chunk manifest");
+    }
+    const uint32_t chunkSize = (uint32_t) loadLittleEndian(serialized + chunkSizeOffset, 4);
+    const uint64_t blobSize = loadLittleEndian(serialized + blobSizeOffset, 8);
+    const uint64_t chunkCount = loadLittleEndian(serialized + chunkCountOffset, 8);
+    if (chunkSize == 0 || chunkCount != chunksInBlob(blobSize, chunkSize)) {
+      throw std::invalid_argument("Invalid chunk manifest header");
+    }
+    // The header's counts are untrusted: check them against the nodes the
+    // body can actually hold before using them to size anything
+    const uint64_t nodesInBody = (length - ChunkManifest::headerBytes) / ChunkManifest::hashBytes;
+    if (chunkCount > nodesInBody) {
+      throw std::invalid_argument("Chunk manifest length does not match its header");
+    }
+    const std::vector<uint64_t> sizes = computeLevelSizes(chunkCount);
+    if (countNodes(sizes, nodesInBody) != nodesInBody ||
+        (length - ChunkManifest::headerBytes) % ChunkManifest::hashBytes != 0) {
+      throw std::invalid_argument("Chunk manifest length does not match its header");
+    }
+    return sizes;
+  }
+
+  // Allocate a manifest for a blob, with its header filled in
+  // except for the root hash and signature.
+  std::shared_ptr<std::vector<unsigned char>> allocateManifest(uint64_t blobSize, uint32_t chunkSize) {
+    if (chunkSize == 0) {
+      throw std::invalid_argument("chunkSize must be greater than zero");
+    }
+    const uint64_t chunkCount = chunksInBlob(blobSize, chunkSize);
+    const uint64_t maximumNodes = (SIZE_MAX - ChunkManifest::headerBytes) / ChunkManifest::hashBytes;
+    const uint64_t nodeCount = countNodes(computeLevelSizes(chunkCount), maximumNodes);
+    if (nodeCount > maximumNodes) {
+      throw std::invalid_argument("Blob has too many chunks for a manifest to be held in memory");
+    }
+    std::shared_ptr<std::vector<unsigned char>> bytes = std::make_shared<std::vector<unsigned char>>(
+      ChunkManifest::headerBytes + (size_t) nodeCount * ChunkManifest::hashBytes, 0
+    );
+    unsigned char* header = bytes->data();
+    memcpy(header, manifestMagic, sizeof manifestMagic);
+    storeLittleEndian(header + chunkSizeOffset, chunkSize, 4);
+    storeLittleEndian(header + blobSizeOffset, blobSize, 8);
+    storeLittleEndian(header + chunkCountOffset, chunkCount, 8);
+    return bytes;
+  }
+
+  // Given a manifest with its leaves hashed, hash the rest of the tree,
+  // then record and sign the root.
+  void completeManifest(std::vector<unsigned char>& bytes, const SigningKey& signingKey) {
+    unsigned char* header = bytes.data();
+    unsigned char* nodes = header + ChunkManifest::headerBytes;
+    const uint32_t chunkSize = (uint32_t) loadLittleEndian(header + chunkSizeOffset, 4);
+    const uint64_t blobSize = loadLittleEndian(header + blobSizeOffset, 8);
+    const std::vector<uint64_t> sizes = computeLevelSizes(loadLittleEndian(header + chunkCountOffset, 8));
+    const std::vector<uint64_t> offsets = computeLevelOffsets(sizes);
+    for (size_t level = 0; level + 1 < sizes.size(); level++) {
+      hashLevel(
+        nodes + offsets[level + 1] * ChunkManifest::hashBytes,
+        nodes + offsets[level] * ChunkManifest::hashBytes,
+        sizes[level]
+      );
+    }
+    const unsigned char* root = nodes + offsets.back() * ChunkManifest::hashBytes;
+    memcpy(header + rootHashOffset, root, ChunkManifest::hashBytes);
+    const std::vector<unsigned char> statement = signedStatement(chunkSize, blobSize, root);
+    const std::vector<unsigned char> signature = signingKey.generateSignature(statement);
+    memcpy(header + signatureOffset, signature.data(), crypto_sign_BYTES);
+  }
+
+  // Take the next sibling hash from a proof, or return NULL if there are none left
+  const unsigned char* nextSibling(const std::vector<unsigned char>& siblingHashes, size_t& used) {
+    if ((used + 1) * ChunkManifest::hashBytes > siblingHashes.size()) {
+      return NULL;
+    }
+    return siblingHashes.data() + (used++) * ChunkManifest::hashBytes;
+  }
+
+}
+
+ChunkRangeProof::ChunkRangeProof(
+  uint64_t _blobSize,
+  uint32_t _chunkSize,
+  uint64_t _firstChunk,
+  uint64_t _chunkCount,
+  const std::vector<unsigned char>& _siblingHashes,
+  const std::vector<unsigned char>& _signature
+) :
+  blobSize(_blobSize),
+  chunkSize(_chunkSize),
+  firstChunk(_firstChunk),
+  chunkCount(_chunkCount),
+  siblingHashes(_siblingHashes),
+  signature(_signature)
+{}
+
+uint64_t ChunkRangeProof::getRangeOffset() const {
+  const uint64_t offset = firstChunk * chunkSize;
+  return offset < blobSize ? offset : blobSize;
+}
+
+uint64_t ChunkRangeProof::getRangeLength() const {
+  const uint64_t end = (firstChunk + chunkCount) * chunkSize;
+  return (end < blobSize ? end : blobSize) - getRangeOffset();
+}
+
+bool ChunkRangeProof::verify(
+  const SignatureVerificationKey& signatureVerificationKey,
+  const unsigned char* rangeData,
+  const size_t rangeLength
+) const {
+  if (chunkSize == 0 || signature.size() != crypto_sign_BYTES ||
+      siblingHashes.size() % ChunkManifest::hashBytes != 0) {
+    return false;
+  }
+  uint64_t levelSize = chunksInBlob(blobSize, chunkSize);
+  if (chunkCount == 0 || firstChunk >= levelSize || chunkCount > levelSize - firstChunk ||
+      rangeLength != getRangeLength()) {
+    return false;
+  }
+
+  // Hash the range's chunks, then walk up the tree, adding a sibling from
+  // the proof wherever the range's nodes at a level have one outside it.
+  std::vector<unsigned char> nodes((size_t) chunkCount * ChunkManifest::hashBytes);
+  hashLeaves(nodes.data(), rangeData, firstChunk, chunkCount, blobSize, chunkSize);
+  uint64_t first = firstChunk;
+  uint64_t last = firstChunk + chunkCount - 1;
+  size_t siblingsUsed = 0;
+  while (levelSize > 1) {
+    if (first % 2 == 1) {
+      const unsigned char* sibling = nextSibling(siblingHashes, siblingsUsed);
+      if (sibling == NULL) {
+        return false;
+      }
+      nodes.insert(nodes.begin(), sibling, sibling + ChunkManifest::hashBytes);
+    }
+    if (last % 2 == 0 && last + 1 < levelSize) {
+      const unsigned char* sibling = nextSibling(siblingHashes, siblingsUsed);
+      if (sibling == NULL) {
+        return false;
+      }
+      nodes.insert(nodes.end(), sibling, sibling + ChunkManifest::hashBytes);
+    }
+    const uint64_t nodeCount = nodes.size() / ChunkManifest::hashBytes;
+    std::vector<unsigned char> parents((size_t) (nodeCount + 1) / 2 * ChunkManifest::hashBytes);
+    hashLevel(parents.data(), nodes.data(), nodeCount);
+    nodes.swap(parents);
+    first /= 2;
+    last /= 2;
+    levelSize = (levelSize + 1) / 2;
+  }
+  if (siblingsUsed * ChunkManifest::hashBytes != siblingHashes.size()) {
+    return false;
+  }
+  return signatureVerificationKey.verify(
+    signedStatement(chunkSize, blobSize, nodes.data()),
+    signature
+  );
+}
+
+const std::vector<unsigned char> ChunkRangeProof::toSerializedBinaryForm() const {
+  std::vector<unsigned char> serialized(proofHeaderBytes + siblingHashes.size(), 0);
+  memcpy(serialized.data(), proofMagic, sizeof proofMagic);
+  storeLittleEndian(serialized.data() + 8, chunkSize, 4);
+  storeLittleEndian(serialized.data() + 16, blobSize, 8);
+  storeLittleEndian(serialized.data() + 24, firstChunk, 8);
+  storeLittleEndian(serialized.data() + 32, chunkCount, 8);
+  if (signature.size() == crypto_sign_BYTES) {
+    memcpy(serialized.data() + 40, signature.data(), crypto_sign_BYTES);
+  }
+  if (!siblingHashes.empty()) {
+    memcpy(serialized.data() + proofHeaderBytes, siblingHashes.data(), siblingHashes.size());
+  }
+  return serialized;
+}
+
+ChunkRangeProof ChunkRangeProof::fromSerializedBinaryForm(
+  const unsigned char* serialized,
+  const size_t length
+) {
+  if (length < proofHeaderBytes || memcmp(serialized, proofMagic, sizeof proofMagic) != 0 ||
+      (length - proofHeaderBytes) % ChunkManifest::hashBytes != 0) {
+    throw std::invalid_argument("Not a chunk range proof");
+  }
+  return ChunkRangeProof(
+    loadLittleEndian(serialized + 16, 8),
+    (uint32_t) loadLittleEndian(serialized + 8, 4),
+    loadLittleEndian(serialized + 24, 8),
+    loadLittleEndian(serialized + 32, 8),
+    std::vector<unsigned char>(serialized + proofHeaderBytes, serialized + length),
+    std::vector<unsigned char>(serialized + 40, serialized + 40 + crypto_sign_BYTES)
+  );
+}
+
+ChunkRangeProof ChunkRangeProof::fromSerializedBinaryForm(
+  const std::vector<unsigned char>& serializedBinaryForm
+) {
+  return fromSerializedBinaryForm(serializedBinaryForm.data(), serializedBinaryForm.size());
+}
+
+ChunkManifest::ChunkManifest(
+  const std::shared_ptr<const void>& _storage,
+  const unsigned char* _serialized,
+  const size_t _serializedLength
+) :
+  storage(_storage),
+  serialized(_serialized),
+  serializedLength(_serializedLength),
+  levelSizes(parseLevelSizes(_serialized, _serializedLength)),
+  levelOffsets(computeLevelOffsets(levelSizes))
+{}
+
+ChunkManifest ChunkManifest::build(
+  const unsigned char* blob,
+  const uint64_t blobSize,
+  const SigningKey& signingKey,
+  const uint32_t chunkSize
+) {
+  std::shared_ptr<std::vector<unsigned char>> bytes = allocateManifest(blobSize, chunkSize);
+  hashLeaves(
+    bytes->data() + headerBytes, blob, 0, chunksInBlob(blobSize, chunkSize), blobSize, chunkSize
+  );
+  completeManifest(*bytes, signingKey);
+  return ChunkManifest(bytes, bytes->data(), bytes->size());
+}
+
+ChunkManifest ChunkManifest::buildFromFile(
+  const std::string& path,
+  const SigningKey& signingKey,
+  const uint32_t chunkSize
+) {
+  const uint64_t blobSize = MemoryMappedFile(path, 0, 0).getFileSize();
+  std::shared_ptr<std::vector<unsigned char>> bytes = allocateManifest(blobSize, chunkSize);
+  const uint64_t chunkCount = chunksInBlob(blobSize, chunkSize);
+  const uint64_t chunksPerWindow = chunkSize < mappingWindowSize ? mappingWindowSize / chunkSize : 1;
+  for (uint64_t firstChunk = 0; firstChunk < chunkCount; firstChunk += chunksPerWindow) {
+    const uint64_t windowChunks = chunksPerWindow < chunkCount - firstChunk ?
+      chunksPerWindow : chunkCount - firstChunk;
+    const MemoryMappedFile window(path, firstChunk * chunkSize, (size_t) (windowChunks * chunkSize));
+    hashLeaves(
+      bytes->data() + headerBytes + firstChunk * hashBytes,
+      window.data(), firstChunk, windowChunks, blobSize, chunkSize
+    );
+  }
+  completeManifest(*bytes, signingKey);
+  return ChunkManifest(bytes, bytes->data(), bytes->size());
+}
+
+ChunkManifest ChunkManifest::fromSerializedBinaryForm(
+  const unsigned char* serializedBinaryForm,
+  const size_t serializedBinaryFormLength
+) {
+  std::shared_ptr<std::vector<unsigned char>> bytes = std::make_shared<std::vector<unsigned char>>(
+    serializedBinaryForm, serializedBinaryForm + serializedBinaryFormLength
+  );
+  return ChunkManifest(bytes, bytes->data(), bytes->size());
+}
+
+ChunkManifest ChunkManifest::fromSerializedBinaryForm(
+  const std::vector<unsigned char>& serializedBinaryForm
+) {
+  return fromSerializedBinaryForm(serializedBinaryForm.data(), serializedBinaryForm.size());
+}
+
+ChunkManifest ChunkManifest::fromFile(
+  const std::string& path
+) {
+  std::shared_ptr<MemoryMappedFile> mapping = std::make_shared<MemoryMappedFile>(path);
+  return ChunkManifest(mapping, mapping->data(), mapping->size());
+}
+
+const std::vector<unsigned char> ChunkManifest::toSerializedBinaryForm() const {
+  return std::vector<unsigned char>(serialized, serialized + serializedLength);
+}
+
+uint64_t ChunkManifest::getBlobSize() const {
+  return loadLittleEndian(serialized + blobSizeOffset, 8);
+}
+
+uint32_t ChunkManifest::getChunkSize() const {
+  return (uint32_t) loadLittleEndian(serialized + chunkSizeOffset, 4);
+}
+
+uint64_t ChunkManifest::getChunkCount() const {
+  return levelSizes[0];
+}
+
+const std::vector<unsigned char> ChunkManifest::getRootHash() const {
+  return std::vector<unsigned char>(serialized + rootHashOffset, serialized + rootHashOffset + hashBytes);
+}
+
+const std::vector<unsigned char> ChunkManifest::getSignature() const {
+  return std::vector<unsigned char>(serialized + signatureOffset, serialized + signatureOffset + crypto_sign_BYTES);
+}
+
+const unsigned char* ChunkManifest::node(size_t level, uint64_t index) const {
+  return serialized + headerBytes + (levelOffsets[level] + index) * hashBytes;
+}
+
+bool ChunkManifest::verify(
+  const SignatureVerificationKey& signatureVerificationKey
+) const {
+  for (size_t level = 0; level + 1 < levelSizes.size(); level++) {
+    std::vector<unsigned char> parents((size_t) levelSizes[level + 1] * hashBytes);
+    hashLevel(parents.data(), node(level, 0), levelSizes[level]);
+    if (memcmp(parents.data(), node(level + 1, 0), parents.size()) != 0) {
+      return false;
+    }
+  }
+  const unsigned char* root = node(levelSizes.size() - 1, 0);
+  if (memcmp(root, serialized + rootHashOffset, hashBytes) != 0) {
+    return false;
+  }
+  return signatureVerificationKey.verify(
+    signedStatement(getChunkSize(), getBlobSize(), root),
+    getSignature()
+  );
+}
+
+ChunkRangeProof ChunkManifest::proveRange(
+  const uint64_t firstChunk,
+  const uint64_t chunkCount
+) const {
+  if (chunkCount == 0 || firstChunk >= levelSizes[0] || chunkCount > levelSizes[0] - firstChunk) {
+    throw std::out_of_range("Chunk range is empty or extends past the last chunk");
+  }
+  std::vector<unsigned char> siblingHashes;
+  uint64_t first = firstChunk;
+  uint64_t last = firstChunk + chunkCount - 1;
+  for (size_t level = 0; level + 1 < levelSizes.size(); level++) {
+    if (first % 2 == 1) {
+      siblingHashes.insert(siblingHashes.end(), node(level, first - 1), node(level, first - 1) + hashBytes);
+    }
+    if (last % 2 == 0 && last + 1 < levelSizes[level]) {
+      siblingHashes.insert(siblingHashes.end(), node(level, last + 1), node(level, last + 1) + hashBytes);
+    }
+    first /= 2;
+    last /= 2;
+  }
+  return ChunkRangeProof(
+    getBlobSize(), getChunkSize(), firstChunk, chunkCount, siblingHashes, getSignature()
+  );
+}
+
+ChunkRangeProof ChunkManifest::proveByteRange(
+  const uint64_t offset,
+  const uint64_t length
+) const {
+  const uint64_t blobSize = getBlobSize();
+  if (length == 0 || offset >= blobSize || length > blobSize - offset) {
+    throw std::out_of_range("Byte range is empty or extends past the end of the blob");
+  }
+  const uint64_t firstChunk = offset / getChunkSize();
+  const uint64_t lastChunk = (offset + length - 1) / getChunkSize();
+  return proveRange(firstChunk, lastChunk - firstChunk + 1);
+}
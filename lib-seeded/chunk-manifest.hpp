@@ -0,0 +1,296 @@
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include "signing-key.hpp"
+#include "signature-verification-key.hpp"
+
+/**
+ * @brief Proof that a contiguous range of chunks belongs to a blob
+ * described by a signed ChunkManifest.
+ *
+ * A proof is self-contained: it carries the blob and chunk sizes, the
+ * position of the range, the Merkle sibling hashes needed to recompute the
+ * root from the range's chunks, and the signature of that root.  Someone
+ * holding only the SignatureVerificationKey, the proof, and the bytes of
+ * the range can verify those bytes without any other part of the blob.
+ *
+ * Obtain proofs from ChunkManifest::proveRange.
+ *
+ * @ingroup DerivedFromSeeds
+ */
+class ChunkRangeProof {
+public:
+  /**
+   * @brief The size of the whole blob in bytes
+   */
+  const uint64_t blobSize;
+  /**
+   * @brief The size of each chunk (all but the last are full-sized)
+   */
+  const uint32_t chunkSize;
+  /**
+   * @brief The index of the first chunk in the range
+   */
+  const uint64_t firstChunk;
+  /**
+   * @brief The number of chunks in the range
+   */
+  const uint64_t chunkCount;
+  /**
+   * @brief The Merkle sibling hashes, ChunkManifest::hashBytes each,
+   * from the leaves up
+   */
+  const std::vector<unsigned char> siblingHashes;
+  /**
+   * @brief The manifest's signature of its root
+   */
+  const std::vector<unsigned char> signature;
+
+  /**
+   * @brief Construct from the objects members
+   */
+  ChunkRangeProof(
+    uint64_t blobSize,
+    uint32_t chunkSize,
+    uint64_t firstChunk,
+    uint64_t chunkCount,
+    const std::vector<unsigned char>& siblingHashes,
+    const std::vector<unsigned char>& signature
+  );
+
+  /**
+   * @brief The offset within the blob of the first byte of the range
+   */
+  uint64_t getRangeOffset() const;
+
+  /**
+   * @brief The number of bytes in the range
+   */
+  uint64_t getRangeLength() const;
+
+  /**
+   * @brief Verify that rangeData is the range of the blob this proof
+   * describes, as signed by the SigningKey corresponding to signatureVerificationKey.
+   *
+   * @param signatureVerificationKey The key of the manifest's signer
+   * @param rangeData The bytes of the range (getRangeLength() of them)
+   * @param rangeLength The number of bytes in rangeData
+   * @return true if the range is authentic
+   * @return false if the data, the proof, or the signature is invalid
+   */
+  bool verify(
+    const SignatureVerificationKey& signatureVerificationKey,
+    const unsigned char* rangeData,
+    const size_t rangeLength
+  ) const;
+
+  /**
+   * @brief Serialize to a byte array: a fixed-size little-endian header
+   * followed by the sibling hashes.
+   */
+  const std::vector<unsigned char> toSerializedBinaryForm() const;
+
+  /**
+   * @brief Deserialize from a byte array created by toSerializedBinaryForm
+   *
+   * @exception std::invalid_argument Thrown if the bytes are not a valid proof.
+   */
+  static ChunkRangeProof fromSerializedBinaryForm(
+    const unsigned char* serializedBinaryForm,
+    const size_t serializedBinaryFormLength
+  );
+
+  /**
+   * @brief Deserialize from a byte array created by toSerializedBinaryForm
+   *
+   * @exception std::invalid_argument Thrown if the bytes are not a valid proof.
+   */
+  static ChunkRangeProof fromSerializedBinaryForm(
+    const std::vector<unsigned char>& serializedBinaryForm
+  );
+};
+
+/**
+ * @brief A signed Merkle tree over a large blob split into fixed-size
+ * chunks, from which proofs for any range of chunks can be extracted.
+ *
+ * Chunks are hashed with BLAKE2b-256 as leaves (prefixed by a 0 byte), and
+ * pairs of nodes as parents (prefixed by a 1 byte); a node without a
+ * sibling at the end of a level is carried up unchanged.  The signer's
+ * SigningKey signs the root together with the blob and chunk sizes.
+ * Building the tree hashes chunks, and then each level, in parallel on
+ * the WorkStealingPool.
+ *
+ * The serialized form is designed to be used in place (for example via
+ * ChunkManifest::fromFile, which maps it into memory): a 128-byte header
+ *   (magic "SCMNFST1", chunkSize: u32, reserved: u32, blobSize: u64,
+ *    chunkCount: u64, root hash: 32 bytes, signature: 64 bytes)
+ * followed by every node of the tree as a flat array of 32-byte hashes,
+ * level by level from the leaves to the root, so that any node is found
+ * by arithmetic alone.  All integers are little-endian.
+ *
+ * @ingroup DerivedFromSeeds
+ */
+class ChunkManifest {
+public:
+  /**
+   * @brief The size of each node hash
+   */
+  static const size_t hashBytes = 32;
+  /**
+   * @brief The size of the serialized header
+   */
+  static const size_t headerBytes = 128;
+  /**
+   * @brief The chunk size used if none is specified
+   */
+  static const uint32_t defaultChunkSize = 1 << 20;
+
+  /**
+   * @brief Build and sign the manifest of a blob in memory
+   *
+   * @exception std::invalid_argument Thrown if chunkSize is zero.
+   */
+  static ChunkManifest build(
+    const unsigned char* blob,
+    const uint64_t blobSize,
+    const SigningKey& signingKey,
+    const uint32_t chunkSize = defaultChunkSize
+  );
+
+  /**
+   * @brief Build and sign the manifest of a file, mapping it into
+   * memory a window of chunks at a time.
+   *
+   * @exception FileAccessException Thrown if the file cannot be mapped.
+   * @exception std::invalid_argument Thrown if chunkSize is zero.
+   */
+  static ChunkManifest buildFromFile(
+    const std::string& path,
+    const SigningKey& signingKey,
+    const uint32_t chunkSize = defaultChunkSize
+  );
+
+  /**
+   * @brief Load a manifest from serialized bytes (which are copied)
+   *
+   * @exception std::invalid_argument Thrown if the bytes are not a valid manifest.
+   */
+  static ChunkManifest fromSerializedBinaryForm(
+    const unsigned char* serializedBinaryForm,
+    const size_t serializedBinaryFormLength
+  );
+
+  /**
+   * @brief Load a manifest from serialized bytes (which are copied)
+   *
+   * @exception std::invalid_argument Thrown if the bytes are not a valid manifest.
+   */
+  static ChunkManifest fromSerializedBinaryForm(
+    const std::vector<unsigned char>& serializedBinaryForm
+  );
+
+  /**
+   * @brief Map a serialized manifest file into memory and use it in place
+   *
+   * @exception FileAccessException Thrown if the file cannot be mapped.
+   * @exception std::invalid_argument Thrown if the file is not a valid manifest.
+   */
+  static ChunkManifest fromFile(
+    const std::string& path
+  );
+
+  /**
+   * @brief The serialized form, which can be written to a file as is
+   */
+  const unsigned char* getSerializedBytes() const { return serialized; }
+
+  /**
+   * @brief The length of the serialized form
+   */
+  size_t getSerializedLength() const { return serializedLength; }
+
+  /**
+   * @brief A copy of the serialized form
+   */
+  const std::vector<unsigned char> toSerializedBinaryForm() const;
+
+  /**
+   * @brief The size of the blob in bytes
+   */
+  uint64_t getBlobSize() const;
+
+  /**
+   * @brief The size of each chunk (all but the last are full-sized)
+   */
+  uint32_t getChunkSize() const;
+
+  /**
+   * @brief The number of chunks (an empty blob has one empty chunk)
+   */
+  uint64_t getChunkCount() const;
+
+  /**
+   * @brief The root of the Merkle tree
+   */
+  const std::vector<unsigned char> getRootHash() const;
+
+  /**
+   * @brief The signature of the root, blob size, and chunk size
+   */
+  const std::vector<unsigned char> getSignature() const;
+
+  /**
+   * @brief Check that the tree is consistent (each parent is the hash
+   * of its children, up to the root) and that the root is signed by the
+   * SigningKey corresponding to signatureVerificationKey.
+   */
+  bool verify(
+    const SignatureVerificationKey& signatureVerificationKey
+  ) const;
+
+  /**
+   * @brief Extract the proof for chunkCount chunks starting at firstChunk
+   *
+   * @exception std::out_of_range Thrown if the range is empty or
+   * extends past the last chunk.
+   */
+  ChunkRangeProof proveRange(
+    const uint64_t firstChunk,
+    const uint64_t chunkCount
+  ) const;
+
+  /**
+   * @brief Extract the proof for the smallest range of chunks that
+   * covers length bytes starting at offset.  The proof's getRangeOffset()
+   * and getRangeLength() give the bytes the verifier will need.
+   *
+   * @exception std::out_of_range Thrown if the byte range is empty or
+   * extends past the end of the blob.
+   */
+  ChunkRangeProof proveByteRange(
+    const uint64_t offset,
+    const uint64_t length
+  ) const;
+
+private:
+  ChunkManifest(
+    const std::shared_ptr<const void>& storage,
+    const unsigned char* serialized,
+    const size_t serializedLength
+  );
+
+  const unsigned char* node(size_t level, uint64_t index) const;
+
+  // Keeps the bytes alive: an owned vector, or a MemoryMappedFile
+  const std::shared_ptr<const void> storage;
+  const unsigned char* const serialized;
+  const size_t serializedLength;
+  // The number of nodes in each level, from the leaves to the root,
+  // and the index of each level's first node in the flat node array
+  const std::vector<uint64_t> levelSizes;
+  const std::vector<uint64_t> levelOffsets;
+};
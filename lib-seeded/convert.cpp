@@ -1,35 +1,377 @@
 #include "convert.hpp"
+#include <cctype>
 #include <exception>
 #include <stdexcept>
+#include <sodium.h>
+#include "sodium-initializer.hpp"
+
+// The vectorized codecs are compiled for SSSE3 and AVX2 with function
+// attributes, as for x25519Batch, and only called when the processor
+// reports the instruction set at runtime.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__)) && !defined(__EMSCRIPTEN__)
+  #define SEEDED_HEX_SIMD
+  #define SEEDED_SSSE3_TARGET __attribute__((target("ssse3")))
+  #define SEEDED_AVX2_TARGET __attribute__((target("avx2")))
+#elif defined(_MSC_VER) && defined(_M_X64)
+  #define SEEDED_HEX_SIMD
+  #define SEEDED_SSSE3_TARGET
+  #define SEEDED_AVX2_TARGET
+#endif
+
+#ifdef SEEDED_HEX_SIMD
+#include <immintrin.h>
+#endif
 
 constexpr char hexDigits[] = {
   '0', '1', '2', '3', '4', '5', '6', '7',
   '8', '9', 'a', 'b', 'c', 'd', 'e', 'f'
 };
 
-const std::string toHexStr(const std::vector<unsigned char> bytes)
-{
-  std::string hexString(bytes.size() * 2, ' ');
-  int i = 0;
-  for (const unsigned char b : bytes) {
-    hexString[i++] = hexDigits[b >> 4];
-    hexString[i++] = hexDigits[b & 0xf];
+static void hexEncodeScalar(char* hex, const unsigned char* bytes, const size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    hex[2 * i] = hexDigits[bytes[i] >> 4];
+    hex[2 * i + 1] = hexDigits[bytes[i] & 0xf];
+  }
+}
+
+// The value of each hex digit, and 0xff for every other character
+static const struct HexValues {
+  unsigned char value[256];
+  HexValues() {
+    for (int c = 0; c < 256; c++) {
+      value[c] = 0xff;
+    }
+    for (int digit = 0; digit < 16; digit++) {
+      value[(unsigned char) hexDigits[digit]] = (unsigned char) digit;
+      value[(unsigned char) toupper(hexDigits[digit])] = (unsigned char) digit;
+    }
+  }
+} hexValues;
+
+static bool hexDecodeScalar(unsigned char* bytes, const char* hex, const size_t length) {
+  unsigned char invalid = 0;
+  for (size_t i = 0; i < length; i++) {
+    const unsigned char high = hexValues.value[(unsigned char) hex[2 * i]];
+    const unsigned char low = hexValues.value[(unsigned char) hex[2 * i + 1]];
+    invalid |= (high | low) & 0xf0;
+    bytes[i] = (unsigned char) ((high << 4) | (low & 0xf));
+  }
+  return invalid == 0;
+}
+
+#ifdef SEEDED_HEX_SIMD
+
+// Encode 16 bytes as 32 hex digits: split each byte into nibbles and
+// look the nibbles up in hexDigits with a byte shuffle.
+SEEDED_SSSE3_TARGET static inline void hexEncode16(char* hex, __m128i input, __m128i digits) {
+  const __m128i lowNibbleMask = _mm_set1_epi8(0x0f);
+  const __m128i high = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(input, 4), lowNibbleMask));
+  const __m128i low = _mm_shuffle_epi8(digits, _mm_and_si128(input, lowNibbleMask));
+  _mm_storeu_si128((__m128i*) hex, _mm_unpacklo_epi8(high, low));
+  _mm_storeu_si128((__m128i*) (hex + 16), _mm_unpackhi_epi8(high, low));
+}
+
+SEEDED_SSSE3_TARGET static void hexEncodeSsse3(char* hex, const unsigned char* bytes, const size_t length) {
+  const __m128i digits = _mm_loadu_si128((const __m128i*) hexDigits);
+  size_t i = 0;
+  for (; i + 16 <= length; i += 16) {
+    hexEncode16(hex + 2 * i, _mm_loadu_si128((const __m128i*) (bytes + i)), digits);
+  }
+  hexEncodeScalar(hex + 2 * i, bytes + i, length - i);
+}
+
+SEEDED_AVX2_TARGET static void hexEncodeAvx2(char* hex, const unsigned char* bytes, const size_t length) {
+  const __m256i digits = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) hexDigits));
+  const __m256i lowNibbleMask = _mm256_set1_epi8(0x0f);
+  size_t i = 0;
+  for (; i + 32 <= length; i += 32) {
+    const __m256i input = _mm256_loadu_si256((const __m256i*) (bytes + i));
+    const __m256i high = _mm256_shuffle_epi8(digits, _mm256_and_si256(_mm256_srli_epi16(input, 4), lowNibbleMask));
+    const __m256i low = _mm256_shuffle_epi8(digits, _mm256_and_si256(input, lowNibbleMask));
+    // The unpacks interleave within each 128-bit lane, so
+    // reassemble the lanes in order before storing
+    const __m256i interleavedLow = _mm256_unpacklo_epi8(high, low);
+    const __m256i interleavedHigh = _mm256_unpackhi_epi8(high, low);
+    _mm256_storeu_si256((__m256i*) (hex + 2 * i), _mm256_permute2x128_si256(interleavedLow, interleavedHigh, 0x20));
+    _mm256_storeu_si256((__m256i*) (hex + 2 * i + 32), _mm256_permute2x128_si256(interleavedLow, interleavedHigh, 0x31));
+  }
+  hexEncodeScalar(hex + 2 * i, bytes + i, length - i);
+}
+
+// Convert 16 hex digits to their values, clearing valid's bits for any
+// byte that is not a hex digit.  Bytes >= 0x80 compare as negative and
+// so fall outside both ranges.
+SEEDED_SSSE3_TARGET static inline __m128i hexValues16(__m128i c, __m128i& valid) {
+  const __m128i lowerCase = _mm_or_si128(c, _mm_set1_epi8(0x20));
+  const __m128i isDigit = _mm_and_si128(
+    _mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('9' + 1), c)
+  );
+  const __m128i isLetter = _mm_and_si128(
+    _mm_cmpgt_epi8(lowerCase, _mm_set1_epi8('a' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('f' + 1), lowerCase)
+  );
+  valid = _mm_and_si128(valid, _mm_or_si128(isDigit, isLetter));
+  return _mm_or_si128(
+    _mm_and_si128(isDigit, _mm_sub_epi8(c, _mm_set1_epi8('0'))),
+    _mm_and_si128(isLetter, _mm_sub_epi8(lowerCase, _mm_set1_epi8('a' - 10)))
+  );
+}
+
+SEEDED_SSSE3_TARGET static bool hexDecodeSsse3(unsigned char* bytes, const char* hex, const size_t length) {
+  // Each 16-bit lane holds (high digit, low digit): multiply-add by (16, 1)
+  const __m128i weights = _mm_set1_epi16(0x0110);
+  __m128i valid = _mm_set1_epi8(-1);
+  size_t i = 0;
+  for (; i + 16 <= length; i += 16) {
+    const __m128i first = hexValues16(_mm_loadu_si128((const __m128i*) (hex + 2 * i)), valid);
+    const __m128i second = hexValues16(_mm_loadu_si128((const __m128i*) (hex + 2 * i + 16)), valid);
+    _mm_storeu_si128((__m128i*) (bytes + i), _mm_packus_epi16(
+      _mm_maddubs_epi16(first, weights), _mm_maddubs_epi16(second, weights)
+    ));
+  }
+  const bool tailValid = hexDecodeScalar(bytes + i, hex + 2 * i, length - i);
+  return _mm_movemask_epi8(valid) == 0xffff && tailValid;
+}
+
+SEEDED_AVX2_TARGET static inline __m256i hexValues32(__m256i c, __m256i& valid) {
+  const __m256i lowerCase = _mm256_or_si256(c, _mm256_set1_epi8(0x20));
+  const __m256i isDigit = _mm256_and_si256(
+    _mm256_cmpgt_epi8(c, _mm256_set1_epi8('0' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), c)
+  );
+  const __m256i isLetter = _mm256_and_si256(
+    _mm256_cmpgt_epi8(lowerCase, _mm256_set1_epi8('a' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('f' + 1), lowerCase)
+  );
+  valid = _mm256_and_si256(valid, _mm256_or_si256(isDigit, isLetter));
+  return _mm256_or_si256(
+    _mm256_and_si256(isDigit, _mm256_sub_epi8(c, _mm256_set1_epi8('0'))),
+    _mm256_and_si256(isLetter, _mm256_sub_epi8(lowerCase, _mm256_set1_epi8('a' - 10)))
+  );
+}
+
+SEEDED_AVX2_TARGET static bool hexDecodeAvx2(unsigned char* bytes, const char* hex, const size_t length) {
+  const __m256i weights = _mm256_set1_epi16(0x0110);
+  __m256i valid = _mm256_set1_epi8(-1);
+  size_t i = 0;
+  for (; i + 32 <= length; i += 32) {
+    const __m256i first = hexValues32(_mm256_loadu_si256((const __m256i*) (hex + 2 * i)), valid);
+    const __m256i second = hexValues32(_mm256_loadu_si256((const __m256i*) (hex + 2 * i + 32)), valid);
+    // The pack works within 128-bit lanes, leaving 64-bit
+    // blocks in the order 0, 2, 1, 3
+    const __m256i packed = _mm256_packus_epi16(
+      _mm256_maddubs_epi16(first, weights), _mm256_maddubs_epi16(second, weights)
+    );
+    _mm256_storeu_si256((__m256i*) (bytes + i), _mm256_permute4x64_epi64(packed, 0xd8));
   }
+  const bool tailValid = hexDecodeScalar(bytes + i, hex + 2 * i, length - i);
+  return _mm256_movemask_epi8(valid) == -1 && tailValid;
+}
+
+#endif
+
+bool hexCodecIsSupported(HexCodec codec) {
+  // libsodium's CPU feature flags are set by sodium_init
+  ensureSodiumInitialized();
+  switch (codec) {
+#ifdef SEEDED_HEX_SIMD
+    case HexCodec::Avx2:
+      return sodium_runtime_has_avx2() != 0;
+    case HexCodec::Ssse3:
+      return sodium_runtime_has_ssse3() != 0;
+#endif
+    case HexCodec::Scalar:
+      return true;
+    default:
+      return false;
+  }
+}
+
+HexCodec bestHexCodec() {
+  return hexCodecIsSupported(HexCodec::Avx2) ? HexCodec::Avx2 :
+    hexCodecIsSupported(HexCodec::Ssse3) ? HexCodec::Ssse3 :
+    HexCodec::Scalar;
+}
+
+const char* hexCodecName(HexCodec codec) {
+  switch (codec) {
+    case HexCodec::Avx2: return "avx2";
+    case HexCodec::Ssse3: return "ssse3";
+    default: return "scalar";
+  }
+}
+
+void hexEncode(char* hex, const unsigned char* bytes, const size_t length, HexCodec codec) {
+  if (!hexCodecIsSupported(codec)) {
+    throw std::invalid_argument("Hex codec not supported on this processor");
+  }
+#ifdef SEEDED_HEX_SIMD
+  if (codec == HexCodec::Avx2) {
+    return hexEncodeAvx2(hex, bytes, length);
+  } else if (codec == HexCodec::Ssse3) {
+    return hexEncodeSsse3(hex, bytes, length);
+  }
+#endif
+  hexEncodeScalar(hex, bytes, length);
+}
+
+bool hexDecode(unsigned char* bytes, const char* hex, const size_t length, HexCodec codec) {
+  if (!hexCodecIsSupported(codec)) {
+    throw std::invalid_argument("Hex codec not supported on this processor");
+  }
+#ifdef SEEDED_HEX_SIMD
+  if (codec == HexCodec::Avx2) {
+    return hexDecodeAvx2(bytes, hex, length);
+  } else if (codec == HexCodec::Ssse3) {
+    return hexDecodeSsse3(bytes, hex, length);
+  }
+#endif
+  return hexDecodeScalar(bytes, hex, length);
+}
+
+const std::string toHexStr(const unsigned char* bytes, const size_t length)
+{
+  std::string hexString(length * 2, ' ');
+  hexEncode(&hexString[0], bytes, length);
   return hexString;
 }
 
-const std::vector<unsigned char> hexStrToByteVector(const std::string hexStr)
+const std::string toHexStr(const std::vector<unsigned char>& bytes)
 {
-  if (hexStr.length() >= 2 && hexStr[1] == 'x' && hexStr[0] == '0') {
-    // Ignore prefix '0x'
-    return hexStrToByteVector(hexStr.substr(2));
-  }
-  if (hexStr.length() % 2 == 1) {
+  return toHexStr(bytes.data(), bytes.size());
+}
+
+// The length of the (ignored) '0x' prefix, if any
+static size_t hexPrefixLength(const std::string& hexStr) {
+  return (hexStr.length() >= 2 && hexStr[1] == 'x' && hexStr[0] == '0') ? 2 : 0;
+}
+
+const std::vector<unsigned char> hexStrToByteVector(const std::string& hexStr)
+{
+  const size_t start = hexPrefixLength(hexStr);
+  if ((hexStr.length() - start) % 2 == 1) {
     throw std::invalid_argument("Invalid hex string length");
   }
-  std::vector<unsigned char> byteVector(hexStr.length() / 2, 0);
-  for (size_t i = 0; i < byteVector.size(); i++) {
-    byteVector[i] = (parseHexChar(hexStr[2 * i]) << 4) | parseHexChar(hexStr[2 * i + 1]);
+  std::vector<unsigned char> byteVector((hexStr.length() - start) / 2, 0);
+  if (!hexDecode(byteVector.data(), hexStr.data() + start, byteVector.size())) {
+    throw InvalidHexCharacterException();
+  }
+  return byteVector;
+}
+
+bool tryHexStrToByteVector(const std::string& hexStr, std::vector<unsigned char>& byteVector)
+{
+  const size_t start = hexPrefixLength(hexStr);
+  if ((hexStr.length() - start) % 2 == 1) {
+    return false;
+  }
+  byteVector.resize((hexStr.length() - start) / 2);
+  return hexDecode(byteVector.data(), hexStr.data() + start, byteVector.size());
+}
+
+size_t base64UrlEncodedLength(const size_t length)
+{
+  // sodium_base64_ENCODED_LEN includes the NUL terminator
+  return sodium_base64_ENCODED_LEN(length, sodium_base64_VARIANT_URLSAFE_NO_PADDING) - 1;
+}
+
+void base64UrlEncode(char* base64Url, const unsigned char* bytes, const size_t length)
+{
+  sodium_bin2base64(
+    base64Url, base64UrlEncodedLength(length) + 1, bytes, length,
+    sodium_base64_VARIANT_URLSAFE_NO_PADDING
+  );
+}
+
+bool base64UrlDecode(unsigned char* bytes, size_t& length, const char* base64Url, const size_t base64UrlLength)
+{
+  return sodium_base642bin(
+    bytes, (base64UrlLength * 3) / 4, base64Url, base64UrlLength,
+    NULL, &length, NULL, sodium_base64_VARIANT_URLSAFE_NO_PADDING
+  ) == 0;
+}
+
+const std::string toBase64UrlStr(const unsigned char* bytes, const size_t length)
+{
+  std::string base64UrlString(base64UrlEncodedLength(length) + 1, '\0');
+  base64UrlEncode(&base64UrlString[0], bytes, length);
+  base64UrlString.resize(base64UrlString.size() - 1);
+  return base64UrlString;
+}
+
+static bool tryBase64UrlStrToByteVector(const std::string& base64UrlStr, std::vector<unsigned char>& byteVector)
+{
+  byteVector.resize((base64UrlStr.length() * 3) / 4);
+  size_t length = 0;
+  if (!base64UrlDecode(byteVector.data(), length, base64UrlStr.data(), base64UrlStr.length())) {
+    return false;
+  }
+  byteVector.resize(length);
+  return true;
+}
+
+const std::vector<unsigned char> base64UrlStrToByteVector(const std::string& base64UrlStr)
+{
+  std::vector<unsigned char> byteVector;
+  if (!tryBase64UrlStrToByteVector(base64UrlStr, byteVector)) {
+    throw std::invalid_argument("Invalid base64url string");
   }
   return byteVector;
 }
+
+namespace BinaryEncodingName {
+  const std::string hex = "hex";
+  const std::string base64Url = "base64url";
+}
+
+const std::string binaryEncodingName(BinaryEncoding binaryEncoding) {
+  return binaryEncoding == BinaryEncoding::Base64Url ? BinaryEncodingName::base64Url : BinaryEncodingName::hex;
+}
+
+bool tryBinaryEncodingFromName(const std::string& name, BinaryEncoding& binaryEncoding) {
+  if (name == BinaryEncodingName::hex) {
+    binaryEncoding = BinaryEncoding::Hex;
+  } else if (name == BinaryEncodingName::base64Url) {
+    binaryEncoding = BinaryEncoding::Base64Url;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+BinaryEncoding binaryEncodingFromName(const std::string& name) {
+  BinaryEncoding binaryEncoding;
+  if (!tryBinaryEncodingFromName(name, binaryEncoding)) {
+    throw std::invalid_argument("Unknown binary encoding: " + name);
+  }
+  return binaryEncoding;
+}
+
+const std::string toEncodedStr(const unsigned char* bytes, const size_t length, BinaryEncoding binaryEncoding) {
+  return binaryEncoding == BinaryEncoding::Base64Url ?
+    toBase64UrlStr(bytes, length) : toHexStr(bytes, length);
+}
+
+const std::string toEncodedStr(const std::vector<unsigned char>& bytes, BinaryEncoding binaryEncoding) {
+  return toEncodedStr(bytes.data(), bytes.size(), binaryEncoding);
+}
+
+const std::vector<unsigned char> encodedStrToByteVector(const std::string& encodedStr, BinaryEncoding binaryEncoding) {
+  return binaryEncoding == BinaryEncoding::Base64Url ?
+    base64UrlStrToByteVector(encodedStr) : hexStrToByteVector(encodedStr);
+}
+
+bool tryEncodedStrToByteVector(const std::string& encodedStr, BinaryEncoding binaryEncoding, std::vector<unsigned char>& byteVector) {
+  return binaryEncoding == BinaryEncoding::Base64Url ?
+    tryBase64UrlStrToByteVector(encodedStr, byteVector) : tryHexStrToByteVector(encodedStr, byteVector);
+}
+
+SodiumBuffer encodedStrToSodiumBuffer(const std::string& encodedStr, BinaryEncoding binaryEncoding) {
+  if (binaryEncoding == BinaryEncoding::Hex) {
+    return SodiumBuffer::fromHexString(encodedStr);
+  }
+  // Decode into secure memory, then copy only the decoded length
+  SodiumBuffer decoded((encodedStr.length() * 3) / 4);
+  size_t length = 0;
+  if (!base64UrlDecode(decoded.data, length, encodedStr.data(), encodedStr.length())) {
+    throw std::invalid_argument("Invalid base64url string");
+  }
+  return SodiumBuffer(length, decoded.data);
+}
@@ -26,5 +26,71 @@ inline unsigned char parseHexChar(char c) {
   throw InvalidHexCharacterException();
 }
 
-const std::string toHexStr(const std::vector<unsigned char> bytes);
-const std::vector<unsigned char> hexStrToByteVector(const std::string hexStr);
+/**
+ * The implementations of the hex codec.  The vectorized ones are only
+ * used when the processor reports the instruction set at runtime
+ * (after sodium_init), and all produce identical output.
+ */
+enum class HexCodec {
+  Scalar,
+  Ssse3,
+  Avx2
+};
+
+// true if the processor can run the given implementation
+bool hexCodecIsSupported(HexCodec codec);
+// The fastest implementation the processor supports
+HexCodec bestHexCodec();
+const char* hexCodecName(HexCodec codec);
+
+// Write 2 * length lower-case hex digits encoding bytes into hex
+// (which is not NUL-terminated).
+void hexEncode(char* hex, const unsigned char* bytes, const size_t length, HexCodec codec = bestHexCodec());
+// Decode 2 * length hex digits (of either case) into length bytes.
+// Returns false, leaving bytes unspecified, if a character is not a hex digit.
+bool hexDecode(unsigned char* bytes, const char* hex, const size_t length, HexCodec codec = bestHexCodec());
+
+const std::string toHexStr(const unsigned char* bytes, const size_t length);
+const std::string toHexStr(const std::vector<unsigned char>& bytes);
+const std::vector<unsigned char> hexStrToByteVector(const std::string& hexStr);
+// The non-throwing form of hexStrToByteVector: returns false, leaving
+// byteVector unspecified, if hexStr is not a valid hex string.
+bool tryHexStrToByteVector(const std::string& hexStr, std::vector<unsigned char>& byteVector);
+
+// Unpadded base64url (RFC 4648 section 5), via libsodium's constant-time codec
+size_t base64UrlEncodedLength(const size_t length);
+// Write base64UrlEncodedLength(length) characters followed by a NUL into base64Url
+void base64UrlEncode(char* base64Url, const unsigned char* bytes, const size_t length);
+// Decode into bytes (of at least (base64UrlLength * 3) / 4 bytes), setting length.
+// Returns false if base64Url is not canonical, unpadded base64url.
+bool base64UrlDecode(unsigned char* bytes, size_t& length, const char* base64Url, const size_t base64UrlLength);
+const std::string toBase64UrlStr(const unsigned char* bytes, const size_t length);
+const std::vector<unsigned char> base64UrlStrToByteVector(const std::string& base64UrlStr);
+
+/**
+ * How binary fields are written as strings in the JSON formats.  Hex is
+ * the default; base64url is a third smaller (4/3 rather than 2 characters
+ * per byte).  A JSON object that uses base64url says so with a
+ * "binaryEncoding": "base64url" field, and objects without that field
+ * are read as hex, so JSON written before base64url existed still parses.
+ */
+enum class BinaryEncoding {
+  Hex,
+  Base64Url
+};
+
+namespace BinaryEncodingJsonField {
+  const std::string binaryEncoding = "binaryEncoding";
+}
+
+const std::string binaryEncodingName(BinaryEncoding binaryEncoding);
+// Throws std::invalid_argument if the name is not "hex" or "base64url"
+BinaryEncoding binaryEncodingFromName(const std::string& name);
+bool tryBinaryEncodingFromName(const std::string& name, BinaryEncoding& binaryEncoding);
+
+const std::string toEncodedStr(const unsigned char* bytes, const size_t length, BinaryEncoding binaryEncoding);
+const std::string toEncodedStr(const std::vector<unsigned char>& bytes, BinaryEncoding binaryEncoding);
+const std::vector<unsigned char> encodedStrToByteVector(const std::string& encodedStr, BinaryEncoding binaryEncoding);
+bool tryEncodedStrToByteVector(const std::string& encodedStr, BinaryEncoding binaryEncoding, std::vector<unsigned char>& byteVector);
+// Decode directly into secure memory, for secrets
+SodiumBuffer encodedStrToSodiumBuffer(const std::string& encodedStr, BinaryEncoding binaryEncoding);
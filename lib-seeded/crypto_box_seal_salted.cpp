@@ -55,7 +55,6 @@ crypto_box_salted_seal(
   const size_t salt_length  
 )
 {
-    unsigned char nonce[crypto_box_NONCEBYTES];
     unsigned char epk[crypto_box_PUBLICKEYBYTES];
     unsigned char esk[crypto_box_SECRETKEYBYTES];
     int           ret;
@@ -64,13 +63,45 @@ crypto_box_salted_seal(
     if (crypto_box_keypair(epk, esk) != 0) {
         return -1; /* LCOV_EXCL_LINE */
     }
+    ret = crypto_box_salted_seal_with_ephemeral_keypair(
+      output_ciphertext, message, message_length,
+      recipients_curve22519_public_key, epk, esk,
+      salt, salt_length
+    );
+    sodium_memzero(esk, sizeof esk);
+    sodium_memzero(epk, sizeof epk);
+
+    return ret;
+}
+
+/**
+ * The same as crypto_box_salted_seal, but using an ephemeral
+ * key pair generated by the caller (e.g. ahead of time by
+ * an EphemeralKeyPool).
+ * 
+ * The caller is responsible for using each ephemeral key pair
+ * only once and for erasing the ephemeral secret key afterward.
+ */
+int
+crypto_box_salted_seal_with_ephemeral_keypair(
+  unsigned char *output_ciphertext,
+  const unsigned char *message,
+  unsigned long long message_length,
+  const unsigned char *recipients_curve22519_public_key,
+  const unsigned char *epk,
+  const unsigned char *esk,
+  const char* salt,
+  const size_t salt_length
+)
+{
+    unsigned char nonce[crypto_box_NONCEBYTES];
+    int           ret;
+
     memcpy(output_ciphertext, epk, crypto_box_PUBLICKEYBYTES);
     _crypto_box_seal_nonce_salted(nonce, epk, recipients_curve22519_public_key, salt, salt_length);
     ret = crypto_box_easy(output_ciphertext + crypto_box_PUBLICKEYBYTES,
                           message, message_length,
                           nonce, recipients_curve22519_public_key, esk);
-    sodium_memzero(esk, sizeof esk);
-    sodium_memzero(epk, sizeof epk);
     sodium_memzero(nonce, sizeof nonce);
 
     return ret;
@@ -97,3 +128,277 @@ crypto_box_salted_seal_open(
                                 nonce, c, sk);
 }
 
+
+/**
+ * The same as crypto_box_salted_seal_with_ephemeral_keypair, but
+ * taking the key k = crypto_box_beforenm(pk, esk) in place of esk,
+ * so that the caller can compute the keys for many messages at once.
+ */
+int
+crypto_box_salted_seal_afternm(
+  unsigned char *output_ciphertext,
+  const unsigned char *message,
+  unsigned long long message_length,
+  const unsigned char *recipients_curve22519_public_key,
+  const unsigned char *epk,
+  const unsigned char *k,
+  const char* salt,
+  const size_t salt_length
+)
+{
+    unsigned char nonce[crypto_box_NONCEBYTES];
+    int           ret;
+
+    memcpy(output_ciphertext, epk, crypto_box_PUBLICKEYBYTES);
+    _crypto_box_seal_nonce_salted(nonce, epk, recipients_curve22519_public_key, salt, salt_length);
+    ret = crypto_box_easy_afternm(output_ciphertext + crypto_box_PUBLICKEYBYTES,
+                                  message, message_length, nonce, k);
+    sodium_memzero(nonce, sizeof nonce);
+
+    return ret;
+}
+
+/**
+ * The same as crypto_box_salted_seal_open, but taking the key
+ * k = crypto_box_beforenm(epk, sk), where epk is the first
+ * crypto_box_PUBLICKEYBYTES of the ciphertext, in place of sk.
+ */
+int
+crypto_box_salted_seal_open_afternm(
+  unsigned char *m, const unsigned char *c,
+  unsigned long long clen,
+  const unsigned char *pk, const unsigned char *k,
+  const char* salt, const size_t salt_length
+)
+{
+    unsigned char nonce[crypto_box_NONCEBYTES];
+
+    if (clen < crypto_box_SEALBYTES) {
+        return -1;
+    }
+    _crypto_box_seal_nonce_salted(nonce, c, pk, salt, salt_length);
+
+    return crypto_box_open_easy_afternm(m, c + crypto_box_PUBLICKEYBYTES,
+                                        clen - crypto_box_PUBLICKEYBYTES,
+                                        nonce, k);
+}
+
+/**
+ * Check the Poly1305 authenticator of an XSalsa20-Poly1305 secret box
+ * (as created by crypto_secretbox_easy) without decrypting it.
+ * 
+ * This is the first half of crypto_secretbox_open_detached: the
+ * Poly1305 key is the first 32 bytes of the XSalsa20 keystream.
+ * Splitting it out lets a caller reject a forged or corrupted
+ * message before allocating space for its plaintext.
+ * 
+ * Returns 0 if the box is authentic and -1 if it is not.
+ **/
+int
+crypto_secretbox_xsalsa20poly1305_verify_only(
+  const unsigned char *mac,
+  const unsigned char *c,
+  unsigned long long clen,
+  const unsigned char *n,
+  const unsigned char *k
+)
+{
+    unsigned char poly1305_key[crypto_onetimeauth_poly1305_KEYBYTES];
+    int           ret;
+
+    crypto_stream_xsalsa20(poly1305_key, sizeof poly1305_key, n, k);
+    ret = crypto_onetimeauth_poly1305_verify(mac, c, clen, poly1305_key);
+    sodium_memzero(poly1305_key, sizeof poly1305_key);
+
+    return ret;
+}
+
+/**
+ * The second half of crypto_secretbox_open_detached: decrypt a
+ * secret box that crypto_secretbox_xsalsa20poly1305_verify_only has
+ * already found to be authentic.  The message starts 32 bytes
+ * into the keystream, after the Poly1305 key.
+ **/
+void
+crypto_secretbox_xsalsa20poly1305_open_verified(
+  unsigned char *m,
+  const unsigned char *c,
+  unsigned long long clen,
+  const unsigned char *n,
+  const unsigned char *k
+)
+{
+    unsigned char      block0[64U];
+    unsigned long long mlen0;
+
+    mlen0 = clen < 32U ? clen : 32U;
+    memset(block0, 0, 32U);
+    memcpy(block0 + 32U, c, mlen0);
+    crypto_stream_xsalsa20_xor(block0, block0, 32U + mlen0, n, k);
+    memcpy(m, block0 + 32U, mlen0);
+    if (clen > mlen0) {
+        crypto_stream_xsalsa20_xor_ic(m + mlen0, c + mlen0, clen - mlen0, n, 1U, k);
+    }
+    sodium_memzero(block0, sizeof block0);
+}
+
+/**
+ * Check the authenticator of a ciphertext sealed by
+ * crypto_box_salted_seal, without decrypting it, given
+ * k as for crypto_box_salted_seal_open_afternm.
+ * 
+ * Returns 0 if the ciphertext is authentic and -1 if it is not.
+ **/
+int
+crypto_box_salted_seal_verify_afternm(
+  const unsigned char *c,
+  unsigned long long clen,
+  const unsigned char *pk, const unsigned char *k,
+  const char* salt, const size_t salt_length
+)
+{
+    unsigned char nonce[crypto_box_NONCEBYTES];
+
+    if (clen < crypto_box_SEALBYTES) {
+        return -1;
+    }
+    _crypto_box_seal_nonce_salted(nonce, c, pk, salt, salt_length);
+
+    return crypto_secretbox_xsalsa20poly1305_verify_only(
+      c + crypto_box_PUBLICKEYBYTES,
+      c + crypto_box_SEALBYTES,
+      clen - crypto_box_SEALBYTES,
+      nonce, k
+    );
+}
+
+/**
+ * Decrypt a ciphertext that crypto_box_salted_seal_verify_afternm
+ * has found to be authentic, without verifying it a second time.
+ * The output buffer m must be clen - crypto_box_SEALBYTES long.
+ **/
+void
+crypto_box_salted_seal_open_verified_afternm(
+  unsigned char *m, const unsigned char *c,
+  unsigned long long clen,
+  const unsigned char *pk, const unsigned char *k,
+  const char* salt, const size_t salt_length
+)
+{
+    unsigned char nonce[crypto_box_NONCEBYTES];
+
+    _crypto_box_seal_nonce_salted(nonce, c, pk, salt, salt_length);
+    crypto_secretbox_xsalsa20poly1305_open_verified(
+      m, c + crypto_box_SEALBYTES, clen - crypto_box_SEALBYTES, nonce, k
+    );
+}
+
+/**
+ * crypto_secretbox_easy for a message held in m_count fragments,
+ * producing exactly the box crypto_secretbox_easy would produce for
+ * the fragments concatenated, without concatenating them.
+ * 
+ * The XSalsa20 keystream is applied to each fragment in turn, a whole
+ * number of 64-byte blocks at a time where the fragment allows, with
+ * any block that straddles two fragments generated once and kept.
+ * As in crypto_secretbox_detached, the first 32 bytes of the keystream
+ * are the Poly1305 key and the message starts 32 bytes in.
+ * 
+ * The output buffer c must be crypto_secretbox_MACBYTES longer than the
+ * total length of the fragments.
+ **/
+int
+crypto_secretbox_xsalsa20poly1305_easy_fragments(
+  unsigned char *c,
+  const MessageFragment *m,
+  size_t m_count,
+  const unsigned char *n,
+  const unsigned char *k
+)
+{
+    crypto_onetimeauth_poly1305_state state;
+    unsigned char      subkey[crypto_stream_salsa20_KEYBYTES];
+    unsigned char      block[64U];
+    unsigned char     *out = c + crypto_secretbox_MACBYTES;
+    unsigned long long position = 32U;
+    size_t             i;
+
+    crypto_core_hsalsa20(subkey, n, k, NULL);
+    memset(block, 0, sizeof block);
+    crypto_stream_salsa20_xor_ic(block, block, sizeof block, n + 16, 0U, subkey);
+    crypto_onetimeauth_poly1305_init(&state, block);
+
+    for (i = 0; i < m_count; i++) {
+        const unsigned char *in = m[i].data;
+        size_t               remaining = m[i].length;
+
+        while (remaining > 0) {
+            const size_t offset = (size_t) (position % 64U);
+            size_t       take;
+            size_t       j;
+
+            if (offset == 0 && remaining >= 64U) {
+                // Whole blocks go straight through the stream cipher
+                take = remaining & ~(size_t) 63U;
+                crypto_stream_salsa20_xor_ic(out, in, take, n + 16, position / 64U, subkey);
+            } else {
+                if (offset == 0) {
+                    memset(block, 0, sizeof block);
+                    crypto_stream_salsa20_xor_ic(block, block, sizeof block, n + 16, position / 64U, subkey);
+                }
+                take = 64U - offset < remaining ? 64U - offset : remaining;
+                for (j = 0; j < take; j++) {
+                    out[j] = in[j] ^ block[offset + j];
+                }
+            }
+            crypto_onetimeauth_poly1305_update(&state, out, take);
+            out += take;
+            in += take;
+            remaining -= take;
+            position += take;
+        }
+    }
+    crypto_onetimeauth_poly1305_final(&state, c);
+    sodium_memzero(&state, sizeof state);
+    sodium_memzero(subkey, sizeof subkey);
+    sodium_memzero(block, sizeof block);
+
+    return 0;
+}
+
+/**
+ * crypto_box_salted_seal_with_ephemeral_keypair for a message held in
+ * m_count fragments, producing the same ciphertext as it would for the
+ * fragments concatenated.
+ **/
+int
+crypto_box_salted_seal_fragments_with_ephemeral_keypair(
+  unsigned char *output_ciphertext,
+  const MessageFragment *message_fragments,
+  size_t message_fragment_count,
+  const unsigned char *recipients_curve22519_public_key,
+  const unsigned char *epk,
+  const unsigned char *esk,
+  const char* salt,
+  const size_t salt_length
+)
+{
+    unsigned char nonce[crypto_box_NONCEBYTES];
+    unsigned char k[crypto_box_BEFORENMBYTES];
+    int           ret;
+
+    if (crypto_box_beforenm(k, recipients_curve22519_public_key, esk) != 0) {
+        return -1;
+    }
+    memcpy(output_ciphertext, epk, crypto_box_PUBLICKEYBYTES);
+    _crypto_box_seal_nonce_salted(nonce, epk, recipients_curve22519_public_key, salt, salt_length);
+    ret = crypto_secretbox_xsalsa20poly1305_easy_fragments(
+      output_ciphertext + crypto_box_PUBLICKEYBYTES,
+      message_fragments, message_fragment_count,
+      nonce, k
+    );
+    sodium_memzero(k, sizeof k);
+    sodium_memzero(nonce, sizeof nonce);
+
+    return ret;
+}
@@ -7,6 +7,8 @@
 
 #pragma once
 
+#include "message-fragment.hpp"
+
 int crypto_box_salted_seal(
   unsigned char* c, const unsigned char* m,
   unsigned long long mlen, const unsigned char* pk,
@@ -14,6 +16,14 @@ int crypto_box_salted_seal(
   const size_t salt_length
 );
 
+int crypto_box_salted_seal_with_ephemeral_keypair(
+  unsigned char* c, const unsigned char* m,
+  unsigned long long mlen, const unsigned char* pk,
+  const unsigned char* epk, const unsigned char* esk,
+  const char* salt,
+  const size_t salt_length
+);
+
 int
 crypto_box_salted_seal_open(
   unsigned char* m, const unsigned char* c,
@@ -21,3 +31,72 @@ crypto_box_salted_seal_open(
   const unsigned char* pk, const unsigned char* sk,
   const char* salt, const size_t salt_length
 );
+
+int crypto_box_salted_seal_afternm(
+  unsigned char* c, const unsigned char* m,
+  unsigned long long mlen, const unsigned char* pk,
+  const unsigned char* epk, const unsigned char* k,
+  const char* salt,
+  const size_t salt_length
+);
+
+int
+crypto_box_salted_seal_open_afternm(
+  unsigned char* m, const unsigned char* c,
+  unsigned long long clen,
+  const unsigned char* pk, const unsigned char* k,
+  const char* salt, const size_t salt_length
+);
+
+int
+crypto_box_salted_seal_verify_afternm(
+  const unsigned char* c,
+  unsigned long long clen,
+  const unsigned char* pk, const unsigned char* k,
+  const char* salt, const size_t salt_length
+);
+
+void
+crypto_box_salted_seal_open_verified_afternm(
+  unsigned char* m, const unsigned char* c,
+  unsigned long long clen,
+  const unsigned char* pk, const unsigned char* k,
+  const char* salt, const size_t salt_length
+);
+
+int
+crypto_secretbox_xsalsa20poly1305_verify_only(
+  const unsigned char* mac,
+  const unsigned char* c,
+  unsigned long long clen,
+  const unsigned char* n,
+  const unsigned char* k
+);
+
+void
+crypto_secretbox_xsalsa20poly1305_open_verified(
+  unsigned char* m,
+  const unsigned char* c,
+  unsigned long long clen,
+  const unsigned char* n,
+  const unsigned char* k
+);
+
+int
+crypto_secretbox_xsalsa20poly1305_easy_fragments(
+  unsigned char* c,
+  const MessageFragment* m,
+  size_t m_count,
+  const unsigned char* n,
+  const unsigned char* k
+);
+
+int crypto_box_salted_seal_fragments_with_ephemeral_keypair(
+  unsigned char* c,
+  const MessageFragment* m,
+  size_t m_count,
+  const unsigned char* pk,
+  const unsigned char* epk, const unsigned char* esk,
+  const char* salt,
+  const size_t salt_length
+);
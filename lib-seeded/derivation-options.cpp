@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cassert>
 #include <exception>
 #include "sodium.h"
@@ -71,7 +72,8 @@ DerivationOptions::DerivationOptions(
     (type == DerivationOptionsJson::type::UnsealingKey) ?
       // For public key crypto, default to X25519
       DerivationOptionsJson::Algorithm::X25519 :
-    (type == DerivationOptionsJson::type::SigningKey) ?
+    (type == DerivationOptionsJson::type::SigningKey ||
+     type == DerivationOptionsJson::type::SigningAndUnsealingKey) ?
       // For public key signing, default to Ed25519
     DerivationOptionsJson::Algorithm::Ed25519 :
       // Otherwise, the leave the key setting to invalid (we don't care about a specific key type)
@@ -94,7 +96,8 @@ DerivationOptions::DerivationOptions(
       "Invalid algorithm type for public key cryptography"
     );
   }
-  if (type == DerivationOptionsJson::type::SigningKey &&
+  if ((type == DerivationOptionsJson::type::SigningKey ||
+       type == DerivationOptionsJson::type::SigningAndUnsealingKey) &&
     algorithm != DerivationOptionsJson::Algorithm::Ed25519
     ) {
     throw InvalidDerivationOptionValueException(
@@ -188,6 +191,17 @@ DerivationOptions::DerivationOptions(
 }
 
 
+// The name of a type as it appears in hash preimages, or "" if none
+static std::string typeName(const DerivationOptionsJson::type type) {
+  return
+    type == DerivationOptionsJson::type::Secret ? "Secret" :
+		type == DerivationOptionsJson::type::SymmetricKey ? "SymmetricKey" :
+		type == DerivationOptionsJson::type::UnsealingKey ? "UnsealingKey" :
+		type == DerivationOptionsJson::type::SigningKey ? "SigningKey" :
+		type == DerivationOptionsJson::type::SigningAndUnsealingKey ? "SigningAndUnsealingKey" :
+    "";
+}
+
 const std::string DerivationOptions::derivationOptionsJsonWithAllOptionalParametersSpecified(
   int indent,
   const char indent_char
@@ -203,12 +217,7 @@ const SodiumBuffer DerivationOptions::derivePrimarySecret(
   const DerivationOptionsJson::type finalType =
     type == DerivationOptionsJson::type::_INVALID_TYPE_ ?
       defaultType : type;
-  const std::string typeString =
-    finalType == DerivationOptionsJson::type::Secret ? "Secret" :
-		finalType == DerivationOptionsJson::type::SymmetricKey ? "SymmetricKey" :
-		finalType == DerivationOptionsJson::type::UnsealingKey ? "UnsealingKey" :
-		finalType == DerivationOptionsJson::type::SigningKey ? "SigningKey" :
-    "";
+  const std::string typeString = typeName(finalType);
 
   // Create a hash preimage that is the seed string, followed by a null
   // terminator, followed by the derivationOptionsJson string.
@@ -279,4 +288,73 @@ const SodiumBuffer DerivationOptions::derivePrimarySecret(
     }
 
     return DerivationOptions.derivePrimarySecret(seedString, typeRequired);
-  }
\ No newline at end of file
+  }
+
+const SodiumBuffer DerivationOptions::deriveChildSecret(
+  const SodiumBuffer& rootSecret,
+  const DerivationOptionsJson::type defaultType
+) const {
+  if (rootSecret.length < crypto_generichash_KEYBYTES_MIN ||
+      rootSecret.length > crypto_generichash_KEYBYTES_MAX) {
+    throw InvalidDerivationOptionValueException( (
+      "A root secret must be between " + std::to_string(crypto_generichash_KEYBYTES_MIN) +
+      " and " + std::to_string(crypto_generichash_KEYBYTES_MAX) + " bytes long"
+      ).c_str()
+    );
+  }
+  const DerivationOptionsJson::type finalType =
+    type == DerivationOptionsJson::type::_INVALID_TYPE_ ?
+      defaultType : type;
+  const std::string typeString = typeName(finalType);
+  static const std::string childDomain = "seeded-crypto:child";
+
+  // Each block of output is BLAKE2b-512 keyed with the root secret over
+  //   <blockIndex: u64> + <lengthInBytes: u64> + <label>
+  // where the label is the BLAKE2b-512 hash of
+  //   "seeded-crypto:child" + '\0' + <type> + '\0' + <derivationOptionsJson>
+  unsigned char input[8 + 8 + crypto_generichash_BYTES_MAX];
+  unsigned char* const label = input + 16;
+  crypto_generichash_state state;
+  crypto_generichash_init(&state, NULL, 0, crypto_generichash_BYTES_MAX);
+  crypto_generichash_update(&state, (const unsigned char*) childDomain.c_str(), childDomain.length() + 1);
+  crypto_generichash_update(&state, (const unsigned char*) typeString.c_str(), typeString.length() + 1);
+  crypto_generichash_update(&state, (const unsigned char*) derivationOptionsJson.c_str(), derivationOptionsJson.length());
+  crypto_generichash_final(&state, label, crypto_generichash_BYTES_MAX);
+  for (size_t i = 0; i < 8; i++) {
+    input[8 + i] = (unsigned char) ((uint64_t) lengthInBytes >> (8 * i));
+  }
+
+  SodiumBuffer derivedKey(lengthInBytes);
+  unsigned char block[crypto_generichash_BYTES_MAX];
+  for (uint64_t blockIndex = 0, offset = 0; offset < lengthInBytes; blockIndex++, offset += sizeof block) {
+    for (size_t i = 0; i < 8; i++) {
+      input[i] = (unsigned char) (blockIndex >> (8 * i));
+    }
+    crypto_generichash(block, sizeof block, input, sizeof input, rootSecret.data, rootSecret.length);
+    const size_t bytesToCopy = std::min<uint64_t>(sizeof block, lengthInBytes - offset);
+    memcpy(derivedKey.data + offset, block, bytesToCopy);
+  }
+  sodium_memzero(block, sizeof block);
+  return derivedKey;
+}
+
+const SodiumBuffer DerivationOptions::deriveChildSecret(
+  const SodiumBuffer& rootSecret,
+  const std::string& derivationOptionsJson,
+  const DerivationOptionsJson::type typeRequired,
+  const size_t lengthInBytesRequired
+) {
+  const DerivationOptions derivationOptions(derivationOptionsJson, typeRequired);
+
+  // Verify key-length requirements (if specified)
+  if (lengthInBytesRequired > 0 &&
+      derivationOptions.lengthInBytes != lengthInBytesRequired) {
+    throw InvalidDerivationOptionValueException( (
+      "lengthInBytes for this type should be " + std::to_string(lengthInBytesRequired) +
+      " but lengthInBytes field was set to " + std::to_string(derivationOptions.lengthInBytes)
+      ).c_str()
+    );
+  }
+
+  return derivationOptions.deriveChildSecret(rootSecret, typeRequired);
+}
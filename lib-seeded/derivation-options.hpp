@@ -108,7 +108,7 @@ public:
 	 *   <seedString> + '\0' + <typeRequired> + <derivationOptionsJson>
 	 * ```
 	 * where typeRequired is converted to a string in
-	 * ["Secret", "SymmetricKey", "UnsealingKey", "SigningKey"],
+	 * ["Secret", "SymmetricKey", "UnsealingKey", "SigningKey", "SigningAndUnsealingKey"],
 	 * based on the value of the typeRequired parameter.
 	 * 
 	 *   * For "Secret", the generated secret is placed directly into the
@@ -121,6 +121,8 @@ public:
 	 *   * For "SigningKey", the generated secret is the final parameter (input) to
 	 *     libsodium's `crypto_sign_seed_keypair` function, which generates
 	 *     the key bytes for the SigningKey and SignatureVerificationKey..
+	 *   * For "SigningAndUnsealingKey", the generated secret is used as for "SigningKey",
+	 *     and the X25519 UnsealingKey and SealingKey are converted from the Ed25519 pair.
 	 * 
 	 * @param seedString A seed value that is the primary salt for the hash function
 	 * @param derivationOptionsJson The derivation options in @ref derivation_options_format.
@@ -155,7 +157,7 @@ public:
 	 *   <seedString> + '\0' + <type> + <derivationOptionsJson>
 	 * ```
 	 * where type is converted to a string in
-	 * ["Secret", "SymmetricKey", "UnsealingKey", "SigningKey"],
+	 * ["Secret", "SymmetricKey", "UnsealingKey", "SigningKey", "SigningAndUnsealingKey"],
 	 * based on the value of the type parameter,
 	 * defaultType if type is not set (_INVALID_TYPE_),
 	 * or "" if neither is set (both are _INVALID_TYPE_).
@@ -170,6 +172,8 @@ public:
 	 *   * For "SigningKey", the generated secret is the final parameter (input) to
 	 *     libsodium's `crypto_sign_seed_keypair` function, which generates
 	 *     the key bytes for the SigningKey and SignatureVerificationKey..
+	 *   * For "SigningAndUnsealingKey", the generated secret is used as for "SigningKey",
+	 *     and the X25519 UnsealingKey and SealingKey are converted from the Ed25519 pair.
 	 * 
 	 * @param seedString A seed value that is the primary salt for the hash function
 	 * @param defaultType If the derivationOptionsJson has a type field, and that field
@@ -186,4 +190,57 @@ public:
 			DerivationOptionsJson::type::_INVALID_TYPE_
 	) const;
 
+	/**
+	 * @brief Derive the secret for a child key from a root secret, which is
+	 * itself the output of a (possibly memory-hard) derivePrimarySecret,
+	 * without running the derivation hash function again.
+	 *
+	 * This is the hierarchical alternative to derivePrimarySecret: the
+	 * expensive hash function runs once to produce a root Secret, and each
+	 * child costs a few keyed BLAKE2b computations.  The child secret is the
+	 * concatenation of 64-byte blocks, truncated to lengthInBytes, where each
+	 * block is BLAKE2b keyed with the root secret over
+	 * ```
+	 *   <blockIndex: u64> + <lengthInBytes: u64> + <label>
+	 * ```
+	 * (integers little-endian) and the label is the 64-byte BLAKE2b hash of
+	 * ```
+	 *   "seeded-crypto:child" + '\0' + <type> + '\0' + <derivationOptionsJson>
+	 * ```
+	 * The child secret is used just as the primary secret of the same type
+	 * would be.  The hash function fields of the derivationOptionsJson are
+	 * ignored, as the child is derived from the root secret rather than
+	 * from a seed.
+	 *
+	 * @param rootSecret The root secret, which must be 16 to 64 bytes long
+	 * @param derivationOptionsJson The child's derivation options in @ref derivation_options_format.
+	 * @param typeRequired As for derivePrimarySecret
+	 * @param lengthInBytesRequired As for derivePrimarySecret
+	 * @return const SodiumBuffer The derived child secret
+	 *
+	 * @throw InvalidDerivationOptionValueException
+	 * @throw InvalidDerivationOptionsJsonException
+	 */
+	static const SodiumBuffer deriveChildSecret(
+		const SodiumBuffer& rootSecret,
+		const std::string& derivationOptionsJson,
+		const DerivationOptionsJson::type typeRequired = DerivationOptionsJson::type::_INVALID_TYPE_,
+		const size_t lengthInBytesRequired = 0
+	);
+
+	/**
+	 * @brief Derive the secret for a child key from a root secret, as
+	 * described for the static deriveChildSecret.
+	 *
+	 * @param rootSecret The root secret, which must be 16 to 64 bytes long
+	 * @param defaultType The type to use if the derivationOptionsJson has none
+	 *
+	 * @throw InvalidDerivationOptionValueException
+	 */
+	const SodiumBuffer deriveChildSecret(
+		const SodiumBuffer& rootSecret,
+		const DerivationOptionsJson::type defaultType =
+			DerivationOptionsJson::type::_INVALID_TYPE_
+	) const;
+
 };
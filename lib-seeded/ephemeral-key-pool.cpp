@@ -0,0 +1,129 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include "ephemeral-key-pool.hpp"
+#include "sodium-initializer.hpp"
+
+// Generate key pairs in batches outside of the lock so that
+// callers of take() are never blocked behind scalar multiplications.
+static const size_t keyPairsGeneratedPerBatch = 16;
+
+static std::shared_ptr<EphemeralKeyPool> defaultEphemeralKeyPool;
+
+EphemeralKeyPool::EphemeralKeyPool(
+  size_t _capacity,
+  size_t _refillThreshold
+) :
+  capacity(_capacity),
+  refillThreshold(_refillThreshold > 0 ? _refillThreshold : _capacity / 2),
+  keyPairs(_capacity * keyPairBytes),
+  head(0),
+  count(0),
+  stopping(false),
+  hits(0),
+  misses(0)
+{
+  if (capacity == 0) {
+    throw std::invalid_argument("An EphemeralKeyPool must have a capacity of at least one key pair");
+  }
+  if (refillThreshold >= capacity) {
+    throw std::invalid_argument("An EphemeralKeyPool's refill threshold must be less than its capacity");
+  }
+  ensureSodiumInitialized();
+  worker = std::thread(&EphemeralKeyPool::refill, this);
+}
+
+EphemeralKeyPool::~EphemeralKeyPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  refillNeeded.notify_all();
+  worker.join();
+  // The SodiumBuffer holding any unused key pairs erases them when freed
+}
+
+bool EphemeralKeyPool::take(
+  unsigned char* publicKey,
+  unsigned char* secretKey
+) {
+  bool belowThreshold;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (count == 0) {
+      misses++;
+      return false;
+    }
+    unsigned char* slot = keyPairs.data + head * keyPairBytes;
+    memcpy(publicKey, slot, crypto_box_PUBLICKEYBYTES);
+    memcpy(secretKey, slot + crypto_box_PUBLICKEYBYTES, crypto_box_SECRETKEYBYTES);
+    // Each key pair is used exactly once
+    sodium_memzero(slot, keyPairBytes);
+    head = (head + 1) % capacity;
+    count--;
+    belowThreshold = count <= refillThreshold;
+  }
+  hits++;
+  if (belowThreshold) {
+    refillNeeded.notify_one();
+  }
+  return true;
+}
+
+size_t EphemeralKeyPool::available() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return count;
+}
+
+void EphemeralKeyPool::fill() {
+  SodiumBuffer batch(keyPairsGeneratedPerBatch * keyPairBytes);
+  std::unique_lock<std::mutex> lock(mutex);
+  fillToCapacity(lock, batch);
+}
+
+void EphemeralKeyPool::fillToCapacity(
+  std::unique_lock<std::mutex>& lock,
+  SodiumBuffer& batch
+) {
+  while (!stopping && count < capacity) {
+    const size_t keyPairsToGenerate = std::min(keyPairsGeneratedPerBatch, capacity - count);
+    lock.unlock();
+    for (size_t i = 0; i < keyPairsToGenerate; i++) {
+      unsigned char* keyPair = batch.data + i * keyPairBytes;
+      crypto_box_keypair(keyPair, keyPair + crypto_box_PUBLICKEYBYTES);
+    }
+    lock.lock();
+    // Slots may have been taken while the lock was released, never filled
+    const size_t keyPairsToStore = std::min(keyPairsToGenerate, capacity - count);
+    for (size_t i = 0; i < keyPairsToStore; i++) {
+      memcpy(
+        keyPairs.data + ((head + count) % capacity) * keyPairBytes,
+        batch.data + i * keyPairBytes,
+        keyPairBytes
+      );
+      count++;
+    }
+    sodium_memzero(batch.data, batch.length);
+  }
+}
+
+void EphemeralKeyPool::refill() {
+  SodiumBuffer batch(keyPairsGeneratedPerBatch * keyPairBytes);
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    refillNeeded.wait(lock, [this]() { return stopping || count <= refillThreshold; });
+    // Fill all the way to capacity once the threshold has been crossed
+    fillToCapacity(lock, batch);
+    if (stopping) {
+      return;
+    }
+  }
+}
+
+void EphemeralKeyPool::setDefault(std::shared_ptr<EphemeralKeyPool> pool) {
+  std::atomic_store(&defaultEphemeralKeyPool, pool);
+}
+
+std::shared_ptr<EphemeralKeyPool> EphemeralKeyPool::getDefault() {
+  return std::atomic_load(&defaultEphemeralKeyPool);
+}
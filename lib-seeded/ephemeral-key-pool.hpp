@@ -0,0 +1,127 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "sodium-buffer.hpp"
+
+/**
+ * @brief A thread-safe pool of pre-generated ephemeral X25519 key pairs
+ * used by SealingKey::seal.
+ * 
+ * Sealing a message with a SealingKey generates a fresh ephemeral key pair,
+ * which costs a fixed-base scalar multiplication plus randomness and is
+ * roughly half the cost of sealing a small message.  An EphemeralKeyPool
+ * moves that work off the sealing path: a background thread keeps the pool
+ * topped up, and each seal takes one key pair from it.
+ * 
+ * Key pairs are held in a single SodiumBuffer, so they live in memory that is
+ * erased before it is released.  Each key pair is handed out exactly once and
+ * its slot is erased as it is taken.  When the pool is empty (e.g. during a
+ * burst larger than the pool) sealing falls back to generating the key pair
+ * inline, so using a pool never changes the format of sealed messages.
+ * 
+ * Pools are opt-in. To have SealingKey use one, install it by calling
+ * EphemeralKeyPool::setDefault.
+ * 
+ * @ingroup BuildingBlocks
+ */
+class EphemeralKeyPool {
+public:
+  /**
+   * @brief Construct a pool and start the background thread that fills it.
+   * 
+   * @param capacity The maximum number of key pairs to hold.
+   * @param refillThreshold The worker refills the pool whenever it holds
+   * this many key pairs or fewer.  Defaults (0) to half the capacity.
+   */
+  EphemeralKeyPool(
+    size_t capacity = 256,
+    size_t refillThreshold = 0
+  );
+
+  /**
+   * @brief Stop the background thread and erase any unused key pairs.
+   */
+  ~EphemeralKeyPool();
+
+  EphemeralKeyPool(const EphemeralKeyPool&) = delete;
+  EphemeralKeyPool& operator=(const EphemeralKeyPool&) = delete;
+
+  /**
+   * @brief Remove one key pair from the pool, copying it out and erasing
+   * its slot.
+   * 
+   * @param publicKey A buffer of crypto_box_PUBLICKEYBYTES to write the public key to
+   * @param secretKey A buffer of crypto_box_SECRETKEYBYTES to write the secret key to,
+   * which the caller must erase after its one use.
+   * @return true if a key pair was taken
+   * @return false if the pool was empty and the caller should generate its own
+   */
+  bool take(
+    unsigned char* publicKey,
+    unsigned char* secretKey
+  );
+
+  /**
+   * @brief Generate key pairs on the calling thread until the pool is full.
+   *
+   * Use this to have a pool warm before its first seal (or, in tests, to
+   * know exactly how many key pairs it holds) without waiting on the
+   * background thread.
+   */
+  void fill();
+
+  /**
+   * @brief The number of key pairs currently in the pool.
+   */
+  size_t available() const;
+
+  /**
+   * @brief The maximum number of key pairs the pool holds.
+   */
+  size_t getCapacity() const { return capacity; }
+
+  /**
+   * @brief The number of calls to take that found a key pair.
+   */
+  unsigned long long getHits() const { return hits.load(); }
+
+  /**
+   * @brief The number of calls to take that found the pool empty.
+   */
+  unsigned long long getMisses() const { return misses.load(); }
+
+  /**
+   * @brief Install a pool for SealingKey::seal to draw from, or pass
+   * an empty pointer to go back to generating key pairs inline.
+   */
+  static void setDefault(std::shared_ptr<EphemeralKeyPool> pool);
+
+  /**
+   * @brief The pool installed by setDefault (an empty pointer if none).
+   */
+  static std::shared_ptr<EphemeralKeyPool> getDefault();
+
+private:
+  static const size_t keyPairBytes = crypto_box_PUBLICKEYBYTES + crypto_box_SECRETKEYBYTES;
+
+  const size_t capacity;
+  const size_t refillThreshold;
+  // capacity slots of (public key, secret key), used as a ring buffer
+  SodiumBuffer keyPairs;
+  size_t head;
+  size_t count;
+  bool stopping;
+  std::atomic<unsigned long long> hits;
+  std::atomic<unsigned long long> misses;
+  mutable std::mutex mutex;
+  std::condition_variable refillNeeded;
+  std::thread worker;
+
+  void refill();
+  // Called with lock held; releases it while generating key pairs
+  void fillToCapacity(std::unique_lock<std::mutex>& lock, SodiumBuffer& batch);
+};
@@ -85,4 +85,19 @@ class InvalidDerivationOptionValueException: public std::invalid_argument
 		std::invalid_argument(m ? m : "Invalid key derivation options") {};
 };
 
+/**
+ * @brief Thrown when a file cannot be opened, read, or mapped into memory
+ */
+class FileAccessException: public std::runtime_error
+{
+	public:
+	/**
+	 * @brief Construct by throwing, passing an optional exception message
+	 * 
+	 * @param m The exception message
+	 */
+	FileAccessException(const char* m = NULL) :
+		std::runtime_error(m ? m : "Could not access file") {};
+};
+
 /** @} */ // end of Exceptions group
\ No newline at end of file
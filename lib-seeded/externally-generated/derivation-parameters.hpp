@@ -28,14 +28,16 @@ namespace DerivationOptionsJson {
 		Secret,
 		SymmetricKey,
 		UnsealingKey,
-		SigningKey
+		SigningKey,
+		SigningAndUnsealingKey
 	};
 	NLOHMANN_JSON_SERIALIZE_ENUM( type, {
 		{type::_INVALID_TYPE_, nullptr},
 		{type::Secret, "Secret"},
 		{type::SymmetricKey, "SymmetricKey"},
 		{type::UnsealingKey, "UnsealingKey"},
-		{type::SigningKey, "SigningKey"}
+		{type::SigningKey, "SigningKey"},
+		{type::SigningAndUnsealingKey, "SigningAndUnsealingKey"}
 	})
 	
 
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stddef.h>
+#include <string.h>
+#include <array>
+#include <vector>
+#include <sodium.h>
+
+/**
+ * @brief N bytes held inline, for the public keys and signatures whose
+ * lengths libsodium fixes at compile time.
+ *
+ * A key or signature stored this way is copied without allocating, and
+ * can be passed wherever a std::array<unsigned char, N> is expected.
+ * Code written when these were std::vector<unsigned char> still compiles:
+ * a FixedLengthBytes converts implicitly to a vector (a copy, which does
+ * allocate) and compares equal to a vector holding the same bytes.
+ *
+ * @ingroup BuildingBlocks
+ */
+template <size_t N>
+class FixedLengthBytes : public std::array<unsigned char, N> {
+public:
+  /**
+   * @brief N zero bytes
+   */
+  FixedLengthBytes() {
+    this->fill(0);
+  }
+
+  /**
+   * @brief A copy of the N bytes at bytes
+   */
+  explicit FixedLengthBytes(const unsigned char* bytes) {
+    memcpy(this->data(), bytes, N);
+  }
+
+  /**
+   * @brief Copy the bytes into a vector
+   */
+  const std::vector<unsigned char> toVector() const {
+    return std::vector<unsigned char>(this->begin(), this->end());
+  }
+
+  operator std::vector<unsigned char>() const {
+    return toVector();
+  }
+};
+
+// Without these, comparing two FixedLengthBytes would be ambiguous between
+// std::array's operators and the vector comparisons below
+template <size_t N>
+bool operator==(const FixedLengthBytes<N>& a, const FixedLengthBytes<N>& b) {
+  return memcmp(a.data(), b.data(), N) == 0;
+}
+
+template <size_t N>
+bool operator!=(const FixedLengthBytes<N>& a, const FixedLengthBytes<N>& b) {
+  return !(a == b);
+}
+
+template <size_t N>
+bool operator==(const FixedLengthBytes<N>& a, const std::vector<unsigned char>& b) {
+  return b.size() == N && memcmp(a.data(), b.data(), N) == 0;
+}
+
+template <size_t N>
+bool operator==(const std::vector<unsigned char>& a, const FixedLengthBytes<N>& b) {
+  return b == a;
+}
+
+template <size_t N>
+bool operator!=(const FixedLengthBytes<N>& a, const std::vector<unsigned char>& b) {
+  return !(a == b);
+}
+
+template <size_t N>
+bool operator!=(const std::vector<unsigned char>& a, const FixedLengthBytes<N>& b) {
+  return !(b == a);
+}
+
+/**
+ * @brief The bytes of a SealingKey or SignatureVerificationKey
+ * (crypto_box_PUBLICKEYBYTES and crypto_sign_PUBLICKEYBYTES are both 32)
+ */
+typedef FixedLengthBytes<crypto_box_PUBLICKEYBYTES> PublicKeyBytes;
+
+/**
+ * @brief A detached Ed25519 signature, as generated by a SigningKey
+ */
+typedef FixedLengthBytes<crypto_sign_BYTES> SignatureBytes;
+
+static_assert(
+  crypto_box_PUBLICKEYBYTES == crypto_sign_PUBLICKEYBYTES,
+  "PublicKeyBytes must hold both sealing and signature-verification keys"
+);
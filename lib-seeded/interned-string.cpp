@@ -0,0 +1,68 @@
+#include "interned-string.hpp"
+
+namespace {
+  // Function-local statics, so strings may be interned during static
+  // initialization of other translation units
+  std::shared_ptr<InternTable>& defaultInternTable() {
+    static std::shared_ptr<InternTable> table = std::make_shared<InternTable>();
+    return table;
+  }
+
+  const std::shared_ptr<const std::string>& emptyString() {
+    static const std::shared_ptr<const std::string> empty = std::make_shared<const std::string>();
+    return empty;
+  }
+}
+
+std::shared_ptr<const std::string> InternTable::intern(const std::string& str) {
+  std::lock_guard<std::mutex> lock(mutex);
+  std::weak_ptr<const std::string>& entry = entries[str];
+  std::shared_ptr<const std::string> shared = entry.lock();
+  if (shared) {
+    return shared;
+  }
+  shared = std::make_shared<const std::string>(str);
+  entry = shared;
+  // Sweep out freed strings whenever the table has doubled since the last
+  // sweep, so the cost of sweeping is amortized over the insertions
+  if (entries.size() > 2 * liveAtLastSweep + 16) {
+    for (auto it = entries.begin(); it != entries.end();) {
+      if (it->second.expired()) {
+        it = entries.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    liveAtLastSweep = entries.size();
+  }
+  return shared;
+}
+
+size_t InternTable::size() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return entries.size();
+}
+
+void InternTable::setDefault(std::shared_ptr<InternTable> table) {
+  std::atomic_store(&defaultInternTable(), table);
+}
+
+std::shared_ptr<InternTable> InternTable::getDefault() {
+  return std::atomic_load(&defaultInternTable());
+}
+
+InternedString::InternedString() : value(emptyString()) {}
+
+InternedString::InternedString(const std::string& str) {
+  if (str.empty()) {
+    value = emptyString();
+    return;
+  }
+  const std::shared_ptr<InternTable> table = InternTable::getDefault();
+  value = table ? table->intern(str) : std::make_shared<const std::string>(str);
+}
+
+InternedString::InternedString(const char* str) : InternedString(std::string(str)) {}
+
+InternedString::InternedString(const std::string& str, InternTable& table) :
+  value(str.empty() ? emptyString() : table.intern(str)) {}
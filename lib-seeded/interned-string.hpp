@@ -0,0 +1,137 @@
+#pragma once
+
+#include <stddef.h>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+
+/**
+ * @brief A thread-safe table of distinct strings, shared by every
+ * InternedString made from one of them.
+ *
+ * The table holds only weak references: a string is freed when the last
+ * InternedString referring to it is destroyed, and its entry is swept from
+ * the table as the table grows.
+ *
+ * A process-wide table (getDefault) is used unless an InternedString is
+ * constructed with another.  Components that intern many strings of their
+ * own, such as a key store for one tenant, can use a table of their own so
+ * that lookups in it do not contend with the rest of the process.
+ *
+ * @ingroup BuildingBlocks
+ */
+class InternTable {
+public:
+  InternTable() : liveAtLastSweep(0) {}
+
+  InternTable(const InternTable&) = delete;
+  InternTable& operator=(const InternTable&) = delete;
+
+  /**
+   * @brief The shared, immutable copy of str: the one already in the table
+   * if a live InternedString refers to it, or else a new one.
+   */
+  std::shared_ptr<const std::string> intern(const std::string& str);
+
+  /**
+   * @brief The number of entries in the table (including any whose
+   * strings have been freed but which have not yet been swept)
+   */
+  size_t size() const;
+
+  /**
+   * @brief Install the table that InternedStrings are interned in by
+   * default, or pass an empty pointer to give each InternedString a copy
+   * of its own.
+   */
+  static void setDefault(std::shared_ptr<InternTable> table);
+
+  /**
+   * @brief The table installed by setDefault, which is initially a
+   * process-wide table (an empty pointer if interning has been turned off).
+   */
+  static std::shared_ptr<InternTable> getDefault();
+
+private:
+  mutable std::mutex mutex;
+  std::unordered_map<std::string, std::weak_ptr<const std::string>> entries;
+  // The number of entries that survived the last sweep of freed strings
+  size_t liveAtLastSweep;
+};
+
+/**
+ * @brief An immutable, reference-counted string that shares its storage
+ * with every other InternedString of the same value.
+ *
+ * Keys and sealed messages store their derivationOptionsJson this way.
+ * A process may hold millions of keys derived from a handful of distinct
+ * derivation options; each key then holds a pointer to the options rather
+ * than a copy of them.  Copying an InternedString copies only the pointer.
+ *
+ * It converts implicitly to and from `const std::string&`, so it can be
+ * passed to functions that take strings and compared with them.
+ *
+ * @ingroup BuildingBlocks
+ */
+class InternedString {
+public:
+  /**
+   * @brief The empty string, which needs no table lookup
+   */
+  InternedString();
+
+  /**
+   * @brief Intern str in the default InternTable
+   */
+  InternedString(const std::string& str);
+
+  /**
+   * @brief Intern a C string in the default InternTable
+   */
+  InternedString(const char* str);
+
+  /**
+   * @brief Intern str in a table other than the default
+   */
+  InternedString(const std::string& str, InternTable& table);
+
+  /**
+   * @brief The string's value
+   */
+  const std::string& str() const { return *value; }
+  operator const std::string&() const { return *value; }
+
+  size_t size() const { return value->size(); }
+  size_t length() const { return value->length(); }
+  bool empty() const { return value->empty(); }
+  const char* data() const { return value->data(); }
+  const char* c_str() const { return value->c_str(); }
+
+  /**
+   * @brief true if other refers to the same storage as this string,
+   * as two InternedStrings of the same value interned in the same table do
+   */
+  bool sharesStorageWith(const InternedString& other) const { return value == other.value; }
+
+private:
+  std::shared_ptr<const std::string> value;
+};
+
+inline bool operator==(const InternedString& a, const InternedString& b) {
+  return a.sharesStorageWith(b) || a.str() == b.str();
+}
+inline bool operator==(const InternedString& a, const std::string& b) { return a.str() == b; }
+inline bool operator==(const std::string& a, const InternedString& b) { return a == b.str(); }
+inline bool operator==(const InternedString& a, const char* b) { return a.str() == b; }
+inline bool operator==(const char* a, const InternedString& b) { return a == b.str(); }
+inline bool operator!=(const InternedString& a, const InternedString& b) { return !(a == b); }
+inline bool operator!=(const InternedString& a, const std::string& b) { return !(a == b); }
+inline bool operator!=(const std::string& a, const InternedString& b) { return !(a == b); }
+inline bool operator!=(const InternedString& a, const char* b) { return !(a == b); }
+inline bool operator!=(const char* a, const InternedString& b) { return !(a == b); }
+
+inline std::ostream& operator<<(std::ostream& out, const InternedString& str) {
+  return out << str.str();
+}
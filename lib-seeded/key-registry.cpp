@@ -0,0 +1,148 @@
+#include "key-registry.hpp"
+#include "exceptions.hpp"
+
+static std::string keyIdToIndexKey(const unsigned char* keyId, const size_t keyIdLength) {
+  return std::string((const char*) keyId, keyIdLength);
+}
+
+bool KeyRegistry::add(const UnsealingKey& unsealingKey) {
+  const std::vector<unsigned char> keyId = unsealingKey.getKeyId();
+  if (!unsealingKeyIndex.insert(std::make_pair(
+    keyIdToIndexKey(keyId.data(), keyId.size()), unsealingKeys.size()
+  )).second) {
+    return false;
+  }
+  unsealingKeysByDerivationOptions[unsealingKey.derivationOptionsJson].push_back(unsealingKeys.size());
+  unsealingKeys.push_back(unsealingKey);
+  return true;
+}
+
+bool KeyRegistry::add(const SymmetricKey& symmetricKey) {
+  const std::vector<unsigned char> keyId = symmetricKey.getKeyId();
+  if (!symmetricKeyIndex.insert(std::make_pair(
+    keyIdToIndexKey(keyId.data(), keyId.size()), symmetricKeys.size()
+  )).second) {
+    return false;
+  }
+  symmetricKeysByDerivationOptions[symmetricKey.derivationOptionsJson].push_back(symmetricKeys.size());
+  symmetricKeys.push_back(symmetricKey);
+  return true;
+}
+
+const UnsealingKey* KeyRegistry::findUnsealingKey(const unsigned char* keyId, const size_t keyIdLength) const {
+  const auto entry = unsealingKeyIndex.find(keyIdToIndexKey(keyId, keyIdLength));
+  return entry == unsealingKeyIndex.end() ? NULL : &unsealingKeys[entry->second];
+}
+
+const SymmetricKey* KeyRegistry::findSymmetricKey(const unsigned char* keyId, const size_t keyIdLength) const {
+  const auto entry = symmetricKeyIndex.find(keyIdToIndexKey(keyId, keyIdLength));
+  return entry == symmetricKeyIndex.end() ? NULL : &symmetricKeys[entry->second];
+}
+
+Result<SodiumBuffer> KeyRegistry::route(
+  const unsigned char* keyId,
+  const size_t keyIdLength,
+  const SealingAlgorithm algorithm,
+  const std::string* derivationOptionsJson,
+  const unsigned char* ciphertext,
+  const size_t ciphertextLength,
+  const std::string& unsealingInstructions
+) const {
+  const bool mayBeUnsealingKey = algorithm != SealingAlgorithm::XSalsa20Poly1305;
+  const bool mayBeSymmetricKey = algorithm != SealingAlgorithm::X25519XSalsa20Poly1305;
+  if (keyIdLength > 0) {
+    const UnsealingKey* unsealingKey = mayBeUnsealingKey ? findUnsealingKey(keyId, keyIdLength) : NULL;
+    if (unsealingKey != NULL) {
+      return unsealingKey->tryUnseal(ciphertext, ciphertextLength, unsealingInstructions);
+    }
+    const SymmetricKey* symmetricKey = mayBeSymmetricKey ? findSymmetricKey(keyId, keyIdLength) : NULL;
+    if (symmetricKey != NULL) {
+      return symmetricKey->tryUnseal(ciphertext, ciphertextLength, unsealingInstructions);
+    }
+    return Result<SodiumBuffer>(ResultStatus::InvalidInput);
+  }
+
+  // Without a key ID, try each key derived with the same options
+  if (derivationOptionsJson == NULL) {
+    return Result<SodiumBuffer>(ResultStatus::InvalidInput);
+  }
+  bool hasCandidate = false;
+  if (mayBeUnsealingKey) {
+    const auto candidates = unsealingKeysByDerivationOptions.find(*derivationOptionsJson);
+    if (candidates != unsealingKeysByDerivationOptions.end()) {
+      for (size_t index : candidates->second) {
+        hasCandidate = true;
+        Result<SodiumBuffer> result = unsealingKeys[index].tryUnseal(ciphertext, ciphertextLength, unsealingInstructions);
+        if (result.ok()) {
+          return result;
+        }
+      }
+    }
+  }
+  if (mayBeSymmetricKey) {
+    const auto candidates = symmetricKeysByDerivationOptions.find(*derivationOptionsJson);
+    if (candidates != symmetricKeysByDerivationOptions.end()) {
+      for (size_t index : candidates->second) {
+        hasCandidate = true;
+        Result<SodiumBuffer> result = symmetricKeys[index].tryUnseal(ciphertext, ciphertextLength, unsealingInstructions);
+        if (result.ok()) {
+          return result;
+        }
+      }
+    }
+  }
+  return Result<SodiumBuffer>(
+    hasCandidate ? ResultStatus::CryptographicVerificationFailure : ResultStatus::InvalidInput
+  );
+}
+
+Result<SodiumBuffer> KeyRegistry::tryUnseal(const PackagedSealedMessage& packagedSealedMessage) const {
+  return route(
+    packagedSealedMessage.keyId.data(),
+    packagedSealedMessage.keyId.size(),
+    SealingAlgorithm::Unspecified,
+    &packagedSealedMessage.derivationOptionsJson.str(),
+    packagedSealedMessage.ciphertext.data(),
+    packagedSealedMessage.ciphertext.size(),
+    packagedSealedMessage.unsealingInstructions
+  );
+}
+
+Result<SodiumBuffer> KeyRegistry::tryUnseal(
+  const SealedMessageEnvelope& envelope,
+  const DerivationOptionsTable* derivationOptionsTable
+) const {
+  const std::string unsealingInstructions(envelope.unsealingInstructions, envelope.unsealingInstructionsLength);
+  const std::string* derivationOptionsJson = NULL;
+  std::string envelopeDerivationOptionsJson;
+  if (envelope.keyIdHintLength == 0) {
+    // Only needed to find candidate keys when there is no key ID
+    if (!envelope.hasDerivationOptionsTableId) {
+      envelopeDerivationOptionsJson.assign(envelope.derivationOptionsJson, envelope.derivationOptionsJsonLength);
+      derivationOptionsJson = &envelopeDerivationOptionsJson;
+    } else if (derivationOptionsTable != NULL) {
+      derivationOptionsJson = derivationOptionsTable->at(envelope.derivationOptionsTableId);
+    }
+  }
+  return route(
+    envelope.keyIdHint,
+    envelope.keyIdHintLength,
+    envelope.algorithm,
+    derivationOptionsJson,
+    envelope.ciphertext,
+    envelope.ciphertextLength,
+    unsealingInstructions
+  );
+}
+
+const SodiumBuffer KeyRegistry::unseal(const PackagedSealedMessage& packagedSealedMessage) const {
+  Result<SodiumBuffer> result = tryUnseal(packagedSealedMessage);
+  switch (result.getStatus()) {
+    case ResultStatus::Success:
+      return result.getValue();
+    case ResultStatus::CryptographicVerificationFailure:
+      throw CryptographicVerificationFailureException();
+    default:
+      throw std::invalid_argument("No key in the registry matches the message");
+  }
+}
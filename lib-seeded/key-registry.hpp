@@ -0,0 +1,129 @@
+#pragma once
+
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "sodium-buffer.hpp"
+#include "result.hpp"
+#include "packaged-sealed-message.hpp"
+#include "sealed-message-envelope.hpp"
+#include "unsealing-key.hpp"
+#include "symmetric-key.hpp"
+
+/**
+ * @brief A collection of UnsealingKeys and SymmetricKeys that routes each
+ * incoming sealed message to the key that can unseal it.
+ *
+ * Keys are indexed by their key IDs (UnsealingKey::getKeyId and
+ * SymmetricKey::getKeyId), so a message sealed with sealWithKeyId is routed
+ * with a single hash-table lookup and unsealed with a single key, however
+ * many keys the registry holds.
+ *
+ * A message without a key ID is tried against each key whose
+ * derivationOptionsJson matches the message's exactly, which is
+ * linear in the number of such keys.  A message whose key ID is not in
+ * the registry is rejected without trying any key.
+ *
+ * The registry is not synchronized: keys must not be added while
+ * other threads are looking up or unsealing messages.
+ *
+ * @ingroup DerivedFromSeeds
+ */
+class KeyRegistry {
+public:
+  KeyRegistry() {}
+
+  KeyRegistry(const KeyRegistry&) = delete;
+  KeyRegistry& operator=(const KeyRegistry&) = delete;
+
+  /**
+   * @brief Add a copy of an UnsealingKey
+   *
+   * @return false if a key with the same key ID was already added
+   */
+  bool add(const UnsealingKey& unsealingKey);
+
+  /**
+   * @brief Add a copy of a SymmetricKey
+   *
+   * @return false if a key with the same key ID was already added
+   */
+  bool add(const SymmetricKey& symmetricKey);
+
+  /**
+   * @brief The number of keys in the registry
+   */
+  size_t size() const { return unsealingKeys.size() + symmetricKeys.size(); }
+
+  /**
+   * @brief Find the UnsealingKey with the given key ID
+   *
+   * @return The key, or NULL if it is not in the registry.  The pointer
+   * remains valid for the lifetime of the registry.
+   */
+  const UnsealingKey* findUnsealingKey(const unsigned char* keyId, const size_t keyIdLength) const;
+
+  /**
+   * @brief Find the SymmetricKey with the given key ID
+   *
+   * @return The key, or NULL if it is not in the registry.  The pointer
+   * remains valid for the lifetime of the registry.
+   */
+  const SymmetricKey* findSymmetricKey(const unsigned char* keyId, const size_t keyIdLength) const;
+
+  /**
+   * @brief Unseal a message with whichever key in the registry can unseal it
+   *
+   * @return Result<SodiumBuffer> The plaintext, or ResultStatus::InvalidInput if
+   * no key in the registry matches the message's key ID (or, if it has none,
+   * its derivationOptionsJson), or ResultStatus::CryptographicVerificationFailure
+   * if no matching key could unseal it.
+   */
+  Result<SodiumBuffer> tryUnseal(const PackagedSealedMessage& packagedSealedMessage) const;
+
+  /**
+   * @brief Unseal a message straight from a parsed SealedMessageEnvelope,
+   * without copying its ciphertext, using its algorithm to decide which
+   * kind of key to look for (see the other form of tryUnseal).
+   *
+   * @param envelope The envelope, as parsed by SealedMessageEnvelope::parse
+   * @param derivationOptionsTable The table with which to resolve the
+   * envelope's derivation options ID, if it has one and no key ID hint
+   */
+  Result<SodiumBuffer> tryUnseal(
+    const SealedMessageEnvelope& envelope,
+    const DerivationOptionsTable* derivationOptionsTable = NULL
+  ) const;
+
+  /**
+   * @brief Unseal a message with whichever key in the registry can unseal it
+   *
+   * @exception std::invalid_argument Thrown if no key in the registry matches
+   * the message's key ID or derivationOptionsJson.
+   * @exception CryptographicVerificationFailureException Thrown if no matching
+   * key could unseal the message.
+   */
+  const SodiumBuffer unseal(const PackagedSealedMessage& packagedSealedMessage) const;
+
+private:
+  // Deques, so that pointers to keys remain valid as keys are added
+  std::deque<UnsealingKey> unsealingKeys;
+  std::deque<SymmetricKey> symmetricKeys;
+  // Key IDs (as strings of bytes) to indexes in the deques above
+  std::unordered_map<std::string, size_t> unsealingKeyIndex;
+  std::unordered_map<std::string, size_t> symmetricKeyIndex;
+  // derivationOptionsJson to the indexes of the keys derived with it
+  std::unordered_map<std::string, std::vector<size_t>> unsealingKeysByDerivationOptions;
+  std::unordered_map<std::string, std::vector<size_t>> symmetricKeysByDerivationOptions;
+
+  Result<SodiumBuffer> route(
+    const unsigned char* keyId,
+    const size_t keyIdLength,
+    const SealingAlgorithm algorithm,
+    const std::string* derivationOptionsJson,
+    const unsigned char* ciphertext,
+    const size_t ciphertextLength,
+    const std::string& unsealingInstructions
+  ) const;
+};
@@ -8,8 +8,20 @@
  */
 
 #include "sodium-buffer.hpp"
+#include "message-fragment.hpp"
+#include "fixed-length-bytes.hpp"
+#include "interned-string.hpp"
+#include "sodium-implementations.hpp"
+#include "ephemeral-key-pool.hpp"
+#include "result.hpp"
+#include "work-stealing-pool.hpp"
+#include "x25519-batch.hpp"
+#include "prepared-signature-verifier.hpp"
+#include "verification-cache.hpp"
+#include "memory-mapped-file.hpp"
 #include "hash-functions.hpp"
 #include "derivation-options.hpp"
+#include "sealed-message-envelope.hpp"
 #include "packaged-sealed-message.hpp"
 #include "unsealing-instructions.hpp"
 
@@ -23,4 +35,12 @@
 #include "symmetric-key.hpp"
 #include "sealing-key.hpp"
 #include "unsealing-key.hpp"
+#include "multi-recipient-sealed-message.hpp"
+#include "sealing-session.hpp"
+#include "key-registry.hpp"
+#include "sealed-message-archive.hpp"
 #include "signing-key.hpp"
+#include "signing-and-unsealing-key.hpp"
+#include "public-key-store.hpp"
+#include "streaming-signature.hpp"
+#include "chunk-manifest.hpp"
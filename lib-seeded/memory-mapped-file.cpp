@@ -0,0 +1,137 @@
+#include "memory-mapped-file.hpp"
+#include "exceptions.hpp"
+
+#ifdef _WIN32
+  #ifndef WIN32_LEAN_AND_MEAN
+    #define WIN32_LEAN_AND_MEAN
+  #endif
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+namespace {
+  void throwFileAccessException(const std::string& what, const std::string& path) {
+    throw FileAccessException(("Could not " + what + " " + path).c_str());
+  }
+}
+
+MemoryMappedFile::MemoryMappedFile(
+  const std::string& path
+) : MemoryMappedFile(path, 0, SIZE_MAX) {}
+
+MemoryMappedFile::MemoryMappedFile(
+  const std::string& path,
+  uint64_t offset,
+  size_t length
+) :
+  mapping(NULL),
+  mappingLength(0),
+  windowData(NULL),
+  windowLength(0),
+  fileSize(0)
+{
+  map(path, offset, length);
+}
+
+#ifdef _WIN32
+
+void MemoryMappedFile::map(const std::string& path, uint64_t offset, size_t length) {
+  HANDLE file = CreateFileA(
+    path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+    FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL
+  );
+  if (file == INVALID_HANDLE_VALUE) {
+    throwFileAccessException("open", path);
+  }
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size)) {
+    CloseHandle(file);
+    throwFileAccessException("get the size of", path);
+  }
+  fileSize = (uint64_t) size.QuadPart;
+  if (offset >= fileSize || length == 0) {
+    // Empty files cannot be mapped, and there is nothing to map anyway
+    CloseHandle(file);
+    return;
+  }
+  windowLength = (size_t) (length < fileSize - offset ? length : fileSize - offset);
+
+  SYSTEM_INFO systemInfo;
+  GetSystemInfo(&systemInfo);
+  const uint64_t alignedOffset = offset - (offset % systemInfo.dwAllocationGranularity);
+  mappingLength = windowLength + (size_t) (offset - alignedOffset);
+
+  HANDLE fileMapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (fileMapping == NULL) {
+    CloseHandle(file);
+    throwFileAccessException("map", path);
+  }
+  mapping = MapViewOfFile(
+    fileMapping, FILE_MAP_READ,
+    (DWORD) (alignedOffset >> 32), (DWORD) (alignedOffset & 0xffffffff),
+    mappingLength
+  );
+  // The view keeps the file and the mapping object alive
+  CloseHandle(fileMapping);
+  CloseHandle(file);
+  if (mapping == NULL) {
+    throwFileAccessException("map", path);
+  }
+  windowData = ((const unsigned char*) mapping) + (offset - alignedOffset);
+}
+
+MemoryMappedFile::~MemoryMappedFile() {
+  if (mapping != NULL) {
+    UnmapViewOfFile(mapping);
+  }
+}
+
+#else
+
+void MemoryMappedFile::map(const std::string& path, uint64_t offset, size_t length) {
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throwFileAccessException("open", path);
+  }
+  struct stat status;
+  if (fstat(fd, &status) != 0) {
+    close(fd);
+    throwFileAccessException("get the size of", path);
+  }
+  fileSize = (uint64_t) status.st_size;
+  if (offset >= fileSize || length == 0) {
+    // mmap rejects zero-length mappings, and there is nothing to map anyway
+    close(fd);
+    return;
+  }
+  windowLength = (size_t) (length < fileSize - offset ? length : fileSize - offset);
+
+  const uint64_t pageSize = (uint64_t) sysconf(_SC_PAGESIZE);
+  const uint64_t alignedOffset = offset - (offset % pageSize);
+  mappingLength = windowLength + (size_t) (offset - alignedOffset);
+
+  mapping = mmap(NULL, mappingLength, PROT_READ, MAP_PRIVATE, fd, (off_t) alignedOffset);
+  // The mapping keeps the file alive
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    mapping = NULL;
+    throwFileAccessException("map", path);
+  }
+#ifdef MADV_SEQUENTIAL
+  // Read ahead aggressively and drop pages behind the reader
+  madvise(mapping, mappingLength, MADV_SEQUENTIAL);
+#endif
+  windowData = ((const unsigned char*) mapping) + (offset - alignedOffset);
+}
+
+MemoryMappedFile::~MemoryMappedFile() {
+  if (mapping != NULL) {
+    munmap(mapping, mappingLength);
+  }
+}
+
+#endif
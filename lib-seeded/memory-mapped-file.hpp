@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+/**
+ * @brief A read-only memory mapping of a file, or of a window into a file.
+ *
+ * Mapping a file lets it be hashed or signed straight from the page cache
+ * without copying it through a read buffer.  Mapping a large file one
+ * window at a time (see the offset-and-length constructor) keeps the
+ * address space used bounded, so files larger than RAM (or than a 32-bit
+ * address space) can be processed.
+ *
+ * Uses mmap on POSIX systems and MapViewOfFile on Windows.  The mapping is
+ * released when the object is destroyed.
+ *
+ * @ingroup BuildingBlocks
+ */
+class MemoryMappedFile {
+public:
+  /**
+   * @brief Map an entire file
+   *
+   * @exception FileAccessException Thrown if the file cannot be opened or mapped.
+   */
+  explicit MemoryMappedFile(
+    const std::string& path
+  );
+
+  /**
+   * @brief Map a window of a file: up to length bytes starting at offset.
+   * The window is truncated at the end of the file, and is empty if the
+   * offset is at or past the end of the file.  The offset need not be
+   * aligned to a page.
+   *
+   * @exception FileAccessException Thrown if the file cannot be opened or mapped.
+   */
+  MemoryMappedFile(
+    const std::string& path,
+    uint64_t offset,
+    size_t length
+  );
+
+  ~MemoryMappedFile();
+
+  MemoryMappedFile(const MemoryMappedFile&) = delete;
+  MemoryMappedFile& operator=(const MemoryMappedFile&) = delete;
+
+  /**
+   * @brief The first byte of the mapped window (NULL if the window is empty)
+   */
+  const unsigned char* data() const { return windowData; }
+
+  /**
+   * @brief The number of bytes in the mapped window
+   */
+  size_t size() const { return windowLength; }
+
+  /**
+   * @brief The size of the whole file, which may be larger than the window
+   */
+  uint64_t getFileSize() const { return fileSize; }
+
+private:
+  void map(const std::string& path, uint64_t offset, size_t length);
+
+  // The mapping starts at an aligned offset at or before the window
+  void* mapping;
+  size_t mappingLength;
+  const unsigned char* windowData;
+  size_t windowLength;
+  uint64_t fileSize;
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stddef.h>
+#include <array>
+#include <string>
+#include <vector>
+#include "sodium-buffer.hpp"
+
+/**
+ * @brief One contiguous piece of a message that is held in several
+ * buffers (a protocol header, a body, a trailer), in the manner of POSIX's
+ * struct iovec.
+ *
+ * Sealing and signing methods that take a list of fragments produce exactly
+ * the ciphertexts and signatures they would for the fragments concatenated
+ * into one buffer, without making that copy.
+ *
+ * A fragment points to memory it does not own, which must remain valid
+ * while the fragment is in use.
+ *
+ * @ingroup BuildingBlocks
+ */
+struct MessageFragment {
+  /**
+   * @brief The fragment's bytes
+   */
+  const unsigned char* data;
+  /**
+   * @brief The number of bytes in the fragment
+   */
+  size_t length;
+
+  MessageFragment(const unsigned char* _data, size_t _length) : data(_data), length(_length) {}
+  MessageFragment(const std::vector<unsigned char>& bytes) : data(bytes.data()), length(bytes.size()) {}
+  template <size_t N>
+  MessageFragment(const std::array<unsigned char, N>& bytes) : data(bytes.data()), length(N) {}
+  MessageFragment(const std::string& str) :
+    data((const unsigned char*) str.data()), length(str.size()) {}
+  MessageFragment(const SodiumBuffer& buffer) : data(buffer.data), length(buffer.length) {}
+
+  /**
+   * @brief The length of the message formed by concatenating fragments
+   */
+  static size_t totalLength(const MessageFragment* fragments, size_t fragmentCount) {
+    size_t total = 0;
+    for (size_t i = 0; i < fragmentCount; i++) {
+      total += fragments[i].length;
+    }
+    return total;
+  }
+};
@@ -0,0 +1,235 @@
+#include <unordered_set>
+#include "multi-recipient-sealed-message.hpp"
+#include "github-com-nlohmann-json/json.hpp"
+#include "crypto_box_seal_salted.h"
+#include "symmetric-key.hpp"
+#include "exceptions.hpp"
+#include "convert.hpp"
+
+// JSON field names
+namespace MultiRecipientSealedMessageJsonFields {
+  static const std::string ciphertext = "ciphertext";
+  static const std::string recipients = "recipients";
+  static const std::string keyId = "keyId";
+  static const std::string sealedContentKey = "sealedContentKey";
+  static const std::string unsealingInstructions = "unsealingInstructions";
+}
+
+static const size_t contentKeyLength = crypto_secretbox_KEYBYTES;
+static const size_t sealedContentKeyBytes = contentKeyLength + crypto_box_SEALBYTES;
+static const size_t recipientBytes = SealingKey::keyIdBytes + sealedContentKeyBytes;
+
+static const std::string keyIdToIndexKey(const std::vector<unsigned char>& keyId) {
+  return std::string((const char*) keyId.data(), keyId.size());
+}
+
+static std::unordered_map<std::string, size_t> indexRecipients(
+  const std::vector<MultiRecipientSealedMessage::Recipient>& recipients
+) {
+  std::unordered_map<std::string, size_t> index;
+  index.reserve(recipients.size());
+  for (size_t i = 0; i < recipients.size(); i++) {
+    if (recipients[i].keyId.size() != SealingKey::keyIdBytes) {
+      throw std::invalid_argument("Invalid recipient key id length");
+    }
+    if (recipients[i].sealedContentKey.size() != sealedContentKeyBytes) {
+      throw std::invalid_argument("Invalid recipient sealed content key length");
+    }
+    // If a key id appears more than once, the first entry is used
+    index.insert(std::make_pair(keyIdToIndexKey(recipients[i].keyId), i));
+  }
+  return index;
+}
+
+MultiRecipientSealedMessage::MultiRecipientSealedMessage(
+  const std::vector<unsigned char>& _ciphertext,
+  const std::vector<Recipient>& _recipients,
+  const std::string& _unsealingInstructions
+) :
+  ciphertext(_ciphertext),
+  recipients(_recipients),
+  unsealingInstructions(_unsealingInstructions),
+  recipientIndex(indexRecipients(_recipients))
+  {}
+
+MultiRecipientSealedMessage MultiRecipientSealedMessage::seal(
+  const unsigned char* message,
+  const size_t messageLength,
+  const std::vector<SealingKey>& sealingKeys,
+  const std::string& unsealingInstructions
+) {
+  if (sealingKeys.size() == 0) {
+    throw std::invalid_argument("A message must be sealed to at least one recipient");
+  }
+  SodiumBuffer contentKeyBytes(contentKeyLength);
+  randombytes_buf(contentKeyBytes.data, contentKeyBytes.length);
+  // Since the content key is used only once, the derivation options are empty
+  const SymmetricKey contentKey(contentKeyBytes, "");
+
+  std::vector<Recipient> recipients;
+  recipients.reserve(sealingKeys.size());
+  std::unordered_set<std::string> recipientsAlreadySealedTo;
+  for (const SealingKey& sealingKey : sealingKeys) {
+    Recipient recipient;
+    recipient.keyId = sealingKey.getKeyId();
+    if (!recipientsAlreadySealedTo.insert(keyIdToIndexKey(recipient.keyId)).second) {
+      continue;
+    }
+    recipient.sealedContentKey = SealingKey::sealToCiphertextOnly(
+      contentKeyBytes, sealingKey.sealingKeyBytes, unsealingInstructions
+    );
+    recipients.push_back(recipient);
+  }
+
+  return MultiRecipientSealedMessage(
+    contentKey.sealToCiphertextOnly(message, messageLength, unsealingInstructions),
+    recipients,
+    unsealingInstructions
+  );
+}
+
+MultiRecipientSealedMessage MultiRecipientSealedMessage::seal(
+  const SodiumBuffer& message,
+  const std::vector<SealingKey>& sealingKeys,
+  const std::string& unsealingInstructions
+) {
+  return seal(message.data, message.length, sealingKeys, unsealingInstructions);
+}
+
+MultiRecipientSealedMessage MultiRecipientSealedMessage::seal(
+  const std::vector<unsigned char>& message,
+  const std::vector<SealingKey>& sealingKeys,
+  const std::string& unsealingInstructions
+) {
+  return seal(message.data(), message.size(), sealingKeys, unsealingInstructions);
+}
+
+const MultiRecipientSealedMessage::Recipient* MultiRecipientSealedMessage::findRecipient(
+  const std::vector<unsigned char>& keyId
+) const {
+  const auto entry = recipientIndex.find(keyIdToIndexKey(keyId));
+  if (entry == recipientIndex.end()) {
+    return NULL;
+  }
+  return &recipients[entry->second];
+}
+
+const SodiumBuffer MultiRecipientSealedMessage::unseal(
+  const std::vector<unsigned char>& sealingKeyBytes,
+  const SodiumBuffer& unsealingKeyBytes
+) const {
+  const Recipient* recipient = findRecipient(SealingKey::getKeyId(sealingKeyBytes));
+  if (recipient == NULL) {
+    throw CryptographicVerificationFailureException("Multi-recipient unseal failed: the message was not sealed to this key.");
+  }
+  SodiumBuffer contentKeyBytes(contentKeyLength);
+  const int result = crypto_box_salted_seal_open(
+    contentKeyBytes.data,
+    recipient->sealedContentKey.data(),
+    recipient->sealedContentKey.size(),
+    sealingKeyBytes.data(),
+    unsealingKeyBytes.data,
+    unsealingInstructions.c_str(),
+    unsealingInstructions.length()
+  );
+  if (result != 0) {
+    throw CryptographicVerificationFailureException("Multi-recipient unseal failed: the private key doesn't match the public key used to seal the message, the unsealing instructions do not match those used to seal the message, or the ciphertext was modified/corrupted.");
+  }
+  return SymmetricKey(contentKeyBytes, "").unseal(ciphertext, unsealingInstructions);
+}
+
+size_t MultiRecipientSealedMessage::serializedSize() const {
+  return SodiumBuffer::fixedLengthListSize(
+    ciphertext,
+    unsealingInstructions,
+    SodiumBuffer::FixedLengthListItem(NULL, recipients.size() * recipientBytes)
+  );
+}
+
+size_t MultiRecipientSealedMessage::serializeInto(unsigned char* out, size_t capacity) const {
+  const size_t recipientsLength = recipients.size() * recipientBytes;
+  if (serializedSize() > capacity) {
+    throw std::invalid_argument("Not enough space to write the fixed-length list");
+  }
+  // The last item of a list has no length field, so the list is the first
+  // two items followed by an empty one, and then the recipients in place
+  unsigned char* writePtr = out + SodiumBuffer::writeFixedLengthList(
+    out, capacity - recipientsLength, ciphertext, unsealingInstructions, SodiumBuffer::FixedLengthListItem()
+  );
+  for (const Recipient& recipient : recipients) {
+    memcpy(writePtr, recipient.keyId.data(), SealingKey::keyIdBytes);
+    writePtr += SealingKey::keyIdBytes;
+    memcpy(writePtr, recipient.sealedContentKey.data(), sealedContentKeyBytes);
+    writePtr += sealedContentKeyBytes;
+  }
+  return writePtr - out;
+}
+
+const SodiumBuffer MultiRecipientSealedMessage::toSerializedBinaryForm() const {
+  SodiumBuffer serialized(serializedSize());
+  serializeInto(serialized.data, serialized.length);
+  return serialized;
+}
+
+MultiRecipientSealedMessage MultiRecipientSealedMessage::fromSerializedBinaryForm(const SodiumBuffer &serializedBinaryForm) {
+  const auto fields = serializedBinaryForm.splitFixedLengthList(3);
+  const SodiumBuffer& _recipients = fields[2];
+  if (_recipients.length % recipientBytes != 0) {
+    throw std::invalid_argument("Invalid length for list of recipients");
+  }
+  std::vector<Recipient> recipients(_recipients.length / recipientBytes);
+  const unsigned char* recipientPtr = _recipients.data;
+  for (Recipient& recipient : recipients) {
+    recipient.keyId.assign(recipientPtr, recipientPtr + SealingKey::keyIdBytes);
+    recipientPtr += SealingKey::keyIdBytes;
+    recipient.sealedContentKey.assign(recipientPtr, recipientPtr + sealedContentKeyBytes);
+    recipientPtr += sealedContentKeyBytes;
+  }
+  return MultiRecipientSealedMessage(fields[0].toVector(), recipients, fields[1].toUtf8String());
+}
+
+const std::string MultiRecipientSealedMessage::toJson(
+  int indent,
+  const char indent_char,
+  BinaryEncoding binaryEncoding
+) const {
+  nlohmann::json asJson;
+  asJson[MultiRecipientSealedMessageJsonFields::ciphertext] = toEncodedStr(ciphertext, binaryEncoding);
+  nlohmann::json recipientsAsJson = nlohmann::json::array();
+  for (const Recipient& recipient : recipients) {
+    nlohmann::json recipientAsJson;
+    recipientAsJson[MultiRecipientSealedMessageJsonFields::keyId] = toEncodedStr(recipient.keyId, binaryEncoding);
+    recipientAsJson[MultiRecipientSealedMessageJsonFields::sealedContentKey] = toEncodedStr(recipient.sealedContentKey, binaryEncoding);
+    recipientsAsJson.push_back(recipientAsJson);
+  }
+  asJson[MultiRecipientSealedMessageJsonFields::recipients] = recipientsAsJson;
+  if (unsealingInstructions.size() > 0) {
+    asJson[MultiRecipientSealedMessageJsonFields::unsealingInstructions] = unsealingInstructions;
+  }
+  if (binaryEncoding != BinaryEncoding::Hex) {
+    asJson[BinaryEncodingJsonField::binaryEncoding] = binaryEncodingName(binaryEncoding);
+  }
+  return asJson.dump(indent, indent_char);
+}
+
+MultiRecipientSealedMessage MultiRecipientSealedMessage::fromJson(const std::string& multiRecipientSealedMessageAsJson) {
+  try {
+    nlohmann::json jsonObject = nlohmann::json::parse(multiRecipientSealedMessageAsJson);
+    const BinaryEncoding binaryEncoding = binaryEncodingFromName(jsonObject.value<std::string>(
+      BinaryEncodingJsonField::binaryEncoding, binaryEncodingName(BinaryEncoding::Hex)));
+    std::vector<Recipient> recipients;
+    for (const nlohmann::json& recipientAsJson : jsonObject.at(MultiRecipientSealedMessageJsonFields::recipients)) {
+      Recipient recipient;
+      recipient.keyId = encodedStrToByteVector(recipientAsJson.at(MultiRecipientSealedMessageJsonFields::keyId), binaryEncoding);
+      recipient.sealedContentKey = encodedStrToByteVector(recipientAsJson.at(MultiRecipientSealedMessageJsonFields::sealedContentKey), binaryEncoding);
+      recipients.push_back(recipient);
+    }
+    return MultiRecipientSealedMessage(
+      encodedStrToByteVector(jsonObject.at(MultiRecipientSealedMessageJsonFields::ciphertext), binaryEncoding),
+      recipients,
+      jsonObject.value<std::string>(MultiRecipientSealedMessageJsonFields::unsealingInstructions, "")
+    );
+  } catch (const nlohmann::json::exception& e) {
+    throw JsonParsingException(e.what());
+  }
+}
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "sodium-buffer.hpp"
+#include "convert.hpp"
+#include "sealing-key.hpp"
+
+/**
+ * @brief A message sealed once for any number of recipients, each of which
+ * can unseal it with the UnsealingKey matching one of the SealingKeys it
+ * was sealed with.
+ * 
+ * Sealing a message separately with each of N SealingKeys encrypts (and stores)
+ * the whole message N times.  A MultiRecipientSealedMessage instead seals the
+ * message once, with a random content key, and then seals only that 32-byte
+ * content key to each recipient's SealingKey (with crypto_box_salted_seal).
+ * The cost of sealing for N recipients is thus proportional to the size of the
+ * message plus N, rather than to the size of the message times N.
+ * 
+ * Each recipient's sealed copy of the content key is labeled with the
+ * recipient's SealingKey::getKeyId, and the labels are indexed so that
+ * an UnsealingKey finds its copy in constant time.
+ * 
+ * Note that every recipient learns the content key, so any recipient could
+ * re-seal a different message under it for the others.  If recipients must
+ * be able to tell who created the message, it should also be signed.
+ * 
+ * @ingroup BuildingBlocks
+ */
+class MultiRecipientSealedMessage {
+public:
+  /**
+   * @brief The content key, sealed to one recipient's SealingKey
+   */
+  struct Recipient {
+    /**
+     * @brief The recipient's SealingKey::getKeyId
+     */
+    std::vector<unsigned char> keyId;
+    /**
+     * @brief The content key sealed with crypto_box_salted_seal to the
+     * recipient's SealingKey, salted with the unsealing instructions
+     */
+    std::vector<unsigned char> sealedContentKey;
+  };
+
+  /**
+   * @brief The message, sealed with the content key as a SymmetricKey
+   */
+  const std::vector<unsigned char> ciphertext;
+  /**
+   * @brief The content key sealed to each recipient
+   */
+  const std::vector<Recipient> recipients;
+  /**
+   * @brief Optional public instructions that the sealer
+   * requests the unsealer to follow as a condition of unsealing.
+   */
+  const std::string unsealingInstructions;
+
+  /**
+   * @brief Construct directly from the constituent members
+   * 
+   * @exception std::invalid_argument Thrown if a recipient's
+   * keyId or sealedContentKey is not of the correct length.
+   */
+  MultiRecipientSealedMessage(
+    const std::vector<unsigned char>& ciphertext,
+    const std::vector<Recipient>& recipients,
+    const std::string& unsealingInstructions
+  );
+
+  /**
+   * @brief Seal a message so that the UnsealingKey of any of the
+   * given SealingKeys can unseal it.
+   * 
+   * Duplicate SealingKeys are included only once.
+   * 
+   * @param message The plaintext message to seal
+   * @param messageLength The length of the plaintext message
+   * @param sealingKeys The recipients' SealingKeys
+   * @param unsealingInstructions If this optional string is
+   * passed, the same string must be passed to unseal the message.
+   */
+  static MultiRecipientSealedMessage seal(
+    const unsigned char* message,
+    const size_t messageLength,
+    const std::vector<SealingKey>& sealingKeys,
+    const std::string& unsealingInstructions = {}
+  );
+
+  /**
+   * @brief Seal a message so that the UnsealingKey of any of the
+   * given SealingKeys can unseal it.
+   * 
+   * @param message The plaintext message to seal
+   * @param sealingKeys The recipients' SealingKeys
+   * @param unsealingInstructions If this optional string is
+   * passed, the same string must be passed to unseal the message.
+   */
+  static MultiRecipientSealedMessage seal(
+    const SodiumBuffer& message,
+    const std::vector<SealingKey>& sealingKeys,
+    const std::string& unsealingInstructions = {}
+  );
+
+  /**
+   * @brief Seal a message so that the UnsealingKey of any of the
+   * given SealingKeys can unseal it.
+   * 
+   * @param message The plaintext message to seal
+   * @param sealingKeys The recipients' SealingKeys
+   * @param unsealingInstructions If this optional string is
+   * passed, the same string must be passed to unseal the message.
+   */
+  static MultiRecipientSealedMessage seal(
+    const std::vector<unsigned char>& message,
+    const std::vector<SealingKey>& sealingKeys,
+    const std::string& unsealingInstructions = {}
+  );
+
+  /**
+   * @brief Find the content key sealed to a given recipient.
+   * 
+   * @param keyId The recipient's SealingKey::getKeyId
+   * @return const Recipient* The recipient's entry, or NULL if
+   * the message was not sealed to that key.
+   */
+  const Recipient* findRecipient(
+    const std::vector<unsigned char>& keyId
+  ) const;
+
+  /**
+   * @brief Unseal the message using the secret key of one of its recipients.
+   * 
+   * Most callers should use UnsealingKey::unseal instead.
+   * 
+   * @param sealingKeyBytes The recipient's public key
+   * @param unsealingKeyBytes The recipient's secret key
+   * @return const SodiumBuffer The plaintext message
+   * 
+   * @exception CryptographicVerificationFailureException Thrown if the message
+   * was not sealed to this key or the message was modified/corrupted.
+   */
+  const SodiumBuffer unseal(
+    const std::vector<unsigned char>& sealingKeyBytes,
+    const SodiumBuffer& unsealingKeyBytes
+  ) const;
+
+  /**
+   * @brief Serialize to byte array as a list of:
+   *   (ciphertext, unsealingInstructions, recipients)
+   * where recipients is the concatenation of each recipient's
+   * keyId and sealedContentKey.
+   * 
+   * Stored in SodiumBuffer's fixed-length list format.
+   * Strings are stored as UTF8 byte arrays.
+   */
+  const SodiumBuffer toSerializedBinaryForm() const;
+
+  /**
+   * @brief The exact number of bytes toSerializedBinaryForm produces
+   */
+  size_t serializedSize() const;
+
+  /**
+   * @brief Write the same bytes as toSerializedBinaryForm (ciphertext, unsealingInstructions, and recipients)
+   * into memory supplied by the caller, without allocating.
+   *
+   * @param out Where to write the serialized form
+   * @param capacity The number of bytes available at out, which must be at
+   * least serializedSize()
+   * @return size_t The number of bytes written
+   * @exception std::invalid_argument Thrown if capacity is too small.
+   */
+  size_t serializeInto(unsigned char* out, size_t capacity) const;
+
+  /**
+   * @brief Deserialize from a byte array stored as a list of:
+   *   (ciphertext, unsealingInstructions, recipients)
+   * 
+   * Stored in SodiumBuffer's fixed-length list format.
+   * Strings are stored as UTF8 byte arrays.
+   */
+  static MultiRecipientSealedMessage fromSerializedBinaryForm(const SodiumBuffer &serializedBinaryForm);
+
+  /**
+   * @brief Serialize this object to a JSON-formatted string
+   * 
+   * It can be reconstituted by calling fromJson with this string.
+   * 
+   * @param indent The number of characters to indent the JSON (optional)
+   * @param indent_char The character with which to indent the JSON (optional)
+   * @param binaryEncoding How binary fields are written (optional, hex by default)
+   * @return const std::string
+   */
+  const std::string toJson(
+    int indent = -1,
+    const char indent_char = ' ',
+    BinaryEncoding binaryEncoding = BinaryEncoding::Hex
+  ) const;
+
+  /**
+   * @brief Construct by reconstituting this object from a JSON string
+   * 
+   * @param multiRecipientSealedMessageAsJson The JSON encoding of this object
+   * generated by a call to toJson
+   */
+  static MultiRecipientSealedMessage fromJson(const std::string& multiRecipientSealedMessageAsJson);
+
+private:
+  // Maps each recipient's keyId (as a string of bytes) to its index in recipients
+  const std::unordered_map<std::string, size_t> recipientIndex;
+};
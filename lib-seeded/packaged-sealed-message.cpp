@@ -1,71 +1,882 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <ostream>
 #include "packaged-sealed-message.hpp"
 #include "github-com-nlohmann-json/json.hpp"
 #include "exceptions.hpp"
 #include "convert.hpp"
+#include "derivation-options.hpp"
 
 // JSON field names
 namespace PackagedSealedMessageJsonFields {
   static const std::string ciphertext = "ciphertext";
   static const std::string derivationOptionsJson = "derivationOptionsJson";
   static const std::string unsealingInstructions = "unsealingInstructions";
+  static const std::string keyId = "keyId";
 }
 
 PackagedSealedMessage::PackagedSealedMessage(
         const std::vector<unsigned char>& _ciphertext,
-        const std::string& _derivationOptionsJson,
-        const std::string& _unsealingInstructions
+        const InternedString& _derivationOptionsJson,
+        const std::string& _unsealingInstructions,
+        const std::vector<unsigned char>& _keyId
 ) : 
     ciphertext(_ciphertext),
     derivationOptionsJson(_derivationOptionsJson),
-    unsealingInstructions(_unsealingInstructions)
+    unsealingInstructions(_unsealingInstructions),
+    keyId(_keyId)
+    {}
+
+PackagedSealedMessage::PackagedSealedMessage(
+        std::vector<unsigned char>&& _ciphertext,
+        const InternedString& _derivationOptionsJson,
+        const std::string& _unsealingInstructions,
+        const std::vector<unsigned char>& _keyId
+) : 
+    ciphertext(std::move(_ciphertext)),
+    derivationOptionsJson(_derivationOptionsJson),
+    unsealingInstructions(_unsealingInstructions),
+    keyId(_keyId)
     {}
 
 PackagedSealedMessage::PackagedSealedMessage(const PackagedSealedMessage &other) :
   ciphertext(other.ciphertext),
   derivationOptionsJson(other.derivationOptionsJson),
-  unsealingInstructions(other.unsealingInstructions)
+  unsealingInstructions(other.unsealingInstructions),
+  keyId(other.keyId)
   {}
 
+size_t PackagedSealedMessage::serializedSize() const {
+  return SodiumBuffer::fixedLengthListSize(ciphertext, derivationOptionsJson, unsealingInstructions);
+}
+
+size_t PackagedSealedMessage::serializeInto(unsigned char* out, size_t capacity) const {
+  return SodiumBuffer::writeFixedLengthList(out, capacity, ciphertext, derivationOptionsJson, unsealingInstructions);
+}
+
 const SodiumBuffer PackagedSealedMessage::toSerializedBinaryForm() const {
-  SodiumBuffer _ciphertext(ciphertext);
-  SodiumBuffer _derivationOptionsJson(derivationOptionsJson);
-  SodiumBuffer _unsealingInstructions(unsealingInstructions);
-  return SodiumBuffer::combineFixedLengthList({
-    &_ciphertext,
-    &_derivationOptionsJson,
-    &_unsealingInstructions
-  });
+  return SodiumBuffer::combineFixedLengthList(ciphertext, derivationOptionsJson, unsealingInstructions);
 }
 
-PackagedSealedMessage PackagedSealedMessage::fromSerializedBinaryForm(const SodiumBuffer &serializedBinaryForm) {
+PackagedSealedMessage PackagedSealedMessage::fromSerializedBinaryForm(
+  const SodiumBuffer &serializedBinaryForm,
+  const DerivationOptionsTable* derivationOptionsTable
+) {
+  if (SealedMessageEnvelope::hasMagic(serializedBinaryForm.data, serializedBinaryForm.length)) {
+    SealedMessageEnvelope envelope;
+    if (!SealedMessageEnvelope::parse(serializedBinaryForm.data, serializedBinaryForm.length, envelope)) {
+      throw std::invalid_argument("Malformed or unsupported sealed message envelope");
+    }
+    return fromEnvelope(envelope, derivationOptionsTable);
+  }
   const auto fields = serializedBinaryForm.splitFixedLengthList(3);
   return PackagedSealedMessage(fields[0].toVector(), fields[1].toUtf8String(), fields[2].toUtf8String());
 }
 
+Result<PackagedSealedMessage> PackagedSealedMessage::tryFromSerializedBinaryForm(
+  const SodiumBuffer &serializedBinaryForm,
+  const DerivationOptionsTable* derivationOptionsTable
+) {
+  if (SealedMessageEnvelope::hasMagic(serializedBinaryForm.data, serializedBinaryForm.length)) {
+    SealedMessageEnvelope envelope;
+    if (!SealedMessageEnvelope::parse(serializedBinaryForm.data, serializedBinaryForm.length, envelope) || (
+      envelope.hasDerivationOptionsTableId && (
+        derivationOptionsTable == NULL || derivationOptionsTable->at(envelope.derivationOptionsTableId) == NULL
+      )
+    )) {
+      return Result<PackagedSealedMessage>(ResultStatus::InvalidInput);
+    }
+    return Result<PackagedSealedMessage>(std::unique_ptr<PackagedSealedMessage>(
+      new PackagedSealedMessage(fromEnvelope(envelope, derivationOptionsTable))
+    ));
+  }
+  const unsigned char* itemData[3];
+  size_t itemLengths[3];
+  if (!SodiumBuffer::locateFixedLengthListItems(
+    serializedBinaryForm.data, serializedBinaryForm.length, 3, itemData, itemLengths
+  )) {
+    return Result<PackagedSealedMessage>(ResultStatus::InvalidInput);
+  }
+  return Result<PackagedSealedMessage>(std::unique_ptr<PackagedSealedMessage>(new PackagedSealedMessage(
+    std::vector<unsigned char>(itemData[0], itemData[0] + itemLengths[0]),
+    std::string((const char*) itemData[1], itemLengths[1]),
+    std::string((const char*) itemData[2], itemLengths[2])
+  )));
+}
+
+SealingAlgorithm PackagedSealedMessage::sealingAlgorithmFor(const std::string& derivationOptionsJson) {
+  const nlohmann::json jsonObject = nlohmann::json::parse(derivationOptionsJson, nullptr, false);
+  if (!jsonObject.is_object()) {
+    return SealingAlgorithm::Unspecified;
+  }
+  const auto algorithm = jsonObject.find(DerivationOptionsJson::FieldNames::algorithm);
+  if (algorithm != jsonObject.end() && algorithm->is_string()) {
+    const std::string& name = algorithm->get_ref<const std::string&>();
+    if (name == "X25519") {
+      return SealingAlgorithm::X25519XSalsa20Poly1305;
+    } else if (name == "XSalsa20Poly1305") {
+      return SealingAlgorithm::XSalsa20Poly1305;
+    }
+    return SealingAlgorithm::Unspecified;
+  }
+  const auto type = jsonObject.find(DerivationOptionsJson::FieldNames::type);
+  if (type != jsonObject.end() && type->is_string()) {
+    const std::string& name = type->get_ref<const std::string&>();
+    if (name == "UnsealingKey" || name == "SigningAndUnsealingKey") {
+      return SealingAlgorithm::X25519XSalsa20Poly1305;
+    } else if (name == "SymmetricKey") {
+      return SealingAlgorithm::XSalsa20Poly1305;
+    }
+  }
+  return SealingAlgorithm::Unspecified;
+}
+
+SealedMessageEnvelope PackagedSealedMessage::toEnvelope(
+  SealingAlgorithm algorithm,
+  const std::vector<unsigned char>& keyIdHint,
+  const DerivationOptionsTable* derivationOptionsTable
+) const {
+  SealedMessageEnvelope envelope;
+  envelope.algorithm = algorithm == SealingAlgorithm::Unspecified ?
+    sealingAlgorithmFor(derivationOptionsJson) : algorithm;
+  const std::vector<unsigned char>& hint = keyIdHint.empty() ? keyId : keyIdHint;
+  envelope.keyIdHint = hint.data();
+  envelope.keyIdHintLength = hint.size();
+  uint32_t derivationOptionsTableId;
+  if (derivationOptionsTable != NULL && derivationOptionsTable->find(
+    derivationOptionsJson.data(), derivationOptionsJson.size(), derivationOptionsTableId
+  )) {
+    envelope.hasDerivationOptionsTableId = true;
+    envelope.derivationOptionsTableId = derivationOptionsTableId;
+  } else {
+    envelope.derivationOptionsJson = derivationOptionsJson.data();
+    envelope.derivationOptionsJsonLength = derivationOptionsJson.size();
+  }
+  envelope.unsealingInstructions = unsealingInstructions.data();
+  envelope.unsealingInstructionsLength = unsealingInstructions.size();
+  envelope.ciphertext = ciphertext.data();
+  envelope.ciphertextLength = ciphertext.size();
+  return envelope;
+}
+
+const SodiumBuffer PackagedSealedMessage::toEnvelopeBinaryForm(
+  SealingAlgorithm algorithm,
+  const std::vector<unsigned char>& keyIdHint,
+  const DerivationOptionsTable* derivationOptionsTable
+) const {
+  const SealedMessageEnvelope envelope = toEnvelope(algorithm, keyIdHint, derivationOptionsTable);
+  SodiumBuffer envelopeBytes(envelope.encodedLength());
+  envelope.writeTo(envelopeBytes.data);
+  return envelopeBytes;
+}
+
+PackagedSealedMessage PackagedSealedMessage::fromEnvelope(
+  const SealedMessageEnvelope& envelope,
+  const DerivationOptionsTable* derivationOptionsTable
+) {
+  const std::string* tableDerivationOptionsJson = NULL;
+  if (envelope.hasDerivationOptionsTableId) {
+    if (derivationOptionsTable == NULL ||
+        (tableDerivationOptionsJson = derivationOptionsTable->at(envelope.derivationOptionsTableId)) == NULL) {
+      throw std::invalid_argument("The envelope's derivation options ID is not in the derivation options table");
+    }
+  }
+  return PackagedSealedMessage(
+    std::vector<unsigned char>(envelope.ciphertext, envelope.ciphertext + envelope.ciphertextLength),
+    tableDerivationOptionsJson != NULL ? *tableDerivationOptionsJson :
+      std::string(envelope.derivationOptionsJson, envelope.derivationOptionsJsonLength),
+    std::string(envelope.unsealingInstructions, envelope.unsealingInstructionsLength),
+    std::vector<unsigned char>(envelope.keyIdHint, envelope.keyIdHint + envelope.keyIdHintLength)
+  );
+}
+
+namespace {
+
+  // The streaming writer and reader below handle the JSON for a
+  // PackagedSealedMessage without an nlohmann::json document, so that the
+  // ciphertext is never held in memory as a single encoded string.
+
+  class StringJsonSink {
+  public:
+    explicit StringJsonSink(std::string& output) : output(output) {}
+    void write(const char* data, size_t length) { output.append(data, length); }
+  private:
+    std::string& output;
+  };
+
+  class StreamJsonSink {
+  public:
+    explicit StreamJsonSink(std::ostream& out) : out(out) {}
+    void write(const char* data, size_t length) { out.write(data, (std::streamsize) length); }
+  private:
+    std::ostream& out;
+  };
+
+  // Bytes of ciphertext encoded at a time: a multiple of 3, so that
+  // base64url chunks need no padding, and of 32 for the hex codec
+  const size_t ciphertextChunkLength = 3 * 4096;
+  // Characters of ciphertext decoded at a time: a multiple of 4 and of 2
+  const size_t encodedChunkLength = 16384;
+
+  template <typename Sink>
+  void writeKey(Sink& sink, const std::string& key) {
+    sink.write("\"", 1);
+    sink.write(key.data(), key.size());
+    sink.write("\":", 2);
+  }
+
+  template <typename Sink>
+  void writeString(Sink& sink, const std::string& value) {
+    // Escaped exactly as in a JSON document
+    const std::string escaped = nlohmann::json(value).dump();
+    sink.write(escaped.data(), escaped.size());
+  }
+
+  // Fields are written in the (sorted) order that nlohmann::json::dump
+  // uses, so the output matches a document-built toJson
+  template <typename Sink>
+  void writePackagedSealedMessageJson(
+    Sink& sink,
+    const PackagedSealedMessage& message,
+    BinaryEncoding binaryEncoding
+  ) {
+    sink.write("{", 1);
+    if (binaryEncoding != BinaryEncoding::Hex) {
+      writeKey(sink, BinaryEncodingJsonField::binaryEncoding);
+      writeString(sink, binaryEncodingName(binaryEncoding));
+      sink.write(",", 1);
+    }
+    writeKey(sink, PackagedSealedMessageJsonFields::ciphertext);
+    sink.write("\"", 1);
+    std::vector<char> encoded(2 * ciphertextChunkLength + 1);
+    const std::vector<unsigned char>& ciphertext = message.ciphertext;
+    for (size_t offset = 0; offset < ciphertext.size(); offset += ciphertextChunkLength) {
+      const size_t length = std::min(ciphertextChunkLength, ciphertext.size() - offset);
+      if (binaryEncoding == BinaryEncoding::Base64Url) {
+        base64UrlEncode(encoded.data(), ciphertext.data() + offset, length);
+        sink.write(encoded.data(), base64UrlEncodedLength(length));
+      } else {
+        hexEncode(encoded.data(), ciphertext.data() + offset, length);
+        sink.write(encoded.data(), 2 * length);
+      }
+    }
+    sink.write("\"", 1);
+    if (message.derivationOptionsJson.size() > 0) {
+      sink.write(",", 1);
+      writeKey(sink, PackagedSealedMessageJsonFields::derivationOptionsJson);
+      writeString(sink, message.derivationOptionsJson);
+    }
+    if (message.keyId.size() > 0) {
+      sink.write(",", 1);
+      writeKey(sink, PackagedSealedMessageJsonFields::keyId);
+      writeString(sink, toEncodedStr(message.keyId, binaryEncoding));
+    }
+    if (message.unsealingInstructions.size() > 0) {
+      sink.write(",", 1);
+      writeKey(sink, PackagedSealedMessageJsonFields::unsealingInstructions);
+      writeString(sink, message.unsealingInstructions);
+    }
+    sink.write("}", 1);
+  }
+
+  const int endOfJson = -1;
+
+  class MemoryJsonSource {
+  public:
+    MemoryJsonSource(const char* data, size_t length) :
+      start(data), position(data), end(data + length) {}
+    int peek() const { return position < end ? (unsigned char) *position : endOfJson; }
+    int get() { return position < end ? (unsigned char) *position++ : endOfJson; }
+    bool isSeekable() const { return true; }
+    size_t tell() const { return position - start; }
+    void seek(size_t offset) { position = start + offset; }
+    size_t remaining() const { return end - position; }
+    const char* current() const { return position; }
+  private:
+    const char* start;
+    const char* position;
+    const char* end;
+  };
+
+  // Reads through the stream's buffer directly, leaving the stream
+  // positioned just after the last character consumed
+  class StreamJsonSource {
+  public:
+    explicit StreamJsonSource(std::istream& in) : buffer(in.rdbuf()) {
+      if (buffer == NULL) {
+        throw JsonParsingException("The stream has no buffer to read from");
+      }
+      seekable = buffer->pubseekoff(0, std::ios_base::cur, std::ios_base::in) != std::streampos(std::streamoff(-1));
+    }
+    int peek() {
+      const std::streambuf::int_type c = buffer->sgetc();
+      return c == std::streambuf::traits_type::eof() ? endOfJson : (int) (unsigned char) c;
+    }
+    int get() {
+      const std::streambuf::int_type c = buffer->sbumpc();
+      return c == std::streambuf::traits_type::eof() ? endOfJson : (int) (unsigned char) c;
+    }
+    bool isSeekable() const { return seekable; }
+    size_t tell() { return (size_t) (std::streamoff) buffer->pubseekoff(0, std::ios_base::cur, std::ios_base::in); }
+    void seek(size_t offset) { buffer->pubseekpos(std::streampos(std::streamoff(offset)), std::ios_base::in); }
+  private:
+    std::streambuf* buffer;
+    bool seekable;
+  };
+
+  // Append a decoded chunk of ciphertext to ciphertext, returning false if
+  // it is not valid in the given encoding. Only the last chunk may be partial.
+  bool appendDecodedChunk(
+    std::vector<unsigned char>& ciphertext,
+    const char* encoded,
+    size_t encodedLength,
+    BinaryEncoding binaryEncoding
+  ) {
+    const size_t previousLength = ciphertext.size();
+    if (binaryEncoding == BinaryEncoding::Base64Url) {
+      ciphertext.resize(previousLength + (encodedLength * 3) / 4);
+      size_t decodedLength = 0;
+      const bool valid = base64UrlDecode(ciphertext.data() + previousLength, decodedLength, encoded, encodedLength);
+      ciphertext.resize(previousLength + decodedLength);
+      return valid;
+    }
+    if (encodedLength % 2 == 1) {
+      return false;
+    }
+    ciphertext.resize(previousLength + encodedLength / 2);
+    return hexDecode(ciphertext.data() + previousLength, encoded, encodedLength / 2);
+  }
+
+  size_t hexPrefixLength(const char* encoded, size_t encodedLength, BinaryEncoding binaryEncoding) {
+    // Hex strings may be prefixed by '0x', which is ignored
+    return (binaryEncoding == BinaryEncoding::Hex && encodedLength >= 2 &&
+      encoded[0] == '0' && encoded[1] == 'x') ? 2 : 0;
+  }
+
+  // Decode the ciphertext string (just after its opening quote) a chunk
+  // at a time, consuming it through the closing quote.  Returns false if
+  // the ciphertext is not valid in the given encoding.
+  //
+  // The ciphertext grows a chunk at a time rather than being sized from
+  // what remains of the stream, which may hold many more messages: its
+  // capacity is bounded by its own length, not by the stream's.
+  template <typename Source>
+  bool decodeCiphertext(Source& source, BinaryEncoding binaryEncoding, std::vector<unsigned char>& ciphertext) {
+    ciphertext.clear();
+    std::vector<char> chunk(encodedChunkLength);
+    size_t chunkLength = 0;
+    bool isFirstChunk = true;
+    bool valid = true;
+    for (;;) {
+      const int c = source.get();
+      if (c == endOfJson) {
+        throw JsonParsingException("Unterminated ciphertext string");
+      } else if (c == '"') {
+        break;
+      }
+      chunk[chunkLength++] = (char) c;
+      if (chunkLength == encodedChunkLength) {
+        const size_t prefixLength = isFirstChunk ? hexPrefixLength(chunk.data(), chunkLength, binaryEncoding) : 0;
+        if (prefixLength > 0) {
+          // Keep chunks aligned to whole base64url groups and hex digit pairs
+          std::copy(chunk.begin() + prefixLength, chunk.end(), chunk.begin());
+          chunkLength -= prefixLength;
+        } else {
+          valid = valid && appendDecodedChunk(ciphertext, chunk.data(), chunkLength, binaryEncoding);
+          chunkLength = 0;
+        }
+        isFirstChunk = false;
+      }
+    }
+    const size_t prefixLength = isFirstChunk ? hexPrefixLength(chunk.data(), chunkLength, binaryEncoding) : 0;
+    return valid && appendDecodedChunk(ciphertext, chunk.data() + prefixLength, chunkLength - prefixLength, binaryEncoding);
+  }
+
+  // JSON held in memory is decoded in one pass straight into a buffer of the exact size
+  bool decodeCiphertext(MemoryJsonSource& source, BinaryEncoding binaryEncoding, std::vector<unsigned char>& ciphertext) {
+    const char* encoded = source.current();
+    const char* closingQuote = (const char*) memchr(encoded, '"', source.remaining());
+    if (closingQuote == NULL) {
+      throw JsonParsingException("Unterminated ciphertext string");
+    }
+    const size_t encodedLength = closingQuote - encoded;
+    source.seek(source.tell() + encodedLength + 1);
+    const size_t prefixLength = hexPrefixLength(encoded, encodedLength, binaryEncoding);
+    ciphertext.clear();
+    return appendDecodedChunk(ciphertext, encoded + prefixLength, encodedLength - prefixLength, binaryEncoding);
+  }
+
+  void appendUtf8(std::string& value, unsigned long codePoint) {
+    if (codePoint < 0x80) {
+      value += (char) codePoint;
+    } else if (codePoint < 0x800) {
+      value += (char) (0xc0 | (codePoint >> 6));
+      value += (char) (0x80 | (codePoint & 0x3f));
+    } else if (codePoint < 0x10000) {
+      value += (char) (0xe0 | (codePoint >> 12));
+      value += (char) (0x80 | ((codePoint >> 6) & 0x3f));
+      value += (char) (0x80 | (codePoint & 0x3f));
+    } else {
+      value += (char) (0xf0 | (codePoint >> 18));
+      value += (char) (0x80 | ((codePoint >> 12) & 0x3f));
+      value += (char) (0x80 | ((codePoint >> 6) & 0x3f));
+      value += (char) (0x80 | (codePoint & 0x3f));
+    }
+  }
+
+  // true if value is well-formed UTF-8, as JSON strings must be
+  bool isValidUtf8(const std::string& value) {
+    size_t i = 0;
+    while (i < value.size()) {
+      const unsigned char c = (unsigned char) value[i];
+      size_t continuationBytes;
+      unsigned long codePoint;
+      if (c < 0x80) {
+        i++;
+        continue;
+      } else if ((c & 0xe0) == 0xc0) {
+        continuationBytes = 1; codePoint = c & 0x1f;
+      } else if ((c & 0xf0) == 0xe0) {
+        continuationBytes = 2; codePoint = c & 0x0f;
+      } else if ((c & 0xf8) == 0xf0) {
+        continuationBytes = 3; codePoint = c & 0x07;
+      } else {
+        return false;
+      }
+      if (i + continuationBytes >= value.size()) {
+        return false;
+      }
+      for (size_t j = 1; j <= continuationBytes; j++) {
+        const unsigned char continuation = (unsigned char) value[i + j];
+        if ((continuation & 0xc0) != 0x80) {
+          return false;
+        }
+        codePoint = (codePoint << 6) | (continuation & 0x3f);
+      }
+      // Reject overlong encodings, surrogates, and values beyond U+10FFFF
+      const unsigned long minimum[] = { 0, 0x80, 0x800, 0x10000 };
+      if (codePoint < minimum[continuationBytes] || codePoint > 0x10ffff ||
+          (codePoint >= 0xd800 && codePoint <= 0xdfff)) {
+        return false;
+      }
+      i += continuationBytes + 1;
+    }
+    return true;
+  }
+
+  template <typename Source>
+  class PackagedSealedMessageJsonReader {
+  public:
+    explicit PackagedSealedMessageJsonReader(Source& source) : source(source) {}
+
+    PackagedSealedMessage read() {
+      std::vector<unsigned char> ciphertext;
+      std::string derivationOptionsJson, unsealingInstructions, encodedKeyId;
+      BinaryEncoding binaryEncoding = BinaryEncoding::Hex;
+      BinaryEncoding ciphertextEncoding = BinaryEncoding::Hex;
+      bool hasCiphertext = false;
+      bool ciphertextIsValid = true;
+      size_t ciphertextPosition = 0;
+
+      skipWhitespace();
+      expect('{');
+      skipWhitespace();
+      if (source.peek() == '}') {
+        source.get();
+      } else for (;;) {
+        expect('"');
+        const std::string key = readString();
+        skipWhitespace();
+        expect(':');
+        skipWhitespace();
+        if (key == PackagedSealedMessageJsonFields::ciphertext) {
+          expect('"');
+          if (source.isSeekable()) {
+            ciphertextPosition = source.tell();
+          }
+          ciphertextEncoding = binaryEncoding;
+          ciphertextIsValid = decodeCiphertext(source, ciphertextEncoding, ciphertext);
+          hasCiphertext = true;
+        } else if (key == BinaryEncodingJsonField::binaryEncoding) {
+          if (!tryBinaryEncodingFromName(readStringValue(), binaryEncoding)) {
+            throw JsonParsingException("Unknown binaryEncoding");
+          }
+        } else if (key == PackagedSealedMessageJsonFields::derivationOptionsJson) {
+          derivationOptionsJson = readStringValue();
+        } else if (key == PackagedSealedMessageJsonFields::unsealingInstructions) {
+          unsealingInstructions = readStringValue();
+        } else if (key == PackagedSealedMessageJsonFields::keyId) {
+          // Decoded once the binaryEncoding is known
+          encodedKeyId = readStringValue();
+        } else {
+          skipValue();
+        }
+        skipWhitespace();
+        const int c = source.get();
+        if (c == '}') {
+          break;
+        } else if (c != ',') {
+          throw JsonParsingException("Expected ',' or '}' in JSON object");
+        }
+        skipWhitespace();
+      }
+
+      if (!hasCiphertext) {
+        throw JsonParsingException("The JSON object has no ciphertext field");
+      }
+      if (ciphertextEncoding != binaryEncoding) {
+        // The binaryEncoding field followed the ciphertext,
+        // so decode the ciphertext again in the encoding it names
+        if (!source.isSeekable()) {
+          throw JsonParsingException("binaryEncoding must precede the ciphertext in a stream that cannot seek");
+        }
+        const size_t endPosition = source.tell();
+        source.seek(ciphertextPosition);
+        ciphertextIsValid = decodeCiphertext(source, binaryEncoding, ciphertext);
+        source.seek(endPosition);
+      }
+      if (!ciphertextIsValid) {
+        if (binaryEncoding == BinaryEncoding::Hex) {
+          throw InvalidHexCharacterException("The ciphertext is not a valid hex string");
+        }
+        throw std::invalid_argument("The ciphertext is not a valid base64url string");
+      }
+      return PackagedSealedMessage(
+        std::move(ciphertext),
+        derivationOptionsJson,
+        unsealingInstructions,
+        encodedStrToByteVector(encodedKeyId, binaryEncoding)
+      );
+    }
+
+    void skipWhitespace() {
+      for (int c = source.peek(); c == ' ' || c == '\t' || c == '\n' || c == '\r'; c = source.peek()) {
+        source.get();
+      }
+    }
+
+  private:
+    Source& source;
+
+    void expect(char expected) {
+      if (source.get() != (unsigned char) expected) {
+        throw JsonParsingException((std::string("Expected '") + expected + "' in JSON").c_str());
+      }
+    }
+
+    unsigned long readHexQuad() {
+      char digits[4];
+      for (char& digit : digits) {
+        const int c = source.get();
+        if (c == endOfJson) {
+          throw JsonParsingException("Unterminated string");
+        }
+        digit = (char) c;
+      }
+      unsigned char high, low;
+      if (!hexDecode(&high, digits, 1, HexCodec::Scalar) || !hexDecode(&low, digits + 2, 1, HexCodec::Scalar)) {
+        throw JsonParsingException("Invalid \\u escape in string");
+      }
+      return ((unsigned long) high << 8) | low;
+    }
+
+    // Read the rest of a string whose opening quote has been consumed
+    std::string readString() {
+      std::string value;
+      for (;;) {
+        int c = source.get();
+        if (c == endOfJson) {
+          throw JsonParsingException("Unterminated string");
+        } else if (c == '"') {
+          break;
+        } else if (c < 0x20) {
+          throw JsonParsingException("Unescaped control character in string");
+        } else if (c != '\\') {
+          value += (char) c;
+          continue;
+        }
+        switch (c = source.get()) {
+          case '"': case '\\': case '/': value += (char) c; break;
+          case 'b': value += '\b'; break;
+          case 'f': value += '\f'; break;
+          case 'n': value += '\n'; break;
+          case 'r': value += '\r'; break;
+          case 't': value += '\t'; break;
+          case 'u': {
+            unsigned long codePoint = readHexQuad();
+            if (codePoint >= 0xd800 && codePoint <= 0xdbff) {
+              expect('\\');
+              expect('u');
+              const unsigned long lowSurrogate = readHexQuad();
+              if (lowSurrogate < 0xdc00 || lowSurrogate > 0xdfff) {
+                throw JsonParsingException("Invalid surrogate pair in string");
+              }
+              codePoint = 0x10000 + ((codePoint - 0xd800) << 10) + (lowSurrogate - 0xdc00);
+            } else if (codePoint >= 0xdc00 && codePoint <= 0xdfff) {
+              throw JsonParsingException("Invalid surrogate pair in string");
+            }
+            appendUtf8(value, codePoint);
+            break;
+          }
+          default:
+            throw JsonParsingException("Invalid escape in string");
+        }
+      }
+      if (!isValidUtf8(value)) {
+        throw JsonParsingException("Invalid UTF-8 in string");
+      }
+      return value;
+    }
+
+    std::string readStringValue() {
+      if (source.peek() != '"') {
+        throw JsonParsingException("Expected a string value");
+      }
+      source.get();
+      return readString();
+    }
+
+    void expectLiteral(const char* rest) {
+      for (const char* c = rest; *c != '\0'; c++) {
+        if (source.get() != (unsigned char) *c) {
+          throw JsonParsingException("Invalid literal in JSON");
+        }
+      }
+    }
+
+    bool nextIsDigit() {
+      const int c = source.peek();
+      return c >= '0' && c <= '9';
+    }
+
+    void skipDigits() {
+      if (!nextIsDigit()) {
+        throw JsonParsingException("Invalid number in JSON");
+      }
+      while (nextIsDigit()) {
+        source.get();
+      }
+    }
+
+    // Skip the rest of a number whose first character, c, has been consumed
+    void skipNumber(int c) {
+      if (c == '-') {
+        c = source.get();
+      }
+      if (c >= '1' && c <= '9') {
+        while (nextIsDigit()) {
+          source.get();
+        }
+      } else if (c != '0') {
+        throw JsonParsingException("Invalid number in JSON");
+      }
+      if (source.peek() == '.') {
+        source.get();
+        skipDigits();
+      }
+      if (source.peek() == 'e' || source.peek() == 'E') {
+        source.get();
+        if (source.peek() == '+' || source.peek() == '-') {
+          source.get();
+        }
+        skipDigits();
+      }
+    }
+
+    void skipMemberName() {
+      expect('"');
+      readString();
+      skipWhitespace();
+      expect(':');
+    }
+
+    // Skip the value of a field this reader does not use, validating it as
+    // strictly as nlohmann::json would (which tryFromJson uses), so that
+    // fromJson and tryFromJson accept the same documents.  Nesting is
+    // tracked in a string of open brackets rather than by recursion, so
+    // deeply nested values cannot exhaust the stack.
+    void skipValue() {
+      std::string open;
+      for (;;) {
+        skipWhitespace();
+        int c = source.get();
+        if (c == '"') {
+          readString();
+        } else if (c == '{' || c == '[') {
+          skipWhitespace();
+          if (source.peek() == (c == '{' ? '}' : ']')) {
+            source.get();
+          } else {
+            open += (char) c;
+            if (c == '{') {
+              skipMemberName();
+            }
+            continue;
+          }
+        } else if (c == 't') {
+          expectLiteral("rue");
+        } else if (c == 'f') {
+          expectLiteral("alse");
+        } else if (c == 'n') {
+          expectLiteral("ull");
+        } else if (c == '-' || (c >= '0' && c <= '9')) {
+          skipNumber(c);
+        } else {
+          throw JsonParsingException("Expected a JSON value");
+        }
+        // A value is complete: close the containers it completes, or
+        // move on to the next element of the innermost one
+        for (;;) {
+          if (open.empty()) {
+            return;
+          }
+          skipWhitespace();
+          c = source.get();
+          if (c == ',') {
+            if (open.back() == '{') {
+              skipWhitespace();
+              skipMemberName();
+            }
+            break;
+          } else if (c == (open.back() == '{' ? '}' : ']')) {
+            open.erase(open.size() - 1);
+          } else {
+            throw JsonParsingException("Expected ',' or a closing bracket in JSON");
+          }
+        }
+      }
+    }
+  };
+
+}
+
+void PackagedSealedMessage::writeJson(
+  std::ostream& out,
+  BinaryEncoding binaryEncoding
+) const {
+  StreamJsonSink sink(out);
+  writePackagedSealedMessageJson(sink, *this, binaryEncoding);
+}
+
+void PackagedSealedMessage::writeJsonToFile(
+  const std::string& path,
+  BinaryEncoding binaryEncoding
+) const {
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out) {
+    throw FileAccessException(("Could not open " + path).c_str());
+  }
+  writeJson(out, binaryEncoding);
+  out.close();
+  if (!out) {
+    throw FileAccessException(("Could not write " + path).c_str());
+  }
+}
+
+PackagedSealedMessage PackagedSealedMessage::readJson(std::istream& in) {
+  StreamJsonSource source(in);
+  return PackagedSealedMessageJsonReader<StreamJsonSource>(source).read();
+}
+
+PackagedSealedMessage PackagedSealedMessage::readJsonFromFile(const std::string& path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    throw FileAccessException(("Could not open " + path).c_str());
+  }
+  return readJson(in);
+}
+
 const std::string PackagedSealedMessage::toJson(
   int indent,
-  const char indent_char
+  const char indent_char,
+  BinaryEncoding binaryEncoding
 ) const {
+  if (indent < 0) {
+    std::string json;
+    json.reserve(
+      (binaryEncoding == BinaryEncoding::Hex ? 2 * ciphertext.size() : base64UrlEncodedLength(ciphertext.size())) +
+      derivationOptionsJson.size() + unsealingInstructions.size() + 128
+    );
+    StringJsonSink sink(json);
+    writePackagedSealedMessageJson(sink, *this, binaryEncoding);
+    return json;
+  }
   nlohmann::json asJson;
-  asJson[PackagedSealedMessageJsonFields::ciphertext] = toHexStr(ciphertext);
+  asJson[PackagedSealedMessageJsonFields::ciphertext] = toEncodedStr(ciphertext, binaryEncoding);
   if (derivationOptionsJson.size() > 0) {
     asJson[PackagedSealedMessageJsonFields::derivationOptionsJson] = derivationOptionsJson;
   }
+  if (keyId.size() > 0) {
+    asJson[PackagedSealedMessageJsonFields::keyId] = toEncodedStr(keyId, binaryEncoding);
+  }
   if (unsealingInstructions.size() > 0) {
     asJson[PackagedSealedMessageJsonFields::unsealingInstructions] = unsealingInstructions;
   }
+  if (binaryEncoding != BinaryEncoding::Hex) {
+    asJson[BinaryEncodingJsonField::binaryEncoding] = binaryEncodingName(binaryEncoding);
+  }
   return asJson.dump(indent, indent_char);
 }
   
 PackagedSealedMessage PackagedSealedMessage::fromJson(const std::string& packagedSealedMessageAsJson) {
-  try {
-    nlohmann::json jsonObject = nlohmann::json::parse(packagedSealedMessageAsJson);
-    return PackagedSealedMessage(
-      hexStrToByteVector(jsonObject.at(PackagedSealedMessageJsonFields::ciphertext)),
-      jsonObject.value<std::string>(PackagedSealedMessageJsonFields::derivationOptionsJson, ""),
-      jsonObject.value<std::string>(PackagedSealedMessageJsonFields::unsealingInstructions, "")
-    );
-  } catch (nlohmann::json::exception e) {
-    throw JsonParsingException(e.what());
+  MemoryJsonSource source(packagedSealedMessageAsJson.data(), packagedSealedMessageAsJson.size());
+  PackagedSealedMessageJsonReader<MemoryJsonSource> reader(source);
+  const PackagedSealedMessage packagedSealedMessage = reader.read();
+  reader.skipWhitespace();
+  if (source.peek() != endOfJson) {
+    throw JsonParsingException("Unexpected characters after the JSON object");
+  }
+  return packagedSealedMessage;
+}
+
+// Read an optional string field, failing only if it is present
+// but not a string.
+static bool tryGetOptionalString(
+  const nlohmann::json& jsonObject,
+  const std::string& fieldName,
+  std::string& value
+) {
+  const auto field = jsonObject.find(fieldName);
+  if (field == jsonObject.end()) {
+    value.clear();
+    return true;
+  }
+  if (!field->is_string()) {
+    return false;
+  }
+  value = field->get<std::string>();
+  return true;
+}
+
+Result<PackagedSealedMessage> PackagedSealedMessage::tryFromJson(const std::string& packagedSealedMessageAsJson) {
+  const nlohmann::json jsonObject = nlohmann::json::parse(packagedSealedMessageAsJson, nullptr, false);
+  if (jsonObject.is_discarded() || !jsonObject.is_object()) {
+    return Result<PackagedSealedMessage>(ResultStatus::InvalidInput);
+  }
+  const auto ciphertextField = jsonObject.find(PackagedSealedMessageJsonFields::ciphertext);
+  const auto binaryEncodingField = jsonObject.find(BinaryEncodingJsonField::binaryEncoding);
+  std::vector<unsigned char> ciphertext;
+  std::vector<unsigned char> keyId;
+  std::string derivationOptionsJson, unsealingInstructions, encodedKeyId;
+  BinaryEncoding binaryEncoding = BinaryEncoding::Hex;
+  if (
+    // As in fromJson, a binaryEncoding field (even an empty one) must name an encoding
+    (binaryEncodingField != jsonObject.end() && !(
+      binaryEncodingField->is_string() &&
+      tryBinaryEncodingFromName(binaryEncodingField->get<std::string>(), binaryEncoding)
+    )) ||
+    ciphertextField == jsonObject.end() || !ciphertextField->is_string() ||
+    !tryEncodedStrToByteVector(ciphertextField->get<std::string>(), binaryEncoding, ciphertext) ||
+    !tryGetOptionalString(jsonObject, PackagedSealedMessageJsonFields::derivationOptionsJson, derivationOptionsJson) ||
+    !tryGetOptionalString(jsonObject, PackagedSealedMessageJsonFields::unsealingInstructions, unsealingInstructions) ||
+    !tryGetOptionalString(jsonObject, PackagedSealedMessageJsonFields::keyId, encodedKeyId) ||
+    !tryEncodedStrToByteVector(encodedKeyId, binaryEncoding, keyId)
+  ) {
+    return Result<PackagedSealedMessage>(ResultStatus::InvalidInput);
   }
+  return Result<PackagedSealedMessage>(std::unique_ptr<PackagedSealedMessage>(
+    new PackagedSealedMessage(ciphertext, derivationOptionsJson, unsealingInstructions, keyId)
+  ));
 }
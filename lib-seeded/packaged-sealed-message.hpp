@@ -1,8 +1,13 @@
 #pragma once
 
+#include <iosfwd>
 #include <string>
 #include <vector>
 #include "sodium-buffer.hpp"
+#include "convert.hpp"
+#include "interned-string.hpp"
+#include "result.hpp"
+#include "sealed-message-envelope.hpp"
 
 /**
  * @brief When a message is sealed, the ciphertext is packaged with the derivationOptionsJson
@@ -22,12 +27,22 @@ public:
      * @brief The derivation options used to generate the
      * encryption/decryption keys.
      */
-    const std::string derivationOptionsJson;
+    const InternedString derivationOptionsJson;
     /**
      * @brief Optional public instructions that the sealer
      * requests the unsealer to follow as a condition of unsealing.
      */
     const std::string unsealingInstructions;
+    /**
+     * @brief An optional identifier of the key that can unseal the message
+     * (SealingKey::getKeyId or SymmetricKey::getKeyId), set by sealWithKeyId,
+     * with which a KeyRegistry can find that key without trying others.
+     * Empty if the sealer did not include one.
+     * 
+     * It is carried by the JSON and envelope forms, but not by
+     * toSerializedBinaryForm's fixed-length list.
+     */
+    const std::vector<unsigned char> keyId;
 
     /**
      * @brief Construct directly from the constituent members
@@ -37,11 +52,24 @@ public:
      * encryption/decryption keys.
      * @param unsealingInstructions Optional public instructions that the sealer
      * requests the unsealer to follow as a condition of unsealing.
+     * @param keyId An optional identifier of the key that can unseal the message.
      */
     PackagedSealedMessage(
         const std::vector<unsigned char>& ciphertext,
-        const std::string& derivationOptionsJson,
-        const std::string& unsealingInstructions
+        const InternedString& derivationOptionsJson,
+        const std::string& unsealingInstructions,
+        const std::vector<unsigned char>& keyId = std::vector<unsigned char>()
+    );
+
+    /**
+     * @brief Construct by taking ownership of a ciphertext, rather than
+     * copying it, for large messages.
+     */
+    PackagedSealedMessage(
+        std::vector<unsigned char>&& ciphertext,
+        const InternedString& derivationOptionsJson,
+        const std::string& unsealingInstructions,
+        const std::vector<unsigned char>& keyId = std::vector<unsigned char>()
     );
 
     /**
@@ -60,14 +88,108 @@ public:
    */
   const SodiumBuffer toSerializedBinaryForm() const;
 
+  /**
+   * @brief The exact number of bytes toSerializedBinaryForm produces
+   */
+  size_t serializedSize() const;
+
+  /**
+   * @brief Write the same bytes as toSerializedBinaryForm (ciphertext, derivationOptionsJson, and unsealingInstructions)
+   * into memory supplied by the caller, without allocating. Used by SealedMessageArchive
+   * to append messages through a single reusable buffer.
+   *
+   * @param out Where to write the serialized form
+   * @param capacity The number of bytes available at out, which must be at
+   * least serializedSize()
+   * @return size_t The number of bytes written
+   * @exception std::invalid_argument Thrown if capacity is too small.
+   */
+  size_t serializeInto(unsigned char* out, size_t capacity) const;
+
   /**
    * @brief Deserialize from a byte array stored as a list of:
    *   (keyBytes, derivationOptionsJson)
    * 
    * Stored in SodiumBuffer's fixed-length list format.
    * Strings are stored as UTF8 byte arrays.
+   * 
+   * Also accepts the SealedMessageEnvelope written by toEnvelopeBinaryForm,
+   * which is recognized by its magic bytes.
+   * 
+   * @param derivationOptionsTable The table with which to resolve an
+   * envelope's derivation options ID, if it has one (optional)
    */
-  static PackagedSealedMessage fromSerializedBinaryForm(const SodiumBuffer &serializedBinaryForm);
+  static PackagedSealedMessage fromSerializedBinaryForm(
+    const SodiumBuffer &serializedBinaryForm,
+    const DerivationOptionsTable* derivationOptionsTable = NULL
+  );
+
+  /**
+   * @brief The non-throwing form of fromSerializedBinaryForm, for
+   * messages received from untrusted sources.
+   * 
+   * @return Result<PackagedSealedMessage> The message, or
+   * ResultStatus::InvalidInput if serializedBinaryForm is malformed
+   * or refers to a derivation options ID not in derivationOptionsTable.
+   */
+  static Result<PackagedSealedMessage> tryFromSerializedBinaryForm(
+    const SodiumBuffer &serializedBinaryForm,
+    const DerivationOptionsTable* derivationOptionsTable = NULL
+  );
+
+  /**
+   * @brief Serialize to a SealedMessageEnvelope, a versioned binary
+   * form that a receiver can parse in one pass, and whose
+   * algorithm and key ID hint can be read without parsing JSON.
+   * 
+   * @param algorithm The algorithm the message was sealed with.  If
+   * Unspecified (the default), it is inferred from the "algorithm" or
+   * "type" field of derivationOptionsJson where possible.
+   * @param keyIdHint An optional identifier of the key that can unseal
+   * the message.  If empty (the default), the message's keyId is used.
+   * @param derivationOptionsTable If set, and derivationOptionsJson is in
+   * the table, the envelope holds the table's ID for it instead of the string.
+   */
+  const SodiumBuffer toEnvelopeBinaryForm(
+    SealingAlgorithm algorithm = SealingAlgorithm::Unspecified,
+    const std::vector<unsigned char>& keyIdHint = std::vector<unsigned char>(),
+    const DerivationOptionsTable* derivationOptionsTable = NULL
+  ) const;
+
+  /**
+   * @brief The SealedMessageEnvelope that toEnvelopeBinaryForm would write,
+   * as a view of this message's fields (and keyIdHint, if not empty), so that
+   * it can be measured with encodedLength and written with writeTo into memory
+   * supplied by the caller.  The view must not outlive the message.
+   */
+  SealedMessageEnvelope toEnvelope(
+    SealingAlgorithm algorithm = SealingAlgorithm::Unspecified,
+    const std::vector<unsigned char>& keyIdHint = std::vector<unsigned char>(),
+    const DerivationOptionsTable* derivationOptionsTable = NULL
+  ) const;
+
+  /**
+   * @brief Copy the fields out of a parsed SealedMessageEnvelope,
+   * taking the keyId from its key ID hint
+   * 
+   * @param envelope The envelope, as parsed by SealedMessageEnvelope::parse
+   * @param derivationOptionsTable The table with which to resolve the
+   * envelope's derivation options ID, if it has one
+   * @exception std::invalid_argument Thrown if the envelope has a derivation
+   * options ID that is not in derivationOptionsTable.
+   */
+  static PackagedSealedMessage fromEnvelope(
+    const SealedMessageEnvelope& envelope,
+    const DerivationOptionsTable* derivationOptionsTable = NULL
+  );
+
+  /**
+   * @brief The SealingAlgorithm named by a derivationOptionsJson string's
+   * "algorithm" field or, failing that, implied by its "type" field.
+   * 
+   * @return SealingAlgorithm::Unspecified if neither field determines it
+   */
+  static SealingAlgorithm sealingAlgorithmFor(const std::string& derivationOptionsJson);
 
   /**
    * @brief Serialize this object to a JSON-formatted string
@@ -76,11 +198,13 @@ public:
    * 
    * @param indent The number of characters to indent the JSON (optional)
    * @param indent_char The character with which to indent the JSON (optional)
+   * @param binaryEncoding How binary fields are written (optional, hex by default)
    * @return const std::string
    */
   const std::string toJson(
     int indent = -1,
-    const char indent_char = ' '
+    const char indent_char = ' ',
+    BinaryEncoding binaryEncoding = BinaryEncoding::Hex
   ) const;
   
   /**
@@ -91,4 +215,64 @@ public:
    */
   static PackagedSealedMessage fromJson(const std::string& packagedSealedMessageAsJson);
 
+  /**
+   * @brief The non-throwing form of fromJson, for messages received
+   * from untrusted sources.
+   * 
+   * @return Result<PackagedSealedMessage> The message, or
+   * ResultStatus::InvalidInput if the JSON is malformed or a field
+   * is missing or of the wrong type.
+   */
+  static Result<PackagedSealedMessage> tryFromJson(const std::string& packagedSealedMessageAsJson);
+
+  /**
+   * @brief Write this object as JSON to a stream without building the
+   * JSON in memory first. The ciphertext is encoded a chunk at a time,
+   * so the only full-size copy of it is the one in this object.
+   * 
+   * The output is the same as that of toJson() with no indentation.
+   * 
+   * @param out The stream to write to
+   * @param binaryEncoding How the ciphertext is written (optional, hex by default)
+   */
+  void writeJson(
+    std::ostream& out,
+    BinaryEncoding binaryEncoding = BinaryEncoding::Hex
+  ) const;
+
+  /**
+   * @brief Write this object as JSON to a file, as writeJson does to a stream.
+   * 
+   * @exception FileAccessException Thrown if the file cannot be written.
+   */
+  void writeJsonToFile(
+    const std::string& path,
+    BinaryEncoding binaryEncoding = BinaryEncoding::Hex
+  ) const;
+
+  /**
+   * @brief Read one JSON-encoded PackagedSealedMessage from a stream
+   * without building a JSON document in memory.  The ciphertext is decoded
+   * a chunk at a time straight into the new object's ciphertext. If the
+   * stream is seekable, that buffer is sized from the remaining length
+   * of the stream so that it is not re-allocated as it grows.
+   * 
+   * Reading stops after the object's closing brace, so a stream may
+   * hold a sequence of messages.  On a stream that is not seekable,
+   * a "binaryEncoding" field other than "hex" must precede the ciphertext
+   * (as it does in the output of toJson and writeJson).
+   * 
+   * @exception JsonParsingException Thrown if the JSON is malformed or
+   * the ciphertext field is missing.
+   */
+  static PackagedSealedMessage readJson(std::istream& in);
+
+  /**
+   * @brief Read a JSON-encoded PackagedSealedMessage from a file, as
+   * readJson does from a stream.
+   * 
+   * @exception FileAccessException Thrown if the file cannot be read.
+   */
+  static PackagedSealedMessage readJsonFromFile(const std::string& path);
+
 };
\ No newline at end of file
@@ -0,0 +1,1001 @@
+#include <array>
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <string.h>
+#include <unordered_map>
+#include "sodium.h"
+#include "exceptions.hpp"
+#include "prepared-signature-verifier.hpp"
+
+// The table arithmetic uses radix-2^51 field elements, which need a
+// 64x64->128-bit multiply.  Elsewhere (MSVC) verification is left to libsodium.
+#if defined(__SIZEOF_INT128__)
+  #define SEEDED_ED25519_PREPARED
+#endif
+
+#ifdef SEEDED_ED25519_PREPARED
+namespace {
+
+  __extension__ typedef unsigned __int128 uint128;
+
+  // Field elements mod p = 2^255 - 19 as five 51-bit limbs.  Every
+  // operation leaves its limbs below 2^52, which keeps the products in
+  // fe_mul and fe_sq (times at most 38) well within 128 bits.
+  struct fe {
+    uint64_t v[5];
+  };
+
+  static const uint64_t mask51 = (1ULL << 51) - 1;
+
+  static inline uint64_t load64(const unsigned char* s) {
+    uint64_t r = 0;
+    for (int i = 7; i >= 0; i--) {
+      r = (r << 8) | s[i];
+    }
+    return r;
+  }
+
+  static inline void store64(unsigned char* s, uint64_t v) {
+    for (int i = 0; i < 8; i++) {
+      s[i] = (unsigned char) (v >> (8 * i));
+    }
+  }
+
+  static inline void fe_carry(fe& h) {
+    uint64_t c;
+    c = h.v[0] >> 51; h.v[0] &= mask51; h.v[1] += c;
+    c = h.v[1] >> 51; h.v[1] &= mask51; h.v[2] += c;
+    c = h.v[2] >> 51; h.v[2] &= mask51; h.v[3] += c;
+    c = h.v[3] >> 51; h.v[3] &= mask51; h.v[4] += c;
+    c = h.v[4] >> 51; h.v[4] &= mask51; h.v[0] += 19 * c;
+  }
+
+  static inline void fe_0(fe& h) {
+    h.v[0] = h.v[1] = h.v[2] = h.v[3] = h.v[4] = 0;
+  }
+
+  static inline void fe_1(fe& h) {
+    fe_0(h);
+    h.v[0] = 1;
+  }
+
+  static inline void fe_add(fe& h, const fe& f, const fe& g) {
+    for (int i = 0; i < 5; i++) {
+      h.v[i] = f.v[i] + g.v[i];
+    }
+    fe_carry(h);
+  }
+
+  // h = f + 4p - g, so that no limb goes negative
+  static inline void fe_sub(fe& h, const fe& f, const fe& g) {
+    h.v[0] = f.v[0] + 0x1FFFFFFFFFFFB4ULL - g.v[0];
+    for (int i = 1; i < 5; i++) {
+      h.v[i] = f.v[i] + 0x1FFFFFFFFFFFFCULL - g.v[i];
+    }
+    fe_carry(h);
+  }
+
+  static inline void fe_neg(fe& h, const fe& f) {
+    fe zero;
+    fe_0(zero);
+    fe_sub(h, zero, f);
+  }
+
+  static inline void fe_mul(fe& h, const fe& f, const fe& g) {
+    const uint64_t f0 = f.v[0], f1 = f.v[1], f2 = f.v[2], f3 = f.v[3], f4 = f.v[4];
+    const uint64_t g0 = g.v[0], g1 = g.v[1], g2 = g.v[2], g3 = g.v[3], g4 = g.v[4];
+    const uint64_t g1_19 = 19 * g1, g2_19 = 19 * g2, g3_19 = 19 * g3, g4_19 = 19 * g4;
+    uint128 r0 = (uint128) f0 * g0 + (uint128) f1 * g4_19 + (uint128) f2 * g3_19 +
+      (uint128) f3 * g2_19 + (uint128) f4 * g1_19;
+    uint128 r1 = (uint128) f0 * g1 + (uint128) f1 * g0 + (uint128) f2 * g4_19 +
+      (uint128) f3 * g3_19 + (uint128) f4 * g2_19;
+    uint128 r2 = (uint128) f0 * g2 + (uint128) f1 * g1 + (uint128) f2 * g0 +
+      (uint128) f3 * g4_19 + (uint128) f4 * g3_19;
+    uint128 r3 = (uint128) f0 * g3 + (uint128) f1 * g2 + (uint128) f2 * g1 +
+      (uint128) f3 * g0 + (uint128) f4 * g4_19;
+    uint128 r4 = (uint128) f0 * g4 + (uint128) f1 * g3 + (uint128) f2 * g2 +
+      (uint128) f3 * g1 + (uint128) f4 * g0;
+    r1 += (uint64_t) (r0 >> 51); h.v[0] = (uint64_t) r0 & mask51;
+    r2 += (uint64_t) (r1 >> 51); h.v[1] = (uint64_t) r1 & mask51;
+    r3 += (uint64_t) (r2 >> 51); h.v[2] = (uint64_t) r2 & mask51;
+    r4 += (uint64_t) (r3 >> 51); h.v[3] = (uint64_t) r3 & mask51;
+    const uint64_t c = (uint64_t) (r4 >> 51); h.v[4] = (uint64_t) r4 & mask51;
+    h.v[0] += 19 * c;
+    h.v[1] += h.v[0] >> 51;
+    h.v[0] &= mask51;
+  }
+
+  static inline void fe_sq(fe& h, const fe& f) {
+    const uint64_t f0 = f.v[0], f1 = f.v[1], f2 = f.v[2], f3 = f.v[3], f4 = f.v[4];
+    const uint64_t f0_2 = 2 * f0, f1_2 = 2 * f1;
+    const uint64_t f1_38 = 38 * f1, f2_38 = 38 * f2, f3_38 = 38 * f3;
+    const uint64_t f3_19 = 19 * f3, f4_19 = 19 * f4;
+    uint128 r0 = (uint128) f0 * f0 + (uint128) f1_38 * f4 + (uint128) f2_38 * f3;
+    uint128 r1 = (uint128) f0_2 * f1 + (uint128) f2_38 * f4 + (uint128) f3_19 * f3;
+    uint128 r2 = (uint128) f0_2 * f2 + (uint128) f1 * f1 + (uint128) f3_38 * f4;
+    uint128 r3 = (uint128) f0_2 * f3 + (uint128) f1_2 * f2 + (uint128) f4_19 * f4;
+    uint128 r4 = (uint128) f0_2 * f4 + (uint128) f1_2 * f3 + (uint128) f2 * f2;
+    r1 += (uint64_t) (r0 >> 51); h.v[0] = (uint64_t) r0 & mask51;
+    r2 += (uint64_t) (r1 >> 51); h.v[1] = (uint64_t) r1 & mask51;
+    r3 += (uint64_t) (r2 >> 51); h.v[2] = (uint64_t) r2 & mask51;
+    r4 += (uint64_t) (r3 >> 51); h.v[3] = (uint64_t) r3 & mask51;
+    const uint64_t c = (uint64_t) (r4 >> 51); h.v[4] = (uint64_t) r4 & mask51;
+    h.v[0] += 19 * c;
+    h.v[1] += h.v[0] >> 51;
+    h.v[0] &= mask51;
+  }
+
+  // h = f^(2^n)
+  static inline void fe_sqn(fe& h, const fe& f, int n) {
+    fe_sq(h, f);
+    for (int i = 1; i < n; i++) {
+      fe_sq(h, h);
+    }
+  }
+
+  // Sets t1 = z^(2^250 - 1) and t0 = z^11, the common prefix of the
+  // addition chains for inversion and for square roots.
+  static void fe_pow2_250_1(fe& t1, fe& t0, const fe& z) {
+    fe t2, t3;
+    fe_sq(t0, z);             // 2
+    fe_sqn(t1, t0, 2);        // 8
+    fe_mul(t1, z, t1);        // 9
+    fe_mul(t0, t0, t1);       // 11
+    fe_sq(t2, t0);            // 22
+    fe_mul(t1, t1, t2);       // 2^5 - 1
+    fe_sqn(t2, t1, 5);
+    fe_mul(t1, t2, t1);       // 2^10 - 1
+    fe_sqn(t2, t1, 10);
+    fe_mul(t2, t2, t1);       // 2^20 - 1
+    fe_sqn(t3, t2, 20);
+    fe_mul(t2, t3, t2);       // 2^40 - 1
+    fe_sqn(t2, t2, 10);
+    fe_mul(t1, t2, t1);       // 2^50 - 1
+    fe_sqn(t2, t1, 50);
+    fe_mul(t2, t2, t1);       // 2^100 - 1
+    fe_sqn(t3, t2, 100);
+    fe_mul(t2, t3, t2);       // 2^200 - 1
+    fe_sqn(t2, t2, 50);
+    fe_mul(t1, t2, t1);       // 2^250 - 1
+  }
+
+  // h = z^(p - 2) = 1/z
+  static void fe_invert(fe& h, const fe& z) {
+    fe t0, t1;
+    fe_pow2_250_1(t1, t0, z);
+    fe_sqn(t1, t1, 5);        // 2^255 - 2^5
+    fe_mul(h, t1, t0);        // 2^255 - 21
+  }
+
+  // h = z^((p - 5) / 8) = z^(2^252 - 3)
+  static void fe_pow22523(fe& h, const fe& z) {
+    fe t0, t1;
+    fe_pow2_250_1(t1, t0, z);
+    fe_sqn(t1, t1, 2);        // 2^252 - 4
+    fe_mul(h, t1, z);         // 2^252 - 3
+  }
+
+  static void fe_frombytes(fe& h, const unsigned char* s) {
+    h.v[0] = load64(s) & mask51;
+    h.v[1] = (load64(s + 6) >> 3) & mask51;
+    h.v[2] = (load64(s + 12) >> 6) & mask51;
+    h.v[3] = (load64(s + 19) >> 1) & mask51;
+    h.v[4] = (load64(s + 24) >> 12) & mask51;
+  }
+
+  static void fe_tobytes(unsigned char* s, const fe& h) {
+    fe t = h;
+    fe_carry(t);
+    fe_carry(t);
+    // t is now below 2^255.  Adding 19 carries out of bit 255
+    // exactly when t >= p, in which case t - p is wanted.
+    t.v[0] += 19;
+    fe_carry(t);
+    // t is now (t mod p) + 19.  Take the 19 back off by adding
+    // 2^255 - 19 and dropping bit 255.
+    t.v[0] += (1ULL << 51) - 19;
+    t.v[1] += (1ULL << 51) - 1;
+    t.v[2] += (1ULL << 51) - 1;
+    t.v[3] += (1ULL << 51) - 1;
+    t.v[4] += (1ULL << 51) - 1;
+    t.v[1] += t.v[0] >> 51; t.v[0] &= mask51;
+    t.v[2] += t.v[1] >> 51; t.v[1] &= mask51;
+    t.v[3] += t.v[2] >> 51; t.v[2] &= mask51;
+    t.v[4] += t.v[3] >> 51; t.v[3] &= mask51;
+    t.v[4] &= mask51;
+    store64(s, t.v[0] | (t.v[1] << 51));
+    store64(s + 8, (t.v[1] >> 13) | (t.v[2] << 38));
+    store64(s + 16, (t.v[2] >> 26) | (t.v[3] << 25));
+    store64(s + 24, (t.v[3] >> 39) | (t.v[4] << 12));
+  }
+
+  static bool fe_iszero(const fe& f) {
+    unsigned char s[32];
+    fe_tobytes(s, f);
+    return sodium_is_zero(s, 32) == 1;
+  }
+
+  static bool fe_isnegative(const fe& f) {
+    unsigned char s[32];
+    fe_tobytes(s, f);
+    return (s[0] & 1) != 0;
+  }
+
+  // Points on the twisted Edwards curve -x^2 + y^2 = 1 + d x^2 y^2, in the
+  // representations used by ref10 (and libsodium):
+  //   p2:     (X:Y:Z)       with x = X/Z, y = Y/Z
+  //   p3:     (X:Y:Z:T)     extended, with XY = ZT
+  //   p1p1:   ((X:Z),(Y:T)) completed, with x = X/Z, y = Y/T
+  //   precomp (y+x, y-x, 2dxy) for affine points in tables
+  //   cached  (Y+X, Y-X, Z, 2dT)
+  struct ge_p2 { fe X, Y, Z; };
+  struct ge_p3 { fe X, Y, Z, T; };
+  struct ge_p1p1 { fe X, Y, Z, T; };
+  struct ge_precomp { fe yplusx, yminusx, xy2d; };
+  struct ge_cached { fe YplusX, YminusX, Z, T2d; };
+
+  // A table of multiples of a point P: row i holds 1..8 times 256^i P,
+  // so that any 256-bit scalar multiple of P is a sum of at most 64
+  // (signed) table entries and four doublings.
+  static const size_t tableRows = 32;
+  static const size_t tableColumns = 8;
+
+  struct CurveConstants {
+    fe d, d2, sqrtm1;
+    std::vector<ge_precomp> baseTable;
+  };
+
+  static void ge_p3_0(ge_p3& h) {
+    fe_0(h.X);
+    fe_1(h.Y);
+    fe_1(h.Z);
+    fe_0(h.T);
+  }
+
+  static inline void ge_p1p1_to_p2(ge_p2& r, const ge_p1p1& p) {
+    fe_mul(r.X, p.X, p.T);
+    fe_mul(r.Y, p.Y, p.Z);
+    fe_mul(r.Z, p.Z, p.T);
+  }
+
+  static inline void ge_p1p1_to_p3(ge_p3& r, const ge_p1p1& p) {
+    fe_mul(r.X, p.X, p.T);
+    fe_mul(r.Y, p.Y, p.Z);
+    fe_mul(r.Z, p.Z, p.T);
+    fe_mul(r.T, p.X, p.Y);
+  }
+
+  static inline void ge_p3_to_p2(ge_p2& r, const ge_p3& p) {
+    r.X = p.X;
+    r.Y = p.Y;
+    r.Z = p.Z;
+  }
+
+  static inline void ge_p2_dbl(ge_p1p1& r, const ge_p2& p) {
+    fe t0;
+    fe_sq(r.X, p.X);
+    fe_sq(r.Z, p.Y);
+    fe_sq(r.T, p.Z);
+    fe_add(r.T, r.T, r.T);
+    fe_add(r.Y, p.X, p.Y);
+    fe_sq(t0, r.Y);
+    fe_add(r.Y, r.Z, r.X);
+    fe_sub(r.Z, r.Z, r.X);
+    fe_sub(r.X, t0, r.Y);
+    fe_sub(r.T, r.T, r.Z);
+  }
+
+  static inline void ge_p3_dbl(ge_p3& r, const ge_p3& p) {
+    ge_p2 q;
+    ge_p1p1 t;
+    ge_p3_to_p2(q, p);
+    ge_p2_dbl(t, q);
+    ge_p1p1_to_p3(r, t);
+  }
+
+  static inline void ge_p3_to_cached(ge_cached& r, const ge_p3& p, const CurveConstants& c) {
+    fe_add(r.YplusX, p.Y, p.X);
+    fe_sub(r.YminusX, p.Y, p.X);
+    r.Z = p.Z;
+    fe_mul(r.T2d, p.T, c.d2);
+  }
+
+  static inline void ge_add(ge_p1p1& r, const ge_p3& p, const ge_cached& q) {
+    fe t0;
+    fe_add(r.X, p.Y, p.X);
+    fe_sub(r.Y, p.Y, p.X);
+    fe_mul(r.Z, r.X, q.YplusX);
+    fe_mul(r.Y, r.Y, q.YminusX);
+    fe_mul(r.T, q.T2d, p.T);
+    fe_mul(r.X, p.Z, q.Z);
+    fe_add(t0, r.X, r.X);
+    fe_sub(r.X, r.Z, r.Y);
+    fe_add(r.Y, r.Z, r.Y);
+    fe_add(r.Z, t0, r.T);
+    fe_sub(r.T, t0, r.T);
+  }
+
+  static inline void ge_sub(ge_p1p1& r, const ge_p3& p, const ge_cached& q) {
+    fe t0;
+    fe_add(r.X, p.Y, p.X);
+    fe_sub(r.Y, p.Y, p.X);
+    fe_mul(r.Z, r.X, q.YminusX);
+    fe_mul(r.Y, r.Y, q.YplusX);
+    fe_mul(r.T, q.T2d, p.T);
+    fe_mul(r.X, p.Z, q.Z);
+    fe_add(t0, r.X, r.X);
+    fe_sub(r.X, r.Z, r.Y);
+    fe_add(r.Y, r.Z, r.Y);
+    fe_sub(r.Z, t0, r.T);
+    fe_add(r.T, t0, r.T);
+  }
+
+  static inline void ge_madd(ge_p1p1& r, const ge_p3& p, const ge_precomp& q) {
+    fe t0;
+    fe_add(r.X, p.Y, p.X);
+    fe_sub(r.Y, p.Y, p.X);
+    fe_mul(r.Z, r.X, q.yplusx);
+    fe_mul(r.Y, r.Y, q.yminusx);
+    fe_mul(r.T, q.xy2d, p.T);
+    fe_add(t0, p.Z, p.Z);
+    fe_sub(r.X, r.Z, r.Y);
+    fe_add(r.Y, r.Z, r.Y);
+    fe_add(r.Z, t0, r.T);
+    fe_sub(r.T, t0, r.T);
+  }
+
+  static inline void ge_msub(ge_p1p1& r, const ge_p3& p, const ge_precomp& q) {
+    fe t0;
+    fe_add(r.X, p.Y, p.X);
+    fe_sub(r.Y, p.Y, p.X);
+    fe_mul(r.Z, r.X, q.yminusx);
+    fe_mul(r.Y, r.Y, q.yplusx);
+    fe_mul(r.T, q.xy2d, p.T);
+    fe_add(t0, p.Z, p.Z);
+    fe_sub(r.X, r.Z, r.Y);
+    fe_add(r.Y, r.Z, r.Y);
+    fe_sub(r.Z, t0, r.T);
+    fe_add(r.T, t0, r.T);
+  }
+
+  static void ge_p2_tobytes(unsigned char* s, const ge_p2& h) {
+    fe recip, x, y;
+    fe_invert(recip, h.Z);
+    fe_mul(x, h.X, recip);
+    fe_mul(y, h.Y, recip);
+    fe_tobytes(s, y);
+    s[31] ^= (unsigned char) (fe_isnegative(x) << 7);
+  }
+
+  // Decompress as libsodium's ge25519_frombytes (negate = false) or
+  // ge25519_frombytes_negate_vartime (negate = true).
+  static bool ge_frombytes(ge_p3& h, const unsigned char* s, bool negate, const CurveConstants& c) {
+    fe u, v, v3, vxx, check;
+    fe_frombytes(h.Y, s);
+    fe_1(h.Z);
+    fe_sq(u, h.Y);
+    fe_mul(v, u, c.d);
+    fe_sub(u, u, h.Z);        // u = y^2 - 1
+    fe_add(v, v, h.Z);        // v = dy^2 + 1
+
+    fe_sq(v3, v);
+    fe_mul(v3, v3, v);        // v^3
+    fe_sq(h.X, v3);
+    fe_mul(h.X, h.X, v);
+    fe_mul(h.X, h.X, u);      // uv^7
+    fe_pow22523(h.X, h.X);    // (uv^7)^((p - 5) / 8)
+    fe_mul(h.X, h.X, v3);
+    fe_mul(h.X, h.X, u);      // uv^3 (uv^7)^((p - 5) / 8)
+
+    fe_sq(vxx, h.X);
+    fe_mul(vxx, vxx, v);
+    fe_sub(check, vxx, u);
+    if (!fe_iszero(check)) {
+      fe_add(check, vxx, u);
+      if (!fe_iszero(check)) {
+        return false;
+      }
+      fe_mul(h.X, h.X, c.sqrtm1);
+    }
+    const bool signBit = (s[31] >> 7) != 0;
+    if (fe_isnegative(h.X) == (negate ? signBit : !signBit)) {
+      fe_neg(h.X, h.X);
+    }
+    fe_mul(h.T, h.X, h.Y);
+    return true;
+  }
+
+  // As libsodium's ge25519_is_canonical: reject y >= p
+  static bool isCanonicalPointEncoding(const unsigned char* s) {
+    if ((s[31] & 0x7f) != 0x7f || s[0] < 0xed) {
+      return true;
+    }
+    for (int i = 1; i < 31; i++) {
+      if (s[i] != 0xff) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // As libsodium's ge25519_has_small_order: the encodings (ignoring the sign
+  // bit) of the points of order 1, 2, 4 and 8, including non-canonical ones.
+  static bool hasSmallOrder(const unsigned char* s) {
+    static const unsigned char blacklist[][32] = {
+      // 0 (order 4)
+      { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+      // 1 (order 1)
+      { 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+      // order 8
+      { 0x26, 0xe8, 0x95, 0x8f, 0xc2, 0xb2, 0x27, 0xb0, 0x45, 0xc3, 0xf4,
+        0x89, 0xf2, 0xef, 0x98, 0xf0, 0xd5, 0xdf, 0xac, 0x05, 0xd3, 0xc6,
+        0x33, 0x39, 0xb1, 0x38, 0x02, 0x88, 0x6d, 0x53, 0xfc, 0x05 },
+      // order 8
+      { 0xc7, 0x17, 0x6a, 0x70, 0x3d, 0x4d, 0xd8, 0x4f, 0xba, 0x3c, 0x0b,
+        0x76, 0x0d, 0x10, 0x67, 0x0f, 0x2a, 0x20, 0x53, 0xfa, 0x2c, 0x39,
+        0xcc, 0xc6, 0x4e, 0xc7, 0xfd, 0x77, 0x92, 0xac, 0x03, 0x7a },
+      // p - 1 (order 2)
+      { 0xec, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x7f },
+      // p (= 0, order 4)
+      { 0xed, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x7f },
+      // p + 1 (= 1, order 1)
+      { 0xee, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x7f }
+    };
+    for (size_t i = 0; i < sizeof blacklist / sizeof blacklist[0]; i++) {
+      if (memcmp(s, blacklist[i], 31) == 0 && (s[31] & 0x7f) == blacklist[i][31]) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // As libsodium's sc25519_is_canonical: s < L
+  static bool isCanonicalScalar(const unsigned char* s) {
+    unsigned char wide[crypto_core_ed25519_NONREDUCEDSCALARBYTES] = { 0 };
+    unsigned char reduced[crypto_core_ed25519_SCALARBYTES];
+    memcpy(wide, s, crypto_core_ed25519_SCALARBYTES);
+    crypto_core_ed25519_scalar_reduce(reduced, wide);
+    return memcmp(reduced, s, crypto_core_ed25519_SCALARBYTES) == 0;
+  }
+
+  static std::vector<ge_precomp> buildTable(const ge_p3& point, const CurveConstants& c) {
+    const size_t entries = tableRows * tableColumns;
+    std::vector<ge_p3> multiples(entries);
+    ge_p3 rowBase = point;
+    for (size_t row = 0; row < tableRows; row++) {
+      ge_cached rowBaseCached;
+      ge_p3_to_cached(rowBaseCached, rowBase, c);
+      multiples[row * tableColumns] = rowBase;
+      for (size_t column = 1; column < tableColumns; column++) {
+        ge_p1p1 sum;
+        ge_add(sum, multiples[row * tableColumns + column - 1], rowBaseCached);
+        ge_p1p1_to_p3(multiples[row * tableColumns + column], sum);
+      }
+      for (int i = 0; i < 8; i++) {
+        ge_p3_dbl(rowBase, rowBase);
+      }
+    }
+
+    // Convert to affine coordinates with a single inversion
+    std::vector<fe> prefixProducts(entries);
+    prefixProducts[0] = multiples[0].Z;
+    for (size_t i = 1; i < entries; i++) {
+      fe_mul(prefixProducts[i], prefixProducts[i - 1], multiples[i].Z);
+    }
+    fe inverse;
+    fe_invert(inverse, prefixProducts[entries - 1]);
+    std::vector<ge_precomp> table(entries);
+    for (size_t i = entries; i-- > 0;) {
+      fe zInverse, x, y;
+      if (i > 0) {
+        fe_mul(zInverse, inverse, prefixProducts[i - 1]);
+        fe_mul(inverse, inverse, multiples[i].Z);
+      } else {
+        zInverse = inverse;
+      }
+      fe_mul(x, multiples[i].X, zInverse);
+      fe_mul(y, multiples[i].Y, zInverse);
+      fe_add(table[i].yplusx, y, x);
+      fe_sub(table[i].yminusx, y, x);
+      fe_mul(table[i].xy2d, x, y);
+      fe_mul(table[i].xy2d, table[i].xy2d, c.d2);
+    }
+    return table;
+  }
+
+  static const CurveConstants& curveConstants() {
+    static const CurveConstants constants = []() -> CurveConstants {
+      CurveConstants c;
+      // d = -121665 / 121666
+      fe numerator, denominator;
+      fe_0(numerator);
+      fe_0(denominator);
+      numerator.v[0] = 121665;
+      denominator.v[0] = 121666;
+      fe_neg(numerator, numerator);
+      fe_invert(denominator, denominator);
+      fe_mul(c.d, numerator, denominator);
+      fe_add(c.d2, c.d, c.d);
+      // sqrt(-1) = 2^((p - 1) / 4) = (2^((p - 5) / 8))^2 * 2
+      fe two;
+      fe_0(two);
+      two.v[0] = 2;
+      fe_pow22523(c.sqrtm1, two);
+      fe_sq(c.sqrtm1, c.sqrtm1);
+      fe_mul(c.sqrtm1, c.sqrtm1, two);
+      // The base point has y = 4/5 and positive x
+      unsigned char baseEncoding[32];
+      memset(baseEncoding, 0x66, sizeof baseEncoding);
+      baseEncoding[0] = 0x58;
+      ge_p3 base;
+      ge_frombytes(base, baseEncoding, false, c);
+      c.baseTable = buildTable(base, c);
+      return c;
+    }();
+    return constants;
+  }
+
+  // Signed radix-16 digits e[0..63] in [-8, 8] with a = sum e[i] 16^i,
+  // for a < 2^255.
+  static void toRadix16(signed char* e, const unsigned char* a) {
+    for (int i = 0; i < 32; i++) {
+      e[2 * i] = (signed char) (a[i] & 15);
+      e[2 * i + 1] = (signed char) ((a[i] >> 4) & 15);
+    }
+    signed char carry = 0;
+    for (int i = 0; i < 63; i++) {
+      e[i] += carry;
+      carry = (signed char) ((e[i] + 8) >> 4);
+      e[i] -= (signed char) (carry * 16);
+    }
+    e[63] += carry;
+  }
+
+  static inline void addTableEntry(ge_p3& h, const ge_precomp* row, signed char digit) {
+    ge_p1p1 t;
+    if (digit > 0) {
+      ge_madd(t, h, row[digit - 1]);
+    } else if (digit < 0) {
+      ge_msub(t, h, row[-digit - 1]);
+    } else {
+      return;
+    }
+    ge_p1p1_to_p3(h, t);
+  }
+
+  // r = a P + b Q given the tables of multiples of P and Q
+  static void doubleScalarMultiplyWithTables(
+    ge_p2& r,
+    const ge_precomp* tableP, const unsigned char* a,
+    const ge_precomp* tableQ, const unsigned char* b
+  ) {
+    signed char ea[64], eb[64];
+    toRadix16(ea, a);
+    toRadix16(eb, b);
+    ge_p3 h;
+    ge_p3_0(h);
+    // Odd digits: e[2i + 1] 16^(2i + 1) = 16 (e[2i + 1] 256^i)
+    for (size_t i = 1; i < 64; i += 2) {
+      addTableEntry(h, tableP + (i / 2) * tableColumns, ea[i]);
+      addTableEntry(h, tableQ + (i / 2) * tableColumns, eb[i]);
+    }
+    for (int i = 0; i < 4; i++) {
+      ge_p3_dbl(h, h);
+    }
+    for (size_t i = 0; i < 64; i += 2) {
+      addTableEntry(h, tableP + (i / 2) * tableColumns, ea[i]);
+      addTableEntry(h, tableQ + (i / 2) * tableColumns, eb[i]);
+    }
+    ge_p3_to_p2(r, h);
+  }
+
+  // r = a P + b B, where B is the base point, for a point P that has no
+  // table of multiples: a P is built from 1..8 P, most significant digit
+  // first, and b B from the base point's table as in the tabled form
+  static void doubleScalarMultiplyWithoutTable(
+    ge_p2& r,
+    const ge_p3& p, const unsigned char* a,
+    const unsigned char* b,
+    const CurveConstants& c
+  ) {
+    signed char ea[64], eb[64];
+    toRadix16(ea, a);
+    toRadix16(eb, b);
+    ge_cached multiples[8];
+    ge_p3 multiple = p;
+    ge_p3_to_cached(multiples[0], multiple, c);
+    for (size_t i = 1; i < 8; i++) {
+      ge_p1p1 t;
+      ge_add(t, multiple, multiples[0]);
+      ge_p1p1_to_p3(multiple, t);
+      ge_p3_to_cached(multiples[i], multiple, c);
+    }
+    ge_p3 h;
+    ge_p3_0(h);
+    for (int i = 63; i >= 0; i--) {
+      if (i != 63) {
+        for (int j = 0; j < 4; j++) {
+          ge_p3_dbl(h, h);
+        }
+      }
+      ge_p1p1 t;
+      if (ea[i] > 0) {
+        ge_add(t, h, multiples[ea[i] - 1]);
+        ge_p1p1_to_p3(h, t);
+      } else if (ea[i] < 0) {
+        ge_sub(t, h, multiples[-ea[i] - 1]);
+        ge_p1p1_to_p3(h, t);
+      }
+    }
+    ge_p3 bB;
+    ge_p3_0(bB);
+    for (size_t i = 1; i < 64; i += 2) {
+      addTableEntry(bB, c.baseTable.data() + (i / 2) * tableColumns, eb[i]);
+    }
+    for (int i = 0; i < 4; i++) {
+      ge_p3_dbl(bB, bB);
+    }
+    for (size_t i = 0; i < 64; i += 2) {
+      addTableEntry(bB, c.baseTable.data() + (i / 2) * tableColumns, eb[i]);
+    }
+    ge_cached bBCached;
+    ge_p3_to_cached(bBCached, bB, c);
+    ge_p1p1 sum;
+    ge_add(sum, h, bBCached);
+    ge_p1p1_to_p2(r, sum);
+  }
+
+}
+#endif
+
+// h = SHA-512(R || A || M) mod L, hashing M fragment by fragment
+static void hashForVerification(
+  unsigned char* h,
+  const unsigned char* signature,
+  const unsigned char* signatureVerificationKeyBytes,
+  const MessageFragment* messageFragments,
+  const size_t messageFragmentCount
+) {
+  unsigned char hram[crypto_hash_sha512_BYTES];
+  crypto_hash_sha512_state hs;
+  crypto_hash_sha512_init(&hs);
+  crypto_hash_sha512_update(&hs, signature, 32);
+  crypto_hash_sha512_update(&hs, signatureVerificationKeyBytes, crypto_sign_PUBLICKEYBYTES);
+  for (size_t i = 0; i < messageFragmentCount; i++) {
+    crypto_hash_sha512_update(&hs, messageFragments[i].data, messageFragments[i].length);
+  }
+  crypto_hash_sha512_final(&hs, hram);
+  crypto_core_ed25519_scalar_reduce(h, hram);
+}
+
+// Without the 128-bit arithmetic, fragmented messages are concatenated
+// for crypto_sign_verify_detached
+static bool verifyConcatenated(
+  const unsigned char* signatureVerificationKeyBytes,
+  const MessageFragment* messageFragments,
+  const size_t messageFragmentCount,
+  const unsigned char* signature
+) {
+  if (messageFragmentCount == 1) {
+    return crypto_sign_verify_detached(
+      signature, messageFragments[0].data, messageFragments[0].length, signatureVerificationKeyBytes
+    ) == 0;
+  }
+  std::vector<unsigned char> message;
+  message.reserve(MessageFragment::totalLength(messageFragments, messageFragmentCount));
+  for (size_t i = 0; i < messageFragmentCount; i++) {
+    message.insert(message.end(), messageFragments[i].data, messageFragments[i].data + messageFragments[i].length);
+  }
+  return crypto_sign_verify_detached(
+    signature, message.data(), message.size(), signatureVerificationKeyBytes
+  ) == 0;
+}
+
+struct PreparedSignatureVerifier::Tables {
+#ifdef SEEDED_ED25519_PREPARED
+  /**
+   * @brief Multiples of -A, the negated key point
+   */
+  std::vector<ge_precomp> negatedKeyMultiples;
+#endif
+};
+
+PreparedSignatureVerifier::PreparedSignatureVerifier(
+  const unsigned char* _signatureVerificationKeyBytes,
+  const size_t _signatureVerificationKeyBytesLength
+) :
+  signatureVerificationKeyBytes(
+    _signatureVerificationKeyBytes,
+    _signatureVerificationKeyBytes + (
+      _signatureVerificationKeyBytesLength == crypto_sign_PUBLICKEYBYTES ?
+      _signatureVerificationKeyBytesLength : 0
+    )
+  ),
+  keyIsUsable(false)
+{
+  if (_signatureVerificationKeyBytesLength != crypto_sign_PUBLICKEYBYTES) {
+    throw KeyLengthException("Invalid signature-verification key size");
+  }
+#ifdef SEEDED_ED25519_PREPARED
+  const CurveConstants& c = curveConstants();
+  const unsigned char* pk = signatureVerificationKeyBytes.data();
+  ge_p3 negatedKey;
+  keyIsUsable =
+    isCanonicalPointEncoding(pk) &&
+    !hasSmallOrder(pk) &&
+    ge_frombytes(negatedKey, pk, true, c);
+  if (keyIsUsable) {
+    tables.reset(new Tables());
+    tables->negatedKeyMultiples = buildTable(negatedKey, c);
+  }
+#endif
+}
+
+PreparedSignatureVerifier::PreparedSignatureVerifier(
+  const std::vector<unsigned char>& _signatureVerificationKeyBytes
+) : PreparedSignatureVerifier(
+  _signatureVerificationKeyBytes.data(), _signatureVerificationKeyBytes.size()
+) {}
+
+PreparedSignatureVerifier::~PreparedSignatureVerifier() {}
+
+bool PreparedSignatureVerifier::isAccelerated() {
+#ifdef SEEDED_ED25519_PREPARED
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool PreparedSignatureVerifier::verify(
+  const unsigned char* message,
+  const size_t messageLength,
+  const unsigned char* signature,
+  const size_t signatureLength
+) const {
+  const MessageFragment messageFragment(message, messageLength);
+  return verify(&messageFragment, 1, signature, signatureLength);
+}
+
+bool PreparedSignatureVerifier::verify(
+  const MessageFragment* messageFragments,
+  const size_t messageFragmentCount,
+  const unsigned char* signature,
+  const size_t signatureLength
+) const {
+  if (signatureLength != crypto_sign_BYTES) {
+    return false;
+  }
+#ifdef SEEDED_ED25519_PREPARED
+  // The same checks, in the same order, as crypto_sign_verify_detached
+  if (!keyIsUsable) {
+    return false;
+  }
+  const unsigned char* s = signature + 32;
+  if ((s[31] & 240) != 0 && !isCanonicalScalar(s)) {
+    return false;
+  }
+  if (hasSmallOrder(signature)) {
+    return false;
+  }
+  unsigned char h[crypto_core_ed25519_SCALARBYTES];
+  hashForVerification(h, signature, signatureVerificationKeyBytes.data(), messageFragments, messageFragmentCount);
+
+  // R' = h(-A) + sB must encode to the R in the signature
+  ge_p2 rCheck;
+  doubleScalarMultiplyWithTables(
+    rCheck,
+    tables->negatedKeyMultiples.data(), h,
+    curveConstants().baseTable.data(), s
+  );
+  unsigned char rCheckBytes[32];
+  ge_p2_tobytes(rCheckBytes, rCheck);
+  return crypto_verify_32(rCheckBytes, signature) == 0;
+#else
+  return verifyConcatenated(
+    signatureVerificationKeyBytes.data(), messageFragments, messageFragmentCount, signature
+  );
+#endif
+}
+
+bool PreparedSignatureVerifier::verifyWithoutPreparing(
+  const unsigned char* signatureVerificationKeyBytes,
+  const MessageFragment* messageFragments,
+  const size_t messageFragmentCount,
+  const unsigned char* signature
+) {
+#ifdef SEEDED_ED25519_PREPARED
+  // The table-free multiplication below is slower than libsodium's, so
+  // copying a message is the cheaper way to verify it unless it is large
+  const size_t largestMessageToConcatenate = 256 * 1024;
+  if (
+    messageFragmentCount == 1 ||
+    MessageFragment::totalLength(messageFragments, messageFragmentCount) <= largestMessageToConcatenate
+  ) {
+    return verifyConcatenated(signatureVerificationKeyBytes, messageFragments, messageFragmentCount, signature);
+  }
+  // The checks of crypto_sign_verify_detached, in its order
+  const CurveConstants& c = curveConstants();
+  const unsigned char* pk = signatureVerificationKeyBytes;
+  const unsigned char* s = signature + 32;
+  if ((s[31] & 240) != 0 && !isCanonicalScalar(s)) {
+    return false;
+  }
+  if (hasSmallOrder(signature)) {
+    return false;
+  }
+  ge_p3 negatedKey;
+  if (!isCanonicalPointEncoding(pk) || hasSmallOrder(pk) || !ge_frombytes(negatedKey, pk, true, c)) {
+    return false;
+  }
+  unsigned char h[crypto_core_ed25519_SCALARBYTES];
+  hashForVerification(h, signature, pk, messageFragments, messageFragmentCount);
+  ge_p2 rCheck;
+  doubleScalarMultiplyWithoutTable(rCheck, negatedKey, h, s, c);
+  unsigned char rCheckBytes[32];
+  ge_p2_tobytes(rCheckBytes, rCheck);
+  return crypto_verify_32(rCheckBytes, signature) == 0;
+#else
+  return verifyConcatenated(signatureVerificationKeyBytes, messageFragments, messageFragmentCount, signature);
+#endif
+}
+
+namespace {
+  typedef std::array<unsigned char, crypto_sign_PUBLICKEYBYTES> PreparedCacheKey;
+
+  struct PreparedCacheKeyHash {
+    size_t operator()(const PreparedCacheKey& key) const {
+      // Keys come from prepare(), which callers only use for keys they
+      // trust, so their bytes need no further mixing
+      size_t hash;
+      memcpy(&hash, key.data(), sizeof hash);
+      return hash;
+    }
+  };
+
+  struct PreparedCacheShard {
+    typedef std::pair<PreparedCacheKey, std::shared_ptr<const PreparedSignatureVerifier>> Entry;
+
+    std::mutex mutex;
+    // Most recently used first
+    std::list<Entry> entries;
+    std::unordered_map<PreparedCacheKey, std::list<Entry>::iterator, PreparedCacheKeyHash> index;
+
+    void trimTo(size_t maxEntries) {
+      while (entries.size() > maxEntries) {
+        index.erase(entries.back().first);
+        entries.pop_back();
+      }
+    }
+  };
+
+  // Each prepared key holds about 30KB of tables
+  const size_t defaultPreparedCacheCapacity = 256;
+  const size_t preparedCacheShardCount = 16;
+  PreparedCacheShard preparedCacheShards[preparedCacheShardCount];
+  std::atomic<size_t> maxPreparedPerShard(
+    (defaultPreparedCacheCapacity + preparedCacheShardCount - 1) / preparedCacheShardCount
+  );
+  // Lets the (common) case of an empty cache skip the locks
+  std::atomic<size_t> preparedCacheSize(0);
+
+  PreparedCacheShard* preparedCacheShardFor(
+    const unsigned char* keyBytes, size_t keyBytesLength, PreparedCacheKey& key
+  ) {
+    if (keyBytesLength != key.size()) {
+      return nullptr;
+    }
+    memcpy(key.data(), keyBytes, key.size());
+    // Use a byte the hash above ignores, so each shard's buckets stay spread
+    return &preparedCacheShards[key[sizeof(size_t)] % preparedCacheShardCount];
+  }
+}
+
+std::shared_ptr<const PreparedSignatureVerifier> PreparedSignatureVerifier::prepare(
+  const unsigned char* signatureVerificationKeyBytes,
+  const size_t signatureVerificationKeyBytesLength
+) {
+  std::shared_ptr<const PreparedSignatureVerifier> existing =
+    findPrepared(signatureVerificationKeyBytes, signatureVerificationKeyBytesLength);
+  if (existing) {
+    return existing;
+  }
+  // Build outside the lock; if two threads race, the first to insert wins.
+  // The constructor rejects keys of the wrong length.
+  std::shared_ptr<const PreparedSignatureVerifier> prepared = std::make_shared<PreparedSignatureVerifier>(
+    signatureVerificationKeyBytes, signatureVerificationKeyBytesLength
+  );
+  PreparedCacheKey key;
+  PreparedCacheShard& shard = *preparedCacheShardFor(
+    signatureVerificationKeyBytes, signatureVerificationKeyBytesLength, key
+  );
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto found = shard.index.find(key);
+  if (found != shard.index.end()) {
+    shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+    return found->second->second;
+  }
+  shard.entries.push_front(std::make_pair(key, prepared));
+  shard.index[key] = shard.entries.begin();
+  preparedCacheSize++;
+  const size_t sizeBeforeTrimming = shard.entries.size();
+  shard.trimTo(maxPreparedPerShard.load());
+  preparedCacheSize -= sizeBeforeTrimming - shard.entries.size();
+  return prepared;
+}
+
+std::shared_ptr<const PreparedSignatureVerifier> PreparedSignatureVerifier::findPrepared(
+  const unsigned char* signatureVerificationKeyBytes,
+  const size_t signatureVerificationKeyBytesLength
+) {
+  PreparedCacheKey key;
+  PreparedCacheShard* shard = preparedCacheShardFor(
+    signatureVerificationKeyBytes, signatureVerificationKeyBytesLength, key
+  );
+  if (shard == nullptr || preparedCacheSize.load() == 0) {
+    return std::shared_ptr<const PreparedSignatureVerifier>();
+  }
+  std::lock_guard<std::mutex> lock(shard->mutex);
+  auto found = shard->index.find(key);
+  if (found == shard->index.end()) {
+    return std::shared_ptr<const PreparedSignatureVerifier>();
+  }
+  shard->entries.splice(shard->entries.begin(), shard->entries, found->second);
+  return found->second->second;
+}
+
+void PreparedSignatureVerifier::forget(
+  const unsigned char* signatureVerificationKeyBytes,
+  const size_t signatureVerificationKeyBytesLength
+) {
+  PreparedCacheKey key;
+  PreparedCacheShard* shard = preparedCacheShardFor(
+    signatureVerificationKeyBytes, signatureVerificationKeyBytesLength, key
+  );
+  if (shard == nullptr) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(shard->mutex);
+  auto found = shard->index.find(key);
+  if (found != shard->index.end()) {
+    shard->entries.erase(found->second);
+    shard->index.erase(found);
+    preparedCacheSize--;
+  }
+}
+
+void PreparedSignatureVerifier::forgetAll() {
+  for (PreparedCacheShard& shard : preparedCacheShards) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    preparedCacheSize -= shard.entries.size();
+    shard.entries.clear();
+    shard.index.clear();
+  }
+}
+
+void PreparedSignatureVerifier::setCacheCapacity(size_t maxKeys) {
+  maxPreparedPerShard.store(
+    maxKeys <= preparedCacheShardCount ? 1 : (maxKeys + preparedCacheShardCount - 1) / preparedCacheShardCount
+  );
+  for (PreparedCacheShard& shard : preparedCacheShards) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    const size_t sizeBeforeTrimming = shard.entries.size();
+    shard.trimTo(maxPreparedPerShard.load());
+    preparedCacheSize -= sizeBeforeTrimming - shard.entries.size();
+  }
+}
+
+size_t PreparedSignatureVerifier::getCacheSize() {
+  return preparedCacheSize.load();
+}
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "sodium-buffer.hpp"
+#include "message-fragment.hpp"
+
+/**
+ * @brief An Ed25519 signature verifier for one signature-verification key,
+ * with that key's expensive per-verification work done once, up front.
+ *
+ * libsodium's crypto_sign_verify_detached decompresses the public key point
+ * and then runs a generic double-scalar multiplication (about 250 point
+ * doublings) for every signature.  A PreparedSignatureVerifier decompresses
+ * the key once and precomputes a table of multiples of the key's point
+ * (32 x 8 points, about 30KB), in the same layout as the table of multiples
+ * of the base point, so each verification needs only table additions and
+ * four doublings.
+ *
+ * It accepts exactly the signatures libsodium accepts, including libsodium's
+ * checks for non-canonical and small-order keys, signatures and points.
+ *
+ * Preparing a key costs roughly a few hundred verifications, so it is worth
+ * it only for keys that will verify many signatures.  Use
+ * SignatureVerificationKey::prepareForRepeatedVerification to prepare a key.
+ * Prepared keys are also kept in a bounded process-wide cache, keyed by key
+ * bytes, which the static SignatureVerificationKey::verify methods consult.
+ *
+ * On compilers without 128-bit integer arithmetic, a PreparedSignatureVerifier
+ * simply calls crypto_sign_verify_detached.
+ *
+ * @ingroup BuildingBlocks
+ */
+class PreparedSignatureVerifier {
+public:
+  /**
+   * @brief Decompress the key and build its table of multiples
+   *
+   * @param signatureVerificationKeyBytes The raw libsodium signature-verification key
+   * @param signatureVerificationKeyBytesLength Must be crypto_sign_PUBLICKEYBYTES
+   *
+   * @exception KeyLengthException Thrown if the key is the wrong length.
+   */
+  PreparedSignatureVerifier(
+    const unsigned char* signatureVerificationKeyBytes,
+    const size_t signatureVerificationKeyBytesLength
+  );
+
+  /**
+   * @brief Decompress the key and build its table of multiples
+   *
+   * @exception KeyLengthException Thrown if the key is the wrong length.
+   */
+  explicit PreparedSignatureVerifier(
+    const std::vector<unsigned char>& signatureVerificationKeyBytes
+  );
+
+  ~PreparedSignatureVerifier();
+
+  PreparedSignatureVerifier(const PreparedSignatureVerifier&) = delete;
+  PreparedSignatureVerifier& operator=(const PreparedSignatureVerifier&) = delete;
+
+  /**
+   * @brief Verify a signature of a message by this key.
+   *
+   * @return true if and only if crypto_sign_verify_detached would accept it
+   */
+  bool verify(
+    const unsigned char* message,
+    const size_t messageLength,
+    const unsigned char* signature,
+    const size_t signatureLength
+  ) const;
+
+  /**
+   * @brief Verify a signature of a message held in several fragments,
+   * hashing the fragments in place rather than concatenating them.
+   *
+   * @return true if and only if crypto_sign_verify_detached would accept
+   * it for the fragments concatenated
+   */
+  bool verify(
+    const MessageFragment* messageFragments,
+    const size_t messageFragmentCount,
+    const unsigned char* signature,
+    const size_t signatureLength
+  ) const;
+
+  /**
+   * @brief Verify a signature of a fragmented message by a key that has not
+   * been prepared, without building its table of multiples.
+   *
+   * A message in one fragment, or small enough that copying it costs less
+   * than the slower table-free point multiplication, is passed to
+   * crypto_sign_verify_detached; only larger messages are hashed in place.
+   *
+   * @param signatureVerificationKeyBytes A crypto_sign_PUBLICKEYBYTES key
+   * @param signature A crypto_sign_BYTES signature
+   * @return true if and only if crypto_sign_verify_detached would accept
+   * it for the fragments concatenated
+   */
+  static bool verifyWithoutPreparing(
+    const unsigned char* signatureVerificationKeyBytes,
+    const MessageFragment* messageFragments,
+    const size_t messageFragmentCount,
+    const unsigned char* signature
+  );
+
+  /**
+   * @brief The raw signature-verification key this verifier was prepared for
+   */
+  const std::vector<unsigned char>& getKeyBytes() const { return signatureVerificationKeyBytes; }
+
+  /**
+   * @brief Get the prepared verifier for a key from the process-wide cache,
+   * preparing it and adding it to the cache if it is not already there.
+   *
+   * @exception KeyLengthException Thrown if the key is the wrong length.
+   */
+  static std::shared_ptr<const PreparedSignatureVerifier> prepare(
+    const unsigned char* signatureVerificationKeyBytes,
+    const size_t signatureVerificationKeyBytesLength
+  );
+
+  /**
+   * @brief Get the prepared verifier for a key from the process-wide cache
+   *
+   * @return The verifier, or an empty pointer if the key has not been prepared.
+   */
+  static std::shared_ptr<const PreparedSignatureVerifier> findPrepared(
+    const unsigned char* signatureVerificationKeyBytes,
+    const size_t signatureVerificationKeyBytesLength
+  );
+
+  /**
+   * @brief Remove a key from the process-wide cache.  Verifiers already held
+   * by SignatureVerificationKey objects remain valid.
+   */
+  static void forget(
+    const unsigned char* signatureVerificationKeyBytes,
+    const size_t signatureVerificationKeyBytesLength
+  );
+
+  /**
+   * @brief Remove all keys from the process-wide cache
+   */
+  static void forgetAll();
+
+  /**
+   * @brief Bound the number of keys in the process-wide cache
+   * (by default 256, about 8MB of tables).
+   *
+   * The cache is split into 16 independently locked shards, each holding
+   * an equal share of maxKeys (at least one key) and evicting its least
+   * recently used key when full.  Verifiers already held by
+   * SignatureVerificationKey objects remain valid when evicted.
+   */
+  static void setCacheCapacity(size_t maxKeys);
+
+  /**
+   * @brief The number of keys currently in the process-wide cache
+   */
+  static size_t getCacheSize();
+
+  /**
+   * @brief true if this build uses precomputed tables, false if it
+   * falls back to crypto_sign_verify_detached
+   */
+  static bool isAccelerated();
+
+private:
+  struct Tables;
+
+  const std::vector<unsigned char> signatureVerificationKeyBytes;
+  /**
+   * @brief false if libsodium would reject every signature by this key
+   * (it is non-canonical, of small order, or not a point on the curve)
+   */
+  bool keyIsUsable;
+  std::unique_ptr<Tables> tables;
+};
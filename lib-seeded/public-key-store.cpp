@@ -0,0 +1,265 @@
+#include "public-key-store.hpp"
+#include <cstring>
+#include <stdexcept>
+
+const size_t PublicKeyStore::keyBytesLength;
+const uint32_t PublicKeyStore::emptySlot;
+
+static_assert(
+  PublicKeyStore::keyBytesLength == crypto_box_PUBLICKEYBYTES &&
+  PublicKeyStore::keyBytesLength == crypto_sign_PUBLICKEYBYTES,
+  "Sealing and signature-verification keys must be the same length"
+);
+
+// Indexes are grown to keep at least this proportion of their slots empty,
+// which keeps linear-probing chains short
+static const size_t maximumLoadPercent = 70;
+static const size_t minimumIndexSlots = 16;
+
+const unsigned char* SealingKeyView::getSealingKeyBytes() const {
+  return store->keyBytes.data() + size_t(index) * PublicKeyStore::keyBytesLength;
+}
+
+const unsigned char* SealingKeyView::getKeyId() const {
+  return store->keyIds.data() + size_t(index) * SealingKey::keyIdBytes;
+}
+
+const InternedString& SealingKeyView::getDerivationOptionsJson() const {
+  return store->derivationOptions[store->derivationOptionsIds[index]];
+}
+
+SealingKey SealingKeyView::toSealingKey() const {
+  return SealingKey(PublicKeyBytes(getSealingKeyBytes()), getDerivationOptionsJson());
+}
+
+const unsigned char* SignatureVerificationKeyView::getSignatureVerificationKeyBytes() const {
+  return store->keyBytes.data() + size_t(index) * PublicKeyStore::keyBytesLength;
+}
+
+const InternedString& SignatureVerificationKeyView::getDerivationOptionsJson() const {
+  return store->derivationOptions[store->derivationOptionsIds[index]];
+}
+
+bool SignatureVerificationKeyView::verify(
+  const unsigned char* message,
+  const size_t messageLength,
+  const unsigned char* signature,
+  const size_t signatureLength
+) const {
+  return SignatureVerificationKey::verify(
+    getSignatureVerificationKeyBytes(), PublicKeyStore::keyBytesLength,
+    message, messageLength,
+    signature, signatureLength
+  );
+}
+
+SignatureVerificationKey SignatureVerificationKeyView::toSignatureVerificationKey() const {
+  return SignatureVerificationKey(PublicKeyBytes(getSignatureVerificationKeyBytes()), getDerivationOptionsJson());
+}
+
+PublicKeyStore::PublicKeyStore(size_t expectedKeyCount) {
+  ensureSodiumInitialized();
+  randombytes_buf(hashKey, sizeof hashKey);
+  reserve(expectedKeyCount);
+}
+
+void PublicKeyStore::reserve(size_t keyCount) {
+  if (keyCount >= emptySlot) {
+    throw std::invalid_argument("A PublicKeyStore cannot hold that many keys");
+  }
+  keyBytes.reserve(keyCount * keyBytesLength);
+  keyIds.reserve(keyCount * SealingKey::keyIdBytes);
+  derivationOptionsIds.reserve(keyCount);
+  types.reserve(keyCount);
+  growIndexesFor(keyCount);
+}
+
+uint64_t PublicKeyStore::hash(const unsigned char* bytes, const size_t length) const {
+  unsigned char digest[crypto_shorthash_BYTES];
+  crypto_shorthash(digest, bytes, length, hashKey);
+  uint64_t result;
+  memcpy(&result, digest, sizeof result);
+  return result;
+}
+
+uint32_t PublicKeyStore::findPosition(const PublicKeyType type, const unsigned char* key) const {
+  if (keyBytesIndex.empty()) {
+    return emptySlot;
+  }
+  const size_t mask = keyBytesIndex.size() - 1;
+  for (size_t slot = size_t(hash(key, keyBytesLength)) & mask;; slot = (slot + 1) & mask) {
+    const uint32_t position = keyBytesIndex[slot];
+    if (position == emptySlot) {
+      return emptySlot;
+    }
+    if (
+      types[position] == type &&
+      memcmp(keyBytes.data() + size_t(position) * keyBytesLength, key, keyBytesLength) == 0
+    ) {
+      return position;
+    }
+  }
+}
+
+void PublicKeyStore::insertIntoIndexes(const uint32_t position) {
+  const size_t mask = keyBytesIndex.size() - 1;
+  size_t slot = size_t(hash(keyBytes.data() + size_t(position) * keyBytesLength, keyBytesLength)) & mask;
+  while (keyBytesIndex[slot] != emptySlot) {
+    slot = (slot + 1) & mask;
+  }
+  keyBytesIndex[slot] = position;
+  if (types[position] == PublicKeyType::SealingKey) {
+    slot = size_t(hash(keyIds.data() + size_t(position) * SealingKey::keyIdBytes, SealingKey::keyIdBytes)) & mask;
+    while (keyIdIndex[slot] != emptySlot) {
+      slot = (slot + 1) & mask;
+    }
+    keyIdIndex[slot] = position;
+  }
+}
+
+void PublicKeyStore::growIndexesFor(const size_t keyCount) {
+  size_t slots = keyBytesIndex.empty() ? minimumIndexSlots : keyBytesIndex.size();
+  while (slots * maximumLoadPercent < keyCount * 100) {
+    slots *= 2;
+  }
+  if (slots == keyBytesIndex.size()) {
+    return;
+  }
+  keyBytesIndex.assign(slots, emptySlot);
+  keyIdIndex.assign(slots, emptySlot);
+  for (uint32_t position = 0; position < types.size(); position++) {
+    insertIntoIndexes(position);
+  }
+}
+
+uint32_t PublicKeyStore::derivationOptionsIdFor(const InternedString& derivationOptionsJson) {
+  // Keys are usually added in runs that share options
+  if (!derivationOptions.empty() && derivationOptions.back().sharesStorageWith(derivationOptionsJson)) {
+    return uint32_t(derivationOptions.size() - 1);
+  }
+  const auto existing = derivationOptionsIdsByJson.find(derivationOptionsJson.str());
+  if (existing != derivationOptionsIdsByJson.end()) {
+    return existing->second;
+  }
+  const uint32_t id = uint32_t(derivationOptions.size());
+  derivationOptions.push_back(derivationOptionsJson);
+  derivationOptionsIdsByJson[derivationOptionsJson.str()] = id;
+  return id;
+}
+
+uint32_t PublicKeyStore::derivationOptionsIdFor(const char* derivationOptionsJson, const size_t length) {
+  if (
+    !derivationOptions.empty() &&
+    derivationOptions.back().size() == length &&
+    memcmp(derivationOptions.back().data(), derivationOptionsJson, length) == 0
+  ) {
+    return uint32_t(derivationOptions.size() - 1);
+  }
+  return derivationOptionsIdFor(InternedString(std::string(derivationOptionsJson, length)));
+}
+
+void PublicKeyStore::append(
+  const PublicKeyType type,
+  const unsigned char* key,
+  const uint32_t derivationOptionsId
+) {
+  growIndexesFor(types.size() + 1);
+  const uint32_t position = uint32_t(types.size());
+  keyBytes.insert(keyBytes.end(), key, key + keyBytesLength);
+  keyIds.resize(keyIds.size() + SealingKey::keyIdBytes);
+  if (type == PublicKeyType::SealingKey) {
+    SealingKey::getKeyId(key, keyIds.data() + size_t(position) * SealingKey::keyIdBytes);
+  }
+  derivationOptionsIds.push_back(derivationOptionsId);
+  types.push_back(type);
+  insertIntoIndexes(position);
+}
+
+bool PublicKeyStore::add(
+  const PublicKeyType type,
+  const unsigned char* key,
+  const InternedString& derivationOptionsJson
+) {
+  if (types.size() + 1 >= emptySlot) {
+    throw std::invalid_argument("A PublicKeyStore cannot hold that many keys");
+  }
+  if (findPosition(type, key) != emptySlot) {
+    return false;
+  }
+  append(type, key, derivationOptionsIdFor(derivationOptionsJson));
+  return true;
+}
+
+bool PublicKeyStore::add(const SealingKey& sealingKey) {
+  return add(PublicKeyType::SealingKey, sealingKey.sealingKeyBytes.data(), sealingKey.derivationOptionsJson);
+}
+
+bool PublicKeyStore::add(const SignatureVerificationKey& signatureVerificationKey) {
+  return add(
+    PublicKeyType::SignatureVerificationKey,
+    signatureVerificationKey.signatureVerificationKeyBytes.data(),
+    signatureVerificationKey.derivationOptionsJson
+  );
+}
+
+bool PublicKeyStore::addSerialized(
+  const PublicKeyType type,
+  const unsigned char* serializedBinaryForm,
+  const size_t serializedBinaryFormLength
+) {
+  const unsigned char* itemData[2];
+  size_t itemLengths[2];
+  if (!SodiumBuffer::locateFixedLengthListItems(
+    serializedBinaryForm, serializedBinaryFormLength, 2, itemData, itemLengths
+  )) {
+    throw std::invalid_argument("Invalid serialized key");
+  }
+  if (itemLengths[0] != keyBytesLength) {
+    throw std::invalid_argument("Invalid key size");
+  }
+  if (types.size() + 1 >= emptySlot) {
+    throw std::invalid_argument("A PublicKeyStore cannot hold that many keys");
+  }
+  if (findPosition(type, itemData[0]) != emptySlot) {
+    return false;
+  }
+  append(type, itemData[0], derivationOptionsIdFor((const char*) itemData[1], itemLengths[1]));
+  return true;
+}
+
+size_t PublicKeyStore::getMemoryUsage() const {
+  return
+    keyBytes.capacity() +
+    keyIds.capacity() +
+    derivationOptionsIds.capacity() * sizeof(uint32_t) +
+    types.capacity() * sizeof(PublicKeyType) +
+    (keyBytesIndex.capacity() + keyIdIndex.capacity()) * sizeof(uint32_t);
+}
+
+SealingKeyView PublicKeyStore::findSealingKey(const unsigned char* sealingKeyBytes) const {
+  const uint32_t position = findPosition(PublicKeyType::SealingKey, sealingKeyBytes);
+  return position == emptySlot ? SealingKeyView() : SealingKeyView(this, position);
+}
+
+SealingKeyView PublicKeyStore::findSealingKeyById(const unsigned char* keyId, const size_t keyIdLength) const {
+  if (keyIdLength != SealingKey::keyIdBytes || keyIdIndex.empty()) {
+    return SealingKeyView();
+  }
+  const size_t mask = keyIdIndex.size() - 1;
+  for (size_t slot = size_t(hash(keyId, keyIdLength)) & mask;; slot = (slot + 1) & mask) {
+    const uint32_t position = keyIdIndex[slot];
+    if (position == emptySlot) {
+      return SealingKeyView();
+    }
+    if (memcmp(keyIds.data() + size_t(position) * SealingKey::keyIdBytes, keyId, keyIdLength) == 0) {
+      return SealingKeyView(this, position);
+    }
+  }
+}
+
+SignatureVerificationKeyView PublicKeyStore::findSignatureVerificationKey(
+  const unsigned char* signatureVerificationKeyBytes
+) const {
+  const uint32_t position = findPosition(PublicKeyType::SignatureVerificationKey, signatureVerificationKeyBytes);
+  return position == emptySlot ? SignatureVerificationKeyView() : SignatureVerificationKeyView(this, position);
+}
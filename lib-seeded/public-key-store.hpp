@@ -0,0 +1,306 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <sodium.h>
+#include "sodium-buffer.hpp"
+#include "interned-string.hpp"
+#include "sealing-key.hpp"
+#include "signature-verification-key.hpp"
+
+/**
+ * @brief The kinds of public key a PublicKeyStore holds
+ *
+ * @ingroup DerivedFromSeeds
+ */
+enum class PublicKeyType : uint8_t {
+  SealingKey = 0,
+  SignatureVerificationKey = 1
+};
+
+class PublicKeyStore;
+
+/**
+ * @brief A SealingKey held in a PublicKeyStore, referred to by its position
+ * rather than copied out of the store.
+ *
+ * A view is two words and is valid until the store is destroyed (adding
+ * keys to the store does not invalidate it, though it does invalidate the
+ * byte pointers a view has returned).  A view returned by a lookup that
+ * found nothing is empty: exists() is false and it must not be used.
+ *
+ * @ingroup DerivedFromSeeds
+ */
+class SealingKeyView {
+public:
+  SealingKeyView() : store(NULL), index(0) {}
+
+  /**
+   * @brief false if this view was returned by a lookup that found no key
+   */
+  bool exists() const { return store != NULL; }
+
+  /**
+   * @brief The key's crypto_box_PUBLICKEYBYTES bytes
+   */
+  const unsigned char* getSealingKeyBytes() const;
+
+  /**
+   * @brief The key's SealingKey::keyIdBytes-byte identifier (see SealingKey::getKeyId)
+   */
+  const unsigned char* getKeyId() const;
+
+  /**
+   * @brief The key's derivation options, shared with every other key in
+   * the store that has the same options
+   */
+  const InternedString& getDerivationOptionsJson() const;
+
+  /**
+   * @brief Copy the key out of the store
+   */
+  SealingKey toSealingKey() const;
+
+private:
+  friend class PublicKeyStore;
+  SealingKeyView(const PublicKeyStore* _store, uint32_t _index) : store(_store), index(_index) {}
+
+  const PublicKeyStore* store;
+  uint32_t index;
+};
+
+/**
+ * @brief A SignatureVerificationKey held in a PublicKeyStore, referred to by
+ * its position rather than copied out of the store (see SealingKeyView).
+ *
+ * @ingroup DerivedFromSeeds
+ */
+class SignatureVerificationKeyView {
+public:
+  SignatureVerificationKeyView() : store(NULL), index(0) {}
+
+  /**
+   * @brief false if this view was returned by a lookup that found no key
+   */
+  bool exists() const { return store != NULL; }
+
+  /**
+   * @brief The key's crypto_sign_PUBLICKEYBYTES bytes
+   */
+  const unsigned char* getSignatureVerificationKeyBytes() const;
+
+  /**
+   * @brief The key's derivation options, shared with every other key in
+   * the store that has the same options
+   */
+  const InternedString& getDerivationOptionsJson() const;
+
+  /**
+   * @brief Verify a signature as SignatureVerificationKey::verify would,
+   * without copying the key out of the store
+   */
+  bool verify(
+    const unsigned char* message,
+    const size_t messageLength,
+    const unsigned char* signature,
+    const size_t signatureLength
+  ) const;
+
+  /**
+   * @brief Copy the key out of the store
+   */
+  SignatureVerificationKey toSignatureVerificationKey() const;
+
+private:
+  friend class PublicKeyStore;
+  SignatureVerificationKeyView(const PublicKeyStore* _store, uint32_t _index) : store(_store), index(_index) {}
+
+  const PublicKeyStore* store;
+  uint32_t index;
+};
+
+/**
+ * @brief A compact, in-memory directory of millions of SealingKeys and
+ * SignatureVerificationKeys.
+ *
+ * Rather than a heap object per key, the store keeps its keys as a
+ * structure of arrays: the 32-byte keys back to back in one array, each
+ * sealing key's ID in another, and for each key a 32-bit ID standing for
+ * its derivationOptionsJson, whose distinct values are held once each.
+ * Keys are found through open-addressing hash indexes (by key bytes and,
+ * for sealing keys, by key ID) that hold only 32-bit positions, and are
+ * returned as views that point into the arrays.
+ *
+ * The indexes are hashed with SipHash (crypto_shorthash) under a key chosen
+ * at random for each store, so that keys chosen by an adversary cannot be
+ * made to collide.
+ *
+ * The store is not synchronized: keys must not be added while other
+ * threads are looking keys up.
+ *
+ * @ingroup DerivedFromSeeds
+ */
+class PublicKeyStore {
+public:
+  /**
+   * @brief The length of every key in the store
+   */
+  static const size_t keyBytesLength = 32;
+
+  /**
+   * @brief Construct an empty store
+   *
+   * @param expectedKeyCount The number of keys to reserve space for
+   */
+  explicit PublicKeyStore(size_t expectedKeyCount = 0);
+
+  PublicKeyStore(const PublicKeyStore&) = delete;
+  PublicKeyStore& operator=(const PublicKeyStore&) = delete;
+
+  /**
+   * @brief Reserve space for keyCount keys in all, so that adding them
+   * does not reallocate the arrays or rebuild the indexes
+   */
+  void reserve(size_t keyCount);
+
+  /**
+   * @brief Add a copy of a SealingKey
+   *
+   * @return false if the store already holds this sealing key
+   */
+  bool add(const SealingKey& sealingKey);
+
+  /**
+   * @brief Add a copy of a SignatureVerificationKey
+   *
+   * @return false if the store already holds this signature-verification key
+   */
+  bool add(const SignatureVerificationKey& signatureVerificationKey);
+
+  /**
+   * @brief Add a key of keyBytesLength bytes
+   *
+   * @return false if the store already holds this key as a key of this type
+   */
+  bool add(
+    const PublicKeyType type,
+    const unsigned char* keyBytes,
+    const InternedString& derivationOptionsJson
+  );
+
+  /**
+   * @brief Add a key from its serialized binary form (as produced by
+   * SealingKey::toSerializedBinaryForm or
+   * SignatureVerificationKey::toSerializedBinaryForm) without constructing
+   * a key object.
+   *
+   * @return false if the store already holds this key as a key of this type
+   * @exception std::invalid_argument Thrown if the serialized form is
+   * malformed or its key is not 32 bytes long.
+   */
+  bool addSerialized(
+    const PublicKeyType type,
+    const unsigned char* serializedBinaryForm,
+    const size_t serializedBinaryFormLength
+  );
+
+  /**
+   * @brief Add many keys of one type from their serialized binary forms,
+   * reserving space for all of them first.
+   *
+   * @param serializedBinaryForms A container (such as a vector) of the
+   * serialized forms as SodiumBuffers, byte vectors, or strings
+   * @return size_t The number of keys added (keys already in the store,
+   * or repeated in the list, are skipped)
+   * @exception std::invalid_argument Thrown if a serialized form is malformed,
+   * in which case the keys before it will have been added.
+   */
+  template <typename SerializedBinaryForms>
+  size_t bulkLoad(const PublicKeyType type, const SerializedBinaryForms& serializedBinaryForms) {
+    reserve(size() + serializedBinaryForms.size());
+    size_t added = 0;
+    for (const auto& serializedBinaryForm : serializedBinaryForms) {
+      const SodiumBuffer::FixedLengthListItem item(serializedBinaryForm);
+      if (addSerialized(type, item.data, item.length)) {
+        added++;
+      }
+    }
+    return added;
+  }
+
+  /**
+   * @brief The number of keys in the store
+   */
+  size_t size() const { return types.size(); }
+
+  /**
+   * @brief The number of distinct derivationOptionsJson strings in the store
+   */
+  size_t getDerivationOptionsCount() const { return derivationOptions.size(); }
+
+  /**
+   * @brief The heap memory held by the store's arrays and indexes, in bytes
+   * (not counting the derivation options strings, which may be shared)
+   */
+  size_t getMemoryUsage() const;
+
+  /**
+   * @brief Find a sealing key by its crypto_box_PUBLICKEYBYTES bytes
+   *
+   * @return SealingKeyView The key, or an empty view if it is not in the store
+   */
+  SealingKeyView findSealingKey(const unsigned char* sealingKeyBytes) const;
+
+  /**
+   * @brief Find a sealing key by its key ID (see SealingKey::getKeyId)
+   *
+   * @return SealingKeyView The key, or an empty view if it is not in the store
+   */
+  SealingKeyView findSealingKeyById(const unsigned char* keyId, const size_t keyIdLength) const;
+
+  /**
+   * @brief Find a signature-verification key by its crypto_sign_PUBLICKEYBYTES bytes
+   *
+   * @return SignatureVerificationKeyView The key, or an empty view if it
+   * is not in the store
+   */
+  SignatureVerificationKeyView findSignatureVerificationKey(const unsigned char* signatureVerificationKeyBytes) const;
+
+private:
+  friend class SealingKeyView;
+  friend class SignatureVerificationKeyView;
+
+  static const uint32_t emptySlot = UINT32_MAX;
+
+  // The arrays, one element (or, for keyBytes and keyIds, one fixed-length
+  // run of elements) per key.  Signature-verification keys have no key ID;
+  // their runs of keyIds are zero.
+  std::vector<unsigned char> keyBytes;
+  std::vector<unsigned char> keyIds;
+  std::vector<uint32_t> derivationOptionsIds;
+  std::vector<PublicKeyType> types;
+
+  // Each distinct derivationOptionsJson, and the reverse mapping
+  std::vector<InternedString> derivationOptions;
+  std::unordered_map<std::string, uint32_t> derivationOptionsIdsByJson;
+
+  // Open-addressing (linear-probing) indexes of positions in the arrays,
+  // with a power-of-two number of slots
+  std::vector<uint32_t> keyBytesIndex;
+  std::vector<uint32_t> keyIdIndex;
+  unsigned char hashKey[crypto_shorthash_KEYBYTES];
+
+  uint64_t hash(const unsigned char* bytes, const size_t length) const;
+  uint32_t findPosition(const PublicKeyType type, const unsigned char* key) const;
+  void insertIntoIndexes(const uint32_t position);
+  void growIndexesFor(const size_t keyCount);
+  uint32_t derivationOptionsIdFor(const InternedString& derivationOptionsJson);
+  uint32_t derivationOptionsIdFor(const char* derivationOptionsJson, const size_t length);
+  void append(
+    const PublicKeyType type,
+    const unsigned char* key,
+    const uint32_t derivationOptionsId
+  );
+};
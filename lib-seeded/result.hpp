@@ -0,0 +1,86 @@
+#pragma once
+
+#include <memory>
+#include <stdexcept>
+
+/**
+ * @brief The outcome of an operation that reports failure by
+ * returning a status, rather than by throwing an exception.
+ * 
+ * @ingroup BuildingBlocks
+ */
+enum class ResultStatus {
+  /**
+   * @brief The operation succeeded and the Result holds its value
+   */
+  Success,
+  /**
+   * @brief An input had an invalid length or format
+   */
+  InvalidInput,
+  /**
+   * @brief A ciphertext or signature could not be verified
+   * (the analog of CryptographicVerificationFailureException)
+   */
+  CryptographicVerificationFailure
+};
+
+/**
+ * @brief Either a value or the ResultStatus explaining why there is none.
+ * 
+ * Used by batch operations, which report the outcome of each item
+ * individually instead of throwing on the first failure.
+ * Results can be moved but not copied, as they may own secret values
+ * (e.g. a SodiumBuffer holding an unsealed message).
+ * 
+ * @ingroup BuildingBlocks
+ */
+template <typename T>
+class Result {
+public:
+  /**
+   * @brief Construct a successful result holding value
+   */
+  explicit Result(std::unique_ptr<T> value) :
+    status(value ? ResultStatus::Success : ResultStatus::InvalidInput),
+    value(std::move(value))
+    {}
+
+  /**
+   * @brief Construct a failed result
+   */
+  explicit Result(ResultStatus status) :
+    status(status == ResultStatus::Success ? ResultStatus::InvalidInput : status)
+    {}
+
+  Result(Result&& other) = default;
+  Result& operator=(Result&& other) = default;
+  Result(const Result& other) = delete;
+  Result& operator=(const Result& other) = delete;
+
+  /**
+   * @brief true if the operation succeeded and getValue() may be called
+   */
+  bool ok() const { return status == ResultStatus::Success; }
+
+  /**
+   * @brief The outcome of the operation
+   */
+  ResultStatus getStatus() const { return status; }
+
+  /**
+   * @brief The value produced by a successful operation
+   * 
+   * @exception std::logic_error Thrown if the operation failed
+   */
+  const T& getValue() const {
+    if (!ok()) {
+      throw std::logic_error("Result has no value because the operation failed");
+    }
+    return *value;
+  }
+
+private:
+  ResultStatus status;
+  std::unique_ptr<T> value;
+};
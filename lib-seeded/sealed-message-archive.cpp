@@ -0,0 +1,338 @@
+#include <algorithm>
+#include <stdexcept>
+#include "sealed-message-archive.hpp"
+#include "sealed-message-envelope.hpp"
+#include "work-stealing-pool.hpp"
+#include "exceptions.hpp"
+
+#ifdef _WIN32
+  #include <io.h>
+  #define archiveFseek _fseeki64
+  #define archiveTruncate(file, length) (_chsize_s(_fileno(file), (__int64) (length)) == 0)
+#else
+  #include <sys/types.h>
+  #include <unistd.h>
+  #define archiveFseek fseeko
+  #define archiveTruncate(file, length) (ftruncate(fileno(file), (off_t) (length)) == 0)
+#endif
+
+// Each index entry is the 8-byte little-endian end offset of a record
+static const size_t indexEntryBytes = 8;
+
+// Records are handed to the thread pool in groups of this many
+static const uint64_t recordsPerTask = 256;
+
+static uint64_t readIndexEntry(const unsigned char* entry) {
+  uint64_t value = 0;
+  for (size_t i = indexEntryBytes; i > 0; i--) {
+    value = (value << 8) | entry[i - 1];
+  }
+  return value;
+}
+
+static void writeIndexEntry(unsigned char* entry, uint64_t value) {
+  for (size_t i = 0; i < indexEntryBytes; i++) {
+    entry[i] = (unsigned char) (value >> (8 * i));
+  }
+}
+
+static bool fileExists(const std::string& path) {
+  FILE* file = fopen(path.c_str(), "rb");
+  if (file == NULL) {
+    return false;
+  }
+  fclose(file);
+  return true;
+}
+
+SealedMessageArchive::SealedMessageArchive(
+  const std::string& _path,
+  uint64_t _maxSegmentBytes
+) :
+  path(_path),
+  maxSegmentBytes(_maxSegmentBytes),
+  recordsFile(NULL),
+  indexFile(NULL)
+{
+  uint64_t firstRecordNumber = 0;
+  for (size_t segmentNumber = 0; fileExists(segmentPath(segmentNumber, "index")); segmentNumber++) {
+    Segment segment;
+    segment.firstRecordNumber = firstRecordNumber;
+    segment.index.reset(new MemoryMappedFile(segmentPath(segmentNumber, "index")));
+    // Mapping no bytes of the records file just measures it
+    const uint64_t recordsFileSize = fileExists(segmentPath(segmentNumber, "records")) ?
+      MemoryMappedFile(segmentPath(segmentNumber, "records"), 0, 0).getFileSize() : 0;
+    // An entry cut short by an interrupted append is ignored, as are entries
+    // for records that did not reach the records file before an interruption
+    segment.recordCount = segment.index->size() / indexEntryBytes;
+    segment.recordsLength = 0;
+    while (segment.recordCount > 0) {
+      segment.recordsLength = readIndexEntry(segment.index->data() + (segment.recordCount - 1) * indexEntryBytes);
+      if (segment.recordsLength <= recordsFileSize) {
+        break;
+      }
+      segment.recordCount--;
+      segment.recordsLength = 0;
+    }
+    segment.mappedRecordCount = 0;
+    segment.index.reset();
+    firstRecordNumber += segment.recordCount;
+    segments.push_back(std::move(segment));
+  }
+  if (segments.empty()) {
+    Segment segment;
+    segment.firstRecordNumber = 0;
+    segment.recordCount = 0;
+    segment.recordsLength = 0;
+    segment.mappedRecordCount = 0;
+    segments.push_back(std::move(segment));
+  }
+  openForAppend(segments.size() - 1);
+}
+
+SealedMessageArchive::~SealedMessageArchive() {
+  closeForAppend();
+}
+
+std::string SealedMessageArchive::segmentPath(size_t segmentNumber, const char* suffix) const {
+  return path + "." + std::to_string(segmentNumber) + "." + suffix;
+}
+
+void SealedMessageArchive::openForAppend(size_t segmentNumber) {
+  const Segment& segment = segments[segmentNumber];
+  const std::string recordsPath = segmentPath(segmentNumber, "records");
+  const std::string indexPath = segmentPath(segmentNumber, "index");
+  // Open for update, rather than append, and cut off anything past the last
+  // recovered record (left by an interrupted append).  Stale index entries
+  // left in place could otherwise come back into range once later appends
+  // have grown the records file past the offsets they hold.
+  recordsFile = fopen(recordsPath.c_str(), "r+b");
+  if (recordsFile == NULL) {
+    recordsFile = fopen(recordsPath.c_str(), "w+b");
+  }
+  indexFile = fopen(indexPath.c_str(), "r+b");
+  if (indexFile == NULL) {
+    indexFile = fopen(indexPath.c_str(), "w+b");
+  }
+  if (recordsFile == NULL || indexFile == NULL ||
+      !archiveTruncate(recordsFile, segment.recordsLength) ||
+      !archiveTruncate(indexFile, segment.recordCount * indexEntryBytes) ||
+      archiveFseek(recordsFile, segment.recordsLength, SEEK_SET) != 0 ||
+      archiveFseek(indexFile, segment.recordCount * indexEntryBytes, SEEK_SET) != 0) {
+    closeForAppend();
+    throw FileAccessException(("Could not open " + recordsPath + " for appending").c_str());
+  }
+}
+
+void SealedMessageArchive::closeForAppend() {
+  if (recordsFile != NULL) {
+    fclose(recordsFile);
+    recordsFile = NULL;
+  }
+  if (indexFile != NULL) {
+    fclose(indexFile);
+    indexFile = NULL;
+  }
+}
+
+uint64_t SealedMessageArchive::append(const PackagedSealedMessage& packagedSealedMessage) {
+  // Serialize into a buffer reused across appends, rather than allocating
+  // a SodiumBuffer for each record
+  size_t recordLength;
+  if (packagedSealedMessage.keyId.empty()) {
+    recordLength = packagedSealedMessage.serializedSize();
+    if (appendBuffer.size() < recordLength) {
+      appendBuffer.resize(recordLength);
+    }
+    packagedSealedMessage.serializeInto(appendBuffer.data(), recordLength);
+  } else {
+    const SealedMessageEnvelope envelope = packagedSealedMessage.toEnvelope();
+    recordLength = envelope.encodedLength();
+    if (appendBuffer.size() < recordLength) {
+      appendBuffer.resize(recordLength);
+    }
+    envelope.writeTo(appendBuffer.data());
+  }
+  return appendSerialized(appendBuffer.data(), recordLength);
+}
+
+uint64_t SealedMessageArchive::appendSerialized(const unsigned char* record, const size_t recordLength) {
+  if (recordsFile == NULL || indexFile == NULL) {
+    throw FileAccessException(("Could not append to " + path + " after an earlier write failed").c_str());
+  }
+  if (segments.back().recordCount > 0 && segments.back().recordsLength + recordLength > maxSegmentBytes) {
+    closeForAppend();
+    Segment segment;
+    segment.firstRecordNumber = segments.back().firstRecordNumber + segments.back().recordCount;
+    segment.recordCount = 0;
+    segment.recordsLength = 0;
+    segment.mappedRecordCount = 0;
+    segments.push_back(std::move(segment));
+    openForAppend(segments.size() - 1);
+  }
+  Segment& segment = segments.back();
+  unsigned char entry[indexEntryBytes];
+  writeIndexEntry(entry, segment.recordsLength + recordLength);
+  if (fwrite(record, 1, recordLength, recordsFile) != recordLength ||
+      fwrite(entry, 1, indexEntryBytes, indexFile) != indexEntryBytes) {
+    rollBackFailedWrite();
+    throw FileAccessException(("Could not append to " + segmentPath(segments.size() - 1, "records")).c_str());
+  }
+  segment.recordsLength += recordLength;
+  return segment.firstRecordNumber + segment.recordCount++;
+}
+
+void SealedMessageArchive::flush() {
+  if (recordsFile == NULL || indexFile == NULL) {
+    throw FileAccessException(("Could not write " + path + " after an earlier write failed").c_str());
+  }
+  // The records are flushed first so that the index never refers past them
+  if (fflush(recordsFile) != 0 || fflush(indexFile) != 0) {
+    rollBackFailedWrite();
+    throw FileAccessException(("Could not write " + segmentPath(segments.size() - 1, "records")).c_str());
+  }
+}
+
+void SealedMessageArchive::rollBackFailedWrite() {
+  // A failed write leaves the stdio positions past bytes that are not in
+  // the index, so the next record would land after them and every offset
+  // from then on would be wrong.  Close the files, which drops (or writes
+  // out) anything left in their buffers, and reopen them cut back to the
+  // last record appended.  Appends stay refused if that is impossible,
+  // including when records already appended never reached the disk.
+  closeForAppend();
+  const size_t segmentNumber = segments.size() - 1;
+  const Segment& segment = segments.back();
+  try {
+    const uint64_t recordsFileSize = MemoryMappedFile(segmentPath(segmentNumber, "records"), 0, 0).getFileSize();
+    const uint64_t indexFileSize = MemoryMappedFile(segmentPath(segmentNumber, "index"), 0, 0).getFileSize();
+    if (recordsFileSize >= segment.recordsLength && indexFileSize >= segment.recordCount * indexEntryBytes) {
+      openForAppend(segmentNumber);
+    }
+  } catch (const FileAccessException&) {
+    // Leave the files closed
+  }
+}
+
+uint64_t SealedMessageArchive::size() const {
+  return segments.back().firstRecordNumber + segments.back().recordCount;
+}
+
+SealedMessageArchive::Segment& SealedMessageArchive::mappedSegmentFor(uint64_t recordNumber) {
+  if (recordNumber >= size()) {
+    throw std::out_of_range("No such record in the archive");
+  }
+  // The last segment whose first record is at or before recordNumber
+  auto segmentIterator = std::upper_bound(segments.begin(), segments.end(), recordNumber,
+    [](uint64_t number, const Segment& segment) { return number < segment.firstRecordNumber; }
+  ) - 1;
+  Segment& segment = *segmentIterator;
+  if (recordNumber - segment.firstRecordNumber >= segment.mappedRecordCount) {
+    // Map (or re-map, after appends) the segment's files
+    const size_t segmentNumber = segmentIterator - segments.begin();
+    // (Unless an earlier write failure closed the files, leaving nothing to flush)
+    if (segmentNumber == segments.size() - 1 && recordsFile != NULL) {
+      flush();
+    }
+    segment.records.reset();
+    segment.index.reset();
+    segment.records.reset(new MemoryMappedFile(segmentPath(segmentNumber, "records"), 0, (size_t) segment.recordsLength));
+    segment.index.reset(new MemoryMappedFile(segmentPath(segmentNumber, "index"), 0, (size_t) (segment.recordCount * indexEntryBytes)));
+    if (segment.records->size() != segment.recordsLength || segment.index->size() != segment.recordCount * indexEntryBytes) {
+      throw FileAccessException(("The archive segment " + segmentPath(segmentNumber, "records") + " is truncated").c_str());
+    }
+    segment.mappedRecordCount = segment.recordCount;
+  }
+  return segment;
+}
+
+void SealedMessageArchive::getRecord(uint64_t recordNumber, const unsigned char*& record, size_t& recordLength) {
+  Segment& segment = mappedSegmentFor(recordNumber);
+  const uint64_t indexInSegment = recordNumber - segment.firstRecordNumber;
+  const unsigned char* entries = segment.index->data();
+  const uint64_t start = indexInSegment == 0 ? 0 : readIndexEntry(entries + (indexInSegment - 1) * indexEntryBytes);
+  const uint64_t end = readIndexEntry(entries + indexInSegment * indexEntryBytes);
+  if (start > end || end > segment.recordsLength) {
+    throw std::invalid_argument("The archive index is corrupt");
+  }
+  record = segment.records->data() + start;
+  recordLength = (size_t) (end - start);
+}
+
+// View a record in either format as an envelope, without copying it.
+// Returns false if the record is malformed.
+static bool viewRecord(const unsigned char* record, size_t recordLength, SealedMessageEnvelope& envelope) {
+  if (SealedMessageEnvelope::hasMagic(record, recordLength)) {
+    return SealedMessageEnvelope::parse(record, recordLength, envelope);
+  }
+  const unsigned char* itemData[3];
+  size_t itemLengths[3];
+  if (!SodiumBuffer::locateFixedLengthListItems(record, recordLength, 3, itemData, itemLengths)) {
+    return false;
+  }
+  envelope.ciphertext = itemData[0];
+  envelope.ciphertextLength = itemLengths[0];
+  envelope.derivationOptionsJson = (const char*) itemData[1];
+  envelope.derivationOptionsJsonLength = itemLengths[1];
+  envelope.unsealingInstructions = (const char*) itemData[2];
+  envelope.unsealingInstructionsLength = itemLengths[2];
+  return true;
+}
+
+PackagedSealedMessage SealedMessageArchive::read(uint64_t recordNumber) {
+  const unsigned char* record;
+  size_t recordLength;
+  getRecord(recordNumber, record, recordLength);
+  SealedMessageEnvelope envelope;
+  if (!viewRecord(record, recordLength, envelope)) {
+    throw std::invalid_argument("Malformed record in the archive");
+  }
+  return PackagedSealedMessage::fromEnvelope(envelope);
+}
+
+void SealedMessageArchive::mapAll() {
+  for (const Segment& segment : segments) {
+    if (segment.recordCount > 0) {
+      mappedSegmentFor(segment.firstRecordNumber + segment.recordCount - 1);
+    }
+  }
+}
+
+void SealedMessageArchive::parallelForEachRecord(
+  const std::function<void(uint64_t recordNumber, const unsigned char* record, size_t recordLength)>& visit,
+  uint64_t first,
+  uint64_t count
+) {
+  const uint64_t end = size() - std::min(size(), first) < count ? size() : first + count;
+  if (first >= end) {
+    return;
+  }
+  // Map every segment up front, so that the visiting threads only read
+  mapAll();
+  const uint64_t tasks = (end - first + recordsPerTask - 1) / recordsPerTask;
+  WorkStealingPool::getDefault().parallelFor((size_t) tasks, [this, &visit, first, end](size_t task) {
+    const uint64_t taskFirst = first + task * recordsPerTask;
+    const uint64_t taskEnd = std::min(end, taskFirst + recordsPerTask);
+    for (uint64_t recordNumber = taskFirst; recordNumber < taskEnd; recordNumber++) {
+      const unsigned char* record;
+      size_t recordLength;
+      getRecord(recordNumber, record, recordLength);
+      visit(recordNumber, record, recordLength);
+    }
+  });
+}
+
+void SealedMessageArchive::parallelUnseal(
+  const KeyRegistry& keyRegistry,
+  const std::function<void(uint64_t recordNumber, Result<SodiumBuffer>& plaintext)>& visit,
+  uint64_t first,
+  uint64_t count
+) {
+  parallelForEachRecord([&keyRegistry, &visit](uint64_t recordNumber, const unsigned char* record, size_t recordLength) {
+    SealedMessageEnvelope envelope;
+    Result<SodiumBuffer> plaintext = viewRecord(record, recordLength, envelope) ?
+      keyRegistry.tryUnseal(envelope) :
+      Result<SodiumBuffer>(ResultStatus::InvalidInput);
+    visit(recordNumber, plaintext);
+  }, first, count);
+}
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "result.hpp"
+#include "sodium-buffer.hpp"
+#include "packaged-sealed-message.hpp"
+#include "memory-mapped-file.hpp"
+#include "key-registry.hpp"
+
+/**
+ * @brief An append-only, file-backed archive of PackagedSealedMessages
+ * that can be read by record number without loading it into memory.
+ *
+ * The archive is split into segments, each a pair of files named after
+ * the archive's path:
+ *   - `<path>.<n>.records` holds the records back to back, each in the
+ *     format of PackagedSealedMessage::toSerializedBinaryForm (or, for
+ *     messages with a keyId, toEnvelopeBinaryForm, so the ID is kept).
+ *   - `<path>.<n>.index` holds, for each record, the offset in the records
+ *     file at which the record ends, as an 8-byte little-endian integer.
+ *
+ * A new segment is started when the current one would grow beyond
+ * maxSegmentBytes.  Both files of each segment are memory-mapped when read,
+ * so the index of an archive of 100M records is paged in by the operating
+ * system as needed rather than held on the heap; only a few words per
+ * segment are.
+ *
+ * A record is written before its index entry, so a record whose append was
+ * interrupted is not in the index and is overwritten by the next append.
+ * If a write fails, append and flush throw after cutting both files back
+ * to the last record appended; should even that fail, later appends throw.
+ *
+ * An archive object is not thread-safe, and that includes reads: reading
+ * a record appended since its segment was mapped flushes and re-maps the
+ * segment, invalidating records located by other threads.  The exception is
+ * parallelForEachRecord and parallelUnseal, which map every segment before
+ * calling their visitors from many threads at once (visitors must not call
+ * the archive themselves).
+ *
+ * @ingroup DerivedFromSeeds
+ */
+class SealedMessageArchive {
+public:
+  /**
+   * @brief Open the archive at path, creating it if it does not exist
+   *
+   * @param path The path prefix of the archive's segment files
+   * @param maxSegmentBytes The size to which a segment's records file may
+   * grow before a new segment is started (a record larger than this is
+   * written to a segment of its own)
+   * @exception FileAccessException Thrown if the files cannot be opened or created.
+   */
+  explicit SealedMessageArchive(
+    const std::string& path,
+    uint64_t maxSegmentBytes = uint64_t(1) << 30
+  );
+
+  ~SealedMessageArchive();
+
+  SealedMessageArchive(const SealedMessageArchive&) = delete;
+  SealedMessageArchive& operator=(const SealedMessageArchive&) = delete;
+
+  /**
+   * @brief Append a message to the archive
+   *
+   * @return uint64_t The message's record number
+   * @exception FileAccessException Thrown if the archive cannot be written.
+   */
+  uint64_t append(const PackagedSealedMessage& packagedSealedMessage);
+
+  /**
+   * @brief Append a record already serialized by
+   * PackagedSealedMessage::toSerializedBinaryForm or toEnvelopeBinaryForm
+   *
+   * @return uint64_t The record's record number
+   * @exception FileAccessException Thrown if the archive cannot be written.
+   */
+  uint64_t appendSerialized(const unsigned char* record, const size_t recordLength);
+
+  /**
+   * @brief Write any buffered appends to the segment files
+   *
+   * @exception FileAccessException Thrown if the archive cannot be written.
+   */
+  void flush();
+
+  /**
+   * @brief The number of records in the archive
+   */
+  uint64_t size() const;
+
+  /**
+   * @brief The number of segments in the archive
+   */
+  size_t getSegmentCount() const { return segments.size(); }
+
+  /**
+   * @brief Locate a record in the memory-mapped archive without copying it
+   *
+   * Not safe to call from several threads at once (see above).
+   *
+   * @param recordNumber The record's number, from 0 to size() - 1
+   * @param record Set to point to the record, which remains valid until
+   * the archive is next appended to or destroyed
+   * @param recordLength Set to the record's length
+   * @exception std::out_of_range Thrown if there is no such record.
+   * @exception std::invalid_argument Thrown if the index is corrupt.
+   */
+  void getRecord(uint64_t recordNumber, const unsigned char*& record, size_t& recordLength);
+
+  /**
+   * @brief Read a message from the archive
+   *
+   * Not safe to call from several threads at once (see above).
+   *
+   * @exception std::out_of_range Thrown if there is no such record.
+   * @exception std::invalid_argument Thrown if the record is malformed.
+   */
+  PackagedSealedMessage read(uint64_t recordNumber);
+
+  /**
+   * @brief Call visit for each record from first to first + count - 1,
+   * on all processor cores, with each record in place in the
+   * memory-mapped archive.
+   *
+   * @param visit Called concurrently from many threads with each record's
+   * number, location, and length
+   */
+  void parallelForEachRecord(
+    const std::function<void(uint64_t recordNumber, const unsigned char* record, size_t recordLength)>& visit,
+    uint64_t first = 0,
+    uint64_t count = UINT64_MAX
+  );
+
+  /**
+   * @brief Unseal each record from first to first + count - 1 with the key
+   * in keyRegistry that matches it (see KeyRegistry::tryUnseal), on all
+   * processor cores.  Records are unsealed in place, without copying their
+   * ciphertexts out of the memory-mapped archive.
+   *
+   * @param visit Called concurrently from many threads with each record's
+   * number and its plaintext, or the reason it could not be unsealed
+   * (ResultStatus::InvalidInput if the record is malformed or no key matches)
+   */
+  void parallelUnseal(
+    const KeyRegistry& keyRegistry,
+    const std::function<void(uint64_t recordNumber, Result<SodiumBuffer>& plaintext)>& visit,
+    uint64_t first = 0,
+    uint64_t count = UINT64_MAX
+  );
+
+private:
+  struct Segment {
+    uint64_t firstRecordNumber;
+    uint64_t recordCount;
+    // The length of the records file up to the end of the last indexed record
+    uint64_t recordsLength;
+    std::unique_ptr<MemoryMappedFile> records;
+    std::unique_ptr<MemoryMappedFile> index;
+    // The number of records covered by the current mappings
+    uint64_t mappedRecordCount;
+  };
+
+  const std::string path;
+  const uint64_t maxSegmentBytes;
+  std::vector<Segment> segments;
+  // The last segment's files, open for appending
+  FILE* recordsFile;
+  FILE* indexFile;
+  // Holds each record serialized by append
+  std::vector<unsigned char> appendBuffer;
+
+  std::string segmentPath(size_t segmentNumber, const char* suffix) const;
+  void openForAppend(size_t segmentNumber);
+  void closeForAppend();
+  void rollBackFailedWrite();
+  Segment& mappedSegmentFor(uint64_t recordNumber);
+  void mapAll();
+};
@@ -0,0 +1,207 @@
+#include <cstring>
+#include <stdexcept>
+#include "sealed-message-envelope.hpp"
+
+DerivationOptionsTable::DerivationOptionsTable(
+  const std::vector<std::string>& derivationOptionsJsonStrings
+) {
+  for (const std::string& derivationOptionsJson : derivationOptionsJsonStrings) {
+    add(derivationOptionsJson);
+  }
+}
+
+uint32_t DerivationOptionsTable::add(const std::string& derivationOptionsJson) {
+  const auto existing = ids.find(derivationOptionsJson);
+  if (existing != ids.end()) {
+    return existing->second;
+  }
+  if (strings.size() >= 0xffffffff) {
+    throw std::length_error("DerivationOptionsTable is full");
+  }
+  const uint32_t id = (uint32_t) strings.size();
+  strings.push_back(derivationOptionsJson);
+  ids[derivationOptionsJson] = id;
+  return id;
+}
+
+bool DerivationOptionsTable::find(const char* derivationOptionsJson, size_t length, uint32_t& id) const {
+  const auto found = ids.find(std::string(derivationOptionsJson, length));
+  if (found == ids.end()) {
+    return false;
+  }
+  id = found->second;
+  return true;
+}
+
+const std::string* DerivationOptionsTable::at(uint64_t id) const {
+  return id < strings.size() ? &strings[(size_t) id] : NULL;
+}
+
+const unsigned char SealedMessageEnvelope::magic[4] = { 0xff, 'S', 'M', 'E' };
+const unsigned char SealedMessageEnvelope::currentVersion;
+const unsigned char SealedMessageEnvelope::derivationOptionsTableIdFlag;
+
+// magic, version, algorithm, and flags
+static const size_t fixedHeaderLength = 7;
+
+bool SealedMessageEnvelope::hasMagic(const unsigned char* data, size_t length) {
+  return length >= sizeof(magic) && memcmp(data, magic, sizeof(magic)) == 0;
+}
+
+size_t SealedMessageEnvelope::varintLength(uint64_t value) {
+  size_t length = 1;
+  while (value >= 0x80) {
+    value >>= 7;
+    length++;
+  }
+  return length;
+}
+
+size_t SealedMessageEnvelope::writeVarint(unsigned char* out, uint64_t value) {
+  size_t length = 0;
+  while (value >= 0x80) {
+    out[length++] = (unsigned char) (value | 0x80);
+    value >>= 7;
+  }
+  out[length++] = (unsigned char) value;
+  return length;
+}
+
+bool SealedMessageEnvelope::readVarint(const unsigned char** position, const unsigned char* end, uint64_t& value) {
+  const unsigned char* readPtr = *position;
+  value = 0;
+  for (unsigned shift = 0; readPtr < end; shift += 7) {
+    const unsigned char byte = *readPtr++;
+    // The tenth byte may only hold the 64th bit
+    if (shift == 63 && byte > 1) {
+      return false;
+    }
+    value |= uint64_t(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      *position = readPtr;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Read a varint length followed by that many bytes
+static bool readLengthPrefixed(
+  const unsigned char** position,
+  const unsigned char* end,
+  const unsigned char*& field,
+  size_t& fieldLength
+) {
+  uint64_t length;
+  if (!SealedMessageEnvelope::readVarint(position, end, length) ||
+      length > uint64_t(end - *position)) {
+    return false;
+  }
+  field = *position;
+  fieldLength = (size_t) length;
+  *position += fieldLength;
+  return true;
+}
+
+bool SealedMessageEnvelope::parse(const unsigned char* data, size_t length, SealedMessageEnvelope& envelope) {
+  if (length < fixedHeaderLength || !hasMagic(data, length)) {
+    return false;
+  }
+  const unsigned char* end = data + length;
+  const unsigned char* readPtr = data + sizeof(magic);
+  envelope.version = *readPtr++;
+  if (envelope.version != currentVersion) {
+    return false;
+  }
+  const unsigned char algorithm = *readPtr++;
+  if (algorithm > (unsigned char) SealingAlgorithm::XSalsa20Poly1305) {
+    return false;
+  }
+  envelope.algorithm = (SealingAlgorithm) algorithm;
+  const unsigned char flags = *readPtr++;
+  if ((flags & ~derivationOptionsTableIdFlag) != 0) {
+    return false;
+  }
+  if (!readLengthPrefixed(&readPtr, end, envelope.keyIdHint, envelope.keyIdHintLength)) {
+    return false;
+  }
+  envelope.hasDerivationOptionsTableId = (flags & derivationOptionsTableIdFlag) != 0;
+  const unsigned char* field;
+  if (envelope.hasDerivationOptionsTableId) {
+    if (!readVarint(&readPtr, end, envelope.derivationOptionsTableId)) {
+      return false;
+    }
+    envelope.derivationOptionsJson = NULL;
+    envelope.derivationOptionsJsonLength = 0;
+  } else {
+    envelope.derivationOptionsTableId = 0;
+    if (!readLengthPrefixed(&readPtr, end, field, envelope.derivationOptionsJsonLength)) {
+      return false;
+    }
+    envelope.derivationOptionsJson = (const char*) field;
+  }
+  if (!readLengthPrefixed(&readPtr, end, field, envelope.unsealingInstructionsLength)) {
+    return false;
+  }
+  envelope.unsealingInstructions = (const char*) field;
+  if (!readLengthPrefixed(&readPtr, end, envelope.ciphertext, envelope.ciphertextLength)) {
+    return false;
+  }
+  // The ciphertext must end the envelope
+  return readPtr == end;
+}
+
+size_t SealedMessageEnvelope::encodedLength(
+  size_t keyIdHintLength,
+  bool hasDerivationOptionsTableId,
+  uint64_t derivationOptionsTableId,
+  size_t derivationOptionsJsonLength,
+  size_t unsealingInstructionsLength,
+  size_t ciphertextLength
+) {
+  return fixedHeaderLength +
+    varintLength(keyIdHintLength) + keyIdHintLength +
+    (hasDerivationOptionsTableId ?
+      varintLength(derivationOptionsTableId) :
+      varintLength(derivationOptionsJsonLength) + derivationOptionsJsonLength) +
+    varintLength(unsealingInstructionsLength) + unsealingInstructionsLength +
+    varintLength(ciphertextLength) + ciphertextLength;
+}
+
+size_t SealedMessageEnvelope::encodedLength() const {
+  return encodedLength(
+    keyIdHintLength,
+    hasDerivationOptionsTableId,
+    derivationOptionsTableId,
+    hasDerivationOptionsTableId ? 0 : derivationOptionsJsonLength,
+    unsealingInstructionsLength,
+    ciphertextLength
+  );
+}
+
+// Write a varint length followed by the field's bytes
+static unsigned char* writeLengthPrefixed(unsigned char* writePtr, const void* field, size_t fieldLength) {
+  writePtr += SealedMessageEnvelope::writeVarint(writePtr, fieldLength);
+  if (fieldLength > 0) {
+    memcpy(writePtr, field, fieldLength);
+  }
+  return writePtr + fieldLength;
+}
+
+size_t SealedMessageEnvelope::writeTo(unsigned char* out) const {
+  unsigned char* writePtr = out;
+  memcpy(writePtr, magic, sizeof(magic));
+  writePtr += sizeof(magic);
+  *writePtr++ = currentVersion;
+  *writePtr++ = (unsigned char) algorithm;
+  *writePtr++ = hasDerivationOptionsTableId ? derivationOptionsTableIdFlag : 0;
+  writePtr = writeLengthPrefixed(writePtr, keyIdHint, keyIdHintLength);
+  if (hasDerivationOptionsTableId) {
+    writePtr += writeVarint(writePtr, derivationOptionsTableId);
+  } else {
+    writePtr = writeLengthPrefixed(writePtr, derivationOptionsJson, derivationOptionsJsonLength);
+  }
+  writePtr = writeLengthPrefixed(writePtr, unsealingInstructions, unsealingInstructionsLength);
+  writePtr = writeLengthPrefixed(writePtr, ciphertext, ciphertextLength);
+  return writePtr - out;
+}
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief The algorithm with which the ciphertext in a SealedMessageEnvelope
+ * was sealed, so that a receiver can dispatch on it without parsing
+ * the derivation options.
+ *
+ * @ingroup BuildingBlocks
+ */
+enum class SealingAlgorithm : unsigned char {
+  /**
+   * @brief The sealer did not record the algorithm
+   */
+  Unspecified = 0,
+  /**
+   * @brief Sealed to a public key (SealingKey) with an X25519 key exchange
+   * and XSalsa20Poly1305, as libsodium's crypto_box_seal with a salt
+   */
+  X25519XSalsa20Poly1305 = 1,
+  /**
+   * @brief Sealed with a SymmetricKey using XSalsa20Poly1305
+   */
+  XSalsa20Poly1305 = 2
+};
+
+/**
+ * @brief A numbering of derivationOptionsJson strings agreed between the
+ * sealer and the receiver, so that an envelope can carry a short ID in
+ * place of a derivation options string that both sides already know.
+ *
+ * IDs are assigned in the order strings are added, starting at 0.
+ * Strings are matched exactly, byte for byte.
+ *
+ * @ingroup BuildingBlocks
+ */
+class DerivationOptionsTable {
+public:
+  DerivationOptionsTable() {}
+
+  /**
+   * @brief Construct with IDs assigned to derivationOptionsJsonStrings in order
+   */
+  explicit DerivationOptionsTable(const std::vector<std::string>& derivationOptionsJsonStrings);
+
+  /**
+   * @brief Add a derivationOptionsJson string, returning its ID
+   * (the existing ID if it was already added)
+   */
+  uint32_t add(const std::string& derivationOptionsJson);
+
+  /**
+   * @brief Find the ID of a derivationOptionsJson string
+   *
+   * @return true, setting id, if the string is in the table
+   */
+  bool find(const char* derivationOptionsJson, size_t length, uint32_t& id) const;
+
+  /**
+   * @brief The derivationOptionsJson string with the given ID,
+   * or NULL if there is no such ID
+   */
+  const std::string* at(uint64_t id) const;
+
+  size_t size() const { return strings.size(); }
+
+private:
+  std::vector<std::string> strings;
+  std::unordered_map<std::string, uint32_t> ids;
+};
+
+/**
+ * @brief A versioned binary envelope for a sealed message, and a
+ * zero-copy view of one.
+ *
+ * The envelope is laid out as:
+ *   - magic (4 bytes): 0xFF 'S' 'M' 'E'
+ *   - version (1 byte): currently 1
+ *   - algorithm (1 byte): a SealingAlgorithm
+ *   - flags (1 byte): bit 0 set if the derivation options are given
+ *     as an ID in a DerivationOptionsTable, rather than as a string
+ *   - key ID hint: a varint length followed by that many bytes
+ *   - derivation options: a varint table ID if flag bit 0 is set,
+ *     otherwise a varint length followed by the UTF8 JSON string
+ *   - unsealingInstructions: a varint length followed by the UTF8 string
+ *   - ciphertext: a varint length followed by the ciphertext, which
+ *     must end the envelope
+ *
+ * Varints are unsigned LEB128: seven bits per byte, least significant
+ * first, with the high bit set on all but the last byte.
+ *
+ * The older format written by PackagedSealedMessage::toSerializedBinaryForm
+ * starts with a 4-byte big-endian ciphertext length, so it could only begin
+ * with the magic bytes if it held a ciphertext of more than 4GB.
+ *
+ * parse reads the envelope in one pass and sets pointers into the
+ * buffer it was given, copying nothing.  The buffer must outlive the view.
+ *
+ * @ingroup BuildingBlocks
+ */
+class SealedMessageEnvelope {
+public:
+  /**
+   * @brief The four bytes every envelope starts with
+   */
+  static const unsigned char magic[4];
+  static const unsigned char currentVersion = 1;
+  static const unsigned char derivationOptionsTableIdFlag = 1;
+
+  unsigned char version = 0;
+  SealingAlgorithm algorithm = SealingAlgorithm::Unspecified;
+  /**
+   * @brief An optional identifier of the key needed to unseal
+   * the message (empty if keyIdHintLength is 0)
+   */
+  const unsigned char* keyIdHint = NULL;
+  size_t keyIdHintLength = 0;
+  /**
+   * @brief true if the derivation options are given by
+   * derivationOptionsTableId rather than by derivationOptionsJson
+   */
+  bool hasDerivationOptionsTableId = false;
+  uint64_t derivationOptionsTableId = 0;
+  const char* derivationOptionsJson = NULL;
+  size_t derivationOptionsJsonLength = 0;
+  const char* unsealingInstructions = NULL;
+  size_t unsealingInstructionsLength = 0;
+  const unsigned char* ciphertext = NULL;
+  size_t ciphertextLength = 0;
+
+  /**
+   * @brief true if data starts with the envelope's magic bytes
+   */
+  static bool hasMagic(const unsigned char* data, size_t length);
+
+  /**
+   * @brief Parse an envelope without copying any of its fields
+   *
+   * @param data The envelope, which must outlive envelope
+   * @param length The length of the envelope in bytes
+   * @param envelope Set to point into data
+   * @return false if data is not a well-formed envelope of a supported version
+   */
+  static bool parse(const unsigned char* data, size_t length, SealedMessageEnvelope& envelope);
+
+  /**
+   * @brief The number of bytes needed to write an envelope with fields
+   * of the given lengths.  Pass a derivationOptionsJsonLength of 0
+   * when writing a table ID.
+   */
+  static size_t encodedLength(
+    size_t keyIdHintLength,
+    bool hasDerivationOptionsTableId,
+    uint64_t derivationOptionsTableId,
+    size_t derivationOptionsJsonLength,
+    size_t unsealingInstructionsLength,
+    size_t ciphertextLength
+  );
+
+  /**
+   * @brief The number of bytes writeTo will write for this view's fields
+   */
+  size_t encodedLength() const;
+
+  /**
+   * @brief Write an envelope holding this view's fields into out,
+   * which must have room for the encodedLength of those fields.
+   * The version written is always currentVersion.
+   *
+   * @return The number of bytes written
+   */
+  size_t writeTo(unsigned char* out) const;
+
+  /**
+   * @brief Write a varint to out (which needs room for up to 10 bytes),
+   * returning the number of bytes written
+   */
+  static size_t writeVarint(unsigned char* out, uint64_t value);
+
+  /**
+   * @brief Read a varint from [*position, end), advancing *position past it
+   *
+   * @return false if the varint is truncated or exceeds 64 bits
+   */
+  static bool readVarint(const unsigned char** position, const unsigned char* end, uint64_t& value);
+
+  /**
+   * @brief The number of bytes writeVarint writes for value
+   */
+  static size_t varintLength(uint64_t value);
+};
@@ -1,29 +1,42 @@
+#include <algorithm>
 #include "github-com-nlohmann-json/json.hpp"
 #include "sealing-key.hpp"
 #include "crypto_box_seal_salted.h"
 #include "convert.hpp"
 #include "lib-seeded.hpp"
 #include "exceptions.hpp"
+#include "work-stealing-pool.hpp"
+#include "x25519-batch.hpp"
 
 namespace SealingKeyJsonFieldName {
   const std::string keyBytes = "keyBytes";
   const std::string derivationOptionsJson = "derivationOptionsJson";
 }
 
+static PublicKeyBytes checkedSealingKeyBytes(const std::vector<unsigned char>& sealingKeyBytes) {
+  if (sealingKeyBytes.size() != crypto_box_PUBLICKEYBYTES) {
+    throw InvalidDerivationOptionValueException("Invalid key size exception");
+  }
+  return PublicKeyBytes(sealingKeyBytes.data());
+}
+
 SealingKey::SealingKey(
     const std::vector<unsigned char> &_sealingKeyBytes,
-    const std::string& _derivationOptionsJson
-  ) : sealingKeyBytes(_sealingKeyBytes), derivationOptionsJson(_derivationOptionsJson) {
-    if (sealingKeyBytes.size() != crypto_box_PUBLICKEYBYTES) {
-      throw InvalidDerivationOptionValueException("Invalid key size exception");
-    }
-  }
+    const InternedString& _derivationOptionsJson
+  ) : sealingKeyBytes(checkedSealingKeyBytes(_sealingKeyBytes)), derivationOptionsJson(_derivationOptionsJson) {}
+
+SealingKey::SealingKey(
+    const PublicKeyBytes &_sealingKeyBytes,
+    const InternedString& _derivationOptionsJson
+  ) : sealingKeyBytes(_sealingKeyBytes), derivationOptionsJson(_derivationOptionsJson) {}
 
 SealingKey SealingKey::fromJson(const std::string& sealingKeyAsJson) {
   try {
     nlohmann::json jsonObject = nlohmann::json::parse(sealingKeyAsJson);
+    const BinaryEncoding binaryEncoding = binaryEncodingFromName(jsonObject.value<std::string>(
+      BinaryEncodingJsonField::binaryEncoding, binaryEncodingName(BinaryEncoding::Hex)));
     return SealingKey(
-      hexStrToByteVector(jsonObject.at(SealingKeyJsonFieldName::keyBytes)),
+      encodedStrToByteVector(jsonObject.at(SealingKeyJsonFieldName::keyBytes), binaryEncoding),
       jsonObject.value(SealingKeyJsonFieldName::derivationOptionsJson, "")
     );
   } catch (nlohmann::json::exception e) {
@@ -31,27 +44,58 @@ SealingKey SealingKey::fromJson(const std::string& sealingKeyAsJson) {
   }
 }
 
+Result<SealingKey> SealingKey::tryFromJson(const std::string& sealingKeyAsJson) {
+  const nlohmann::json jsonObject = nlohmann::json::parse(sealingKeyAsJson, nullptr, false);
+  if (jsonObject.is_discarded() || !jsonObject.is_object()) {
+    return Result<SealingKey>(ResultStatus::InvalidInput);
+  }
+  const auto keyBytesField = jsonObject.find(SealingKeyJsonFieldName::keyBytes);
+  const auto derivationOptionsJsonField = jsonObject.find(SealingKeyJsonFieldName::derivationOptionsJson);
+  const auto binaryEncodingField = jsonObject.find(BinaryEncodingJsonField::binaryEncoding);
+  BinaryEncoding binaryEncoding = BinaryEncoding::Hex;
+  std::vector<unsigned char> keyBytes;
+  if (
+    (binaryEncodingField != jsonObject.end() && !(
+      binaryEncodingField->is_string() &&
+      tryBinaryEncodingFromName(binaryEncodingField->get<std::string>(), binaryEncoding)
+    )) ||
+    keyBytesField == jsonObject.end() || !keyBytesField->is_string() ||
+    !tryEncodedStrToByteVector(keyBytesField->get<std::string>(), binaryEncoding, keyBytes) ||
+    keyBytes.size() != crypto_box_PUBLICKEYBYTES ||
+    (derivationOptionsJsonField != jsonObject.end() && !derivationOptionsJsonField->is_string())
+  ) {
+    return Result<SealingKey>(ResultStatus::InvalidInput);
+  }
+  return Result<SealingKey>(std::unique_ptr<SealingKey>(new SealingKey(
+    keyBytes,
+    derivationOptionsJsonField == jsonObject.end() ? "" : derivationOptionsJsonField->get<std::string>()
+  )));
+}
+
 const std::string SealingKey::toJson(
   int indent,
-  const char indent_char
+  const char indent_char,
+  BinaryEncoding binaryEncoding
 ) const {
 	nlohmann::json asJson;  
-  asJson[SealingKeyJsonFieldName::keyBytes] = toHexStr(sealingKeyBytes);
+  asJson[SealingKeyJsonFieldName::keyBytes] = toEncodedStr(sealingKeyBytes.data(), sealingKeyBytes.size(), binaryEncoding);
   asJson[SealingKeyJsonFieldName::derivationOptionsJson] =
     derivationOptionsJson;
+  if (binaryEncoding != BinaryEncoding::Hex) {
+    asJson[BinaryEncodingJsonField::binaryEncoding] = binaryEncodingName(binaryEncoding);
+  }
   return asJson.dump(indent, indent_char);
 };
 
 
-const std::vector<unsigned char> SealingKey::sealToCiphertextOnly(
+// The static and member forms of sealToCiphertextOnly, once the key is
+// known to be crypto_box_PUBLICKEYBYTES long
+static const std::vector<unsigned char> sealToCiphertextWithKey(
   const unsigned char* message,
   const size_t messageLength,
-  const std::vector<unsigned char> &sealingKeyBytes,
+  const unsigned char* sealingKeyBytes,
   const std::string& unsealingInstructions
 ) {
-  if (sealingKeyBytes.size() != crypto_box_PUBLICKEYBYTES) {
-    throw std::invalid_argument("Invalid key size");
-  }
   if (messageLength <= 0) {
     throw std::invalid_argument("Invalid message length");
   }
@@ -59,11 +103,35 @@ const std::vector<unsigned char> SealingKey::sealToCiphertextOnly(
     messageLength + crypto_box_SEALBYTES;
   std::vector<unsigned char> ciphertext(ciphertextLength);
 
+  // Use a pre-generated ephemeral key pair if a pool has been installed
+  // and has one to spare; otherwise generate one inline.
+  std::shared_ptr<EphemeralKeyPool> pool = EphemeralKeyPool::getDefault();
+  if (pool) {
+    // On the stack rather than in a SodiumBuffer, whose guarded pages would
+    // cost more to allocate than the pool saves; erased after its one use.
+    unsigned char ephemeralPublicKey[crypto_box_PUBLICKEYBYTES];
+    unsigned char ephemeralSecretKey[crypto_box_SECRETKEYBYTES];
+    if (pool->take(ephemeralPublicKey, ephemeralSecretKey)) {
+      crypto_box_salted_seal_with_ephemeral_keypair(
+        ciphertext.data(),
+        message,
+        messageLength,
+        sealingKeyBytes,
+        ephemeralPublicKey,
+        ephemeralSecretKey,
+        unsealingInstructions.c_str(),
+        unsealingInstructions.length()
+      );
+      sodium_memzero(ephemeralSecretKey, sizeof ephemeralSecretKey);
+      return ciphertext;
+    }
+  }
+
   crypto_box_salted_seal(
     ciphertext.data(),
     message,
     messageLength,
-    sealingKeyBytes.data(),
+    sealingKeyBytes,
     unsealingInstructions.c_str(),
     unsealingInstructions.length()
   );
@@ -71,6 +139,18 @@ const std::vector<unsigned char> SealingKey::sealToCiphertextOnly(
   return ciphertext;
 }
 
+const std::vector<unsigned char> SealingKey::sealToCiphertextOnly(
+  const unsigned char* message,
+  const size_t messageLength,
+  const std::vector<unsigned char> &sealingKeyBytes,
+  const std::string& unsealingInstructions
+) {
+  if (sealingKeyBytes.size() != crypto_box_PUBLICKEYBYTES) {
+    throw std::invalid_argument("Invalid key size");
+  }
+  return sealToCiphertextWithKey(message, messageLength, sealingKeyBytes.data(), unsealingInstructions);
+}
+
 const std::vector<unsigned char> SealingKey::sealToCiphertextOnly(
   const SodiumBuffer &message,
   const std::vector<unsigned char> &sealingKeyBytes,
@@ -86,7 +166,7 @@ const std::vector<unsigned char> SealingKey::sealToCiphertextOnly(
   const size_t messageLength,
   const std::string& unsealingInstructions
 ) const {
-  return SealingKey::sealToCiphertextOnly(message, messageLength, sealingKeyBytes, unsealingInstructions);
+  return sealToCiphertextWithKey(message, messageLength, sealingKeyBytes.data(), unsealingInstructions);
 }
 
 const std::vector<unsigned char> SealingKey::sealToCiphertextOnly(
@@ -96,6 +176,46 @@ const std::vector<unsigned char> SealingKey::sealToCiphertextOnly(
   return sealToCiphertextOnly(message.data, message.length, unsealingInstructions);
 }
 
+const std::vector<unsigned char> SealingKey::sealToCiphertextOnly(
+  const std::vector<MessageFragment>& messageFragments,
+  const std::string& unsealingInstructions
+) const {
+  const size_t messageLength = MessageFragment::totalLength(messageFragments.data(), messageFragments.size());
+  if (messageLength <= 0) {
+    throw std::invalid_argument("Invalid message length");
+  }
+  std::vector<unsigned char> ciphertext(messageLength + crypto_box_SEALBYTES);
+  unsigned char ephemeralPublicKey[crypto_box_PUBLICKEYBYTES];
+  unsigned char ephemeralSecretKey[crypto_box_SECRETKEYBYTES];
+  std::shared_ptr<EphemeralKeyPool> pool = EphemeralKeyPool::getDefault();
+  if (!pool || !pool->take(ephemeralPublicKey, ephemeralSecretKey)) {
+    crypto_box_keypair(ephemeralPublicKey, ephemeralSecretKey);
+  }
+  crypto_box_salted_seal_fragments_with_ephemeral_keypair(
+    ciphertext.data(),
+    messageFragments.data(),
+    messageFragments.size(),
+    sealingKeyBytes.data(),
+    ephemeralPublicKey,
+    ephemeralSecretKey,
+    unsealingInstructions.c_str(),
+    unsealingInstructions.length()
+  );
+  sodium_memzero(ephemeralSecretKey, sizeof ephemeralSecretKey);
+  return ciphertext;
+}
+
+const PackagedSealedMessage SealingKey::seal(
+  const std::vector<MessageFragment>& messageFragments,
+  const std::string& unsealingInstructions
+) const {
+  return PackagedSealedMessage(
+    sealToCiphertextOnly(messageFragments, unsealingInstructions),
+    derivationOptionsJson,
+    unsealingInstructions
+  );
+}
+
 const PackagedSealedMessage SealingKey::seal(
   const std::vector<unsigned char>& message,
   const std::string& unsealingInstructions
@@ -137,22 +257,169 @@ const PackagedSealedMessage SealingKey::seal(
     return seal((const unsigned char*) message.c_str(), message.size(), unsealingInstructions);
   }
 
+const PackagedSealedMessage SealingKey::sealWithKeyId(
+  const unsigned char* message,
+  const size_t messageLength,
+  const std::string& unsealingInstructions
+) const {
+  return PackagedSealedMessage(
+    sealToCiphertextOnly(message, messageLength, unsealingInstructions),
+    derivationOptionsJson,
+    unsealingInstructions,
+    getKeyId()
+  );
+}
+
+const PackagedSealedMessage SealingKey::sealWithKeyId(
+  const std::vector<unsigned char>& message,
+  const std::string& unsealingInstructions
+) const {
+  return sealWithKeyId(message.data(), message.size(), unsealingInstructions);
+}
+
+// Messages are sealed in groups so that the X25519 operations for a
+// group can be computed together by boxBeforenmBatch
+static const size_t messagesPerBatchGroup = 8;
+
+std::vector<PackagedSealedMessage> SealingKey::sealBatch(
+  const std::vector<std::vector<unsigned char>>& messages,
+  const std::string& unsealingInstructions
+) const {
+  for (const std::vector<unsigned char>& message : messages) {
+    if (message.size() == 0) {
+      throw std::invalid_argument("Invalid message length");
+    }
+  }
+  std::vector<std::vector<unsigned char>> ciphertexts(messages.size());
+  const size_t groups = (messages.size() + messagesPerBatchGroup - 1) / messagesPerBatchGroup;
+  std::shared_ptr<EphemeralKeyPool> pool = EphemeralKeyPool::getDefault();
+
+  WorkStealingPool::getDefault().parallelFor(groups, [this, &messages, &ciphertexts, &unsealingInstructions, &pool](size_t group) {
+    const size_t first = group * messagesPerBatchGroup;
+    const size_t groupSize = std::min(messages.size(), first + messagesPerBatchGroup) - first;
+    unsigned char ephemeralPublicKeys[messagesPerBatchGroup * crypto_box_PUBLICKEYBYTES];
+    // Value-initialized, since only the first groupSize keys are written
+    unsigned char recipientPublicKeys[messagesPerBatchGroup * crypto_box_PUBLICKEYBYTES] = {};
+    // Secrets are held on the stack and erased below, which is far cheaper
+    // than allocating SodiumBuffers for each group
+    unsigned char ephemeralSecretKeys[messagesPerBatchGroup * crypto_box_SECRETKEYBYTES] = {};
+    unsigned char boxKeys[messagesPerBatchGroup * crypto_box_BEFORENMBYTES];
+    int keyResults[messagesPerBatchGroup];
+    for (size_t i = 0; i < groupSize; i++) {
+      unsigned char* ephemeralPublicKey = ephemeralPublicKeys + i * crypto_box_PUBLICKEYBYTES;
+      unsigned char* ephemeralSecretKey = ephemeralSecretKeys + i * crypto_box_SECRETKEYBYTES;
+      if (!pool || !pool->take(ephemeralPublicKey, ephemeralSecretKey)) {
+        crypto_box_keypair(ephemeralPublicKey, ephemeralSecretKey);
+      }
+      memcpy(recipientPublicKeys + i * crypto_box_PUBLICKEYBYTES, sealingKeyBytes.data(), crypto_box_PUBLICKEYBYTES);
+    }
+    boxBeforenmBatch(boxKeys, recipientPublicKeys, ephemeralSecretKeys, groupSize, keyResults);
+    sodium_memzero(ephemeralSecretKeys, sizeof ephemeralSecretKeys);
+
+    for (size_t i = 0; i < groupSize; i++) {
+      if (keyResults[i] != 0) {
+        sodium_memzero(boxKeys, sizeof boxKeys);
+        throw std::invalid_argument("Invalid sealing key");
+      }
+      const std::vector<unsigned char>& message = messages[first + i];
+      std::vector<unsigned char>& ciphertext = ciphertexts[first + i];
+      ciphertext.resize(message.size() + crypto_box_SEALBYTES);
+      crypto_box_salted_seal_afternm(
+        ciphertext.data(),
+        message.data(),
+        message.size(),
+        sealingKeyBytes.data(),
+        ephemeralPublicKeys + i * crypto_box_PUBLICKEYBYTES,
+        boxKeys + i * crypto_box_BEFORENMBYTES,
+        unsealingInstructions.c_str(),
+        unsealingInstructions.length()
+      );
+    }
+    sodium_memzero(boxKeys, sizeof boxKeys);
+  });
+
+  std::vector<PackagedSealedMessage> sealedMessages;
+  sealedMessages.reserve(messages.size());
+  for (const std::vector<unsigned char>& ciphertext : ciphertexts) {
+    sealedMessages.push_back(PackagedSealedMessage(ciphertext, derivationOptionsJson, unsealingInstructions));
+  }
+  return sealedMessages;
+}
+
 const std::vector<unsigned char> SealingKey::getSealingKeyBytes(
 ) const {
-  return sealingKeyBytes;
+  return sealingKeyBytes.toVector();
+}
+
+// Personalizes the key-identifier hash so that it is never equal to a hash
+// of the same public key computed for any other purpose.
+const size_t SealingKey::keyIdBytes;
+
+static const std::string keyIdHashPrefix = "seeded-crypto:SealingKey:keyId";
+
+static void writeKeyId(
+  const unsigned char* sealingKeyBytes,
+  const size_t sealingKeyBytesLength,
+  unsigned char* keyId
+) {
+  crypto_generichash_state st;
+  crypto_generichash_init(&st, NULL, 0, SealingKey::keyIdBytes);
+  crypto_generichash_update(&st, (const unsigned char*) keyIdHashPrefix.c_str(), keyIdHashPrefix.length());
+  crypto_generichash_update(&st, sealingKeyBytes, sealingKeyBytesLength);
+  crypto_generichash_final(&st, keyId, SealingKey::keyIdBytes);
+}
+
+const std::vector<unsigned char> SealingKey::getKeyId(
+  const std::vector<unsigned char>& sealingKeyBytes
+) {
+  std::vector<unsigned char> keyId(keyIdBytes);
+  writeKeyId(sealingKeyBytes.data(), sealingKeyBytes.size(), keyId.data());
+  return keyId;
+}
+
+void SealingKey::getKeyId(
+  const unsigned char* sealingKeyBytes,
+  unsigned char* keyId
+) {
+  writeKeyId(sealingKeyBytes, crypto_box_PUBLICKEYBYTES, keyId);
+}
+
+const std::vector<unsigned char> SealingKey::getKeyId() const {
+  std::vector<unsigned char> keyId(keyIdBytes);
+  writeKeyId(sealingKeyBytes.data(), sealingKeyBytes.size(), keyId.data());
+  return keyId;
+}
+
+size_t SealingKey::serializedSize() const {
+  return SodiumBuffer::fixedLengthListSize(sealingKeyBytes, derivationOptionsJson);
+}
+
+size_t SealingKey::serializeInto(unsigned char* out, size_t capacity) const {
+  return SodiumBuffer::writeFixedLengthList(out, capacity, sealingKeyBytes, derivationOptionsJson);
 }
 
 const SodiumBuffer SealingKey::toSerializedBinaryForm() const {
-  SodiumBuffer derivationOptionsJsonBuffer = SodiumBuffer(derivationOptionsJson);
-  SodiumBuffer _SealingKeyBytes(sealingKeyBytes);
-  SodiumBuffer _derivationOptionsJson(derivationOptionsJson);
-  return SodiumBuffer::combineFixedLengthList({
-    &_SealingKeyBytes,
-    &_derivationOptionsJson
-  });
+  return SodiumBuffer::combineFixedLengthList(sealingKeyBytes, derivationOptionsJson);
 }
 
 SealingKey SealingKey::fromSerializedBinaryForm(const SodiumBuffer &serializedBinaryForm) {
   const auto fields = serializedBinaryForm.splitFixedLengthList(2);
   return SealingKey(fields[0].toVector(), fields[1].toUtf8String());
 }
+
+Result<SealingKey> SealingKey::tryFromSerializedBinaryForm(const SodiumBuffer &serializedBinaryForm) {
+  const unsigned char* itemData[2];
+  size_t itemLengths[2];
+  if (
+    !SodiumBuffer::locateFixedLengthListItems(
+      serializedBinaryForm.data, serializedBinaryForm.length, 2, itemData, itemLengths
+    ) ||
+    itemLengths[0] != crypto_box_PUBLICKEYBYTES
+  ) {
+    return Result<SealingKey>(ResultStatus::InvalidInput);
+  }
+  return Result<SealingKey>(std::unique_ptr<SealingKey>(new SealingKey(
+    std::vector<unsigned char>(itemData[0], itemData[0] + itemLengths[0]),
+    std::string((const char*) itemData[1], itemLengths[1])
+  )));
+}
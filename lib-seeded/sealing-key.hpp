@@ -4,7 +4,12 @@
 #include <string>
 #include <sodium.h>
 #include "sodium-buffer.hpp"
+#include "fixed-length-bytes.hpp"
+#include "convert.hpp"
+#include "interned-string.hpp"
 #include "packaged-sealed-message.hpp"
+#include "message-fragment.hpp"
+#include "result.hpp"
 
 /**
  * @brief A sealingKeyBytes is used to _seal_ messages, in combination with a
@@ -41,22 +46,40 @@ public:
    * @param sealingKeyAsJson The JSON encoding of a sealingKeyBytes
    */
   static SealingKey fromJson(const std::string& sealingKeyAsJson);
+
+  /**
+   * @brief The non-throwing form of fromJson, for keys received
+   * from untrusted sources.
+   * 
+   * @return Result<SealingKey> The key, or ResultStatus::InvalidInput
+   * if the JSON is malformed or the key bytes are not a valid length.
+   */
+  static Result<SealingKey> tryFromJson(const std::string& sealingKeyAsJson);
   
   /**
-   * @brief The binary representation of the public key used for sealing
+   * @brief The binary representation of the public key used for sealing,
+   * held inline in the key object
    */
-  const std::vector<unsigned char> sealingKeyBytes;
+  const PublicKeyBytes sealingKeyBytes;
   /**
    * @brief A @ref derivation_options_format string used to specify how this key is derived.
    */
-  const std::string derivationOptionsJson;
+  const InternedString derivationOptionsJson;
 
   /**
    * @brief Construct a new Public Key object by passing its members.
    */
   SealingKey(
     const std::vector<unsigned char>& sealingKeyBytes,
-    const std::string& derivationOptionsJson
+    const InternedString& derivationOptionsJson
+  );
+
+  /**
+   * @brief Construct from key bytes already known to be the right length
+   */
+  SealingKey(
+    const PublicKeyBytes& sealingKeyBytes,
+    const InternedString& derivationOptionsJson
   );
 
   /**
@@ -66,11 +89,13 @@ public:
    * 
    * @param indent The number of characters to indent the JSON (optional)
    * @param indent_char The character with which to indent the JSON (optional)
+   * @param binaryEncoding How binary fields are written (optional, hex by default)
    * @return const std::string
    */
   const std::string toJson(
     int indent = -1,
-    const char indent_char = ' '
+    const char indent_char = ' ',
+    BinaryEncoding binaryEncoding = BinaryEncoding::Hex
   ) const;
   
   /**
@@ -151,6 +176,23 @@ public:
     const std::string& unsealingInstructions = {}
   ) const;
 
+  /**
+   * @brief Seal a message held in several fragments, such as a header,
+   * body, and trailer in separate buffers, without concatenating them.
+   * 
+   * The ciphertext is what sealToCiphertextOnly would produce for the
+   * concatenated message with the same ephemeral key pair; as with every
+   * seal, a fresh ephemeral key pair is used each time.
+   * 
+   * @param messageFragments The pieces of the plaintext message, in order
+   * @param unsealingInstructions If this optional string
+   * is passed, the same string must be passed to unseal the message.
+   */
+  const std::vector<unsigned char> sealToCiphertextOnly(
+    const std::vector<MessageFragment>& messageFragments,
+    const std::string& unsealingInstructions = {}
+  ) const;
+
 
   /**
    * @brief Seal a plaintext message and then package the results
@@ -225,6 +267,61 @@ public:
     const std::string& unsealingInstructions
   ) const;
 
+  /**
+   * @brief Seal a message held in several fragments and package the result
+   * as seal does (see the fragment form of sealToCiphertextOnly).
+   */
+  const PackagedSealedMessage seal(
+    const std::vector<MessageFragment>& messageFragments,
+    const std::string& unsealingInstructions = {}
+  ) const;
+
+  /**
+   * @brief Seal a plaintext message as seal does, and include this key's
+   * getKeyId in the PackagedSealedMessage so that a recipient holding
+   * many keys can find the UnsealingKey for it in a KeyRegistry.
+   * 
+   * The key ID reveals which public key the message was sealed to,
+   * so use seal for messages whose recipient should not be identifiable.
+   * 
+   * @param message The plaintext message to seal
+   * @param messageLength The length of the plaintext to seal
+   * @param unsealingInstructions If this optional string is
+   * passed, the same string must be passed to unseal the message.
+   */
+  const PackagedSealedMessage sealWithKeyId(
+    const unsigned char* message,
+    const size_t messageLength,
+    const std::string& unsealingInstructions = {}
+  ) const;
+
+  /**
+   * @brief Seal a plaintext message and include this key's getKeyId
+   * (see the other form of sealWithKeyId).
+   */
+  const PackagedSealedMessage sealWithKeyId(
+    const std::vector<unsigned char>& message,
+    const std::string& unsealingInstructions = {}
+  ) const;
+
+  /**
+   * @brief Seal a batch of messages, each as if by sealToCiphertextOnly,
+   * using all processor cores and computing the X25519 operations
+   * for several messages at once (see x25519Batch).
+   * 
+   * @param messages The plaintext messages to seal
+   * @param unsealingInstructions If this optional string is
+   * passed, the same string must be passed to unseal the messages.
+   * @return std::vector<PackagedSealedMessage> The sealed messages, in the same order
+   * 
+   * @exception std::invalid_argument Thrown if a message is empty or
+   * this SealingKey is not a valid public key.
+   */
+  std::vector<PackagedSealedMessage> sealBatch(
+    const std::vector<std::vector<unsigned char>>& messages,
+    const std::string& unsealingInstructions = {}
+  ) const;
+
   /**
    * @brief Get the copy of the raw public key bytes used by lib-sodium
    * 
@@ -232,6 +329,44 @@ public:
    */
   const std::vector<unsigned char> getSealingKeyBytes() const;
 
+  /**
+   * @brief The raw public key bytes used by lib-sodium, without copying them
+   */
+  const PublicKeyBytes& getSealingKeyByteArray() const { return sealingKeyBytes; }
+
+  /**
+   * @brief The number of bytes in a key identifier (see getKeyId)
+   */
+  static const size_t keyIdBytes = 16;
+
+  /**
+   * @brief Get a short identifier for this key, which recipients can use
+   * to find the parts of a message addressed to them without trying every one.
+   * 
+   * The identifier is a BLAKE2b hash of the public sealing key, so it reveals
+   * nothing that the public key does not.
+   * 
+   * @return const std::vector<unsigned char> of keyIdBytes bytes
+   */
+  const std::vector<unsigned char> getKeyId() const;
+
+  /**
+   * @brief Get the identifier (see getKeyId) of a raw libsodium public key.
+   */
+  static const std::vector<unsigned char> getKeyId(
+    const std::vector<unsigned char>& sealingKeyBytes
+  );
+
+  /**
+   * @brief Write the identifier (see getKeyId) of a raw libsodium public key
+   * of crypto_box_PUBLICKEYBYTES bytes into keyIdBytes bytes at keyId,
+   * without allocating.
+   */
+  static void getKeyId(
+    const unsigned char* sealingKeyBytes,
+    unsigned char* keyId
+  );
+
   /**
    * @brief Get the JSON-formatted derivation options string used to generate
    * the public-private key pair.
@@ -251,6 +386,23 @@ public:
    */
   const SodiumBuffer toSerializedBinaryForm() const;
 
+  /**
+   * @brief The exact number of bytes toSerializedBinaryForm produces
+   */
+  size_t serializedSize() const;
+
+  /**
+   * @brief Write the same bytes as toSerializedBinaryForm (sealingKeyBytes and derivationOptionsJson)
+   * into memory supplied by the caller, without allocating.
+   *
+   * @param out Where to write the serialized form
+   * @param capacity The number of bytes available at out, which must be at
+   * least serializedSize()
+   * @return size_t The number of bytes written
+   * @exception std::invalid_argument Thrown if capacity is too small.
+   */
+  size_t serializeInto(unsigned char* out, size_t capacity) const;
+
   /**
    * @brief Deserialize from a byte array stored as a list of:
    *   (sealingKeyBytes, derivationOptionsJson)
@@ -260,5 +412,13 @@ public:
    */
   static SealingKey fromSerializedBinaryForm(const SodiumBuffer &serializedBinaryForm);
 
+  /**
+   * @brief The non-throwing form of fromSerializedBinaryForm
+   * 
+   * @return Result<SealingKey> The key, or ResultStatus::InvalidInput
+   * if serializedBinaryForm is malformed.
+   */
+  static Result<SealingKey> tryFromSerializedBinaryForm(const SodiumBuffer &serializedBinaryForm);
+
 };
 
@@ -0,0 +1,150 @@
+#include "sealing-session.hpp"
+#include "exceptions.hpp"
+
+static const SodiumBuffer computeSharedKey(
+  const UnsealingKey& localUnsealingKey,
+  const SealingKey& peerSealingKey
+) {
+  SodiumBuffer sharedKey(crypto_box_BEFORENMBYTES);
+  if (crypto_box_beforenm(
+    sharedKey.data,
+    peerSealingKey.sealingKeyBytes.data(),
+    localUnsealingKey.unsealingKeyBytes.data
+  ) != 0) {
+    throw CryptographicVerificationFailureException("Sealing session failed: the peer's sealing key is invalid");
+  }
+  return sharedKey;
+}
+
+const size_t SealingSession::overheadBytes;
+
+SealingSession::SealingSession(
+  const UnsealingKey& localUnsealingKey,
+  const SealingKey& peerSealingKey
+) :
+  localSealingKeyBytes(localUnsealingKey.sealingKeyBytes),
+  peerSealingKeyBytes(peerSealingKey.sealingKeyBytes),
+  peerDerivationOptionsJson(peerSealingKey.derivationOptionsJson),
+  sharedKey(computeSharedKey(localUnsealingKey, peerSealingKey))
+  {}
+
+void SealingSession::deriveNonce(
+  unsigned char* nonce,
+  const std::vector<unsigned char>& senderSealingKeyBytes,
+  const std::vector<unsigned char>& recipientSealingKeyBytes,
+  const unsigned char* message,
+  const size_t messageLength,
+  const std::string& unsealingInstructions
+) const {
+  // Prefix the unsealing instructions with their length so that no
+  // (instructions, message) pair hashes the same as another
+  unsigned char unsealingInstructionsLength[8];
+  unsigned long long length = unsealingInstructions.length();
+  for (size_t i = 0; i < sizeof(unsealingInstructionsLength); i++) {
+    unsealingInstructionsLength[i] = (unsigned char) (length >> (8 * i));
+  }
+  crypto_generichash_state st;
+  crypto_generichash_init(&st, sharedKey.data, sharedKey.length, crypto_box_NONCEBYTES);
+  crypto_generichash_update(&st, senderSealingKeyBytes.data(), senderSealingKeyBytes.size());
+  crypto_generichash_update(&st, recipientSealingKeyBytes.data(), recipientSealingKeyBytes.size());
+  crypto_generichash_update(&st, unsealingInstructionsLength, sizeof(unsealingInstructionsLength));
+  crypto_generichash_update(&st, (const unsigned char*) unsealingInstructions.c_str(), unsealingInstructions.length());
+  crypto_generichash_update(&st, message, messageLength);
+  crypto_generichash_final(&st, nonce, crypto_box_NONCEBYTES);
+}
+
+const std::vector<unsigned char> SealingSession::sealToCiphertextOnly(
+  const unsigned char* message,
+  const size_t messageLength,
+  const std::string& unsealingInstructions
+) const {
+  if (messageLength <= 0) {
+    throw std::invalid_argument("Invalid message length");
+  }
+  std::vector<unsigned char> ciphertext(overheadBytes + messageLength);
+  unsigned char* noncePtr = ciphertext.data();
+  deriveNonce(noncePtr, localSealingKeyBytes, peerSealingKeyBytes, message, messageLength, unsealingInstructions);
+  crypto_box_easy_afternm(
+    noncePtr + crypto_box_NONCEBYTES,
+    message,
+    messageLength,
+    noncePtr,
+    sharedKey.data
+  );
+  return ciphertext;
+}
+
+const std::vector<unsigned char> SealingSession::sealToCiphertextOnly(
+  const SodiumBuffer& message,
+  const std::string& unsealingInstructions
+) const {
+  return sealToCiphertextOnly(message.data, message.length, unsealingInstructions);
+}
+
+const PackagedSealedMessage SealingSession::seal(
+  const unsigned char* message,
+  const size_t messageLength,
+  const std::string& unsealingInstructions
+) const {
+  return PackagedSealedMessage(
+    sealToCiphertextOnly(message, messageLength, unsealingInstructions),
+    peerDerivationOptionsJson,
+    unsealingInstructions
+  );
+}
+
+const PackagedSealedMessage SealingSession::seal(
+  const SodiumBuffer& message,
+  const std::string& unsealingInstructions
+) const {
+  return seal(message.data, message.length, unsealingInstructions);
+}
+
+const PackagedSealedMessage SealingSession::seal(
+  const std::vector<unsigned char>& message,
+  const std::string& unsealingInstructions
+) const {
+  return seal(message.data(), message.size(), unsealingInstructions);
+}
+
+const SodiumBuffer SealingSession::unseal(
+  const unsigned char* ciphertext,
+  const size_t ciphertextLength,
+  const std::string& unsealingInstructions
+) const {
+  if (ciphertextLength <= overheadBytes) {
+    throw CryptographicVerificationFailureException("Sealing session unseal failed: Invalid message length");
+  }
+  const unsigned char* noncePtr = ciphertext;
+  SodiumBuffer plaintext(ciphertextLength - overheadBytes);
+  if (crypto_box_open_easy_afternm(
+    plaintext.data,
+    noncePtr + crypto_box_NONCEBYTES,
+    ciphertextLength - crypto_box_NONCEBYTES,
+    noncePtr,
+    sharedKey.data
+  ) != 0) {
+    throw CryptographicVerificationFailureException("Sealing session unseal failed: the message was not sealed by this session's peer or the ciphertext was modified/corrupted.");
+  }
+  // Ensure the message was sealed by the peer, for this party, with these
+  // unsealing instructions
+  unsigned char expectedNonce[crypto_box_NONCEBYTES];
+  deriveNonce(expectedNonce, peerSealingKeyBytes, localSealingKeyBytes, plaintext.data, plaintext.length, unsealingInstructions);
+  if (sodium_memcmp(expectedNonce, noncePtr, crypto_box_NONCEBYTES) != 0) {
+    throw CryptographicVerificationFailureException("Sealing session unseal failed: the unsealing instructions do not match those used to seal the message, or the message was not sealed by this session's peer.");
+  }
+  return plaintext;
+}
+
+const SodiumBuffer SealingSession::unseal(
+  const std::vector<unsigned char>& ciphertext,
+  const std::string& unsealingInstructions
+) const {
+  return unseal(ciphertext.data(), ciphertext.size(), unsealingInstructions);
+}
+
+const SodiumBuffer SealingSession::unseal(
+  const PackagedSealedMessage& packagedSealedMessage
+) const {
+  return unseal(packagedSealedMessage.ciphertext, packagedSealedMessage.unsealingInstructions);
+}
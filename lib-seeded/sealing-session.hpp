@@ -0,0 +1,203 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "sodium-buffer.hpp"
+#include "sealing-key.hpp"
+#include "unsealing-key.hpp"
+#include "packaged-sealed-message.hpp"
+
+/**
+ * @brief A SealingSession seals and unseals messages exchanged between two
+ * fixed parties, each identified by its UnsealingKey/SealingKey pair,
+ * computing the X25519 shared key between them only once.
+ * 
+ * SealingKey::seal and UnsealingKey::unseal perform an X25519 scalar
+ * multiplication for every message, since each message is sealed with a
+ * new ephemeral key.  When one party sends many messages to the same peer,
+ * a SealingSession instead computes the shared key for the pair once
+ * (crypto_box_beforenm), keeps it in a SodiumBuffer, and seals each message
+ * with crypto_box_easy_afternm.
+ * 
+ * Messages sealed by a session can be unsealed only by the peer's session
+ * (the one constructed from the peer's UnsealingKey and this party's SealingKey),
+ * not by UnsealingKey::unseal.  Unlike SealingKey::seal, they also
+ * authenticate the sender: only the holder of one of the two UnsealingKeys
+ * could have sealed them.
+ * 
+ * The ciphertext format is (nonce, MAC, encrypted message).  As with
+ * SymmetricKey, the nonce is a hash of the message, keyed with the shared
+ * key, that also covers the unsealing instructions and the direction
+ * (which party sealed the message for which).  The nonce is re-derived
+ * and checked when unsealing, so a message is rejected if the unsealing
+ * instructions differ or if it is reflected back to the party that sealed it.
+ * Sealing the same message twice, with the same unsealing instructions, yields
+ * the same ciphertext.
+ * 
+ * @ingroup BuildingBlocks
+ */
+class SealingSession {
+public:
+  /**
+   * @brief The number of bytes a sealed message adds to the length of its plaintext
+   */
+  static const size_t overheadBytes = crypto_box_NONCEBYTES + crypto_box_MACBYTES;
+
+  /**
+   * @brief The public key of this party
+   */
+  const std::vector<unsigned char> localSealingKeyBytes;
+  /**
+   * @brief The public key of the peer
+   */
+  const std::vector<unsigned char> peerSealingKeyBytes;
+  /**
+   * @brief The @ref derivation_options_format string of the peer's SealingKey,
+   * with which messages sealed for the peer are packaged.
+   */
+  const std::string peerDerivationOptionsJson;
+
+  /**
+   * @brief Start a session between the owner of localUnsealingKey
+   * and the owner of peerSealingKey.
+   * 
+   * @param localUnsealingKey This party's key pair
+   * @param peerSealingKey The public key of the party messages will be exchanged with
+   * 
+   * @exception CryptographicVerificationFailureException Thrown if the
+   * peer's key is invalid (e.g. a point of small order).
+   */
+  SealingSession(
+    const UnsealingKey& localUnsealingKey,
+    const SealingKey& peerSealingKey
+  );
+
+  /**
+   * @brief Seal a message for the peer
+   * 
+   * @param message The message to seal
+   * @param messageLength The length of the message
+   * @param unsealingInstructions If this optional string is
+   * passed, the same string must be passed to unseal the message.
+   * @return const std::vector<unsigned char> The sealed message (ciphertext)
+   */
+  const std::vector<unsigned char> sealToCiphertextOnly(
+    const unsigned char* message,
+    const size_t messageLength,
+    const std::string& unsealingInstructions = {}
+  ) const;
+
+  /**
+   * @brief Seal a message for the peer
+   * 
+   * @param message The message to seal
+   * @param unsealingInstructions If this optional string is
+   * passed, the same string must be passed to unseal the message.
+   * @return const std::vector<unsigned char> The sealed message (ciphertext)
+   */
+  const std::vector<unsigned char> sealToCiphertextOnly(
+    const SodiumBuffer& message,
+    const std::string& unsealingInstructions = {}
+  ) const;
+
+  /**
+   * @brief Seal a message for the peer and package it along with
+   * the peer's derivationOptionsJson and the unsealingInstructions.
+   * 
+   * @param message The message to seal
+   * @param messageLength The length of the message
+   * @param unsealingInstructions If this optional string is
+   * passed, the same string must be passed to unseal the message.
+   */
+  const PackagedSealedMessage seal(
+    const unsigned char* message,
+    const size_t messageLength,
+    const std::string& unsealingInstructions = {}
+  ) const;
+
+  /**
+   * @brief Seal a message for the peer and package it along with
+   * the peer's derivationOptionsJson and the unsealingInstructions.
+   * 
+   * @param message The message to seal
+   * @param unsealingInstructions If this optional string is
+   * passed, the same string must be passed to unseal the message.
+   */
+  const PackagedSealedMessage seal(
+    const SodiumBuffer& message,
+    const std::string& unsealingInstructions = {}
+  ) const;
+
+  /**
+   * @brief Seal a message for the peer and package it along with
+   * the peer's derivationOptionsJson and the unsealingInstructions.
+   * 
+   * @param message The message to seal
+   * @param unsealingInstructions If this optional string is
+   * passed, the same string must be passed to unseal the message.
+   */
+  const PackagedSealedMessage seal(
+    const std::vector<unsigned char>& message,
+    const std::string& unsealingInstructions = {}
+  ) const;
+
+  /**
+   * @brief Unseal a message sealed by the peer's session
+   * 
+   * @param ciphertext The sealed message
+   * @param ciphertextLength The length of the sealed message
+   * @param unsealingInstructions The unsealing instructions the message was sealed with
+   * @return const SodiumBuffer The plaintext message
+   * 
+   * @exception CryptographicVerificationFailureException Thrown if the ciphertext
+   * was not sealed by the peer for this party with these unsealing instructions,
+   * or was modified/corrupted.
+   */
+  const SodiumBuffer unseal(
+    const unsigned char* ciphertext,
+    const size_t ciphertextLength,
+    const std::string& unsealingInstructions = {}
+  ) const;
+
+  /**
+   * @brief Unseal a message sealed by the peer's session
+   * 
+   * @param ciphertext The sealed message
+   * @param unsealingInstructions The unsealing instructions the message was sealed with
+   * @return const SodiumBuffer The plaintext message
+   * 
+   * @exception CryptographicVerificationFailureException Thrown if the ciphertext
+   * was not sealed by the peer for this party with these unsealing instructions,
+   * or was modified/corrupted.
+   */
+  const SodiumBuffer unseal(
+    const std::vector<unsigned char>& ciphertext,
+    const std::string& unsealingInstructions = {}
+  ) const;
+
+  /**
+   * @brief Unseal a packaged message sealed by the peer's session
+   * 
+   * @param packagedSealedMessage The message to be unsealed
+   * @return const SodiumBuffer The plaintext message
+   * 
+   * @exception CryptographicVerificationFailureException Thrown if the ciphertext
+   * was not sealed by the peer for this party, or was modified/corrupted.
+   */
+  const SodiumBuffer unseal(
+    const PackagedSealedMessage& packagedSealedMessage
+  ) const;
+
+private:
+  // The output of crypto_box_beforenm for the two parties' keys
+  const SodiumBuffer sharedKey;
+
+  void deriveNonce(
+    unsigned char* nonce,
+    const std::vector<unsigned char>& senderSealingKeyBytes,
+    const std::vector<unsigned char>& recipientSealingKeyBytes,
+    const unsigned char* message,
+    const size_t messageLength,
+    const std::string& unsealingInstructions
+  ) const;
+};
@@ -4,12 +4,12 @@
 
 Secret::Secret(
   const SodiumBuffer& _secretBytes,
-  const std::string& _derivationOptionsJson
+  const InternedString& _derivationOptionsJson
 ) : secretBytes(_secretBytes), derivationOptionsJson(_derivationOptionsJson) {}
 
 Secret::Secret(
   const std::string& seedString,
-  const std::string& _derivationOptionsJson
+  const InternedString& _derivationOptionsJson
 ) : secretBytes(
   DerivationOptions::derivePrimarySecret(
     seedString,
@@ -31,6 +31,19 @@ Secret Secret::deriveFromSeed(
   );
 }
 
+Secret Secret::deriveFromRootSecret(
+  const Secret& rootSecret,
+  const std::string& derivationOptionsJson
+) {
+  return Secret(
+    DerivationOptions::deriveChildSecret(
+      rootSecret.secretBytes,
+      derivationOptionsJson,
+      DerivationOptionsJson::type::Secret
+    ),
+    derivationOptionsJson
+  );
+}
 
 Secret::Secret(const Secret &other) : Secret(other.secretBytes, other.derivationOptionsJson) {}
 
@@ -43,9 +56,10 @@ namespace SecretJsonFields {
 Secret Secret::fromJson(const std::string& secretAsJson) {
   try {
     nlohmann::json jsonObject = nlohmann::json::parse(secretAsJson);
-    auto kdo = jsonObject.value<std::string>(SecretJsonFields::derivationOptionsJson, "");
+    const BinaryEncoding binaryEncoding = binaryEncodingFromName(jsonObject.value<std::string>(
+      BinaryEncodingJsonField::binaryEncoding, binaryEncodingName(BinaryEncoding::Hex)));
     return Secret(
-      SodiumBuffer::fromHexString(jsonObject.at(SecretJsonFields::secretBytes)),
+      encodedStrToSodiumBuffer(jsonObject.at(SecretJsonFields::secretBytes), binaryEncoding),
       jsonObject.value<std::string>(SecretJsonFields::derivationOptionsJson, "")
     );
   } catch (nlohmann::json::exception e) {
@@ -56,23 +70,31 @@ Secret Secret::fromJson(const std::string& secretAsJson) {
 const std::string
 Secret::toJson(
   int indent,
-const char indent_char
+const char indent_char,
+  BinaryEncoding binaryEncoding
 ) const {
   nlohmann::json asJson;
-  asJson[SecretJsonFields::secretBytes] = secretBytes.toHexString();
+  asJson[SecretJsonFields::secretBytes] = toEncodedStr(secretBytes.data, secretBytes.length, binaryEncoding);
   if (derivationOptionsJson.size() > 0) {
     asJson[SecretJsonFields::derivationOptionsJson] = derivationOptionsJson;
   }
+  if (binaryEncoding != BinaryEncoding::Hex) {
+    asJson[BinaryEncodingJsonField::binaryEncoding] = binaryEncodingName(binaryEncoding);
+  }
   return asJson.dump(indent, indent_char);
 }
 
 
+size_t Secret::serializedSize() const {
+  return SodiumBuffer::fixedLengthListSize(secretBytes, derivationOptionsJson);
+}
+
+size_t Secret::serializeInto(unsigned char* out, size_t capacity) const {
+  return SodiumBuffer::writeFixedLengthList(out, capacity, secretBytes, derivationOptionsJson);
+}
+
 const SodiumBuffer Secret::toSerializedBinaryForm() const {
-  SodiumBuffer _derivationOptionsJson(derivationOptionsJson);
-  return SodiumBuffer::combineFixedLengthList({
-    &secretBytes,
-    &_derivationOptionsJson
-  });
+  return SodiumBuffer::combineFixedLengthList(secretBytes, derivationOptionsJson);
 }
 
 Secret Secret::fromSerializedBinaryForm(const SodiumBuffer &serializedBinaryForm) {
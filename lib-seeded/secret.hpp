@@ -1,6 +1,8 @@
 #pragma once
 
 #include "sodium-buffer.hpp"
+#include "convert.hpp"
+#include "interned-string.hpp"
 #include <string>
 
 /**
@@ -27,7 +29,7 @@ public:
    * which specifies how the constructor will derive the
    * secretBytes from the original secret seed.
    */
-  const std::string derivationOptionsJson;
+  const InternedString derivationOptionsJson;
 
   /**
    * @brief Construct this object as a copy of another object
@@ -47,7 +49,7 @@ public:
    */
   Secret(
     const SodiumBuffer& secretBytes,
-    const std::string& derivationOptionsJson = {}
+    const InternedString& derivationOptionsJson = {}
   );
 
   /**
@@ -61,7 +63,7 @@ public:
    */
   Secret(
     const std::string& seedString,
-    const std::string& derivationOptionsJson
+    const InternedString& derivationOptionsJson
   );
 
   /**
@@ -78,6 +80,25 @@ public:
     const std::string& derivationOptionsJson
   );
 
+  /**
+   * @brief Derive a secret as a child of a root Secret, using a fast keyed
+   * BLAKE2b KDF (DerivationOptions::deriveChildSecret) labelled by the
+   * child's derivationOptionsJson, rather than from a seed string.
+   *
+   * Every class derived from seeds has a deriveFromRootSecret method.
+   * Deriving N keys from one seed then costs one run of the (possibly
+   * memory-hard) hash function, to derive the root Secret from the seed,
+   * plus N microseconds, rather than N runs.  The root Secret should
+   * be kept as secret as the seed.
+   *
+   * @param rootSecret The root Secret, which must be 16 to 64 bytes long
+   * @param derivationOptionsJson The derivation options in @ref derivation_options_format.
+   */
+  static Secret deriveFromRootSecret(
+    const Secret& rootSecret,
+    const std::string& derivationOptionsJson
+  );
+
 
   /**
    * @brief Serialize this object to a JSON-formatted string
@@ -86,11 +107,13 @@ public:
    * 
    * @param indent The number of characters to indent the JSON (optional)
    * @param indent_char The character with which to indent the JSON (optional)
+   * @param binaryEncoding How binary fields are written (optional, hex by default)
    * @return const std::string A Secret serialized to JSON format.
    */
   const std::string toJson(
     int indent = -1,
-    const char indent_char = ' '
+    const char indent_char = ' ',
+    BinaryEncoding binaryEncoding = BinaryEncoding::Hex
   ) const;
 
   /**
@@ -102,6 +125,24 @@ public:
    */
   const SodiumBuffer toSerializedBinaryForm() const;
 
+  /**
+   * @brief The exact number of bytes toSerializedBinaryForm produces
+   */
+  size_t serializedSize() const;
+
+  /**
+   * @brief Write the same bytes as toSerializedBinaryForm (secretBytes and derivationOptionsJson)
+   * into memory supplied by the caller, without allocating. The caller is responsible
+   * for erasing that memory, since it will hold the secret.
+   *
+   * @param out Where to write the serialized form
+   * @param capacity The number of bytes available at out, which must be at
+   * least serializedSize()
+   * @return size_t The number of bytes written
+   * @exception std::invalid_argument Thrown if capacity is too small.
+   */
+  size_t serializeInto(unsigned char* out, size_t capacity) const;
+
   /**
    * @brief Deserialize from a byte array stored as a list of:
    *   (secretBytes, derivationOptionsJson)
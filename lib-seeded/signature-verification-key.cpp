@@ -2,6 +2,9 @@
 #include "signature-verification-key.hpp"
 #include "exceptions.hpp"
 #include "convert.hpp"
+#include "work-stealing-pool.hpp"
+#include "prepared-signature-verifier.hpp"
+#include "verification-cache.hpp"
 #include <stdexcept>
 
 namespace SignatureVerificationKeyJsonFieldName {
@@ -9,21 +12,31 @@ namespace SignatureVerificationKeyJsonFieldName {
   const std::string derivationOptionsJson = "derivationOptionsJson";
 }
 
+static PublicKeyBytes checkedVerificationKeyBytes(const std::vector<unsigned char>& verificationKeyBytes) {
+  if (verificationKeyBytes.size() != crypto_sign_PUBLICKEYBYTES) {
+    throw std::invalid_argument("Invalid key size exception");
+  }
+  return PublicKeyBytes(verificationKeyBytes.data());
+}
+
 SignatureVerificationKey::SignatureVerificationKey(
     const std::vector<unsigned char> &_verificationKeyBytes,
-    const std::string& _derivationOptionsJson
-  ) : signatureVerificationKeyBytes(_verificationKeyBytes), derivationOptionsJson(_derivationOptionsJson) {
-    if (signatureVerificationKeyBytes.size() != crypto_sign_PUBLICKEYBYTES) {
-      throw std::invalid_argument("Invalid key size exception");
-    }
-  }
+    const InternedString& _derivationOptionsJson
+  ) : signatureVerificationKeyBytes(checkedVerificationKeyBytes(_verificationKeyBytes)), derivationOptionsJson(_derivationOptionsJson) {}
+
+SignatureVerificationKey::SignatureVerificationKey(
+    const PublicKeyBytes &_verificationKeyBytes,
+    const InternedString& _derivationOptionsJson
+  ) : signatureVerificationKeyBytes(_verificationKeyBytes), derivationOptionsJson(_derivationOptionsJson) {}
 
 SignatureVerificationKey SignatureVerificationKey::fromJson(const std::string& signatureVerificationKeyAsJson) {
   try {
     nlohmann::json jsonObject = nlohmann::json::parse(signatureVerificationKeyAsJson);
+    const BinaryEncoding binaryEncoding = binaryEncodingFromName(jsonObject.value<std::string>(
+      BinaryEncodingJsonField::binaryEncoding, binaryEncodingName(BinaryEncoding::Hex)));
     return SignatureVerificationKey(
-      hexStrToByteVector(jsonObject.value<std::string>(
-        SignatureVerificationKeyJsonFieldName::keyBytes, "")),
+      encodedStrToByteVector(jsonObject.value<std::string>(
+        SignatureVerificationKeyJsonFieldName::keyBytes, ""), binaryEncoding),
       jsonObject.value<std::string>(
         SignatureVerificationKeyJsonFieldName::derivationOptionsJson, "")
     );
@@ -32,30 +45,64 @@ SignatureVerificationKey SignatureVerificationKey::fromJson(const std::string& s
   }
 }
 
+Result<SignatureVerificationKey> SignatureVerificationKey::tryFromJson(
+  const std::string& signatureVerificationKeyAsJson
+) {
+  const nlohmann::json jsonObject = nlohmann::json::parse(signatureVerificationKeyAsJson, nullptr, false);
+  if (jsonObject.is_discarded() || !jsonObject.is_object()) {
+    return Result<SignatureVerificationKey>(ResultStatus::InvalidInput);
+  }
+  const auto keyBytesField = jsonObject.find(SignatureVerificationKeyJsonFieldName::keyBytes);
+  const auto derivationOptionsJsonField = jsonObject.find(SignatureVerificationKeyJsonFieldName::derivationOptionsJson);
+  const auto binaryEncodingField = jsonObject.find(BinaryEncodingJsonField::binaryEncoding);
+  BinaryEncoding binaryEncoding = BinaryEncoding::Hex;
+  std::vector<unsigned char> keyBytes;
+  if (
+    (binaryEncodingField != jsonObject.end() && !(
+      binaryEncodingField->is_string() &&
+      tryBinaryEncodingFromName(binaryEncodingField->get<std::string>(), binaryEncoding)
+    )) ||
+    keyBytesField == jsonObject.end() || !keyBytesField->is_string() ||
+    !tryEncodedStrToByteVector(keyBytesField->get<std::string>(), binaryEncoding, keyBytes) ||
+    keyBytes.size() != crypto_sign_PUBLICKEYBYTES ||
+    (derivationOptionsJsonField != jsonObject.end() && !derivationOptionsJsonField->is_string())
+  ) {
+    return Result<SignatureVerificationKey>(ResultStatus::InvalidInput);
+  }
+  return Result<SignatureVerificationKey>(std::unique_ptr<SignatureVerificationKey>(new SignatureVerificationKey(
+    keyBytes,
+    derivationOptionsJsonField == jsonObject.end() ? "" : derivationOptionsJsonField->get<std::string>()
+  )));
+}
+
 // SignatureVerificationKey::SignatureVerificationKey(const std::string& verificationKeyAsJson) :
 //  SignatureVerificationKey(createFrommJson(verificationKeyAsJson)) {}
 
 
 const std::string SignatureVerificationKey::toJson(
   int indent,
-  const char indent_char
+  const char indent_char,
+  BinaryEncoding binaryEncoding
 ) const {
   nlohmann::json asJson;
   asJson[SignatureVerificationKeyJsonFieldName::keyBytes] =
-    toHexStr(getKeyBytes());
+    toEncodedStr(signatureVerificationKeyBytes.data(), signatureVerificationKeyBytes.size(), binaryEncoding);
   asJson[SignatureVerificationKeyJsonFieldName::derivationOptionsJson] =
     derivationOptionsJson;
+  if (binaryEncoding != BinaryEncoding::Hex) {
+    asJson[BinaryEncodingJsonField::binaryEncoding] = binaryEncodingName(binaryEncoding);
+  }
   return asJson.dump(indent, indent_char);
 }
 
 const std::vector<unsigned char> SignatureVerificationKey::getKeyBytes(
 ) const {
-  return signatureVerificationKeyBytes;
+  return signatureVerificationKeyBytes.toVector();
 }
 
 const std::string SignatureVerificationKey::getKeyBytesAsHexDigits(
 ) const {
-  return toHexStr(signatureVerificationKeyBytes);
+  return toHexStr(signatureVerificationKeyBytes.data(), signatureVerificationKeyBytes.size());
 }
 
 bool SignatureVerificationKey::verify(
@@ -64,9 +111,30 @@ bool SignatureVerificationKey::verify(
   const size_t messageLength,
   const unsigned char* signature
 ) {
+  const std::shared_ptr<const PreparedSignatureVerifier> prepared =
+    PreparedSignatureVerifier::findPrepared(signatureVerificationKey, crypto_sign_PUBLICKEYBYTES);
+  if (prepared) {
+    return prepared->verify(message, messageLength, signature, crypto_sign_BYTES);
+  }
   return crypto_sign_verify_detached(signature, message, messageLength, signatureVerificationKey) == 0;
 }
 
+bool SignatureVerificationKey::verify(
+  const unsigned char* signatureVerificationKey,
+  const MessageFragment* messageFragments,
+  const size_t messageFragmentCount,
+  const unsigned char* signature
+) {
+  const std::shared_ptr<const PreparedSignatureVerifier> prepared =
+    PreparedSignatureVerifier::findPrepared(signatureVerificationKey, crypto_sign_PUBLICKEYBYTES);
+  if (prepared) {
+    return prepared->verify(messageFragments, messageFragmentCount, signature, crypto_sign_BYTES);
+  }
+  return PreparedSignatureVerifier::verifyWithoutPreparing(
+    signatureVerificationKey, messageFragments, messageFragmentCount, signature
+  );
+}
+
 bool SignatureVerificationKey::verify(
   const unsigned char* signatureVerificationKey,
   const size_t signatureVerificationKeyLength,
@@ -81,7 +149,7 @@ bool SignatureVerificationKey::verify(
   if (signatureLength != crypto_sign_BYTES) {
     return false;
   }
-  return crypto_sign_verify_detached(signature, message, messageLength, signatureVerificationKey) == 0;
+  return verify(signatureVerificationKey, message, messageLength, signature);
 }
 
 bool SignatureVerificationKey::verify(
@@ -97,36 +165,199 @@ bool SignatureVerificationKey::verify(
   );
 }
 
+bool SignatureVerificationKey::verifyCorrectLengthSignature(
+  const unsigned char* message,
+  const size_t messageLength,
+  const unsigned char* signature
+) const {
+  const auto verifyUncached = [&]() -> bool {
+    const std::shared_ptr<const PreparedSignatureVerifier> prepared = std::atomic_load(&preparedVerifier);
+    if (prepared) {
+      return prepared->verify(message, messageLength, signature, crypto_sign_BYTES);
+    }
+    return verify(signatureVerificationKeyBytes.data(), message, messageLength, signature);
+  };
+  const std::shared_ptr<VerificationCache> cache = VerificationCache::getDefault();
+  if (!cache) {
+    return verifyUncached();
+  }
+  // Wrapped in a reference so that the std::function the cache takes does
+  // not copy the lambda's captures to the heap
+  return cache->verify(
+    signatureVerificationKeyBytes.data(), signatureVerificationKeyBytes.size(),
+    message, messageLength,
+    signature, crypto_sign_BYTES,
+    std::cref(verifyUncached)
+  );
+}
+
+bool SignatureVerificationKey::verifyCorrectLengthSignature(
+  const MessageFragment* messageFragments,
+  const size_t messageFragmentCount,
+  const unsigned char* signature
+) const {
+  const auto verifyUncached = [&]() -> bool {
+    const std::shared_ptr<const PreparedSignatureVerifier> prepared = std::atomic_load(&preparedVerifier);
+    if (prepared) {
+      return prepared->verify(messageFragments, messageFragmentCount, signature, crypto_sign_BYTES);
+    }
+    return verify(signatureVerificationKeyBytes.data(), messageFragments, messageFragmentCount, signature);
+  };
+  const std::shared_ptr<VerificationCache> cache = VerificationCache::getDefault();
+  if (!cache) {
+    return verifyUncached();
+  }
+  return cache->verify(
+    signatureVerificationKeyBytes.data(), signatureVerificationKeyBytes.size(),
+    messageFragments, messageFragmentCount,
+    signature, crypto_sign_BYTES,
+    std::cref(verifyUncached)
+  );
+}
+
+bool SignatureVerificationKey::verify(
+  const std::vector<MessageFragment>& messageFragments,
+  const std::vector<unsigned char>& signature
+) const {
+  return signature.size() == crypto_sign_BYTES &&
+    verifyCorrectLengthSignature(messageFragments.data(), messageFragments.size(), signature.data());
+}
+
 bool SignatureVerificationKey::verify(
   const unsigned char* message,
   const size_t messageLength,
   const std::vector<unsigned char>& signature
 ) const {
-  return verify(signatureVerificationKeyBytes, message, messageLength, signature);
+  return signature.size() == crypto_sign_BYTES &&
+    verifyCorrectLengthSignature(message, messageLength, signature.data());
+}
+
+bool SignatureVerificationKey::verify(
+  const unsigned char* message,
+  const size_t messageLength,
+  const SignatureBytes& signature
+) const {
+  return verifyCorrectLengthSignature(message, messageLength, signature.data());
+}
+
+bool SignatureVerificationKey::verify(
+  const std::vector<unsigned char>& message,
+  const SignatureBytes& signature
+) const {
+  return verifyCorrectLengthSignature(message.data(), message.size(), signature.data());
+}
+
+bool SignatureVerificationKey::verify(
+  const std::vector<MessageFragment>& messageFragments,
+  const SignatureBytes& signature
+) const {
+  return verifyCorrectLengthSignature(messageFragments.data(), messageFragments.size(), signature.data());
+}
+
+ResultStatus SignatureVerificationKey::tryVerify(
+  const unsigned char* signatureVerificationKey,
+  const size_t signatureVerificationKeyLength,
+  const unsigned char* message,
+  const size_t messageLength,
+  const unsigned char* signature,
+  const size_t signatureLength
+) {
+  if (signatureVerificationKeyLength != crypto_sign_PUBLICKEYBYTES || signatureLength != crypto_sign_BYTES) {
+    return ResultStatus::InvalidInput;
+  }
+  return verify(signatureVerificationKey, message, messageLength, signature) ?
+    ResultStatus::Success : ResultStatus::CryptographicVerificationFailure;
+}
+
+ResultStatus SignatureVerificationKey::tryVerify(
+  const unsigned char* message,
+  const size_t messageLength,
+  const unsigned char* signature,
+  const size_t signatureLength
+) const {
+  if (signatureLength != crypto_sign_BYTES) {
+    return ResultStatus::InvalidInput;
+  }
+  return verifyCorrectLengthSignature(message, messageLength, signature) ?
+    ResultStatus::Success : ResultStatus::CryptographicVerificationFailure;
 }
 
 bool SignatureVerificationKey::verify(
   const std::vector<unsigned char>& message,
   const std::vector<unsigned char>& signature
 ) const {
-  return verify(signatureVerificationKeyBytes, message.data(), message.size(), signature);
+  return verify(message.data(), message.size(), signature);
 }
 
 bool SignatureVerificationKey::verify(
   const SodiumBuffer& message,
   const std::vector<unsigned char>& signature
 ) const {
-  return verify(signatureVerificationKeyBytes, message.data, message.length, signature);
+  return verify(message.data, message.length, signature);
 }
 
+void SignatureVerificationKey::prepareForRepeatedVerification() const {
+  std::atomic_store(&preparedVerifier, PreparedSignatureVerifier::prepare(
+    signatureVerificationKeyBytes.data(), signatureVerificationKeyBytes.size()
+  ));
+}
 
-const SodiumBuffer SignatureVerificationKey::toSerializedBinaryForm() const {
-  SodiumBuffer _signatureVerificationKeyBytes(signatureVerificationKeyBytes);
-  SodiumBuffer _derivationOptionsJson(derivationOptionsJson);
-  return SodiumBuffer::combineFixedLengthList({
-    &_signatureVerificationKeyBytes,
-    &_derivationOptionsJson
+bool SignatureVerificationKey::isPreparedForRepeatedVerification() const {
+  return (bool) std::atomic_load(&preparedVerifier);
+}
+
+std::vector<bool> SignatureVerificationKey::verifyBatch(
+  const BatchVerificationItem* items,
+  const size_t count
+) {
+  // Verify into bytes, as threads cannot safely write to
+  // neighboring elements of a std::vector<bool>
+  std::vector<unsigned char> valid(count, 0);
+  WorkStealingPool::getDefault().parallelFor(count, [items, &valid](size_t index) {
+    const BatchVerificationItem& item = items[index];
+    valid[index] =
+      item.signatureVerificationKeyBytesLength == crypto_sign_PUBLICKEYBYTES &&
+      item.signatureLength == crypto_sign_BYTES &&
+      verify(item.signatureVerificationKeyBytes, item.message, item.messageLength, item.signature);
   });
+  return std::vector<bool>(valid.begin(), valid.end());
+}
+
+std::vector<bool> SignatureVerificationKey::verifyBatch(
+  const std::vector<BatchVerificationItem>& items
+) {
+  return verifyBatch(items.data(), items.size());
+}
+
+std::vector<bool> SignatureVerificationKey::verifyBatch(
+  const std::vector<std::vector<unsigned char>>& messages,
+  const std::vector<std::vector<unsigned char>>& signatures
+) const {
+  if (messages.size() != signatures.size()) {
+    throw std::invalid_argument("The number of messages and signatures must be equal");
+  }
+  std::vector<BatchVerificationItem> items(messages.size());
+  for (size_t i = 0; i < messages.size(); i++) {
+    items[i].signatureVerificationKeyBytes = signatureVerificationKeyBytes.data();
+    items[i].signatureVerificationKeyBytesLength = signatureVerificationKeyBytes.size();
+    items[i].message = messages[i].data();
+    items[i].messageLength = messages[i].size();
+    items[i].signature = signatures[i].data();
+    items[i].signatureLength = signatures[i].size();
+  }
+  return verifyBatch(items);
+}
+
+size_t SignatureVerificationKey::serializedSize() const {
+  return SodiumBuffer::fixedLengthListSize(signatureVerificationKeyBytes, derivationOptionsJson);
+}
+
+size_t SignatureVerificationKey::serializeInto(unsigned char* out, size_t capacity) const {
+  return SodiumBuffer::writeFixedLengthList(out, capacity, signatureVerificationKeyBytes, derivationOptionsJson);
+}
+
+const SodiumBuffer SignatureVerificationKey::toSerializedBinaryForm() const {
+  return SodiumBuffer::combineFixedLengthList(signatureVerificationKeyBytes, derivationOptionsJson);
 }
 
 SignatureVerificationKey SignatureVerificationKey::fromSerializedBinaryForm(
@@ -137,3 +368,22 @@ SignatureVerificationKey SignatureVerificationKey::fromSerializedBinaryForm(
     fields[0].toVector(), fields[1].toUtf8String()
   );
 }
+
+Result<SignatureVerificationKey> SignatureVerificationKey::tryFromSerializedBinaryForm(
+  const SodiumBuffer &serializedBinaryForm
+) {
+  const unsigned char* itemData[2];
+  size_t itemLengths[2];
+  if (
+    !SodiumBuffer::locateFixedLengthListItems(
+      serializedBinaryForm.data, serializedBinaryForm.length, 2, itemData, itemLengths
+    ) ||
+    itemLengths[0] != crypto_sign_PUBLICKEYBYTES
+  ) {
+    return Result<SignatureVerificationKey>(ResultStatus::InvalidInput);
+  }
+  return Result<SignatureVerificationKey>(std::unique_ptr<SignatureVerificationKey>(new SignatureVerificationKey(
+    std::vector<unsigned char>(itemData[0], itemData[0] + itemLengths[0]),
+    std::string((const char*) itemData[1], itemLengths[1])
+  )));
+}
@@ -2,10 +2,17 @@
 
 #include <cassert>
 #include <sodium.h>
+#include <memory>
 #include <vector>
 #include <string>
 
 #include "sodium-buffer.hpp"
+#include "fixed-length-bytes.hpp"
+#include "convert.hpp"
+#include "interned-string.hpp"
+#include "message-fragment.hpp"
+#include "prepared-signature-verifier.hpp"
+#include "result.hpp"
 
 /**
  * @brief A SignatureVerificationKey is used to verify that messages were
@@ -27,11 +34,21 @@ public:
   /**
    * @brief The raw binary representation of the cryptographic key
    */
-  const std::vector<unsigned char> signatureVerificationKeyBytes;
+  const PublicKeyBytes signatureVerificationKeyBytes;
   /**
    * @brief A @ref derivation_options_format string used to specify how this key is derived.
    */
-  const std::string derivationOptionsJson;
+  const InternedString derivationOptionsJson;
+
+private:
+  /**
+   * @brief Set by prepareForRepeatedVerification.  Accessed with
+   * std::atomic_load/atomic_store so that a key can be prepared while
+   * other threads are verifying with it.
+   */
+  mutable std::shared_ptr<const PreparedSignatureVerifier> preparedVerifier;
+
+public:
  
   /**
   * @brief Construct by passing the classes members
@@ -41,7 +58,15 @@ public:
   */
   SignatureVerificationKey(
     const std::vector<unsigned char> &keyBytes,
-    const std::string& derivationOptionsJson
+    const InternedString& derivationOptionsJson
+  );
+
+  /**
+   * @brief Construct from key bytes already known to be the right length
+   */
+  SignatureVerificationKey(
+    const PublicKeyBytes &keyBytes,
+    const InternedString& derivationOptionsJson
   );
 
   /**
@@ -54,6 +79,17 @@ public:
     const std::string& signatureVerificationKeyAsJson
   );
 
+  /**
+   * @brief The non-throwing form of fromJson, for keys received
+   * from untrusted sources.
+   * 
+   * @return Result<SignatureVerificationKey> The key, or ResultStatus::InvalidInput
+   * if the JSON is malformed or the key bytes are not a valid length.
+   */
+  static Result<SignatureVerificationKey> tryFromJson(
+    const std::string& signatureVerificationKeyAsJson
+  );
+
   /**
    * @brief Serialize this object to a JSON-formatted string
    * 
@@ -61,11 +97,13 @@ public:
    * 
    * @param indent The number of characters to indent the JSON (optional)
    * @param indent_char The character with which to indent the JSON (optional)
+   * @param binaryEncoding How binary fields are written (optional, hex by default)
    * @return const std::string
    */
   const std::string toJson(
     int indent = -1,
-    const char indent_char = ' '
+    const char indent_char = ' ',
+    BinaryEncoding binaryEncoding = BinaryEncoding::Hex
   ) const;
 
 /**
@@ -84,6 +122,13 @@ private:
     const unsigned char* signature
   );
 
+  static bool verify(
+    const unsigned char* signatureVerificationKeyBytes,
+    const MessageFragment* messageFragments,
+    const size_t messageFragmentCount,
+    const unsigned char* signature
+  );
+
 public:
   /**
    * @brief *Avoid Using* Verify a message's signature using a
@@ -147,6 +192,10 @@ public:
    * @return true if the signature is valid indicating the message was indeed
    * signed by the corresponding SigningKey
    * @return false if the verification fails.
+   *
+   * If a VerificationCache has been installed with VerificationCache::setDefault,
+   * this and the other non-static verify methods consult it first and record
+   * successful verifications in it.
    */
   bool verify(
     const unsigned char* message,
@@ -188,6 +237,172 @@ public:
     const std::vector<unsigned char>& signature
   ) const;
 
+  /**
+   * @brief Verify a signature of a message held in several fragments,
+   * without concatenating them.  A signature is accepted if and only if it
+   * would be accepted for the fragments concatenated.
+   * 
+   * @param messageFragments The pieces of the signed message, in order
+   * @param signature The signature generated by SigningKey::generateSignature
+   */
+  bool verify(
+    const std::vector<MessageFragment>& messageFragments,
+    const std::vector<unsigned char>& signature
+  ) const;
+
+  /**
+   * @brief Verify a signature held in a SignatureBytes, as returned by
+   * SigningKey::generateSignatureBytes.  Since the signature's length is
+   * fixed, this and the other SignatureBytes forms of verify do not
+   * allocate (unless a VerificationCache records a new entry).
+   */
+  bool verify(
+    const unsigned char* message,
+    const size_t messageLength,
+    const SignatureBytes& signature
+  ) const;
+
+  bool verify(
+    const std::vector<unsigned char>& message,
+    const SignatureBytes& signature
+  ) const;
+
+  bool verify(
+    const std::vector<MessageFragment>& messageFragments,
+    const SignatureBytes& signature
+  ) const;
+
+  /**
+   * @brief Verify a signature, reporting why verification failed
+   * without ever throwing.
+   * 
+   * @param signatureVerificationKey The raw signature-verification key
+   * @param signatureVerificationKeyLength Its length
+   * @param message The message to verify the signature of
+   * @param messageLength The length of the message
+   * @param signature The signature to verify
+   * @param signatureLength The length of the signature
+   * @return ResultStatus::Success if the signature is valid,
+   * ResultStatus::InvalidInput if the key or signature is not of a valid length, or
+   * ResultStatus::CryptographicVerificationFailure if the signature is not valid.
+   */
+  static ResultStatus tryVerify(
+    const unsigned char* signatureVerificationKey,
+    const size_t signatureVerificationKeyLength,
+    const unsigned char* message,
+    const size_t messageLength,
+    const unsigned char* signature,
+    const size_t signatureLength
+  );
+
+  /**
+   * @brief Verify a signature with this key, reporting why verification
+   * failed without ever throwing.  Like verify, it uses the prepared form
+   * of this key and the default VerificationCache if either is available.
+   * 
+   * @return ResultStatus::Success if the signature is valid,
+   * ResultStatus::InvalidInput if the signature is not of a valid length, or
+   * ResultStatus::CryptographicVerificationFailure if the signature is not valid.
+   */
+  ResultStatus tryVerify(
+    const unsigned char* message,
+    const size_t messageLength,
+    const unsigned char* signature,
+    const size_t signatureLength
+  ) const;
+
+  /**
+   * @brief One (signature-verification key, message, signature) triple
+   * to be checked by verifyBatch.  The pointers must remain valid
+   * until verifyBatch returns.
+   */
+  struct BatchVerificationItem {
+    /**
+     * @brief The raw libsodium signature-verification key
+     */
+    const unsigned char* signatureVerificationKeyBytes;
+    /**
+     * @brief The length of the key, which must be crypto_sign_PUBLICKEYBYTES
+     */
+    size_t signatureVerificationKeyBytesLength;
+    /**
+     * @brief The message that was signed
+     */
+    const unsigned char* message;
+    /**
+     * @brief The length of the message
+     */
+    size_t messageLength;
+    /**
+     * @brief The signature
+     */
+    const unsigned char* signature;
+    /**
+     * @brief The length of the signature
+     */
+    size_t signatureLength;
+  };
+
+  /**
+   * @brief Verify a batch of signatures, by one or more keys, in parallel
+   * on all processor cores.
+   * 
+   * Each signature is accepted if and only if the single-signature verify
+   * method would accept it, and the result for each signature is reported
+   * individually so that invalid signatures can be identified.
+   * Rather than throwing an exception, an item with a key of invalid
+   * length is reported as invalid.
+   * 
+   * @param items The (key, message, signature) triples to verify
+   * @param count The number of items
+   * @return std::vector<bool> true for each item with a valid signature
+   */
+  static std::vector<bool> verifyBatch(
+    const BatchVerificationItem* items,
+    const size_t count
+  );
+
+  /**
+   * @brief Verify a batch of signatures by one or more keys, in parallel
+   * on all processor cores (see the pointer-and-count overload).
+   */
+  static std::vector<bool> verifyBatch(
+    const std::vector<BatchVerificationItem>& items
+  );
+
+  /**
+   * @brief Verify a batch of signatures made with the SigningKey
+   * that corresponds to this key, in parallel on all processor cores.
+   * 
+   * @param messages The messages that were signed
+   * @param signatures The signature of each message (in the same order)
+   * @return std::vector<bool> true for each message with a valid signature
+   * 
+   * @exception std::invalid_argument Thrown if the number of messages
+   * and signatures differ.
+   */
+  std::vector<bool> verifyBatch(
+    const std::vector<std::vector<unsigned char>>& messages,
+    const std::vector<std::vector<unsigned char>>& signatures
+  ) const;
+
+  /**
+   * @brief Prepare this key for verifying many signatures, by decompressing
+   * it and precomputing a table of its multiples (see PreparedSignatureVerifier).
+   * 
+   * This costs roughly as much as a few hundred verifications and about 30KB
+   * of memory, and makes each subsequent verification by this key (and by
+   * copies of it, and by the static verify methods given the same key bytes)
+   * substantially faster.  It does not change which signatures are accepted.
+   */
+  void prepareForRepeatedVerification() const;
+
+  /**
+   * @brief true if prepareForRepeatedVerification has been called on this
+   * key (or the key it was copied from)
+   */
+  bool isPreparedForRepeatedVerification() const;
+
   /**
    * @brief Get the raw signature verification key as a byte vector.
    * 
@@ -195,6 +410,11 @@ public:
    */
   const std::vector<unsigned char> getKeyBytes() const;
 
+  /**
+   * @brief The raw signature verification key, without copying it
+   */
+  const PublicKeyBytes& getKeyByteArray() const { return signatureVerificationKeyBytes; }
+
   /**
    * @brief Get the raw signature-verification key as a string of hex digits
    *
@@ -221,6 +441,23 @@ public:
    */
   const SodiumBuffer toSerializedBinaryForm() const;
 
+  /**
+   * @brief The exact number of bytes toSerializedBinaryForm produces
+   */
+  size_t serializedSize() const;
+
+  /**
+   * @brief Write the same bytes as toSerializedBinaryForm (signatureVerificationKeyBytes and derivationOptionsJson)
+   * into memory supplied by the caller, without allocating.
+   *
+   * @param out Where to write the serialized form
+   * @param capacity The number of bytes available at out, which must be at
+   * least serializedSize()
+   * @return size_t The number of bytes written
+   * @exception std::invalid_argument Thrown if capacity is too small.
+   */
+  size_t serializeInto(unsigned char* out, size_t capacity) const;
+
   /**
    * @brief Deserialize from a byte array stored as a list of:
    *   (signatureVerificationKeyBytes, derivationOptionsJson)
@@ -230,5 +467,28 @@ public:
    */
   static SignatureVerificationKey fromSerializedBinaryForm(const SodiumBuffer &serializedBinaryForm);
 
+  /**
+   * @brief The non-throwing form of fromSerializedBinaryForm
+   * 
+   * @return Result<SignatureVerificationKey> The key, or
+   * ResultStatus::InvalidInput if serializedBinaryForm is malformed.
+   */
+  static Result<SignatureVerificationKey> tryFromSerializedBinaryForm(const SodiumBuffer &serializedBinaryForm);
+
+private:
+  // Verify a signature of crypto_sign_BYTES with this key, consulting
+  // the prepared key and the default VerificationCache
+  bool verifyCorrectLengthSignature(
+    const unsigned char* message,
+    const size_t messageLength,
+    const unsigned char* signature
+  ) const;
+
+  bool verifyCorrectLengthSignature(
+    const MessageFragment* messageFragments,
+    const size_t messageFragmentCount,
+    const unsigned char* signature
+  ) const;
+
 };
 
@@ -0,0 +1,165 @@
+#include "github-com-nlohmann-json/json.hpp"
+#include "signing-and-unsealing-key.hpp"
+#include "derivation-options.hpp"
+#include "exceptions.hpp"
+
+SigningAndUnsealingKey::SigningAndUnsealingKey(
+  const SodiumBuffer& _signingKeyBytes,
+  const InternedString& _derivationOptionsJson
+) :
+  signingKeyBytes(_signingKeyBytes),
+  signatureVerificationKeyBytes(signatureVerificationKeyFrom(_signingKeyBytes)),
+  unsealingKeyBytes(unsealingKeyFrom(_signingKeyBytes)),
+  sealingKeyBytes(sealingKeyFrom(signatureVerificationKeyBytes)),
+  derivationOptionsJson(_derivationOptionsJson)
+  {}
+
+SigningAndUnsealingKey::SigningAndUnsealingKey(
+  const std::string& _seedString,
+  const InternedString& _derivationOptionsJson
+) : SigningAndUnsealingKey(deriveFromSeed(_seedString, _derivationOptionsJson)) {}
+
+SigningAndUnsealingKey::SigningAndUnsealingKey(
+  const SigningAndUnsealingKey& other
+) :
+  signingKeyBytes(other.signingKeyBytes),
+  signatureVerificationKeyBytes(other.signatureVerificationKeyBytes),
+  unsealingKeyBytes(other.unsealingKeyBytes),
+  sealingKeyBytes(other.sealingKeyBytes),
+  derivationOptionsJson(other.derivationOptionsJson)
+  {}
+
+SigningAndUnsealingKey SigningAndUnsealingKey::deriveFromSeed(
+  const std::string& seedString,
+  const std::string& derivationOptionsJson
+) {
+  // A single run of the (possibly memory-hard) derivation hash function
+  const SodiumBuffer seed = DerivationOptions::derivePrimarySecret(
+    seedString,
+    derivationOptionsJson,
+    DerivationOptionsJson::type::SigningAndUnsealingKey,
+    crypto_sign_SEEDBYTES
+  );
+  return SigningAndUnsealingKey(SigningKey::signingKeyBytesFromSeed(seed), derivationOptionsJson);
+}
+
+SigningAndUnsealingKey SigningAndUnsealingKey::deriveFromRootSecret(
+  const Secret& rootSecret,
+  const std::string& derivationOptionsJson
+) {
+  const SodiumBuffer seed = DerivationOptions::deriveChildSecret(
+    rootSecret.secretBytes,
+    derivationOptionsJson,
+    DerivationOptionsJson::type::SigningAndUnsealingKey,
+    crypto_sign_SEEDBYTES
+  );
+  return SigningAndUnsealingKey(SigningKey::signingKeyBytesFromSeed(seed), derivationOptionsJson);
+}
+
+std::vector<unsigned char> SigningAndUnsealingKey::signatureVerificationKeyFrom(
+  const SodiumBuffer& signingKeyBytes
+) {
+  if (signingKeyBytes.length != crypto_sign_SECRETKEYBYTES) {
+    throw KeyLengthException("Invalid signing key size");
+  }
+  std::vector<unsigned char> signatureVerificationKeyBytes(crypto_sign_PUBLICKEYBYTES);
+  crypto_sign_ed25519_sk_to_pk(signatureVerificationKeyBytes.data(), signingKeyBytes.data);
+  return signatureVerificationKeyBytes;
+}
+
+SodiumBuffer SigningAndUnsealingKey::unsealingKeyFrom(
+  const SodiumBuffer& signingKeyBytes
+) {
+  SodiumBuffer unsealingKeyBytes(crypto_box_SECRETKEYBYTES);
+  crypto_sign_ed25519_sk_to_curve25519(unsealingKeyBytes.data, signingKeyBytes.data);
+  return unsealingKeyBytes;
+}
+
+std::vector<unsigned char> SigningAndUnsealingKey::sealingKeyFrom(
+  const std::vector<unsigned char>& signatureVerificationKeyBytes
+) {
+  std::vector<unsigned char> sealingKeyBytes(crypto_box_PUBLICKEYBYTES);
+  if (crypto_sign_ed25519_pk_to_curve25519(sealingKeyBytes.data(), signatureVerificationKeyBytes.data()) != 0) {
+    throw InvalidDerivationOptionValueException("Signing key cannot be converted to an X25519 key");
+  }
+  return sealingKeyBytes;
+}
+
+const SigningKey SigningAndUnsealingKey::getSigningKey() const {
+  return SigningKey(signingKeyBytes, signatureVerificationKeyBytes, derivationOptionsJson);
+}
+
+const SignatureVerificationKey SigningAndUnsealingKey::getSignatureVerificationKey() const {
+  return SignatureVerificationKey(signatureVerificationKeyBytes, derivationOptionsJson);
+}
+
+const UnsealingKey SigningAndUnsealingKey::getUnsealingKey() const {
+  return UnsealingKey(unsealingKeyBytes, sealingKeyBytes, derivationOptionsJson);
+}
+
+const SealingKey SigningAndUnsealingKey::getSealingKey() const {
+  return SealingKey(sealingKeyBytes, derivationOptionsJson);
+}
+
+const SodiumBuffer SigningAndUnsealingKey::unseal(
+  const PackagedSealedMessage &packagedSealedMessage,
+  const std::string& seedString
+) {
+  return deriveFromSeed(seedString, packagedSealedMessage.derivationOptionsJson)
+    .getUnsealingKey()
+    .unseal(packagedSealedMessage.ciphertext, packagedSealedMessage.unsealingInstructions);
+}
+
+namespace SigningAndUnsealingKeyJsonField {
+  const std::string signingKeyBytes = "signingKeyBytes";
+  const std::string derivationOptionsJson = "derivationOptionsJson";
+}
+
+SigningAndUnsealingKey SigningAndUnsealingKey::fromJson(
+  const std::string& signingAndUnsealingKeyAsJson
+) {
+  try {
+    nlohmann::json jsonObject = nlohmann::json::parse(signingAndUnsealingKeyAsJson);
+    const BinaryEncoding binaryEncoding = binaryEncodingFromName(jsonObject.value<std::string>(
+      BinaryEncodingJsonField::binaryEncoding, binaryEncodingName(BinaryEncoding::Hex)));
+    return SigningAndUnsealingKey(
+      encodedStrToSodiumBuffer(jsonObject.at(SigningAndUnsealingKeyJsonField::signingKeyBytes), binaryEncoding),
+      jsonObject.value(SigningAndUnsealingKeyJsonField::derivationOptionsJson, "")
+    );
+  } catch (const nlohmann::json::exception& e) {
+    throw JsonParsingException(e.what());
+  }
+}
+
+const std::string SigningAndUnsealingKey::toJson(
+  int indent,
+  const char indent_char,
+  BinaryEncoding binaryEncoding
+) const {
+  nlohmann::json asJson;
+  asJson[SigningAndUnsealingKeyJsonField::signingKeyBytes] = toEncodedStr(signingKeyBytes.data, signingKeyBytes.length, binaryEncoding);
+  asJson[SigningAndUnsealingKeyJsonField::derivationOptionsJson] = derivationOptionsJson;
+  if (binaryEncoding != BinaryEncoding::Hex) {
+    asJson[BinaryEncodingJsonField::binaryEncoding] = binaryEncodingName(binaryEncoding);
+  }
+  return asJson.dump(indent, indent_char);
+}
+
+size_t SigningAndUnsealingKey::serializedSize() const {
+  return SodiumBuffer::fixedLengthListSize(signingKeyBytes, derivationOptionsJson);
+}
+
+size_t SigningAndUnsealingKey::serializeInto(unsigned char* out, size_t capacity) const {
+  return SodiumBuffer::writeFixedLengthList(out, capacity, signingKeyBytes, derivationOptionsJson);
+}
+
+const SodiumBuffer SigningAndUnsealingKey::toSerializedBinaryForm() const {
+  return SodiumBuffer::combineFixedLengthList(signingKeyBytes, derivationOptionsJson);
+}
+
+SigningAndUnsealingKey SigningAndUnsealingKey::fromSerializedBinaryForm(
+  const SodiumBuffer &serializedBinaryForm
+) {
+  const auto fields = serializedBinaryForm.splitFixedLengthList(2);
+  return SigningAndUnsealingKey(fields[0], fields[1].toUtf8String());
+}
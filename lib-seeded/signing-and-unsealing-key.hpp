@@ -0,0 +1,215 @@
+#pragma once
+
+#include "sodium-buffer.hpp"
+#include "convert.hpp"
+#include "signing-key.hpp"
+#include "unsealing-key.hpp"
+
+/**
+ * @brief A SigningAndUnsealingKey is a single identity that can both sign
+ * messages (as a SigningKey) and unseal messages sealed to it (as an
+ * UnsealingKey), derived from a seed with one run of the derivation hash
+ * function rather than two.
+ *
+ * The derived secret is the seed of an Ed25519 signing key pair, exactly as
+ * for a SigningKey.  The X25519 unsealing key pair is then converted from
+ * the Ed25519 pair with libsodium's `crypto_sign_ed25519_sk_to_curve25519`
+ * and `crypto_sign_ed25519_pk_to_curve25519`, so that the SealingKey can
+ * be computed by anyone holding the SignatureVerificationKey.
+ *
+ * It is selected by `"type": "SigningAndUnsealingKey"` in the
+ * @ref derivation_options_format.  Since that type is part of the hash
+ * preimage, the keys differ from those of a SigningKey or UnsealingKey
+ * derived from the same seed and options.
+ *
+ * @ingroup DerivedFromSeeds
+ */
+class SigningAndUnsealingKey {
+public:
+  /**
+   * @brief The libsodium Ed25519 secret key used for signing
+   */
+  const SodiumBuffer signingKeyBytes;
+  /**
+   * @brief The libsodium Ed25519 public key used to verify signatures
+   */
+  const std::vector<unsigned char> signatureVerificationKeyBytes;
+  /**
+   * @brief The libsodium X25519 private key used for unsealing
+   */
+  const SodiumBuffer unsealingKeyBytes;
+  /**
+   * @brief The libsodium X25519 public key used for sealing
+   */
+  const std::vector<unsigned char> sealingKeyBytes;
+  /**
+   * @brief A @ref derivation_options_format string used to specify how this key is derived.
+   */
+  const InternedString derivationOptionsJson;
+
+  /**
+   * @brief Construct from an Ed25519 signing key, re-generating the
+   * signature-verification key and the X25519 key pair from it.
+   */
+  SigningAndUnsealingKey(
+    const SodiumBuffer& signingKeyBytes,
+    const InternedString& derivationOptionsJson
+  );
+
+  /**
+   * @brief Construct by deriving the key pairs from a seed string and a
+   * set of derivation options in @ref derivation_options_format.
+   *
+   * @param seedString The private seed which is used to generate the key pairs.
+   * Anyone who knows (or can guess) this seed can re-generate the key pairs
+   * by passing it along with the derivationOptionsJson.
+   * @param derivationOptionsJson The derivation options in @ref derivation_options_format.
+   */
+  SigningAndUnsealingKey(
+    const std::string& seedString,
+    const InternedString& derivationOptionsJson
+  );
+
+  /**
+   * @brief Construct by copying another SigningAndUnsealingKey
+   */
+  SigningAndUnsealingKey(
+    const SigningAndUnsealingKey& other
+  );
+
+  /**
+   * @brief Derive the key pairs from a seed string and a set of
+   * derivation options in @ref derivation_options_format.
+   *
+   * @param seedString The private seed which is used to generate the key pairs.
+   * @param derivationOptionsJson The derivation options in @ref derivation_options_format.
+   */
+  static SigningAndUnsealingKey deriveFromSeed(
+    const std::string& seedString,
+    const std::string& derivationOptionsJson
+  );
+
+  /**
+   * @brief Derive the key pairs from a root Secret rather than from a seed
+   * string, as described for Secret::deriveFromRootSecret.
+   *
+   * @param rootSecret The root Secret, which must be 16 to 64 bytes long
+   * @param derivationOptionsJson The derivation options in @ref derivation_options_format.
+   */
+  static SigningAndUnsealingKey deriveFromRootSecret(
+    const Secret& rootSecret,
+    const std::string& derivationOptionsJson
+  );
+
+  /**
+   * @brief Get the SigningKey with which to sign messages
+   */
+  const SigningKey getSigningKey() const;
+
+  /**
+   * @brief Get the SignatureVerificationKey with which others can
+   * verify this key's signatures
+   */
+  const SignatureVerificationKey getSignatureVerificationKey() const;
+
+  /**
+   * @brief Get the UnsealingKey with which to unseal messages
+   * sealed with the SealingKey
+   *
+   * Its derivationOptionsJson is this key's, from which an UnsealingKey
+   * cannot be re-derived: to unseal from the seed, use the static
+   * SigningAndUnsealingKey::unseal, not UnsealingKey::unseal.
+   */
+  const UnsealingKey getUnsealingKey() const;
+
+  /**
+   * @brief Get the SealingKey with which others can seal messages
+   * to this key
+   *
+   * Messages it seals carry this key's derivationOptionsJson, and are
+   * unsealed from the seed with the static SigningAndUnsealingKey::unseal.
+   */
+  const SealingKey getSealingKey() const;
+
+  /**
+   * @brief Unseal a message sealed with the SealingKey of a
+   * SigningAndUnsealingKey by re-deriving that key from the seed and the
+   * message's derivationOptionsJson.
+   *
+   * UnsealingKey::unseal cannot unseal these messages, since an
+   * UnsealingKey derived from the same options is a different key.
+   *
+   * @param packagedSealedMessage The message to be unsealed
+   * @param seedString The seed string from which the key was derived
+   * @return const SodiumBuffer The plaintext message that had been sealed
+   */
+  static const SodiumBuffer unseal(
+    const PackagedSealedMessage &packagedSealedMessage,
+    const std::string& seedString
+  );
+
+  /**
+   * @brief Construct (reconstitute) from serialized JSON format
+   *
+   * @param signingAndUnsealingKeyAsJson
+   */
+  static SigningAndUnsealingKey fromJson(
+    const std::string& signingAndUnsealingKeyAsJson
+  );
+
+  /**
+   * @brief Serialize this object to a JSON-formatted string.  Only the
+   * signing key bytes and derivationOptionsJson are stored, since the
+   * other keys are re-generated from them.
+   *
+   * @param indent The number of characters to indent the JSON (optional)
+   * @param indent_char The character with which to indent the JSON (optional)
+   * @param binaryEncoding How binary fields are written (optional, hex by default)
+   */
+  const std::string toJson(
+    int indent = -1,
+    const char indent_char = ' ',
+    BinaryEncoding binaryEncoding = BinaryEncoding::Hex
+  ) const;
+
+  /**
+   * @brief Serialize to byte array as a list of:
+   *   (signingKeyBytes, derivationOptionsJson)
+   *
+   * Stored in SodiumBuffer's fixed-length list format.
+   * Strings are stored as UTF8 byte arrays.
+   */
+  const SodiumBuffer toSerializedBinaryForm() const;
+
+  /**
+   * @brief The exact number of bytes toSerializedBinaryForm produces
+   */
+  size_t serializedSize() const;
+
+  /**
+   * @brief Write the same bytes as toSerializedBinaryForm (signingKeyBytes and derivationOptionsJson)
+   * into memory supplied by the caller, without allocating. As signingKeyBytes is
+   * secret, the caller is responsible for erasing that memory.
+   *
+   * @param out Where to write the serialized form
+   * @param capacity The number of bytes available at out, which must be at
+   * least serializedSize()
+   * @return size_t The number of bytes written
+   * @exception std::invalid_argument Thrown if capacity is too small.
+   */
+  size_t serializeInto(unsigned char* out, size_t capacity) const;
+
+  /**
+   * @brief Deserialize from a byte array stored as a list of:
+   *   (signingKeyBytes, derivationOptionsJson)
+   *
+   * Stored in SodiumBuffer's fixed-length list format.
+   * Strings are stored as UTF8 byte arrays.
+   */
+  static SigningAndUnsealingKey fromSerializedBinaryForm(const SodiumBuffer &serializedBinaryForm);
+
+private:
+  static std::vector<unsigned char> signatureVerificationKeyFrom(const SodiumBuffer& signingKeyBytes);
+  static SodiumBuffer unsealingKeyFrom(const SodiumBuffer& signingKeyBytes);
+  static std::vector<unsigned char> sealingKeyFrom(const std::vector<unsigned char>& signatureVerificationKeyBytes);
+};
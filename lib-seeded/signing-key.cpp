@@ -6,11 +6,12 @@
 
 SigningKey::SigningKey(
   const SodiumBuffer& _signingKeyBytes,
-  const std::string& _derivationOptionsJson
+  const InternedString& _derivationOptionsJson
 ) :
   derivationOptionsJson(_derivationOptionsJson),
   signingKeyBytes(_signingKeyBytes),
-  signatureVerificationKeyBytes(0)
+  signatureVerificationKeyBytes(0),
+  expandedSigningKeyBytes(expandSigningKey(_signingKeyBytes))
 {
   if (signatureVerificationKeyBytes.size() > 0 &&
       signatureVerificationKeyBytes.size() != crypto_sign_PUBLICKEYBYTES
@@ -25,11 +26,12 @@ SigningKey::SigningKey(
 SigningKey::SigningKey(
   const SodiumBuffer &_signingKey,
   const std::vector<unsigned char> &_signatureVerificationKey,
-  const std::string& _derivationOptionsJson
+  const InternedString& _derivationOptionsJson
 ) :
   derivationOptionsJson(_derivationOptionsJson),
   signingKeyBytes(_signingKey),
-  signatureVerificationKeyBytes(_signatureVerificationKey) {
+  signatureVerificationKeyBytes(_signatureVerificationKey),
+  expandedSigningKeyBytes(expandSigningKey(_signingKey)) {
 }
 
 SigningKey::SigningKey(
@@ -37,9 +39,34 @@ SigningKey::SigningKey(
 ) :
   derivationOptionsJson(other.derivationOptionsJson),
   signingKeyBytes(other.signingKeyBytes),
-  signatureVerificationKeyBytes(other.signatureVerificationKeyBytes)
+  signatureVerificationKeyBytes(other.signatureVerificationKeyBytes),
+  expandedSigningKeyBytes(other.expandedSigningKeyBytes)
   {}
 
+SodiumBuffer SigningKey::expandSigningKey(
+  const SodiumBuffer &signingKeyBytes
+) {
+  if (signingKeyBytes.length != crypto_sign_SECRETKEYBYTES) {
+    throw InvalidDerivationOptionValueException("Invalid signing key size");
+  }
+  // Same expansion as libsodium's crypto_sign_ed25519_detached:
+  // az = SHA-512(seed), scalar = clamp(az[0..32]), prefix = az[32..64].
+  // The scalar is stored reduced mod L so it can be fed straight into
+  // crypto_core_ed25519_scalar_mul.
+  SodiumBuffer az(crypto_hash_sha512_BYTES);
+  crypto_hash_sha512(az.data, signingKeyBytes.data, crypto_sign_SEEDBYTES);
+  az.data[0] &= 248;
+  az.data[31] &= 127;
+  az.data[31] |= 64;
+  SodiumBuffer wideScalar(crypto_core_ed25519_NONREDUCEDSCALARBYTES);
+  sodium_memzero(wideScalar.data, wideScalar.length);
+  memcpy(wideScalar.data, az.data, crypto_core_ed25519_SCALARBYTES);
+  SodiumBuffer expanded(crypto_core_ed25519_SCALARBYTES + 32);
+  crypto_core_ed25519_scalar_reduce(expanded.data, wideScalar.data);
+  memcpy(expanded.data + crypto_core_ed25519_SCALARBYTES, az.data + 32, 32);
+  return expanded;
+}
+
 
 namespace SigningKeyJsonField {
   const std::string signatureVerificationKeyBytes = "signatureVerificationKeyBytes";
@@ -52,9 +79,11 @@ SigningKey SigningKey::fromJson(
 ) {
   try {
     nlohmann::json jsonObject = nlohmann::json::parse(signingKeyAsJson);
+    const BinaryEncoding binaryEncoding = binaryEncodingFromName(jsonObject.value<std::string>(
+      BinaryEncodingJsonField::binaryEncoding, binaryEncodingName(BinaryEncoding::Hex)));
     return SigningKey(
-      SodiumBuffer::fromHexString(jsonObject.at(SigningKeyJsonField::signingKeyBytes)),
-      hexStrToByteVector(jsonObject.value(SigningKeyJsonField::signatureVerificationKeyBytes, "")),
+      encodedStrToSodiumBuffer(jsonObject.at(SigningKeyJsonField::signingKeyBytes), binaryEncoding),
+      encodedStrToByteVector(jsonObject.value(SigningKeyJsonField::signatureVerificationKeyBytes, ""), binaryEncoding),
       jsonObject.value(SigningKeyJsonField::derivationOptionsJson, "")
     );
   } catch (nlohmann::json::exception e) {
@@ -65,10 +94,31 @@ SigningKey SigningKey::fromJson(
 
 SigningKey::SigningKey(
   const std::string& _seedString,
-  const std::string& _derivationOptionsJson
+  const InternedString& _derivationOptionsJson
 ) : SigningKey(deriveFromSeed(_seedString, _derivationOptionsJson)) {}
 
 
+SodiumBuffer SigningKey::signingKeyBytesFromSeed(const SodiumBuffer& seed) {
+  if (seed.length != crypto_sign_SEEDBYTES) {
+    throw KeyLengthException("Invalid signing key seed size");
+  }
+  SodiumBuffer signingKeyBytes(crypto_sign_SECRETKEYBYTES);
+  unsigned char signatureVerificationKeyBytes[crypto_sign_PUBLICKEYBYTES];
+  crypto_sign_seed_keypair(signatureVerificationKeyBytes, signingKeyBytes.data, seed.data);
+  return signingKeyBytes;
+}
+
+// Dervive a key pair from a seed of crypto_sign_SEEDBYTES
+static SigningKey signingKeyFromSeedBytes(
+  const SodiumBuffer& seed,
+  const std::string& derivationOptionsJson
+) {
+  const SodiumBuffer signingKeyBytes = SigningKey::signingKeyBytesFromSeed(seed);
+  std::vector<unsigned char> signatureVerificationKeyBytes(crypto_sign_PUBLICKEYBYTES);
+  crypto_sign_ed25519_sk_to_pk(signatureVerificationKeyBytes.data(), signingKeyBytes.data);
+  return SigningKey(signingKeyBytes, signatureVerificationKeyBytes, derivationOptionsJson);
+}
+
 SigningKey SigningKey::deriveFromSeed(
   const std::string& _seedString,
   const std::string& _derivationOptionsJson
@@ -80,11 +130,20 @@ SigningKey SigningKey::deriveFromSeed(
     DerivationOptionsJson::type::SigningKey,
     crypto_sign_SEEDBYTES
   );
-  // Dervive a key pair from the seed
-  SodiumBuffer signingKeyBytes(crypto_sign_SECRETKEYBYTES);
-  std::vector<unsigned char> signatureVerificationKeyBytes(crypto_sign_PUBLICKEYBYTES);
-  crypto_sign_seed_keypair(signatureVerificationKeyBytes.data(), signingKeyBytes.data, seed.data);
-  return SigningKey(signingKeyBytes, signatureVerificationKeyBytes, _derivationOptionsJson);
+  return signingKeyFromSeedBytes(seed, _derivationOptionsJson);
+}
+
+SigningKey SigningKey::deriveFromRootSecret(
+  const Secret& rootSecret,
+  const std::string& _derivationOptionsJson
+) {
+  SodiumBuffer seed = DerivationOptions::deriveChildSecret(
+    rootSecret.secretBytes,
+    _derivationOptionsJson,
+    DerivationOptionsJson::type::SigningKey,
+    crypto_sign_SEEDBYTES
+  );
+  return signingKeyFromSeedBytes(seed, _derivationOptionsJson);
 }
 
 
@@ -106,45 +165,149 @@ const std::vector<unsigned char> SigningKey::generateSignature(
   const unsigned char* message,
   const size_t messageLength
 ) const {
-  std::vector<unsigned char> signature(crypto_sign_BYTES);
-  unsigned long long siglen_p;
-  crypto_sign_detached(signature.data(), &siglen_p, message, messageLength, signingKeyBytes.data);
+  return generateSignatureBytes(message, messageLength).toVector();
+}
+
+const std::vector<unsigned char> SigningKey::generateSignature(
+  const std::vector<MessageFragment>& messageFragments
+) const {
+  return generateSignatureBytes(messageFragments).toVector();
+}
+
+const SignatureBytes SigningKey::generateSignatureBytes(
+  const unsigned char* message,
+  const size_t messageLength
+) const {
+  const MessageFragment messageFragment(message, messageLength);
+  return generateSignatureBytes(&messageFragment, 1);
+}
+
+const SignatureBytes SigningKey::generateSignatureBytes(
+  const std::vector<unsigned char>& message
+) const {
+  return generateSignatureBytes(message.data(), message.size());
+}
+
+const SignatureBytes SigningKey::generateSignatureBytes(
+  const std::vector<MessageFragment>& messageFragments
+) const {
+  return generateSignatureBytes(messageFragments.data(), messageFragments.size());
+}
+
+const SignatureBytes SigningKey::generateSignatureBytes(
+  const MessageFragment* messageFragments,
+  const size_t messageFragmentCount
+) const {
+  // Mirrors crypto_sign_ed25519_detached step for step, starting from the
+  // cached expansion rather than re-hashing the seed.
+  const unsigned char* scalar = expandedSigningKeyBytes.data;
+  const unsigned char* prefix = expandedSigningKeyBytes.data + crypto_core_ed25519_SCALARBYTES;
+  const unsigned char* publicKey = signingKeyBytes.data + crypto_sign_SEEDBYTES;
+  SignatureBytes signature;
+  // Per-call temporaries live on the stack and are wiped before returning;
+  // a guarded sodium_malloc per signature costs more than the signing itself.
+  unsigned char hash[crypto_hash_sha512_BYTES];
+  unsigned char nonce[crypto_core_ed25519_SCALARBYTES];
+  unsigned char hram[crypto_core_ed25519_SCALARBYTES];
+  unsigned char hramTimesScalar[crypto_core_ed25519_SCALARBYTES];
+  crypto_hash_sha512_state hs;
+
+  // r = SHA-512(prefix || M) mod L;  R = rB
+  crypto_hash_sha512_init(&hs);
+  crypto_hash_sha512_update(&hs, prefix, 32);
+  for (size_t i = 0; i < messageFragmentCount; i++) {
+    crypto_hash_sha512_update(&hs, messageFragments[i].data, messageFragments[i].length);
+  }
+  crypto_hash_sha512_final(&hs, hash);
+  crypto_core_ed25519_scalar_reduce(nonce, hash);
+  if (crypto_scalarmult_ed25519_base_noclamp(signature.data(), nonce) != 0) {
+    throw std::runtime_error("Ed25519 nonce reduced to zero");
+  }
+  memcpy(signature.data() + 32, publicKey, crypto_sign_PUBLICKEYBYTES);
+
+  // k = SHA-512(R || A || M) mod L;  S = ka + r
+  crypto_hash_sha512_init(&hs);
+  crypto_hash_sha512_update(&hs, signature.data(), crypto_sign_BYTES);
+  for (size_t i = 0; i < messageFragmentCount; i++) {
+    crypto_hash_sha512_update(&hs, messageFragments[i].data, messageFragments[i].length);
+  }
+  crypto_hash_sha512_final(&hs, hash);
+  crypto_core_ed25519_scalar_reduce(hram, hash);
+  crypto_core_ed25519_scalar_mul(hramTimesScalar, hram, scalar);
+  crypto_core_ed25519_scalar_add(signature.data() + 32, hramTimesScalar, nonce);
+
+  sodium_memzero(&hs, sizeof hs);
+  sodium_memzero(hash, sizeof hash);
+  sodium_memzero(nonce, sizeof nonce);
+  sodium_memzero(hram, sizeof hram);
+  sodium_memzero(hramTimesScalar, sizeof hramTimesScalar);
   return signature;
 }
 
 const std::vector<unsigned char> SigningKey::generateSignature(
   const std::vector<unsigned char>& message
 ) const {
-  return generateSignature(message.data(), message.size());
+  return generateSignatureBytes(message.data(), message.size()).toVector();
 }
 
 const std::string SigningKey::toJson(
   bool minimizeSizeByRemovingTheSignatureVerificationKeyBytesWhichCanBeRegeneratedLater,
   int indent,
-  const char indent_char
+  const char indent_char,
+  BinaryEncoding binaryEncoding
 ) const {
   nlohmann::json asJson;
-  asJson[SigningKeyJsonField::signingKeyBytes] = signingKeyBytes.toHexString();
+  asJson[SigningKeyJsonField::signingKeyBytes] = toEncodedStr(signingKeyBytes.data, signingKeyBytes.length, binaryEncoding);
   if (signatureVerificationKeyBytes.size() > 0 &&
       !minimizeSizeByRemovingTheSignatureVerificationKeyBytesWhichCanBeRegeneratedLater) {
     asJson[SigningKeyJsonField::signatureVerificationKeyBytes] =
-      toHexStr(signatureVerificationKeyBytes);
+      toEncodedStr(signatureVerificationKeyBytes, binaryEncoding);
   }
   asJson[SigningKeyJsonField::derivationOptionsJson] = derivationOptionsJson;
+  if (binaryEncoding != BinaryEncoding::Hex) {
+    asJson[BinaryEncodingJsonField::binaryEncoding] = binaryEncodingName(binaryEncoding);
+  }
   return asJson.dump(indent, indent_char);
 };
 
-const SodiumBuffer SigningKey::toSerializedBinaryForm(
+size_t SigningKey::serializedSize(
+  bool minimizeSizeByRemovingTheSignatureVerificationKeyBytesWhichCanBeRegeneratedLater
+) const {
+  return SodiumBuffer::fixedLengthListSize(
+    signingKeyBytes,
+    minimizeSizeByRemovingTheSignatureVerificationKeyBytesWhichCanBeRegeneratedLater ?
+      SodiumBuffer::FixedLengthListItem() : SodiumBuffer::FixedLengthListItem(signatureVerificationKeyBytes),
+    derivationOptionsJson
+  );
+}
+
+size_t SigningKey::serializeInto(
+  unsigned char* out,
+  size_t capacity,
   bool minimizeSizeByRemovingTheSignatureVerificationKeyBytesWhichCanBeRegeneratedLater
 ) const {
-  SodiumBuffer _signatureVerificationKeyBytes(signatureVerificationKeyBytes);
-  SodiumBuffer _derivationOptionsJson(derivationOptionsJson);
-  return SodiumBuffer::combineFixedLengthList({
-    &signingKeyBytes,
+  return SodiumBuffer::writeFixedLengthList(
+    out,
+    capacity,
+    signingKeyBytes,
     minimizeSizeByRemovingTheSignatureVerificationKeyBytesWhichCanBeRegeneratedLater ?
-    NULL : &_signatureVerificationKeyBytes,
-    &_derivationOptionsJson
-  });
+      SodiumBuffer::FixedLengthListItem() : SodiumBuffer::FixedLengthListItem(signatureVerificationKeyBytes),
+    derivationOptionsJson
+  );
+}
+
+const SodiumBuffer SigningKey::toSerializedBinaryForm(
+  bool minimizeSizeByRemovingTheSignatureVerificationKeyBytesWhichCanBeRegeneratedLater
+) const {
+  SodiumBuffer serialized(serializedSize(
+    minimizeSizeByRemovingTheSignatureVerificationKeyBytesWhichCanBeRegeneratedLater
+  ));
+  serializeInto(
+    serialized.data,
+    serialized.length,
+    minimizeSizeByRemovingTheSignatureVerificationKeyBytesWhichCanBeRegeneratedLater
+  );
+  return serialized;
 }
 
 SigningKey SigningKey::fromSerializedBinaryForm(
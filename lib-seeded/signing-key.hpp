@@ -1,6 +1,11 @@
 #pragma once
 
 #include "sodium-buffer.hpp"
+#include "message-fragment.hpp"
+#include "fixed-length-bytes.hpp"
+#include "convert.hpp"
+#include "interned-string.hpp"
+#include "secret.hpp"
 #include "signature-verification-key.hpp"
 
 /**
@@ -46,8 +51,27 @@ public:
   /**
    * @brief A @ref derivation_options_format string used to specify how this key is derived.
    */
-  const std::string derivationOptionsJson;
+  const InternedString derivationOptionsJson;
 
+private:
+  /**
+   * @brief The expanded form of signingKeyBytes: the reduced Ed25519 secret
+   * scalar followed by the 32-byte nonce prefix.
+   *
+   * libsodium re-derives both from the seed (one SHA-512 block) on every
+   * call to crypto_sign_detached. Keeping them in secure memory lets
+   * generateSignature skip that step while producing identical signatures.
+   */
+  const SodiumBuffer expandedSigningKeyBytes;
+
+  static SodiumBuffer expandSigningKey(const SodiumBuffer &signingKeyBytes);
+
+  const SignatureBytes generateSignatureBytes(
+    const MessageFragment* messageFragments,
+    const size_t messageFragmentCount
+  ) const;
+
+public:
   /**
    * @brief Construct a copy of another SigningKey
    */
@@ -61,7 +85,7 @@ public:
    */
   SigningKey(
     const SodiumBuffer &signingKeyBytes,
-    const std::string& derivationOptionsJson
+    const InternedString& derivationOptionsJson
   );
 
   /**
@@ -71,7 +95,7 @@ public:
   SigningKey(
     const SodiumBuffer &signingKeyBytes,
     const std::vector<unsigned char> &signatureVerificationKeyBytes,
-    const std::string& derivationOptionsJson
+    const InternedString& derivationOptionsJson
   );
 
     /**
@@ -85,7 +109,7 @@ public:
    */
   SigningKey(
     const std::string& seedString,
-    const std::string& derivationOptionsJson
+    const InternedString& derivationOptionsJson
   );
 
     /**
@@ -102,6 +126,26 @@ public:
     const std::string& derivationOptionsJson
   );
 
+  /**
+   * @brief Derive a signing key pair from a root Secret rather than from a
+   * seed string, as described for Secret::deriveFromRootSecret.
+   *
+   * @param rootSecret The root Secret, which must be 16 to 64 bytes long
+   * @param derivationOptionsJson The derivation options in @ref derivation_options_format.
+   */
+  static SigningKey deriveFromRootSecret(
+    const Secret& rootSecret,
+    const std::string& derivationOptionsJson
+  );
+
+  /**
+   * @brief The raw signing key (the Ed25519 secret key: the seed followed
+   * by the public key) generated from a seed of crypto_sign_SEEDBYTES
+   *
+   * @exception KeyLengthException Thrown if the seed is the wrong length.
+   */
+  static SodiumBuffer signingKeyBytesFromSeed(const SodiumBuffer& seed);
+
   /**
    * @brief Construct (reconsitute) the SigningKey from JSON format.
    * The JSON object may or may not contain the signatureVerificationKeyBytes.
@@ -159,6 +203,39 @@ public:
     const std::vector<unsigned char> &message
   ) const;
 
+  /**
+   * @brief Sign a message held in several fragments without concatenating
+   * them.  Ed25519 hashes the message twice, so both passes walk the
+   * fragments in order; the signature is identical to the one generated
+   * for the fragments concatenated.
+   * 
+   * @param messageFragments The pieces of the message, in order
+   */
+  const std::vector<unsigned char> generateSignature(
+    const std::vector<MessageFragment>& messageFragments
+  ) const;
+
+  /**
+   * @brief Generate the same signature as generateSignature, returned
+   * inline in a SignatureBytes rather than in a vector, so that signing
+   * does not allocate.
+   * 
+   * @param message The message to _sign_ by generating the signature 
+   * @param messageLength The length of the message.
+   */
+  const SignatureBytes generateSignatureBytes(
+    const unsigned char* message,
+    const size_t messageLength
+  ) const;
+
+  const SignatureBytes generateSignatureBytes(
+    const std::vector<unsigned char>& message
+  ) const;
+
+  const SignatureBytes generateSignatureBytes(
+    const std::vector<MessageFragment>& messageFragments
+  ) const;
+
   /**
    * @brief Serialize this object to a JSON-formatted string
    * 
@@ -173,12 +250,14 @@ public:
    * which takes a little computation in return for the space saved in the JSON format.
    * @param indent The number of characters to indent the JSON (optional)
    * @param indent_char The character with which to indent the JSON (optional)
+   * @param binaryEncoding How binary fields are written (optional, hex by default)
    * @return const std::string
    */
   const std::string toJson(
     bool minimizeSizeByRemovingTheSignatureVerificationKeyBytesWhichCanBeRegeneratedLater = true,
     int indent = -1,
-    const char indent_char = ' '
+    const char indent_char = ' ',
+    BinaryEncoding binaryEncoding = BinaryEncoding::Hex
   ) const;
 
   /**
@@ -198,6 +277,31 @@ public:
     bool minimizeSizeByRemovingTheSignatureVerificationKeyBytesWhichCanBeRegeneratedLater = true
   ) const;
 
+  /**
+   * @brief The exact number of bytes toSerializedBinaryForm produces when
+   * given the same minimize option
+   */
+  size_t serializedSize(
+    bool minimizeSizeByRemovingTheSignatureVerificationKeyBytesWhichCanBeRegeneratedLater = true
+  ) const;
+
+  /**
+   * @brief Write the same bytes as toSerializedBinaryForm into memory
+   * supplied by the caller, without allocating.  Since signingKeyBytes are
+   * secret, the caller is responsible for erasing that memory.
+   *
+   * @param out Where to write the serialized form
+   * @param capacity The number of bytes available at out, which must be at
+   * least serializedSize() for the same minimize option
+   * @return size_t The number of bytes written
+   * @exception std::invalid_argument Thrown if capacity is too small.
+   */
+  size_t serializeInto(
+    unsigned char* out,
+    size_t capacity,
+    bool minimizeSizeByRemovingTheSignatureVerificationKeyBytesWhichCanBeRegeneratedLater = true
+  ) const;
+
   /**
    * @brief Deserialize from a byte array stored as a list of:
    *   (keyBytes, signatureVerificationKeyBytes, derivationOptionsJson)
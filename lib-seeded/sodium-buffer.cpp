@@ -2,6 +2,7 @@
 #include <memory.h>
 #include <vector>
 #include <stdexcept>
+#include <new>
 #include "sodium-buffer.hpp"
 #include "sodium-initializer.hpp"
 #include "convert.hpp"
@@ -27,6 +28,11 @@ SodiumBuffer::SodiumBuffer(size_t _length, const unsigned char* bufferData):
     length(_length),
     data((unsigned char*) sodium_malloc_aligned(_length))
 {
+    if (data == NULL) {
+        // sodium_malloc maps guard pages around every buffer, so it can run
+        // out of mappings (vm.max_map_count) long before memory runs out
+        throw std::bad_alloc();
+    }
     if (bufferData != NULL && _length > 0) {
         memcpy(data, bufferData, _length);
     }
@@ -60,35 +66,22 @@ const std::string SodiumBuffer::toUtf8String() const {
 }
 
 const std::string SodiumBuffer::toHexString() const {
-    constexpr char hexDigits[] = {
-      '0', '1', '2', '3', '4', '5', '6', '7',
-      '8', '9', 'a', 'b', 'c', 'd', 'e', 'f'
-    };
-
   std::string hexString(length * 2, ' ');
-  for (size_t i = 0; i < length; i++) {
-    unsigned char b = data[i];
-    hexString[2 * i] = hexDigits[b >> 4];
-    hexString[2 * i + 1] = hexDigits[b & 0xf];
-  }
+  hexEncode(&hexString[0], data, length);
   return hexString;
 }
 
 SodiumBuffer SodiumBuffer::fromHexString(const std::string& hexStr) {
-    if (hexStr.length() >= 2 && hexStr[1] == 'x' && hexStr[0] == '0') {
-        // Ignore prefix '0x'
-        return SodiumBuffer::fromHexString(hexStr.substr(2));
-    }
-    else {
-      if (hexStr.length() % 2 == 1) {
-        throw std::invalid_argument("Invalid hex string length");
-      }
-      SodiumBuffer buffer(hexStr.length() / 2);
-      for (size_t i = 0; i < buffer.length; i++) {
-        buffer.data[i] = (parseHexChar(hexStr[2 * i]) << 4) | parseHexChar(hexStr[2 * i + 1]);
-      }
-      return buffer;
-    }
+  // Ignore prefix '0x'
+  const size_t start = (hexStr.length() >= 2 && hexStr[1] == 'x' && hexStr[0] == '0') ? 2 : 0;
+  if ((hexStr.length() - start) % 2 == 1) {
+    throw std::invalid_argument("Invalid hex string length");
+  }
+  SodiumBuffer buffer((hexStr.length() - start) / 2);
+  if (!hexDecode(buffer.data, hexStr.data() + start, buffer.length)) {
+    throw InvalidHexCharacterException();
+  }
+  return buffer;
 }
 
 // const SodiumBuffer SodiumBuffer::pushField(const SodiumBuffer &bufferToPrepend) const {
@@ -137,35 +130,35 @@ SodiumBuffer SodiumBuffer::fromHexString(const std::string& hexStr) {
 //   return (buffer->length - bytesConsumed) <= 0;
 // }
 
-const SodiumBuffer SodiumBuffer::combineFixedLengthList(
-    const std::vector<const SodiumBuffer*>& sodiumBufferPtrs
-) {
-  size_t buffersToWrite = sodiumBufferPtrs.size();
-  size_t bufferLengthNeeded = 0;
-    // Calculate the length needed to serialize the record
-    for (int i = 0; i < buffersToWrite; i++) {
-        const SodiumBuffer* sodiumBufferPtr = sodiumBufferPtrs[i];
-        if (i < buffersToWrite - 1) {
-          // allocate space for 4-byte size
-          bufferLengthNeeded += 4;
+size_t SodiumBuffer::fixedLengthListSize(const FixedLengthListItem* items, size_t count) {
+    size_t bufferLengthNeeded = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (i < count - 1) {
+            // allocate space for 4-byte size
+            bufferLengthNeeded += 4;
         }
-        if (sodiumBufferPtr != NULL) {
-            // allocate space for buffer
-            if (sodiumBufferPtr->length > (size_t)0xffffffff) {
-              throw std::invalid_argument("Cannot serialize buffers of size >= 4GB");
-            }
-            bufferLengthNeeded += sodiumBufferPtr->length;
+        if (items[i].length > (size_t)0xffffffff) {
+            throw std::invalid_argument("Cannot serialize buffers of size >= 4GB");
         }
+        bufferLengthNeeded += items[i].length;
+    }
+    return bufferLengthNeeded;
+}
+
+size_t SodiumBuffer::writeFixedLengthList(
+    unsigned char* out,
+    size_t capacity,
+    const FixedLengthListItem* items,
+    size_t count
+) {
+    if (fixedLengthListSize(items, count) > capacity) {
+        throw std::invalid_argument("Not enough space to write the fixed-length list");
     }
-    SodiumBuffer bufferEncodingAFixedLengthListOfOtherBuffers =
-        SodiumBuffer(bufferLengthNeeded);
-    unsigned char* writePtr = bufferEncodingAFixedLengthListOfOtherBuffers.data;
-
-    for (int i = 0; i < buffersToWrite; i++) {
-        const SodiumBuffer* sodiumBufferPtr = sodiumBufferPtrs[i];
-        size_t thisItemsLength = sodiumBufferPtr ? sodiumBufferPtr->length : 0;
-        if (i < buffersToWrite - 1) {
-            // For all buffers except the last, write a four-byte big-endian
+    unsigned char* writePtr = out;
+    for (size_t i = 0; i < count; i++) {
+        const size_t thisItemsLength = items[i].length;
+        if (i < count - 1) {
+            // For all items except the last, write a four-byte big-endian
             // length field which tells us how many more bytes to read
             // before the next item starts.
             *(writePtr++) = (thisItemsLength >> 24) & 0xff;
@@ -175,11 +168,27 @@ const SodiumBuffer SodiumBuffer::combineFixedLengthList(
         }
         if (thisItemsLength > 0) {
             // Write the contents of this item
-            memcpy(writePtr, sodiumBufferPtr->data, thisItemsLength);
+            memcpy(writePtr, items[i].data, thisItemsLength);
             writePtr += thisItemsLength;
         }
     }
-    return bufferEncodingAFixedLengthListOfOtherBuffers;
+    return writePtr - out;
+}
+
+const SodiumBuffer SodiumBuffer::combineFixedLengthList(
+    const std::vector<const SodiumBuffer*>& sodiumBufferPtrs
+) {
+  const std::vector<FixedLengthListItem> items(sodiumBufferPtrs.begin(), sodiumBufferPtrs.end());
+  SodiumBuffer bufferEncodingAFixedLengthListOfOtherBuffers(
+    fixedLengthListSize(items.data(), items.size())
+  );
+  writeFixedLengthList(
+    bufferEncodingAFixedLengthListOfOtherBuffers.data,
+    bufferEncodingAFixedLengthListOfOtherBuffers.length,
+    items.data(),
+    items.size()
+  );
+  return bufferEncodingAFixedLengthListOfOtherBuffers;
 }
 
 const std::vector<SodiumBuffer> SodiumBuffer::splitFixedLengthList(
@@ -218,3 +227,37 @@ const std::vector<SodiumBuffer> SodiumBuffer::splitFixedLengthList(
     return fixedLengthListOfBuffers;
 };
 
+bool SodiumBuffer::locateFixedLengthListItems(
+    const unsigned char* data,
+    const size_t length,
+    const size_t count,
+    const unsigned char** itemData,
+    size_t* itemLengths
+) {
+    size_t bytesRemaining = length;
+    const unsigned char* readPtr = data;
+    for (size_t i = 0; i < count; i++) {
+        size_t itemLength = bytesRemaining;
+        if (i != count - 1) {
+            if (bytesRemaining < 4) {
+                return false;
+            }
+            itemLength =
+                (size_t(*(readPtr)) << 24) +
+                (size_t(*(readPtr + 1)) << 16) +
+                (size_t(*(readPtr + 2)) << 8) +
+                (size_t(*(readPtr + 3)));
+            readPtr += 4;
+            bytesRemaining -= 4;
+            if (itemLength > bytesRemaining) {
+                return false;
+            }
+        }
+        itemData[i] = readPtr;
+        itemLengths[i] = itemLength;
+        readPtr += itemLength;
+        bytesRemaining -= itemLength;
+    }
+    return true;
+}
+
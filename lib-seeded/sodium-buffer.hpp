@@ -3,6 +3,7 @@
 #include "sodium-initializer.hpp"
 #include "sodium.h"
 #include <memory.h>
+#include <array>
 #include <vector>
 #include <string>
 
@@ -86,6 +87,91 @@ public:
     const std::vector<const SodiumBuffer*>& buffers
   );
 
+  /**
+   * @brief A view of the bytes of one item of a fixed-length list, which
+   * can be made implicitly from a SodiumBuffer (or a pointer to one, which
+   * may be NULL), a byte vector or array, or a string, without copying it.
+   */
+  struct FixedLengthListItem {
+    const unsigned char* data;
+    size_t length;
+
+    FixedLengthListItem() : data(NULL), length(0) {}
+    FixedLengthListItem(const unsigned char* _data, size_t _length) : data(_data), length(_length) {}
+    FixedLengthListItem(const SodiumBuffer& buffer) : data(buffer.data), length(buffer.length) {}
+    FixedLengthListItem(const SodiumBuffer* buffer) :
+      data(buffer == NULL ? NULL : buffer->data), length(buffer == NULL ? 0 : buffer->length) {}
+    FixedLengthListItem(const std::vector<unsigned char>& bytes) : data(bytes.data()), length(bytes.size()) {}
+    template <size_t N>
+    FixedLengthListItem(const std::array<unsigned char, N>& bytes) : data(bytes.data()), length(N) {}
+    FixedLengthListItem(const std::string& str) :
+      data((const unsigned char*) str.data()), length(str.size()) {}
+  };
+
+  /**
+   * @brief The number of bytes needed to store a list of items in the
+   * fixed-length list format of combineFixedLengthList.
+   *
+   * @exception std::invalid_argument Thrown if an item is 4GB or larger.
+   */
+  static size_t fixedLengthListSize(const FixedLengthListItem* items, size_t count);
+
+  /**
+   * @brief Write a list of items in the fixed-length list format of
+   * combineFixedLengthList into memory supplied by the caller.
+   *
+   * @param out Where to write the list
+   * @param capacity The number of bytes available at out
+   * @return size_t The number of bytes written (fixedLengthListSize)
+   * @exception std::invalid_argument Thrown if the list needs more than
+   * capacity bytes, or an item is 4GB or larger.
+   */
+  static size_t writeFixedLengthList(
+    unsigned char* out,
+    size_t capacity,
+    const FixedLengthListItem* items,
+    size_t count
+  );
+
+  /**
+   * @brief The variadic form of fixedLengthListSize, e.g.
+   * `fixedLengthListSize(keyBytes, derivationOptionsJson)`.
+   */
+  template <typename... Items>
+  static size_t fixedLengthListSize(const Items&... items) {
+    static_assert(sizeof...(Items) > 0, "A fixed-length list needs at least one item");
+    const FixedLengthListItem list[] = { FixedLengthListItem(items)... };
+    return fixedLengthListSize(list, sizeof...(Items));
+  }
+
+  /**
+   * @brief The variadic form of writeFixedLengthList, e.g.
+   * `writeFixedLengthList(out, capacity, keyBytes, derivationOptionsJson)`.
+   */
+  template <typename... Items>
+  static size_t writeFixedLengthList(unsigned char* out, size_t capacity, const Items&... items) {
+    static_assert(sizeof...(Items) > 0, "A fixed-length list needs at least one item");
+    const FixedLengthListItem list[] = { FixedLengthListItem(items)... };
+    return writeFixedLengthList(out, capacity, list, sizeof...(Items));
+  }
+
+  /**
+   * @brief The variadic form of combineFixedLengthList, which takes the
+   * items themselves (SodiumBuffers, byte vectors, or strings) rather than a
+   * vector of pointers to SodiumBuffers, and so allocates only the result.
+   *
+   * `combineFixedLengthList(keyBytes, derivationOptionsJson)` produces the
+   * same bytes as copying both into SodiumBuffers and passing pointers to them.
+   */
+  template <typename... Items>
+  static const SodiumBuffer combineFixedLengthList(const Items&... items) {
+    static_assert(sizeof...(Items) > 0, "A fixed-length list needs at least one item");
+    const FixedLengthListItem list[] = { FixedLengthListItem(items)... };
+    SodiumBuffer combined(fixedLengthListSize(list, sizeof...(Items)));
+    writeFixedLengthList(combined.data, combined.length, list, sizeof...(Items));
+    return combined;
+  }
+
   /**
    * @brief Deserialize a fixed-length list of SodiumBuffers that had
    * been serialized to a single buffer via a call to the static
@@ -103,6 +189,27 @@ public:
       int count
   ) const;
 
+  /**
+   * @brief The non-throwing, non-copying form of splitFixedLengthList,
+   * for parsing untrusted input: find where each item of a fixed-length
+   * list lies within serialized bytes.
+   *
+   * @param data The serialized list
+   * @param length The length of the serialized list
+   * @param count The number of items in the list
+   * @param itemData Set to point to each item's bytes within data (count entries)
+   * @param itemLengths Set to each item's length (count entries)
+   * @return true if the list was well formed
+   * @return false if a length field is missing or overruns the data
+   */
+  static bool locateFixedLengthListItems(
+      const unsigned char* data,
+      const size_t length,
+      const size_t count,
+      const unsigned char** itemData,
+      size_t* itemLengths
+  );
+
   /**
    * @brief Create a SodiumBuffer from a string of hex digits.
    * 
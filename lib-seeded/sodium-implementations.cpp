@@ -0,0 +1,73 @@
+#include <sodium.h>
+#include "sodium-implementations.hpp"
+#include "sodium-initializer.hpp"
+
+// The SEEDED_SODIUM_HAVE_* definitions are exported by extern/libsodium.cmake
+// to describe how the vendored libsodium was compiled.  The selection logic
+// below mirrors the _pick_best_implementation functions in libsodium 1.0.18.
+
+const std::string SodiumImplementations::toString() const {
+  return
+    "salsa20=" + salsa20 +
+    " poly1305=" + poly1305 +
+    " blake2b=" + blake2b +
+    " argon2=" + argon2 +
+    " x25519=" + x25519;
+}
+
+const SodiumImplementations getActiveSodiumImplementations() {
+  ensureSodiumInitialized();
+  SodiumImplementations implementations;
+
+#ifdef SEEDED_SODIUM_HAVE_SIMD_KERNELS
+  const bool simd = true;
+#else
+  const bool simd = false;
+#endif
+#ifdef SEEDED_SODIUM_HAVE_AMD64_ASM
+  const bool amd64Asm = true;
+#else
+  const bool amd64Asm = false;
+#endif
+#ifdef SEEDED_SODIUM_HAVE_AVX_ASM
+  const bool avxAsm = true;
+#else
+  const bool avxAsm = false;
+#endif
+#ifdef SEEDED_SODIUM_HAVE_TI_MODE
+  const bool tiMode = true;
+#else
+  const bool tiMode = false;
+#endif
+
+  // 1.0.18 only considers the SSE2 kernel in builds without the amd64 assembly
+  implementations.salsa20 =
+    (simd && sodium_runtime_has_avx2()) ? "avx2" :
+    amd64Asm ? "amd64-asm" :
+    (simd && sodium_runtime_has_sse2()) ? "sse2" :
+    "ref";
+
+  implementations.poly1305 =
+    (simd && tiMode && sodium_runtime_has_sse2()) ? "sse2" :
+    tiMode ? "donna64" :
+    "donna32";
+
+  implementations.blake2b =
+    (simd && sodium_runtime_has_avx2()) ? "avx2" :
+    (simd && sodium_runtime_has_sse41()) ? "sse41" :
+    (simd && sodium_runtime_has_ssse3()) ? "ssse3" :
+    "ref";
+
+  implementations.argon2 =
+    (simd && sodium_runtime_has_avx512f()) ? "avx512f" :
+    (simd && sodium_runtime_has_avx2()) ? "avx2" :
+    (simd && sodium_runtime_has_ssse3()) ? "ssse3" :
+    "ref";
+
+  implementations.x25519 =
+    (avxAsm && sodium_runtime_has_avx()) ? "sandy2x" :
+    tiMode ? "ref10-fe51" :
+    "ref10-fe25_5";
+
+  return implementations;
+}
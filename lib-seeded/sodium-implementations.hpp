@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+
+/**
+ * @brief The names of the libsodium implementations that will run on this
+ * CPU for the primitives this library is built on.
+ *
+ * libsodium chooses among its portable reference code, hand-written
+ * assembly, and SSE/AVX kernels when it is initialized, based on which
+ * kernels were compiled in and which instruction sets the CPU reports.
+ * This structure mirrors that choice so that deployments (and benchmarks)
+ * can confirm which code paths are actually in use.
+ *
+ * @ingroup BuildingBlocks
+ */
+struct SodiumImplementations {
+  /**
+   * @brief The salsa20 stream cipher behind SymmetricKey and the
+   * XSalsa20Poly1305 boxes ("avx2", "sse2", "amd64-asm", or "ref").
+   */
+  std::string salsa20;
+  /**
+   * @brief The poly1305 authenticator ("sse2", "donna64", or "donna32").
+   */
+  std::string poly1305;
+  /**
+   * @brief The BLAKE2b compression function ("avx2", "sse41", "ssse3", or "ref").
+   */
+  std::string blake2b;
+  /**
+   * @brief The Argon2 block-filling function ("avx512f", "avx2", "ssse3", or "ref").
+   */
+  std::string argon2;
+  /**
+   * @brief The X25519 scalar multiplication ("sandy2x", "ref10-fe51", or "ref10-fe25_5").
+   */
+  std::string x25519;
+
+  /**
+   * @brief A single-line, human-readable summary of all implementations.
+   */
+  const std::string toString() const;
+};
+
+/**
+ * @brief Determine which libsodium implementations are active, initializing
+ * libsodium (and so its runtime CPU dispatch) first if necessary.
+ *
+ * @ingroup BuildingBlocks
+ */
+const SodiumImplementations getActiveSodiumImplementations();
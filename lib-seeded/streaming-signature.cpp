@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <functional>
+#include <stdexcept>
+#include "streaming-signature.hpp"
+#include "memory-mapped-file.hpp"
+#include "exceptions.hpp"
+
+namespace {
+
+  typedef std::function<void(const unsigned char*, size_t)> ChunkConsumer;
+
+  void readFileInChunks(const std::string& path, size_t bufferSize, const ChunkConsumer& consume) {
+    if (bufferSize == 0) {
+      throw std::invalid_argument("bufferSize must be greater than zero");
+    }
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == NULL) {
+      throw FileAccessException(("Could not open " + path).c_str());
+    }
+    std::vector<unsigned char> buffer(bufferSize);
+    size_t bytesRead;
+    try {
+      while ((bytesRead = fread(buffer.data(), 1, buffer.size(), file)) > 0) {
+        consume(buffer.data(), bytesRead);
+      }
+    } catch (...) {
+      fclose(file);
+      throw;
+    }
+    const bool failed = ferror(file) != 0;
+    fclose(file);
+    if (failed) {
+      throw FileAccessException(("Could not read " + path).c_str());
+    }
+  }
+
+  void mapFileInWindows(const std::string& path, size_t windowSize, const ChunkConsumer& consume) {
+    if (windowSize == 0) {
+      throw std::invalid_argument("windowSize must be greater than zero");
+    }
+    uint64_t offset = 0;
+    while (true) {
+      const MemoryMappedFile window(path, offset, windowSize);
+      if (window.size() == 0) {
+        break;
+      }
+      consume(window.data(), window.size());
+      offset += window.size();
+      if (offset >= window.getFileSize()) {
+        break;
+      }
+    }
+  }
+
+  void throwIfFinalized(bool finalized) {
+    if (finalized) {
+      throw std::logic_error("The signature has already been finalized");
+    }
+  }
+
+}
+
+StreamingSigner::StreamingSigner(
+  const SigningKey& signingKey
+) :
+  signingKeyBytes(signingKey.signingKeyBytes),
+  finalized(false)
+{
+  if (signingKeyBytes.length != crypto_sign_SECRETKEYBYTES) {
+    throw KeyLengthException("Invalid signing key size");
+  }
+  crypto_sign_init(&state);
+}
+
+StreamingSigner::~StreamingSigner() {
+  sodium_memzero(&state, sizeof state);
+}
+
+void StreamingSigner::update(
+  const unsigned char* data,
+  const size_t length
+) {
+  throwIfFinalized(finalized);
+  crypto_sign_update(&state, data, length);
+}
+
+void StreamingSigner::update(
+  const std::vector<unsigned char>& data
+) {
+  update(data.data(), data.size());
+}
+
+void StreamingSigner::update(
+  const SodiumBuffer& data
+) {
+  update(data.data, data.length);
+}
+
+void StreamingSigner::updateFromFile(
+  const std::string& path,
+  size_t bufferSize
+) {
+  throwIfFinalized(finalized);
+  readFileInChunks(path, bufferSize, [this](const unsigned char* data, size_t length) {
+    crypto_sign_update(&state, data, length);
+  });
+}
+
+void StreamingSigner::updateFromMemoryMappedFile(
+  const std::string& path,
+  size_t windowSize
+) {
+  throwIfFinalized(finalized);
+  mapFileInWindows(path, windowSize, [this](const unsigned char* data, size_t length) {
+    crypto_sign_update(&state, data, length);
+  });
+}
+
+const std::vector<unsigned char> StreamingSigner::finalize() {
+  throwIfFinalized(finalized);
+  finalized = true;
+  std::vector<unsigned char> signature(crypto_sign_BYTES);
+  crypto_sign_final_create(&state, signature.data(), NULL, signingKeyBytes.data);
+  return signature;
+}
+
+StreamingSignatureVerifier::StreamingSignatureVerifier(
+  const SignatureVerificationKey& signatureVerificationKey
+) :
+  signatureVerificationKeyBytes(signatureVerificationKey.signatureVerificationKeyBytes),
+  finalized(false)
+{
+  crypto_sign_init(&state);
+}
+
+StreamingSignatureVerifier::~StreamingSignatureVerifier() {}
+
+void StreamingSignatureVerifier::update(
+  const unsigned char* data,
+  const size_t length
+) {
+  throwIfFinalized(finalized);
+  crypto_sign_update(&state, data, length);
+}
+
+void StreamingSignatureVerifier::update(
+  const std::vector<unsigned char>& data
+) {
+  update(data.data(), data.size());
+}
+
+void StreamingSignatureVerifier::update(
+  const SodiumBuffer& data
+) {
+  update(data.data, data.length);
+}
+
+void StreamingSignatureVerifier::updateFromFile(
+  const std::string& path,
+  size_t bufferSize
+) {
+  throwIfFinalized(finalized);
+  readFileInChunks(path, bufferSize, [this](const unsigned char* data, size_t length) {
+    crypto_sign_update(&state, data, length);
+  });
+}
+
+void StreamingSignatureVerifier::updateFromMemoryMappedFile(
+  const std::string& path,
+  size_t windowSize
+) {
+  throwIfFinalized(finalized);
+  mapFileInWindows(path, windowSize, [this](const unsigned char* data, size_t length) {
+    crypto_sign_update(&state, data, length);
+  });
+}
+
+bool StreamingSignatureVerifier::verify(
+  const std::vector<unsigned char>& signature
+) {
+  throwIfFinalized(finalized);
+  finalized = true;
+  if (signature.size() != crypto_sign_BYTES) {
+    return false;
+  }
+  return crypto_sign_final_verify(
+    &state, signature.data(), signatureVerificationKeyBytes.data()
+  ) == 0;
+}
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "sodium-buffer.hpp"
+#include "signing-key.hpp"
+#include "signature-verification-key.hpp"
+
+/**
+ * @brief Sign a message too large to hold in memory by feeding it in
+ * pieces, using libsodium's Ed25519ph (pre-hashed Ed25519)
+ * crypto_sign_init/update/final_create.
+ *
+ * Ed25519ph signs a SHA-512 hash of the message rather than the message
+ * itself, so its signatures are _not_ interchangeable with those of
+ * SigningKey::generateSignature: verify them with a
+ * StreamingSignatureVerifier.  How the message is split between calls
+ * to update does not affect the signature.
+ *
+ * @ingroup DerivedFromSeeds
+ */
+class StreamingSigner {
+public:
+  /**
+   * @brief The default size of the buffer updateFromFile reads into
+   */
+  static const size_t defaultReadBufferSize = 1 << 20;
+  /**
+   * @brief The default size of the windows updateFromMemoryMappedFile maps
+   */
+  static const size_t defaultMappingWindowSize = 64 << 20;
+
+  /**
+   * @brief Start signing a message with a SigningKey (which is copied)
+   */
+  explicit StreamingSigner(
+    const SigningKey& signingKey
+  );
+
+  ~StreamingSigner();
+
+  StreamingSigner(const StreamingSigner&) = delete;
+  StreamingSigner& operator=(const StreamingSigner&) = delete;
+
+  /**
+   * @brief Append bytes to the message being signed
+   *
+   * @exception std::logic_error Thrown if called after finalize.
+   */
+  void update(
+    const unsigned char* data,
+    const size_t length
+  );
+
+  /**
+   * @brief Append bytes to the message being signed
+   */
+  void update(
+    const std::vector<unsigned char>& data
+  );
+
+  /**
+   * @brief Append bytes to the message being signed
+   */
+  void update(
+    const SodiumBuffer& data
+  );
+
+  /**
+   * @brief Append the contents of a file to the message being signed,
+   * reading it through a buffer of bufferSize bytes.
+   *
+   * @exception FileAccessException Thrown if the file cannot be read.
+   */
+  void updateFromFile(
+    const std::string& path,
+    size_t bufferSize = defaultReadBufferSize
+  );
+
+  /**
+   * @brief Append the contents of a file to the message being signed,
+   * mapping it into memory windowSize bytes at a time.
+   *
+   * @exception FileAccessException Thrown if the file cannot be mapped.
+   */
+  void updateFromMemoryMappedFile(
+    const std::string& path,
+    size_t windowSize = defaultMappingWindowSize
+  );
+
+  /**
+   * @brief Sign everything passed to update.  May only be called once.
+   *
+   * @return const std::vector<unsigned char> A crypto_sign_BYTES Ed25519ph signature
+   * @exception std::logic_error Thrown if called more than once.
+   */
+  const std::vector<unsigned char> finalize();
+
+private:
+  const SodiumBuffer signingKeyBytes;
+  crypto_sign_state state;
+  bool finalized;
+};
+
+/**
+ * @brief Verify a StreamingSigner's Ed25519ph signature of a message too
+ * large to hold in memory by feeding the message in pieces, using libsodium's
+ * crypto_sign_init/update/final_verify.
+ *
+ * @ingroup DerivedFromSeeds
+ */
+class StreamingSignatureVerifier {
+public:
+  /**
+   * @brief Start verifying a message with a SignatureVerificationKey
+   */
+  explicit StreamingSignatureVerifier(
+    const SignatureVerificationKey& signatureVerificationKey
+  );
+
+  ~StreamingSignatureVerifier();
+
+  StreamingSignatureVerifier(const StreamingSignatureVerifier&) = delete;
+  StreamingSignatureVerifier& operator=(const StreamingSignatureVerifier&) = delete;
+
+  /**
+   * @brief Append bytes to the message being verified
+   *
+   * @exception std::logic_error Thrown if called after verify.
+   */
+  void update(
+    const unsigned char* data,
+    const size_t length
+  );
+
+  /**
+   * @brief Append bytes to the message being verified
+   */
+  void update(
+    const std::vector<unsigned char>& data
+  );
+
+  /**
+   * @brief Append bytes to the message being verified
+   */
+  void update(
+    const SodiumBuffer& data
+  );
+
+  /**
+   * @brief Append the contents of a file to the message being verified,
+   * reading it through a buffer of bufferSize bytes.
+   *
+   * @exception FileAccessException Thrown if the file cannot be read.
+   */
+  void updateFromFile(
+    const std::string& path,
+    size_t bufferSize = StreamingSigner::defaultReadBufferSize
+  );
+
+  /**
+   * @brief Append the contents of a file to the message being verified,
+   * mapping it into memory windowSize bytes at a time.
+   *
+   * @exception FileAccessException Thrown if the file cannot be mapped.
+   */
+  void updateFromMemoryMappedFile(
+    const std::string& path,
+    size_t windowSize = StreamingSigner::defaultMappingWindowSize
+  );
+
+  /**
+   * @brief Verify the signature of everything passed to update.
+   * May only be called once.
+   *
+   * @param signature A signature from StreamingSigner::finalize
+   * @return true if the signature is valid
+   * @return false if the verification fails.
+   * @exception std::logic_error Thrown if called more than once.
+   */
+  bool verify(
+    const std::vector<unsigned char>& signature
+  );
+
+private:
+  const std::vector<unsigned char> signatureVerificationKeyBytes;
+  crypto_sign_state state;
+  bool finalized;
+};
@@ -3,12 +3,14 @@
 #include "packaged-sealed-message.hpp"
 #include "derivation-options.hpp"
 #include "exceptions.hpp"
+#include "work-stealing-pool.hpp"
+#include "crypto_box_seal_salted.h"
 
 void _crypto_secretbox_nonce_salted(
   unsigned char *nonce,
   const unsigned char *secret_key,
-  const unsigned char *message,
-  const size_t message_length,
+  const MessageFragment *message_fragments,
+  const size_t message_fragment_count,
   const char* salt,
   const size_t salt_length
 ) {
@@ -18,13 +20,27 @@ void _crypto_secretbox_nonce_salted(
     if (salt_length > 0) {
       crypto_generichash_update(&st, (const unsigned char*) salt, salt_length);
     }
-    crypto_generichash_update(&st, message, message_length);
+    for (size_t i = 0; i < message_fragment_count; i++) {
+      crypto_generichash_update(&st, message_fragments[i].data, message_fragments[i].length);
+    }
     crypto_generichash_final(&st, nonce, crypto_box_NONCEBYTES);
 }
 
+void _crypto_secretbox_nonce_salted(
+  unsigned char *nonce,
+  const unsigned char *secret_key,
+  const unsigned char *message,
+  const size_t message_length,
+  const char* salt,
+  const size_t salt_length
+) {
+    const MessageFragment message_fragment(message, message_length);
+    _crypto_secretbox_nonce_salted(nonce, secret_key, &message_fragment, 1, salt, salt_length);
+}
+
 SymmetricKey::SymmetricKey(
   const SodiumBuffer& _keyBytes,
-  const std::string _derivationOptionsJson
+  const InternedString& _derivationOptionsJson
 ) : keyBytes(_keyBytes), derivationOptionsJson(_derivationOptionsJson) {
   if (keyBytes.length != crypto_secretbox_KEYBYTES) {
     throw std::invalid_argument("Invalid key length");
@@ -37,7 +53,7 @@ SymmetricKey::SymmetricKey(
 
 SymmetricKey::SymmetricKey(
   const std::string& seedString,
-  const std::string& derivationOptionsJson
+  const InternedString& derivationOptionsJson
 ) : SymmetricKey(deriveFromSeed(seedString, derivationOptionsJson)) {}
 
 SymmetricKey SymmetricKey::deriveFromSeed(
@@ -55,6 +71,21 @@ SymmetricKey SymmetricKey::deriveFromSeed(
   );
 }
 
+SymmetricKey SymmetricKey::deriveFromRootSecret(
+  const Secret& rootSecret,
+  const std::string& _derivationOptionsJson
+) {
+  return SymmetricKey(
+    DerivationOptions::deriveChildSecret(
+      rootSecret.secretBytes,
+      _derivationOptionsJson,
+      DerivationOptionsJson::type::SymmetricKey,
+      crypto_secretbox_KEYBYTES
+    ),
+    _derivationOptionsJson
+  );
+}
+
 const std::vector<unsigned char> SymmetricKey::sealToCiphertextOnly(
   const unsigned char* message,
   const size_t messageLength,
@@ -86,6 +117,31 @@ const std::vector<unsigned char> SymmetricKey::sealToCiphertextOnly(
   return ciphertext;
 }
 
+const std::vector<unsigned char> SymmetricKey::sealToCiphertextOnly(
+  const std::vector<MessageFragment>& messageFragments,
+  const std::string& unsealingInstructions
+) const {
+  const size_t messageLength = MessageFragment::totalLength(messageFragments.data(), messageFragments.size());
+  if (messageLength <= 0) {
+    throw std::invalid_argument("Invalid message length");
+  }
+  std::vector<unsigned char> ciphertext(
+    crypto_secretbox_NONCEBYTES + messageLength + crypto_secretbox_MACBYTES
+  );
+  unsigned char* noncePtr = ciphertext.data();
+  _crypto_secretbox_nonce_salted(
+    noncePtr, keyBytes.data, messageFragments.data(), messageFragments.size(),
+    unsealingInstructions.c_str(), unsealingInstructions.length());
+  crypto_secretbox_xsalsa20poly1305_easy_fragments(
+    noncePtr + crypto_secretbox_NONCEBYTES,
+    messageFragments.data(),
+    messageFragments.size(),
+    noncePtr,
+    keyBytes.data
+  );
+  return ciphertext;
+}
+
 const std::vector<unsigned char> SymmetricKey::sealToCiphertextOnly(
   const SodiumBuffer &message,
   const std::string& unsealingInstructions
@@ -136,43 +192,178 @@ const PackagedSealedMessage SymmetricKey::seal(
   );
 }
 
-const SodiumBuffer SymmetricKey::unsealMessageContents(
-  const unsigned char* ciphertext,
-  const size_t ciphertextLength,
+const PackagedSealedMessage SymmetricKey::seal(
+  const std::vector<MessageFragment>& messageFragments,
   const std::string& unsealingInstructions
 ) const {
-  if (ciphertextLength <= (crypto_secretbox_MACBYTES + crypto_secretbox_NONCEBYTES)) {
-    throw std::invalid_argument("Invalid message length");
-  }
-  SodiumBuffer plaintextBuffer(ciphertextLength - (crypto_secretbox_MACBYTES + crypto_secretbox_NONCEBYTES));
-  const unsigned char* noncePtr = ciphertext;
-  const unsigned char* secretBoxStartPtr = noncePtr + crypto_secretbox_NONCEBYTES;
+  return PackagedSealedMessage(
+    sealToCiphertextOnly(messageFragments, unsealingInstructions),
+    derivationOptionsJson,
+    unsealingInstructions
+  );
+}
 
-  const int result = crypto_secretbox_open_easy(
-    plaintextBuffer.data,
-    secretBoxStartPtr,
-        ciphertextLength - crypto_secretbox_NONCEBYTES,
+const PackagedSealedMessage SymmetricKey::sealWithKeyId(
+  const unsigned char* message,
+  const size_t messageLength,
+  const std::string& unsealingInstructions
+) const {
+  return PackagedSealedMessage(
+    sealToCiphertextOnly(message, messageLength, unsealingInstructions),
+    derivationOptionsJson,
+    unsealingInstructions,
+    getKeyId()
+  );
+}
+
+const PackagedSealedMessage SymmetricKey::sealWithKeyId(
+  const std::vector<unsigned char>& message,
+  const std::string& unsealingInstructions
+) const {
+  return sealWithKeyId(message.data(), message.size(), unsealingInstructions);
+}
+
+const size_t SymmetricKey::keyIdBytes;
+
+// The string MACed to produce a key identifier, which differs from
+// any message that the key is otherwise used to authenticate
+static const std::string keyIdMacInput = "seeded-crypto:SymmetricKey:keyId";
+
+const std::vector<unsigned char> SymmetricKey::getKeyId() const {
+  std::vector<unsigned char> keyId(keyIdBytes);
+  crypto_generichash(
+    keyId.data(), keyIdBytes,
+    (const unsigned char*) keyIdMacInput.c_str(), keyIdMacInput.length(),
+    keyBytes.data, keyBytes.length
+  );
+  return keyId;
+}
+
+// Check the authenticator of a composite ciphertext (nonce, secret box)
+// without decrypting it, so that forged or corrupted ciphertexts can be
+// rejected before a plaintext buffer is allocated.  The ciphertext must be
+// longer than crypto_secretbox_NONCEBYTES + crypto_secretbox_MACBYTES.
+// Returns 0 if it is authentic and -1 if it is not.
+static int _crypto_secretbox_salted_verify(
+  const unsigned char *secret_key,
+  const unsigned char *ciphertext,
+  const size_t ciphertext_length
+) {
+  const unsigned char* noncePtr = ciphertext;
+  const unsigned char* macPtr = noncePtr + crypto_secretbox_NONCEBYTES;
+  return crypto_secretbox_xsalsa20poly1305_verify_only(
+    macPtr,
+    macPtr + crypto_secretbox_MACBYTES,
+    ciphertext_length - (crypto_secretbox_NONCEBYTES + crypto_secretbox_MACBYTES),
     noncePtr,
-    keyBytes.data
-      );
-   if (result != 0) {
-     throw CryptographicVerificationFailureException("Symmetric key unseal failed: the key or unsealing instructions must be different from those used to seal the message, or the ciphertext was modified/corrupted.");
-   }
+    secret_key
+  );
+}
+
+// Decrypt a composite ciphertext that _crypto_secretbox_salted_verify has
+// found to be authentic, and verify that the nonce matches the one derived
+// when sealing. The plaintext buffer must be
+// ciphertext_length - crypto_secretbox_NONCEBYTES - crypto_secretbox_MACBYTES
+// bytes long.  Returns 0 on success and -1 on failure.
+static int _crypto_secretbox_salted_open_verified(
+  unsigned char *plaintext,
+  const unsigned char *secret_key,
+  const unsigned char *ciphertext,
+  const size_t ciphertext_length,
+  const char* salt,
+  const size_t salt_length
+) {
+  const size_t plaintext_length = ciphertext_length - (crypto_secretbox_MACBYTES + crypto_secretbox_NONCEBYTES);
+  const unsigned char* noncePtr = ciphertext;
+  const unsigned char* boxStartPtr = noncePtr + crypto_secretbox_NONCEBYTES + crypto_secretbox_MACBYTES;
+
+  crypto_secretbox_xsalsa20poly1305_open_verified(
+    plaintext, boxStartPtr, plaintext_length, noncePtr, secret_key
+  );
 
   // Recalculate nonce to validate that the provided
   // unsealingInstructions is valid 
   unsigned char recalculatedNonce[crypto_secretbox_NONCEBYTES];
   _crypto_secretbox_nonce_salted(
-    recalculatedNonce, keyBytes.data, plaintextBuffer.data, plaintextBuffer.length,
-    unsealingInstructions.c_str(), unsealingInstructions.length()
+    recalculatedNonce, secret_key, plaintext, plaintext_length,
+    salt, salt_length
   );
-  if (memcmp(recalculatedNonce, noncePtr, crypto_secretbox_NONCEBYTES) != 0) {
+  if (sodium_memcmp(recalculatedNonce, noncePtr, crypto_secretbox_NONCEBYTES) != 0) {
+    sodium_memzero(plaintext, plaintext_length);
+    return -1;
+  }
+  return 0;
+}
+
+const SodiumBuffer SymmetricKey::unsealMessageContents(
+  const unsigned char* ciphertext,
+  const size_t ciphertextLength,
+  const std::string& unsealingInstructions
+) const {
+  if (ciphertextLength <= (crypto_secretbox_MACBYTES + crypto_secretbox_NONCEBYTES)) {
+    throw std::invalid_argument("Invalid message length");
+  }
+  if (_crypto_secretbox_salted_verify(keyBytes.data, ciphertext, ciphertextLength) != 0) {
+    throw CryptographicVerificationFailureException("Symmetric key unseal failed: the key or unsealing instructions must be different from those used to seal the message, or the ciphertext was modified/corrupted.");
+  }
+  SodiumBuffer plaintextBuffer(ciphertextLength - (crypto_secretbox_MACBYTES + crypto_secretbox_NONCEBYTES));
+  if (_crypto_secretbox_salted_open_verified(
+    plaintextBuffer.data, keyBytes.data, ciphertext, ciphertextLength,
+    unsealingInstructions.c_str(), unsealingInstructions.length()
+  ) != 0) {
      throw CryptographicVerificationFailureException("Symmetric key unseal failed: the key or unsealing instructions must be different from those used to seal the message, or the ciphertext was modified/corrupted.");
   }
 
   return plaintextBuffer;
 }
 
+Result<SodiumBuffer> SymmetricKey::tryUnseal(
+  const unsigned char* ciphertext,
+  const size_t ciphertextLength,
+  const std::string& unsealingInstructions
+) const {
+  if (ciphertextLength <= (crypto_secretbox_MACBYTES + crypto_secretbox_NONCEBYTES)) {
+    return Result<SodiumBuffer>(ResultStatus::InvalidInput);
+  }
+  if (_crypto_secretbox_salted_verify(keyBytes.data, ciphertext, ciphertextLength) != 0) {
+    return Result<SodiumBuffer>(ResultStatus::CryptographicVerificationFailure);
+  }
+  std::unique_ptr<SodiumBuffer> plaintext(new SodiumBuffer(
+    ciphertextLength - (crypto_secretbox_MACBYTES + crypto_secretbox_NONCEBYTES)
+  ));
+  if (_crypto_secretbox_salted_open_verified(
+    plaintext->data, keyBytes.data, ciphertext, ciphertextLength,
+    unsealingInstructions.c_str(), unsealingInstructions.length()
+  ) != 0) {
+    return Result<SodiumBuffer>(ResultStatus::CryptographicVerificationFailure);
+  }
+  return Result<SodiumBuffer>(std::move(plaintext));
+}
+
+Result<SodiumBuffer> SymmetricKey::tryUnseal(
+  const PackagedSealedMessage& packagedSealedMessage
+) const {
+  return tryUnseal(
+    packagedSealedMessage.ciphertext.data(), packagedSealedMessage.ciphertext.size(),
+    packagedSealedMessage.unsealingInstructions
+  );
+}
+
+std::vector<Result<SodiumBuffer>> SymmetricKey::unsealBatch(
+  const PackagedSealedMessage* packagedSealedMessages,
+  const size_t count
+) const {
+  return WorkStealingPool::getDefault().parallelMap<SodiumBuffer>(count, [this, packagedSealedMessages](size_t index) {
+    return tryUnseal(packagedSealedMessages[index]);
+  });
+}
+
+std::vector<Result<SodiumBuffer>> SymmetricKey::unsealBatch(
+  const std::vector<PackagedSealedMessage>& packagedSealedMessages
+) const {
+  return unsealBatch(packagedSealedMessages.data(), packagedSealedMessages.size());
+}
+
 const SodiumBuffer SymmetricKey::unseal(
   const unsigned char* ciphertext,
   const size_t ciphertextLength,
@@ -213,8 +404,10 @@ SymmetricKey SymmetricKey::fromJson(
 ) {
   try {
     nlohmann::json jsonObject = nlohmann::json::parse(symmetricKeyAsJson);
+    const BinaryEncoding binaryEncoding = binaryEncodingFromName(jsonObject.value<std::string>(
+      BinaryEncodingJsonField::binaryEncoding, binaryEncodingName(BinaryEncoding::Hex)));
     return SymmetricKey(
-      SodiumBuffer::fromHexString(jsonObject.at(SymmetricKeyJsonField::keyBytes)),
+      encodedStrToSodiumBuffer(jsonObject.at(SymmetricKeyJsonField::keyBytes), binaryEncoding),
       jsonObject.value(SymmetricKeyJsonField::derivationOptionsJson, "")
     );
   } catch (nlohmann::json::exception e) {
@@ -224,23 +417,31 @@ SymmetricKey SymmetricKey::fromJson(
 
 const std::string SymmetricKey::toJson(
   int indent,
-  const char indent_char
+  const char indent_char,
+  BinaryEncoding binaryEncoding
 ) const {
   nlohmann::json asJson;
-  asJson[SymmetricKeyJsonField::keyBytes] = keyBytes.toHexString();
+  asJson[SymmetricKeyJsonField::keyBytes] = toEncodedStr(keyBytes.data, keyBytes.length, binaryEncoding);
   if (derivationOptionsJson.size() > 0) {
     asJson[SymmetricKeyJsonField::derivationOptionsJson] = derivationOptionsJson;
   }
+  if (binaryEncoding != BinaryEncoding::Hex) {
+    asJson[BinaryEncodingJsonField::binaryEncoding] = binaryEncodingName(binaryEncoding);
+  }
   return asJson.dump(indent, indent_char);
 };
 
 
+size_t SymmetricKey::serializedSize() const {
+  return SodiumBuffer::fixedLengthListSize(keyBytes, derivationOptionsJson);
+}
+
+size_t SymmetricKey::serializeInto(unsigned char* out, size_t capacity) const {
+  return SodiumBuffer::writeFixedLengthList(out, capacity, keyBytes, derivationOptionsJson);
+}
+
 const SodiumBuffer SymmetricKey::toSerializedBinaryForm() const {
-  SodiumBuffer _derivationOptionsJson = SodiumBuffer(derivationOptionsJson);
-  return SodiumBuffer::combineFixedLengthList({
-    &keyBytes,
-    &_derivationOptionsJson
-  });
+  return SodiumBuffer::combineFixedLengthList(keyBytes, derivationOptionsJson);
 }
 
 SymmetricKey SymmetricKey::fromSerializedBinaryForm(const SodiumBuffer &serializedBinaryForm) {
@@ -2,7 +2,12 @@
 
 #include <string>
 #include "sodium-buffer.hpp"
+#include "convert.hpp"
+#include "secret.hpp"
+#include "interned-string.hpp"
 #include "packaged-sealed-message.hpp"
+#include "message-fragment.hpp"
+#include "result.hpp"
 
 /**
  * @brief A SymmetricKey can be used to seal and unseal messages.
@@ -47,14 +52,14 @@ class SymmetricKey {
   /**
    * @brief A @ref derivation_options_format string used to specify how this key is derived.
    */
-  const std::string derivationOptionsJson;
+  const InternedString derivationOptionsJson;
 
   /**
    * @brief Construct a SymmetricKey from its members
    */
   SymmetricKey(
     const SodiumBuffer& keyBytes,
-    std::string derivationOptionsJson
+    const InternedString& derivationOptionsJson
   );
 
   /**
@@ -87,7 +92,7 @@ class SymmetricKey {
    */
   SymmetricKey(
     const std::string& seedString,
-    const std::string& derivationOptionsJson
+    const InternedString& derivationOptionsJson
   );
 
   /**
@@ -105,6 +110,18 @@ class SymmetricKey {
     const std::string& derivationOptionsJson
   );
 
+  /**
+   * @brief Derive a SymmetricKey from a root Secret rather than from a seed
+   * string, as described for Secret::deriveFromRootSecret.
+   *
+   * @param rootSecret The root Secret, which must be 16 to 64 bytes long
+   * @param derivationOptionsJson The derivation options in @ref derivation_options_format.
+   */
+  static SymmetricKey deriveFromRootSecret(
+    const Secret& rootSecret,
+    const std::string& derivationOptionsJson
+  );
+
   /**
    * @brief Seal a plaintext message
    * 
@@ -142,6 +159,15 @@ class SymmetricKey {
     const std::string& unsealingInstructions = {}
   ) const;
 
+  /**
+   * @brief Seal a message held in several fragments to a ciphertext alone
+   * (see the fragment form of seal).
+   */
+  const std::vector<unsigned char> sealToCiphertextOnly(
+    const std::vector<MessageFragment>& messageFragments,
+    const std::string& unsealingInstructions = {}
+  ) const;
+
   /**
    * @brief Seal a plaintext message
    * 
@@ -213,6 +239,62 @@ class SymmetricKey {
     const std::string& unsealingInstructions = {}
   ) const;
 
+  /**
+   * @brief Seal a message held in several fragments, without first
+   * concatenating them.  The ciphertext (including the nonce, which is
+   * derived from the whole message) is the same as seal would produce
+   * for the fragments concatenated.
+   *
+   * @param messageFragments The pieces of the plaintext message, in order
+   * @param unsealingInstructions If this optional string is
+   * passed, the same string must be passed to unseal the message.
+   */
+  const PackagedSealedMessage seal(
+    const std::vector<MessageFragment>& messageFragments,
+    const std::string& unsealingInstructions = {}
+  ) const;
+
+  /**
+   * @brief Seal a plaintext message as seal does, and include this key's
+   * getKeyId in the PackagedSealedMessage so that a recipient holding
+   * many keys can find this key for it in a KeyRegistry.
+   * 
+   * @param message The plaintxt message to seal
+   * @param messageLength The length of the plaintext message to seal
+   * @param unsealingInstructions If this optional string is
+   * passed, the same string must be passed to unseal the message.
+   */
+  const PackagedSealedMessage sealWithKeyId(
+    const unsigned char* message,
+    const size_t messageLength,
+    const std::string& unsealingInstructions = {}
+  ) const;
+
+  /**
+   * @brief Seal a plaintext message and include this key's getKeyId
+   * (see the other form of sealWithKeyId).
+   */
+  const PackagedSealedMessage sealWithKeyId(
+    const std::vector<unsigned char>& message,
+    const std::string& unsealingInstructions = {}
+  ) const;
+
+  /**
+   * @brief The number of bytes in a key identifier (see getKeyId)
+   */
+  static const size_t keyIdBytes = 16;
+
+  /**
+   * @brief Get a short identifier for this key, with which a KeyRegistry
+   * can find it for a message sealed by sealWithKeyId.
+   * 
+   * The identifier is a BLAKE2b MAC, keyed with this key, of a fixed
+   * string, so it reveals nothing about the key itself.
+   * 
+   * @return const std::vector<unsigned char> of keyIdBytes bytes
+   */
+  const std::vector<unsigned char> getKeyId() const;
+
   /**
    * @brief Unseal a message 
    * 
@@ -261,6 +343,66 @@ class SymmetricKey {
     const PackagedSealedMessage& packagedSealedMessage
   ) const;
 
+  /**
+   * @brief Unseal a message without throwing if it cannot be unsealed.
+   * 
+   * The Poly1305 authenticator is checked before any memory is allocated
+   * for the plaintext, so a forged or corrupted ciphertext is rejected
+   * without allocating or throwing.
+   * 
+   * @param ciphertext The sealed message to be unsealed
+   * @param ciphertextLength The length of the sealed message
+   * @param unsealingInstructions The unsealing instructions used to seal the message
+   * @return Result<SodiumBuffer> The plaintext, or ResultStatus::InvalidInput
+   * if the ciphertext is too short to be a sealed message, or
+   * ResultStatus::CryptographicVerificationFailure if it is not authentic or
+   * the unsealingInstructions do not match.
+   */
+  Result<SodiumBuffer> tryUnseal(
+    const unsigned char* ciphertext,
+    const size_t ciphertextLength,
+    const std::string& unsealingInstructions = {}
+  ) const;
+
+  /**
+   * @brief Unseal a message from packaged format without throwing
+   * if it cannot be unsealed (see the other form of tryUnseal).
+   */
+  Result<SodiumBuffer> tryUnseal(
+    const PackagedSealedMessage& packagedSealedMessage
+  ) const;
+
+  /**
+   * @brief Unseal a batch of messages in parallel, on all processor
+   * cores, reporting the outcome of each message individually.
+   * 
+   * The derivationOptionsJson of each message is ignored
+   * since this SymmetricKey has already been instantiated.
+   * 
+   * @param packagedSealedMessages The messages to unseal
+   * @param count The number of messages
+   * @return std::vector<Result<SodiumBuffer>> The plaintext of each message,
+   * in the same order, or the reason it could not be unsealed.
+   * No exception is thrown if a message cannot be unsealed.
+   */
+  std::vector<Result<SodiumBuffer>> unsealBatch(
+    const PackagedSealedMessage* packagedSealedMessages,
+    const size_t count
+  ) const;
+
+  /**
+   * @brief Unseal a batch of messages in parallel, on all processor
+   * cores, reporting the outcome of each message individually.
+   * 
+   * @param packagedSealedMessages The messages to unseal
+   * @return std::vector<Result<SodiumBuffer>> The plaintext of each message,
+   * in the same order, or the reason it could not be unsealed.
+   * No exception is thrown if a message cannot be unsealed.
+   */
+  std::vector<Result<SodiumBuffer>> unsealBatch(
+    const std::vector<PackagedSealedMessage>& packagedSealedMessages
+  ) const;
+
   /**
    * @brief Unseal a message by re-deriving the SymmetricKey from a seed. 
    * 
@@ -282,11 +424,13 @@ class SymmetricKey {
    * 
    * @param indent The number of characters to indent the JSON (optional)
    * @param indent_char The character with which to indent the JSON (optional)
+   * @param binaryEncoding How binary fields are written (optional, hex by default)
    * @return const std::string A SymmetricKey serialized to JSON format.
    */
   const std::string toJson(
     int indent = -1,
-    const char indent_char = ' '
+    const char indent_char = ' ',
+    BinaryEncoding binaryEncoding = BinaryEncoding::Hex
   ) const;
 
 
@@ -299,6 +443,24 @@ class SymmetricKey {
    */
   const SodiumBuffer toSerializedBinaryForm() const;
 
+  /**
+   * @brief The exact number of bytes toSerializedBinaryForm produces
+   */
+  size_t serializedSize() const;
+
+  /**
+   * @brief Write the same bytes as toSerializedBinaryForm (keyBytes and derivationOptionsJson)
+   * into memory supplied by the caller, without allocating. Unlike a SodiumBuffer, that
+   * memory is not erased for you, and it will hold the key.
+   *
+   * @param out Where to write the serialized form
+   * @param capacity The number of bytes available at out, which must be at
+   * least serializedSize()
+   * @return size_t The number of bytes written
+   * @exception std::invalid_argument Thrown if capacity is too small.
+   */
+  size_t serializeInto(unsigned char* out, size_t capacity) const;
+
   /**
    * @brief Deserialize from a byte array stored as a list of:
    *   (keyBytes, derivationOptionsJson)
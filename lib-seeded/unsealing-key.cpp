@@ -1,40 +1,62 @@
+#include <algorithm>
 #include "github-com-nlohmann-json/json.hpp"
 #include "unsealing-key.hpp"
 #include "crypto_box_seal_salted.h"
 #include "derivation-options.hpp"
 #include "convert.hpp"
 #include "exceptions.hpp"
+#include "work-stealing-pool.hpp"
+#include "x25519-batch.hpp"
+
+static PublicKeyBytes checkedSealingKeyBytes(const std::vector<unsigned char>& sealingKeyBytes) {
+  if (sealingKeyBytes.size() != crypto_box_PUBLICKEYBYTES) {
+    throw InvalidDerivationOptionValueException("Invalid public key size");
+  }
+  return PublicKeyBytes(sealingKeyBytes.data());
+}
 
 UnsealingKey::UnsealingKey(
     const SodiumBuffer _unsealingKeyBytes,
     const std::vector<unsigned char> _sealingKeyBytes,
-    const std::string _derivationOptionsJson
+    const InternedString& _derivationOptionsJson
   ) :
     unsealingKeyBytes(_unsealingKeyBytes),
-    sealingKeyBytes(_sealingKeyBytes),
+    sealingKeyBytes(checkedSealingKeyBytes(_sealingKeyBytes)),
     derivationOptionsJson(_derivationOptionsJson)
     {
-    if (sealingKeyBytes.size() != crypto_box_PUBLICKEYBYTES) {
-      throw InvalidDerivationOptionValueException("Invalid public key size");
-    }
     if (unsealingKeyBytes.length != crypto_box_SECRETKEYBYTES) {
       throw InvalidDerivationOptionValueException("Invalid private key size for public/private key pair");
     }
   }
 
-UnsealingKey::UnsealingKey(
-  const SodiumBuffer &seedBuffer,
-  const std::string& _derivationOptionsJson
-) : derivationOptionsJson(_derivationOptionsJson), sealingKeyBytes(crypto_box_PUBLICKEYBYTES), unsealingKeyBytes(crypto_box_SECRETKEYBYTES) {
+// These two steps are those of crypto_box_seed_keypair, split so that each
+// member can be initialized with its half of the key pair
+static SodiumBuffer unsealingKeyFromSeed(const SodiumBuffer &seedBuffer) {
   if (seedBuffer.length < crypto_box_SEEDBYTES){
     throw std::invalid_argument("Insufficient seed length");
   }
-  crypto_box_seed_keypair((unsigned char *) sealingKeyBytes.data(), unsealingKeyBytes.data, seedBuffer.data);
+  SodiumBuffer hash(crypto_hash_sha512_BYTES);
+  crypto_hash_sha512(hash.data, seedBuffer.data, crypto_box_SEEDBYTES);
+  return SodiumBuffer(crypto_box_SECRETKEYBYTES, hash.data);
+}
+
+static PublicKeyBytes sealingKeyFromUnsealingKey(const SodiumBuffer &unsealingKeyBytes) {
+  PublicKeyBytes sealingKeyBytes;
+  crypto_scalarmult_base(sealingKeyBytes.data(), unsealingKeyBytes.data);
+  return sealingKeyBytes;
 }
 
+UnsealingKey::UnsealingKey(
+  const SodiumBuffer &seedBuffer,
+  const InternedString& _derivationOptionsJson
+) :
+  unsealingKeyBytes(unsealingKeyFromSeed(seedBuffer)),
+  sealingKeyBytes(sealingKeyFromUnsealingKey(unsealingKeyBytes)),
+  derivationOptionsJson(_derivationOptionsJson) {}
+
 UnsealingKey::UnsealingKey(
   const std::string& _seedString,
-  const std::string& _derivationOptionsJson
+  const InternedString& _derivationOptionsJson
 ) : UnsealingKey(deriveFromSeed(_seedString, _derivationOptionsJson)) {}
 
 UnsealingKey UnsealingKey::deriveFromSeed(
@@ -47,6 +69,16 @@ UnsealingKey UnsealingKey::deriveFromSeed(
   );
 }
 
+UnsealingKey UnsealingKey::deriveFromRootSecret(
+  const Secret& rootSecret,
+  const std::string& derivationOptionsJson
+) {
+  return UnsealingKey(
+    DerivationOptions::deriveChildSecret(rootSecret.secretBytes, derivationOptionsJson, DerivationOptionsJson::type::UnsealingKey, crypto_box_SEEDBYTES),
+    derivationOptionsJson
+  );
+}
+
 
 UnsealingKey::UnsealingKey(
   const UnsealingKey &other
@@ -81,6 +113,43 @@ const SodiumBuffer UnsealingKey::unseal(
   return plaintext;
 }
 
+Result<SodiumBuffer> UnsealingKey::tryUnseal(
+  const unsigned char* ciphertext,
+  const size_t ciphertextLength,
+  const std::string& unsealingInstructions
+) const {
+  if (ciphertextLength <= crypto_box_SEALBYTES) {
+    return Result<SodiumBuffer>(ResultStatus::InvalidInput);
+  }
+  // The ephemeral public key is the start of the ciphertext.
+  // Authenticate before allocating anything for the plaintext.
+  unsigned char boxKey[crypto_box_BEFORENMBYTES];
+  if (crypto_box_beforenm(boxKey, ciphertext, unsealingKeyBytes.data) != 0 ||
+      crypto_box_salted_seal_verify_afternm(
+        ciphertext, ciphertextLength, sealingKeyBytes.data(), boxKey,
+        unsealingInstructions.c_str(), unsealingInstructions.length()
+      ) != 0) {
+    sodium_memzero(boxKey, sizeof boxKey);
+    return Result<SodiumBuffer>(ResultStatus::CryptographicVerificationFailure);
+  }
+  std::unique_ptr<SodiumBuffer> plaintext(new SodiumBuffer(ciphertextLength - crypto_box_SEALBYTES));
+  crypto_box_salted_seal_open_verified_afternm(
+    plaintext->data, ciphertext, ciphertextLength, sealingKeyBytes.data(), boxKey,
+    unsealingInstructions.c_str(), unsealingInstructions.length()
+  );
+  sodium_memzero(boxKey, sizeof boxKey);
+  return Result<SodiumBuffer>(std::move(plaintext));
+}
+
+Result<SodiumBuffer> UnsealingKey::tryUnseal(
+  const PackagedSealedMessage& packagedSealedMessage
+) const {
+  return tryUnseal(
+    packagedSealedMessage.ciphertext.data(), packagedSealedMessage.ciphertext.size(),
+    packagedSealedMessage.unsealingInstructions
+  );
+}
+
 const SodiumBuffer UnsealingKey::unseal(
   const std::vector<unsigned char> &ciphertext,
   const std::string& unsealingInstructions
@@ -95,10 +164,95 @@ const SodiumBuffer UnsealingKey::unseal(
   return unseal(packagedSealedMessage.ciphertext, packagedSealedMessage.unsealingInstructions);
 }
 
+// Messages are unsealed in groups so that the X25519 operations for a
+// group can be computed together by boxBeforenmBatch
+static const size_t messagesPerBatchGroup = 8;
+
+std::vector<Result<SodiumBuffer>> UnsealingKey::unsealBatch(
+  const PackagedSealedMessage* packagedSealedMessages,
+  const size_t count
+) const {
+  std::vector<Result<SodiumBuffer>> results;
+  results.reserve(count);
+  for (size_t index = 0; index < count; index++) {
+    results.emplace_back(ResultStatus::InvalidInput);
+  }
+  const size_t groups = (count + messagesPerBatchGroup - 1) / messagesPerBatchGroup;
+  WorkStealingPool::getDefault().parallelFor(groups, [this, packagedSealedMessages, count, &results](size_t group) {
+    const size_t first = group * messagesPerBatchGroup;
+    const size_t last = std::min(count, first + messagesPerBatchGroup);
+    size_t indexes[messagesPerBatchGroup];
+    size_t validMessages = 0;
+    for (size_t index = first; index < last; index++) {
+      if (packagedSealedMessages[index].ciphertext.size() > crypto_box_SEALBYTES) {
+        indexes[validMessages++] = index;
+      }
+    }
+    if (validMessages == 0) {
+      return;
+    }
+    // Each message's ephemeral public key is the start of its ciphertext
+    unsigned char ephemeralPublicKeys[messagesPerBatchGroup * crypto_box_PUBLICKEYBYTES];
+    SodiumBuffer secretKeys(validMessages * crypto_box_SECRETKEYBYTES);
+    SodiumBuffer boxKeys(validMessages * crypto_box_BEFORENMBYTES);
+    int keyResults[messagesPerBatchGroup];
+    for (size_t i = 0; i < validMessages; i++) {
+      memcpy(ephemeralPublicKeys + i * crypto_box_PUBLICKEYBYTES, packagedSealedMessages[indexes[i]].ciphertext.data(), crypto_box_PUBLICKEYBYTES);
+      memcpy(secretKeys.data + i * crypto_box_SECRETKEYBYTES, unsealingKeyBytes.data, crypto_box_SECRETKEYBYTES);
+    }
+    boxBeforenmBatch(boxKeys.data, ephemeralPublicKeys, secretKeys.data, validMessages, keyResults);
+
+    for (size_t i = 0; i < validMessages; i++) {
+      const PackagedSealedMessage& message = packagedSealedMessages[indexes[i]];
+      if (keyResults[i] != 0 || crypto_box_salted_seal_verify_afternm(
+        message.ciphertext.data(),
+        message.ciphertext.size(),
+        sealingKeyBytes.data(),
+        boxKeys.data + i * crypto_box_BEFORENMBYTES,
+        message.unsealingInstructions.c_str(),
+        message.unsealingInstructions.length()
+      ) != 0) {
+        results[indexes[i]] = Result<SodiumBuffer>(ResultStatus::CryptographicVerificationFailure);
+        continue;
+      }
+      std::unique_ptr<SodiumBuffer> plaintext(new SodiumBuffer(message.ciphertext.size() - crypto_box_SEALBYTES));
+      crypto_box_salted_seal_open_verified_afternm(
+        plaintext->data,
+        message.ciphertext.data(),
+        message.ciphertext.size(),
+        sealingKeyBytes.data(),
+        boxKeys.data + i * crypto_box_BEFORENMBYTES,
+        message.unsealingInstructions.c_str(),
+        message.unsealingInstructions.length()
+      );
+      results[indexes[i]] = Result<SodiumBuffer>(std::move(plaintext));
+    }
+  });
+  return results;
+}
+
+std::vector<Result<SodiumBuffer>> UnsealingKey::unsealBatch(
+  const std::vector<PackagedSealedMessage>& packagedSealedMessages
+) const {
+  return unsealBatch(packagedSealedMessages.data(), packagedSealedMessages.size());
+}
+
+const SodiumBuffer UnsealingKey::unseal(
+  const MultiRecipientSealedMessage &multiRecipientSealedMessage
+) const {
+  return multiRecipientSealedMessage.unseal(sealingKeyBytes, unsealingKeyBytes);
+}
+
 const SealingKey UnsealingKey::getSealingKey() const {
   return SealingKey(sealingKeyBytes, derivationOptionsJson);
 }
 
+const std::vector<unsigned char> UnsealingKey::getKeyId() const {
+  std::vector<unsigned char> keyId(SealingKey::keyIdBytes);
+  SealingKey::getKeyId(sealingKeyBytes.data(), keyId.data());
+  return keyId;
+}
+
 
 /////
 //  JSON
@@ -114,9 +268,11 @@ UnsealingKey UnsealingKey::fromJson(
 ) {
   try {
     nlohmann::json jsonObject = nlohmann::json::parse(unsealingKeyAsJson);
+    const BinaryEncoding binaryEncoding = binaryEncodingFromName(jsonObject.value<std::string>(
+      BinaryEncodingJsonField::binaryEncoding, binaryEncodingName(BinaryEncoding::Hex)));
     return UnsealingKey(
-      SodiumBuffer::fromHexString(jsonObject.at(UnsealingKeyJsonField::unsealingKeyBytes)),
-      hexStrToByteVector(jsonObject.at(UnsealingKeyJsonField::sealingKeyBytes)),
+      encodedStrToSodiumBuffer(jsonObject.at(UnsealingKeyJsonField::unsealingKeyBytes), binaryEncoding),
+      encodedStrToByteVector(jsonObject.at(UnsealingKeyJsonField::sealingKeyBytes), binaryEncoding),
       jsonObject.value(UnsealingKeyJsonField::derivationOptionsJson, ""));
   } catch (nlohmann::json::exception e) {
     throw JsonParsingException(e.what());
@@ -125,25 +281,30 @@ UnsealingKey UnsealingKey::fromJson(
 
 const std::string UnsealingKey::toJson(
   int indent,
-  const char indent_char
+  const char indent_char,
+  BinaryEncoding binaryEncoding
 ) const {
   nlohmann::json asJson;
-  asJson[UnsealingKeyJsonField::unsealingKeyBytes] = unsealingKeyBytes.toHexString();
-  asJson[UnsealingKeyJsonField::sealingKeyBytes] = toHexStr(sealingKeyBytes);
+  asJson[UnsealingKeyJsonField::unsealingKeyBytes] = toEncodedStr(unsealingKeyBytes.data, unsealingKeyBytes.length, binaryEncoding);
+  asJson[UnsealingKeyJsonField::sealingKeyBytes] = toEncodedStr(sealingKeyBytes.data(), sealingKeyBytes.size(), binaryEncoding);
   asJson[UnsealingKeyJsonField::derivationOptionsJson] = derivationOptionsJson;
+  if (binaryEncoding != BinaryEncoding::Hex) {
+    asJson[BinaryEncodingJsonField::binaryEncoding] = binaryEncodingName(binaryEncoding);
+  }
   return asJson.dump(indent, indent_char);
 };
 
 
+size_t UnsealingKey::serializedSize() const {
+  return SodiumBuffer::fixedLengthListSize(unsealingKeyBytes, sealingKeyBytes, derivationOptionsJson);
+}
+
+size_t UnsealingKey::serializeInto(unsigned char* out, size_t capacity) const {
+  return SodiumBuffer::writeFixedLengthList(out, capacity, unsealingKeyBytes, sealingKeyBytes, derivationOptionsJson);
+}
+
 const SodiumBuffer UnsealingKey::toSerializedBinaryForm() const {
-  SodiumBuffer derivationOptionsJsonBuffer = SodiumBuffer(derivationOptionsJson);
-  SodiumBuffer _SealingKeyBytes(sealingKeyBytes);
-  SodiumBuffer _derivationOptionsJson(derivationOptionsJson);
-  return SodiumBuffer::combineFixedLengthList({
-    &unsealingKeyBytes,
-    &_SealingKeyBytes,
-    &_derivationOptionsJson
-  });
+  return SodiumBuffer::combineFixedLengthList(unsealingKeyBytes, sealingKeyBytes, derivationOptionsJson);
 }
 
 UnsealingKey UnsealingKey::fromSerializedBinaryForm(const SodiumBuffer &serializedBinaryForm) {
@@ -1,7 +1,11 @@
 #pragma once
 
 #include "sodium-buffer.hpp"
+#include "convert.hpp"
+#include "secret.hpp"
 #include "sealing-key.hpp"
+#include "multi-recipient-sealed-message.hpp"
+#include "result.hpp"
 
 /**
  * @brief an UnsealingKey is used to _unseal_ messages sealed with its
@@ -22,11 +26,11 @@ public:
   /**
    * @brief The libsodium public key used for sealing
    */
-  const std::vector<unsigned char> sealingKeyBytes;
+  const PublicKeyBytes sealingKeyBytes;
   /**
    * @brief A @ref derivation_options_format string used to specify how this key is derived.
    */
-  const std::string derivationOptionsJson;
+  const InternedString derivationOptionsJson;
 
   /**
    * @brief Construct a new UnsealingKey by passing its members.
@@ -34,7 +38,7 @@ public:
   UnsealingKey(
     const SodiumBuffer unsealingKeyBytes,
     const std::vector<unsigned char> sealingKeyBytes,
-    const std::string derivationOptionsJson
+    const InternedString& derivationOptionsJson
   );
 
   /**
@@ -47,7 +51,7 @@ public:
    */
   UnsealingKey(
     const SodiumBuffer& seedBuffer,
-    const std::string& derivationOptionsJson
+    const InternedString& derivationOptionsJson
   );
 
   /**
@@ -62,7 +66,7 @@ public:
    */
   UnsealingKey(
     const std::string& seedString,
-    const std::string& derivationOptionsJson
+    const InternedString& derivationOptionsJson
   );
 
   /**
@@ -80,6 +84,18 @@ public:
     const std::string& derivationOptionsJson
   );
 
+  /**
+   * @brief Derive a public/private key pair from a root Secret rather than
+   * from a seed string, as described for Secret::deriveFromRootSecret.
+   *
+   * @param rootSecret The root Secret, which must be 16 to 64 bytes long
+   * @param derivationOptionsJson The derivation options in @ref derivation_options_format.
+   */
+  static UnsealingKey deriveFromRootSecret(
+    const Secret& rootSecret,
+    const std::string& derivationOptionsJson
+  );
+
 
 
   /**
@@ -105,6 +121,17 @@ public:
    */
   const SealingKey getSealingKey() const;
 
+  /**
+   * @brief The bytes of this key's SealingKey, without copying them
+   */
+  const PublicKeyBytes& getSealingKeyByteArray() const { return sealingKeyBytes; }
+
+  /**
+   * @brief The identifier of this key's SealingKey (see SealingKey::getKeyId),
+   * which SealingKey::sealWithKeyId includes in the messages it seals.
+   */
+  const std::vector<unsigned char> getKeyId() const;
+
   /**
    * @brief Unseal a message 
    * 
@@ -155,6 +182,80 @@ public:
     const PackagedSealedMessage& packagedSealedMessage
   ) const;
 
+  /**
+   * @brief Unseal a message that was sealed to multiple recipients,
+   * one of which was this key's SealingKey.
+   * 
+   * @param multiRecipientSealedMessage The message to be unsealed
+   * @return const SodiumBuffer The plaintext message that had been sealed
+   * 
+   * @exception CryptographicVerificationFailureException Thrown if the message
+   * was not sealed to this key or the message was modified/corrupted.
+   */
+  const SodiumBuffer unseal(
+    const MultiRecipientSealedMessage& multiRecipientSealedMessage
+  ) const;
+
+  /**
+   * @brief Unseal a message without throwing if it cannot be unsealed,
+   * for code that must reject junk messages cheaply.
+   * 
+   * The ciphertext is authenticated before any memory is allocated for
+   * its plaintext, so rejecting a message costs one X25519 operation,
+   * a MAC check, and no allocations or exceptions.
+   * 
+   * @param ciphertext The sealed message to be unsealed
+   * @param ciphertextLength The length of the sealed message
+   * @param unsealingInstructions The unsealing instructions used to seal the message
+   * @return Result<SodiumBuffer> The plaintext, or ResultStatus::InvalidInput
+   * if the ciphertext is too short to be a sealed message, or
+   * ResultStatus::CryptographicVerificationFailure if it is not authentic.
+   */
+  Result<SodiumBuffer> tryUnseal(
+    const unsigned char* ciphertext,
+    const size_t ciphertextLength,
+    const std::string& unsealingInstructions
+  ) const;
+
+  /**
+   * @brief Unseal a message from packaged format without throwing
+   * if it cannot be unsealed (see the other form of tryUnseal).
+   */
+  Result<SodiumBuffer> tryUnseal(
+    const PackagedSealedMessage& packagedSealedMessage
+  ) const;
+
+  /**
+   * @brief Unseal a batch of messages in parallel, on all processor
+   * cores, reporting the outcome of each message individually.
+   * 
+   * The derivationOptionsJson of each message is ignored
+   * since this UnsealingKey has already been instantiated.
+   * 
+   * @param packagedSealedMessages The messages to unseal
+   * @param count The number of messages
+   * @return std::vector<Result<SodiumBuffer>> The plaintext of each message,
+   * in the same order, or the reason it could not be unsealed.
+   * No exception is thrown if a message cannot be unsealed.
+   */
+  std::vector<Result<SodiumBuffer>> unsealBatch(
+    const PackagedSealedMessage* packagedSealedMessages,
+    const size_t count
+  ) const;
+
+  /**
+   * @brief Unseal a batch of messages in parallel, on all processor
+   * cores, reporting the outcome of each message individually.
+   * 
+   * @param packagedSealedMessages The messages to unseal
+   * @return std::vector<Result<SodiumBuffer>> The plaintext of each message,
+   * in the same order, or the reason it could not be unsealed.
+   * No exception is thrown if a message cannot be unsealed.
+   */
+  std::vector<Result<SodiumBuffer>> unsealBatch(
+    const std::vector<PackagedSealedMessage>& packagedSealedMessages
+  ) const;
+
   /**
    * @brief Unseal a message by re-deriving the UnsealingKey from its seed. 
    * 
@@ -178,11 +279,13 @@ public:
    * 
    * @param indent The number of characters to indent the JSON (optional)
    * @param indent_char The character with which to indent the JSON (optional)
+   * @param binaryEncoding How binary fields are written (optional, hex by default)
    * @return const std::string an UnsealingKey serialized to JSON format.
    */
   const std::string toJson(
     int indent = -1,
-    const char indent_char = ' '
+    const char indent_char = ' ',
+    BinaryEncoding binaryEncoding = BinaryEncoding::Hex
   ) const;
 
   /**
@@ -194,6 +297,24 @@ public:
    */
   const SodiumBuffer toSerializedBinaryForm() const;
 
+  /**
+   * @brief The exact number of bytes toSerializedBinaryForm produces
+   */
+  size_t serializedSize() const;
+
+  /**
+   * @brief Write the same bytes as toSerializedBinaryForm (both key-byte fields and derivationOptionsJson)
+   * into memory supplied by the caller, without allocating. The caller must erase that
+   * memory once done with it, as it holds the private key.
+   *
+   * @param out Where to write the serialized form
+   * @param capacity The number of bytes available at out, which must be at
+   * least serializedSize()
+   * @return size_t The number of bytes written
+   * @exception std::invalid_argument Thrown if capacity is too small.
+   */
+  size_t serializeInto(unsigned char* out, size_t capacity) const;
+
   /**
    * @brief Deserialize from a byte array stored as a list of:
    *   (unsealingKeyBytes, sealingKeyBytes, derivationOptionsJson)
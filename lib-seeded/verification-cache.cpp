@@ -0,0 +1,224 @@
+#include <array>
+#include <list>
+#include <mutex>
+#include <string.h>
+#include <unordered_map>
+#include "sodium.h"
+#include "verification-cache.hpp"
+
+namespace {
+
+  typedef std::array<unsigned char, 32> Digest;
+
+  struct DigestHash {
+    size_t operator()(const Digest& digest) const {
+      // The digest is already uniformly distributed
+      size_t hash;
+      memcpy(&hash, digest.data(), sizeof hash);
+      return hash;
+    }
+  };
+
+  Digest digestOf(
+    const unsigned char* keyBytes, size_t keyBytesLength,
+    const MessageFragment* messageFragments, size_t messageFragmentCount,
+    const unsigned char* signature, size_t signatureLength
+  ) {
+    // Length-prefix the key and signature so that no two
+    // different triples hash the same input
+    unsigned char lengths[16];
+    for (size_t i = 0; i < 8; i++) {
+      lengths[i] = (unsigned char) ((uint64_t) keyBytesLength >> (8 * i));
+      lengths[8 + i] = (unsigned char) ((uint64_t) signatureLength >> (8 * i));
+    }
+    Digest digest;
+    crypto_generichash_state state;
+    crypto_generichash_init(&state, NULL, 0, digest.size());
+    crypto_generichash_update(&state, lengths, sizeof lengths);
+    crypto_generichash_update(&state, keyBytes, keyBytesLength);
+    crypto_generichash_update(&state, signature, signatureLength);
+    for (size_t i = 0; i < messageFragmentCount; i++) {
+      crypto_generichash_update(&state, messageFragments[i].data, messageFragments[i].length);
+    }
+    crypto_generichash_final(&state, digest.data(), digest.size());
+    return digest;
+  }
+
+  std::shared_ptr<VerificationCache> defaultVerificationCache;
+
+}
+
+struct VerificationCache::Shard {
+  struct Entry {
+    Digest digest;
+    std::vector<unsigned char> keyBytes;
+    Clock::time_point expires;
+  };
+
+  std::mutex mutex;
+  // Most recently used first
+  std::list<Entry> entries;
+  std::unordered_map<Digest, std::list<Entry>::iterator, DigestHash> index;
+  // Incremented whenever entries are invalidated, so that a verification
+  // that was in progress at the time does not add its entry afterwards
+  unsigned long long invalidationEpoch = 0;
+};
+
+VerificationCache::VerificationCache(
+  size_t maxEntries,
+  Clock::duration _timeToLive,
+  size_t shardCount
+) :
+  maxEntriesPerShard(
+    shardCount == 0 || maxEntries <= shardCount ? 1 : (maxEntries + shardCount - 1) / shardCount
+  ),
+  timeToLive(_timeToLive),
+  hits(0),
+  misses(0),
+  evictions(0),
+  expirations(0)
+{
+  for (size_t i = 0; i < (shardCount == 0 ? 1 : shardCount); i++) {
+    shards.push_back(std::unique_ptr<Shard>(new Shard()));
+  }
+}
+
+VerificationCache::~VerificationCache() {}
+
+bool VerificationCache::verify(
+  const unsigned char* signatureVerificationKeyBytes,
+  const size_t signatureVerificationKeyBytesLength,
+  const unsigned char* message,
+  const size_t messageLength,
+  const unsigned char* signature,
+  const size_t signatureLength,
+  const std::function<bool()>& verifyUncached
+) {
+  const MessageFragment messageFragment(message, messageLength);
+  return verify(
+    signatureVerificationKeyBytes, signatureVerificationKeyBytesLength,
+    &messageFragment, 1,
+    signature, signatureLength,
+    verifyUncached
+  );
+}
+
+bool VerificationCache::verify(
+  const unsigned char* signatureVerificationKeyBytes,
+  const size_t signatureVerificationKeyBytesLength,
+  const MessageFragment* messageFragments,
+  const size_t messageFragmentCount,
+  const unsigned char* signature,
+  const size_t signatureLength,
+  const std::function<bool()>& verifyUncached
+) {
+  const Digest digest = digestOf(
+    signatureVerificationKeyBytes, signatureVerificationKeyBytesLength,
+    messageFragments, messageFragmentCount,
+    signature, signatureLength
+  );
+  Shard& shard = *shards[DigestHash()(digest) % shards.size()];
+  unsigned long long epochBeforeVerifying;
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    epochBeforeVerifying = shard.invalidationEpoch;
+    auto found = shard.index.find(digest);
+    if (found != shard.index.end()) {
+      if (Clock::now() < found->second->expires) {
+        shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+        hits++;
+        return true;
+      }
+      shard.entries.erase(found->second);
+      shard.index.erase(found);
+      expirations++;
+    }
+  }
+  misses++;
+
+  // Verify without holding the lock, then cache only a success
+  if (!verifyUncached()) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  if (shard.invalidationEpoch != epochBeforeVerifying) {
+    // The key may have been revoked while it was being verified with:
+    // the signature was valid, but must not be remembered as valid
+    return true;
+  }
+  const Clock::time_point expires = Clock::now() + timeToLive;
+  auto found = shard.index.find(digest);
+  if (found != shard.index.end()) {
+    // Another thread verified the same triple concurrently
+    found->second->expires = expires;
+    shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+    return true;
+  }
+  shard.entries.push_front(Shard::Entry{
+    digest,
+    std::vector<unsigned char>(
+      signatureVerificationKeyBytes, signatureVerificationKeyBytes + signatureVerificationKeyBytesLength
+    ),
+    expires
+  });
+  shard.index[digest] = shard.entries.begin();
+  if (shard.entries.size() > maxEntriesPerShard) {
+    shard.index.erase(shard.entries.back().digest);
+    shard.entries.pop_back();
+    evictions++;
+  }
+  return true;
+}
+
+size_t VerificationCache::invalidateKey(
+  const unsigned char* signatureVerificationKeyBytes,
+  const size_t signatureVerificationKeyBytesLength
+) {
+  size_t removed = 0;
+  for (const std::unique_ptr<Shard>& shard : shards) {
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    shard->invalidationEpoch++;
+    for (auto entry = shard->entries.begin(); entry != shard->entries.end();) {
+      if (entry->keyBytes.size() == signatureVerificationKeyBytesLength &&
+          memcmp(entry->keyBytes.data(), signatureVerificationKeyBytes, signatureVerificationKeyBytesLength) == 0) {
+        shard->index.erase(entry->digest);
+        entry = shard->entries.erase(entry);
+        removed++;
+      } else {
+        ++entry;
+      }
+    }
+  }
+  return removed;
+}
+
+void VerificationCache::clear() {
+  for (const std::unique_ptr<Shard>& shard : shards) {
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    shard->invalidationEpoch++;
+    shard->index.clear();
+    shard->entries.clear();
+  }
+}
+
+size_t VerificationCache::size() const {
+  size_t total = 0;
+  for (const std::unique_ptr<Shard>& shard : shards) {
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    total += shard->entries.size();
+  }
+  return total;
+}
+
+double VerificationCache::getHitRate() const {
+  const double lookups = double(hits.load()) + double(misses.load());
+  return lookups == 0 ? 0 : double(hits.load()) / lookups;
+}
+
+void VerificationCache::setDefault(std::shared_ptr<VerificationCache> cache) {
+  std::atomic_store(&defaultVerificationCache, cache);
+}
+
+std::shared_ptr<VerificationCache> VerificationCache::getDefault() {
+  return std::atomic_load(&defaultVerificationCache);
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "message-fragment.hpp"
+
+/**
+ * @brief A bounded, thread-safe cache of signatures that have already
+ * been verified, so that a (key, message, signature) triple presented
+ * again and again (such as a signed token) is verified only once.
+ *
+ * Entries are keyed by BLAKE2b-256(key || signature || message) and only
+ * successful verifications are cached: a signature that failed is verified
+ * afresh every time it is presented.  Entries expire after a time-to-live
+ * and, when the cache is full, the least recently used are evicted.  The
+ * cache is split into independently locked shards to limit contention.
+ *
+ * Caches are opt-in.  To have SignatureVerificationKey::verify use one,
+ * install it by calling VerificationCache::setDefault.
+ *
+ * @ingroup BuildingBlocks
+ */
+class VerificationCache {
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  /**
+   * @brief Construct an empty cache
+   *
+   * @param maxEntries The most entries to hold across all shards
+   * @param timeToLive How long an entry remains valid after it is added
+   * @param shardCount The number of independently locked shards
+   */
+  VerificationCache(
+    size_t maxEntries = 65536,
+    Clock::duration timeToLive = std::chrono::minutes(5),
+    size_t shardCount = 16
+  );
+
+  ~VerificationCache();
+
+  VerificationCache(const VerificationCache&) = delete;
+  VerificationCache& operator=(const VerificationCache&) = delete;
+
+  /**
+   * @brief Return true if this (key, message, signature) triple is cached
+   * as valid.  Otherwise call verifyUncached and, if it returns true,
+   * cache the triple.
+   */
+  bool verify(
+    const unsigned char* signatureVerificationKeyBytes,
+    const size_t signatureVerificationKeyBytesLength,
+    const unsigned char* message,
+    const size_t messageLength,
+    const unsigned char* signature,
+    const size_t signatureLength,
+    const std::function<bool()>& verifyUncached
+  );
+
+  /**
+   * @brief The form of verify for a message held in several fragments,
+   * which shares its entries with the contiguous form: the digest is
+   * computed over the fragments in order, so a message has the same entry
+   * whether or not it was fragmented.
+   */
+  bool verify(
+    const unsigned char* signatureVerificationKeyBytes,
+    const size_t signatureVerificationKeyBytesLength,
+    const MessageFragment* messageFragments,
+    const size_t messageFragmentCount,
+    const unsigned char* signature,
+    const size_t signatureLength,
+    const std::function<bool()>& verifyUncached
+  );
+
+  /**
+   * @brief Remove every entry for signatures by a key, as when the key is
+   * revoked.  This scans the whole cache.  Verifications already in
+   * progress when it is called do not add entries afterwards.
+   *
+   * @return size_t The number of entries removed
+   */
+  size_t invalidateKey(
+    const unsigned char* signatureVerificationKeyBytes,
+    const size_t signatureVerificationKeyBytesLength
+  );
+
+  /**
+   * @brief Remove every entry
+   */
+  void clear();
+
+  /**
+   * @brief The number of entries currently cached (including any that
+   * have expired but not yet been removed)
+   */
+  size_t size() const;
+
+  /**
+   * @brief The number of calls to verify answered from the cache
+   */
+  unsigned long long getHits() const { return hits.load(); }
+
+  /**
+   * @brief The number of calls to verify that had to call verifyUncached
+   */
+  unsigned long long getMisses() const { return misses.load(); }
+
+  /**
+   * @brief The number of entries removed to make room for new ones
+   */
+  unsigned long long getEvictions() const { return evictions.load(); }
+
+  /**
+   * @brief The number of entries found to have outlived their time-to-live
+   */
+  unsigned long long getExpirations() const { return expirations.load(); }
+
+  /**
+   * @brief hits / (hits + misses), or 0 if verify has not been called
+   */
+  double getHitRate() const;
+
+  /**
+   * @brief Install a cache for SignatureVerificationKey::verify to use, or
+   * pass an empty pointer to stop caching.
+   */
+  static void setDefault(std::shared_ptr<VerificationCache> cache);
+
+  /**
+   * @brief The cache installed by setDefault (an empty pointer if none).
+   */
+  static std::shared_ptr<VerificationCache> getDefault();
+
+private:
+  struct Shard;
+
+  const size_t maxEntriesPerShard;
+  const Clock::duration timeToLive;
+  std::vector<std::unique_ptr<Shard>> shards;
+  std::atomic<unsigned long long> hits;
+  std::atomic<unsigned long long> misses;
+  std::atomic<unsigned long long> evictions;
+  std::atomic<unsigned long long> expirations;
+};
@@ -0,0 +1,163 @@
+#include "work-stealing-pool.hpp"
+
+// Set on threads while they are running a loop body, so that nested
+// calls to parallelFor run serially instead of waiting on the pool.
+static thread_local bool runningLoopBody = false;
+
+static size_t defaultThreadCount() {
+#ifdef __EMSCRIPTEN__
+  return 1;
+#else
+  const size_t cores = std::thread::hardware_concurrency();
+  return cores > 0 ? cores : 1;
+#endif
+}
+
+WorkStealingPool::WorkStealingPool(size_t _threadCount) :
+  threadCount(_threadCount > 0 ? _threadCount : defaultThreadCount()),
+  shares(new Share[threadCount]),
+  body(NULL),
+  generation(0),
+  workersRunning(0),
+  stopping(false)
+{
+  for (size_t i = 0; i < threadCount; i++) {
+    shares[i].begin = shares[i].end = 0;
+  }
+  // The thread calling parallelFor acts as worker 0
+  for (size_t workerIndex = 1; workerIndex < threadCount; workerIndex++) {
+    workers.push_back(std::thread(&WorkStealingPool::workerMain, this, workerIndex));
+  }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+  {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    stopping = true;
+  }
+  jobAvailable.notify_all();
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+}
+
+WorkStealingPool& WorkStealingPool::getDefault() {
+  static WorkStealingPool defaultPool;
+  return defaultPool;
+}
+
+bool WorkStealingPool::takeIndex(size_t workerIndex, size_t& index) {
+  Share& share = shares[workerIndex];
+  std::lock_guard<std::mutex> lock(share.mutex);
+  if (share.begin >= share.end) {
+    return false;
+  }
+  index = share.begin++;
+  return true;
+}
+
+bool WorkStealingPool::steal(size_t workerIndex) {
+  for (size_t offset = 1; offset < threadCount; offset++) {
+    Share& victim = shares[(workerIndex + offset) % threadCount];
+    size_t stolenBegin, stolenEnd;
+    {
+      std::lock_guard<std::mutex> lock(victim.mutex);
+      if (victim.begin >= victim.end) {
+        continue;
+      }
+      const size_t remaining = victim.end - victim.begin;
+      // Take the back half, leaving the victim the items it is about to start
+      stolenEnd = victim.end;
+      stolenBegin = victim.end - (remaining + 1) / 2;
+      victim.end = stolenBegin;
+    }
+    Share& share = shares[workerIndex];
+    std::lock_guard<std::mutex> lock(share.mutex);
+    share.begin = stolenBegin;
+    share.end = stolenEnd;
+    return true;
+  }
+  return false;
+}
+
+void WorkStealingPool::runShares(size_t workerIndex) {
+  runningLoopBody = true;
+  size_t index;
+  do {
+    while (takeIndex(workerIndex, index)) {
+      try {
+        (*body)(index);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        if (!firstException) {
+          firstException = std::current_exception();
+        }
+      }
+    }
+  } while (steal(workerIndex));
+  runningLoopBody = false;
+}
+
+void WorkStealingPool::workerMain(size_t workerIndex) {
+  unsigned long long lastGeneration = 0;
+  std::unique_lock<std::mutex> lock(stateMutex);
+  while (true) {
+    jobAvailable.wait(lock, [&]() { return stopping || generation != lastGeneration; });
+    if (stopping) {
+      return;
+    }
+    lastGeneration = generation;
+    lock.unlock();
+    runShares(workerIndex);
+    lock.lock();
+    if (--workersRunning == 0) {
+      jobComplete.notify_all();
+    }
+  }
+}
+
+void WorkStealingPool::parallelFor(
+  size_t count,
+  const std::function<void(size_t)>& _body
+) {
+  if (count == 0) {
+    return;
+  }
+  if (threadCount == 1 || count == 1 || runningLoopBody) {
+    for (size_t index = 0; index < count; index++) {
+      _body(index);
+    }
+    return;
+  }
+
+  std::lock_guard<std::mutex> jobLock(jobMutex);
+  for (size_t workerIndex = 0; workerIndex < threadCount; workerIndex++) {
+    std::lock_guard<std::mutex> lock(shares[workerIndex].mutex);
+    shares[workerIndex].begin = (count * workerIndex) / threadCount;
+    shares[workerIndex].end = (count * (workerIndex + 1)) / threadCount;
+  }
+  {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    body = &_body;
+    firstException = std::exception_ptr();
+    workersRunning = threadCount;
+    generation++;
+  }
+  jobAvailable.notify_all();
+
+  runShares(0);
+
+  std::exception_ptr exception;
+  {
+    std::unique_lock<std::mutex> lock(stateMutex);
+    if (--workersRunning > 0) {
+      jobComplete.wait(lock, [this]() { return workersRunning == 0; });
+    }
+    body = NULL;
+    exception = firstException;
+    firstException = std::exception_ptr();
+  }
+  if (exception) {
+    std::rethrow_exception(exception);
+  }
+}
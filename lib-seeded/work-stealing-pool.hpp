@@ -0,0 +1,119 @@
+#pragma once
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "result.hpp"
+
+/**
+ * @brief A pool of worker threads for running a loop body
+ * over a range of indexes in parallel.
+ * 
+ * Batch operations (e.g. UnsealingKey::unsealBatch) use the default pool
+ * to spread items across all processor cores.  Since items can be of very
+ * different sizes (one large message in a batch of small ones), the range is
+ * not simply split in equal parts: each thread starts with an equal share of
+ * indexes, and a thread that runs out of work steals the back half of the
+ * remaining share of another thread.
+ * 
+ * The calling thread works alongside the pool's threads, so a pool of
+ * one thread runs everything on the caller.  Calls to parallelFor from within
+ * a loop body run serially on the calling worker.
+ * 
+ * @ingroup BuildingBlocks
+ */
+class WorkStealingPool {
+public:
+  /**
+   * @brief Construct a pool
+   * 
+   * @param threadCount The number of threads to run loop bodies on, including
+   * the thread that calls parallelFor.  Defaults (0) to the number of processor cores.
+   */
+  explicit WorkStealingPool(size_t threadCount = 0);
+
+  /**
+   * @brief Stop and join the pool's threads
+   */
+  ~WorkStealingPool();
+
+  WorkStealingPool(const WorkStealingPool&) = delete;
+  WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+  /**
+   * @brief The number of threads that run loop bodies, including the caller
+   */
+  size_t getThreadCount() const { return threadCount; }
+
+  /**
+   * @brief Call body(i) for every i in [0, count), in parallel,
+   * returning once all calls have completed.
+   * 
+   * If any call throws, the remaining calls still run and the first
+   * exception is re-thrown to the caller.
+   */
+  void parallelFor(
+    size_t count,
+    const std::function<void(size_t)>& body
+  );
+
+  /**
+   * @brief Call fn(i) for every i in [0, count), in parallel, and
+   * return the results in order.
+   * 
+   * @tparam T The type of value held by each Result
+   * @param fn A function from an index to a Result<T>, which should
+   * report failures via the Result rather than throwing.
+   */
+  template <typename T, typename Fn>
+  std::vector<Result<T>> parallelMap(size_t count, Fn fn) {
+    std::vector<Result<T>> results;
+    results.reserve(count);
+    for (size_t index = 0; index < count; index++) {
+      results.emplace_back(ResultStatus::InvalidInput);
+    }
+    parallelFor(count, [&results, &fn](size_t index) {
+      results[index] = fn(index);
+    });
+    return results;
+  }
+
+  /**
+   * @brief The pool used by batch operations, which is
+   * created (with one thread per processor core) on first use.
+   */
+  static WorkStealingPool& getDefault();
+
+private:
+  // The indexes [begin, end) not yet started by one thread
+  struct Share {
+    std::mutex mutex;
+    size_t begin;
+    size_t end;
+  };
+
+  const size_t threadCount;
+  std::vector<std::thread> workers;
+  std::unique_ptr<Share[]> shares;
+
+  // Serializes calls to parallelFor
+  std::mutex jobMutex;
+
+  std::mutex stateMutex;
+  std::condition_variable jobAvailable;
+  std::condition_variable jobComplete;
+  const std::function<void(size_t)>* body;
+  unsigned long long generation;
+  size_t workersRunning;
+  bool stopping;
+  std::exception_ptr firstException;
+
+  void workerMain(size_t workerIndex);
+  void runShares(size_t workerIndex);
+  bool takeIndex(size_t workerIndex, size_t& index);
+  bool steal(size_t workerIndex);
+};
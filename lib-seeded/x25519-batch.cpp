@@ -0,0 +1,433 @@
+#include <string.h>
+#include "sodium.h"
+#include "x25519-batch.hpp"
+
+// The vectorized ladder is compiled for AVX2 with a function attribute, so
+// that the rest of the library still runs on processors without it, and
+// is only called when the processor reports AVX2 at runtime.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__)) && !defined(__EMSCRIPTEN__)
+  #define SEEDED_X25519_AVX2
+  #define SEEDED_AVX2_TARGET __attribute__((target("avx2")))
+#elif defined(_MSC_VER) && defined(_M_X64)
+  #define SEEDED_X25519_AVX2
+  #define SEEDED_AVX2_TARGET
+#endif
+
+#ifdef SEEDED_X25519_AVX2
+#include <immintrin.h>
+
+// The limb loops below have constant bounds and must be fully unrolled
+// (so that limbs stay in registers) even in builds that use -O2.
+#if defined(__clang__)
+  #define SEEDED_UNROLL _Pragma("unroll")
+#elif defined(__GNUC__) && __GNUC__ >= 8
+  #define SEEDED_UNROLL _Pragma("GCC unroll 10")
+#else
+  #define SEEDED_UNROLL
+#endif
+
+namespace {
+
+  // Field elements mod p = 2^255 - 19 in radix 2^25.5 (as in ref10): ten limbs,
+  // alternating 26 and 25 bits.  Each __m256i holds the same limb of four
+  // independent field elements, one per 64-bit lane.  Limbs are kept unsigned
+  // and below 2^26 (plus a small carry) between operations, so that each
+  // 32x32-bit partial product (times at most 38) fits in 64 bits.
+  struct fe4 {
+    __m256i v[10];
+  };
+
+  static const uint64_t mask26 = (1ULL << 26) - 1;
+  static const uint64_t mask25 = (1ULL << 25) - 1;
+
+  static inline bool limbHas26Bits(int i) { return (i & 1) == 0; }
+
+  SEEDED_AVX2_TARGET static inline void fe4_carry(fe4& h) {
+    const __m256i m26 = _mm256_set1_epi64x(mask26);
+    const __m256i m25 = _mm256_set1_epi64x(mask25);
+    SEEDED_UNROLL
+    for (int i = 0; i < 9; i++) {
+      const int bits = limbHas26Bits(i) ? 26 : 25;
+      const __m256i carry = _mm256_srli_epi64(h.v[i], bits);
+      h.v[i] = _mm256_and_si256(h.v[i], bits == 26 ? m26 : m25);
+      h.v[i + 1] = _mm256_add_epi64(h.v[i + 1], carry);
+    }
+    const __m256i carry9 = _mm256_srli_epi64(h.v[9], 25);
+    h.v[9] = _mm256_and_si256(h.v[9], m25);
+    // 2^255 = 19 mod p.  The carry can exceed 32 bits, so multiply
+    // by 19 = 16 + 2 + 1 with shifts rather than with _mm256_mul_epu32.
+    const __m256i carry9Times19 = _mm256_add_epi64(
+      _mm256_add_epi64(_mm256_slli_epi64(carry9, 4), _mm256_slli_epi64(carry9, 1)),
+      carry9
+    );
+    h.v[0] = _mm256_add_epi64(h.v[0], carry9Times19);
+    const __m256i carry0 = _mm256_srli_epi64(h.v[0], 26);
+    h.v[0] = _mm256_and_si256(h.v[0], m26);
+    h.v[1] = _mm256_add_epi64(h.v[1], carry0);
+  }
+
+  SEEDED_AVX2_TARGET static inline void fe4_add(fe4& h, const fe4& f, const fe4& g) {
+    SEEDED_UNROLL
+    for (int i = 0; i < 10; i++) {
+      h.v[i] = _mm256_add_epi64(f.v[i], g.v[i]);
+    }
+    fe4_carry(h);
+  }
+
+  // h = f - g, computed as f + 2p - g to stay non-negative
+  SEEDED_AVX2_TARGET static inline void fe4_sub(fe4& h, const fe4& f, const fe4& g) {
+    const __m256i twoP0 = _mm256_set1_epi64x(2 * ((1LL << 26) - 19));
+    const __m256i twoP26 = _mm256_set1_epi64x(2 * mask26);
+    const __m256i twoP25 = _mm256_set1_epi64x(2 * mask25);
+    SEEDED_UNROLL
+    for (int i = 0; i < 10; i++) {
+      const __m256i twoP = i == 0 ? twoP0 : (limbHas26Bits(i) ? twoP26 : twoP25);
+      h.v[i] = _mm256_sub_epi64(_mm256_add_epi64(f.v[i], twoP), g.v[i]);
+    }
+    fe4_carry(h);
+  }
+
+  SEEDED_AVX2_TARGET static inline void fe4_mul(fe4& h, const fe4& f, const fe4& g) {
+    const __m256i nineteen = _mm256_set1_epi64x(19);
+    __m256i g19[10];
+    __m256i f2[10];
+    SEEDED_UNROLL
+    for (int i = 0; i < 10; i++) {
+      g19[i] = _mm256_mul_epu32(g.v[i], nineteen);
+      f2[i] = limbHas26Bits(i) ? f.v[i] : _mm256_add_epi64(f.v[i], f.v[i]);
+    }
+    __m256i out[10];
+    SEEDED_UNROLL
+    for (int k = 0; k < 10; k++) {
+      out[k] = _mm256_setzero_si256();
+    }
+    SEEDED_UNROLL
+    for (int i = 0; i < 10; i++) {
+      SEEDED_UNROLL
+      for (int j = 0; j < 10; j++) {
+        // Limb i has weight 2^ceil(25.5 i); the product of two odd limbs
+        // lands half a bit above limb i + j's weight, so is doubled.
+        const __m256i fi = (i & j & 1) ? f2[i] : f.v[i];
+        if (i + j < 10) {
+          out[i + j] = _mm256_add_epi64(out[i + j], _mm256_mul_epu32(fi, g.v[j]));
+        } else {
+          out[i + j - 10] = _mm256_add_epi64(out[i + j - 10], _mm256_mul_epu32(fi, g19[j]));
+        }
+      }
+    }
+    SEEDED_UNROLL
+    for (int k = 0; k < 10; k++) {
+      h.v[k] = out[k];
+    }
+    fe4_carry(h);
+  }
+
+  // The same as fe4_mul(h, f, f), using each cross product
+  // f[i] * f[j] once (doubled) rather than twice
+  SEEDED_AVX2_TARGET static inline void fe4_sq(fe4& h, const fe4& f) {
+    const __m256i nineteen = _mm256_set1_epi64x(19);
+    __m256i f2[10], f4[10], f19[10];
+    SEEDED_UNROLL
+    for (int i = 0; i < 10; i++) {
+      f2[i] = _mm256_add_epi64(f.v[i], f.v[i]);
+      f4[i] = _mm256_add_epi64(f2[i], f2[i]);
+      f19[i] = _mm256_mul_epu32(f.v[i], nineteen);
+    }
+    __m256i out[10];
+    SEEDED_UNROLL
+    for (int k = 0; k < 10; k++) {
+      out[k] = _mm256_setzero_si256();
+    }
+    SEEDED_UNROLL
+    for (int i = 0; i < 10; i++) {
+      // The square term, doubled if the limb is odd
+      const __m256i square = _mm256_mul_epu32(
+        (i & 1) ? f2[i] : f.v[i],
+        2 * i < 10 ? f.v[i] : f19[i]
+      );
+      const int k = 2 * i < 10 ? 2 * i : 2 * i - 10;
+      out[k] = _mm256_add_epi64(out[k], square);
+      SEEDED_UNROLL
+      for (int j = i + 1; j < 10; j++) {
+        // Cross terms appear twice, and are doubled again if both limbs are odd
+        const __m256i cross = _mm256_mul_epu32(
+          (i & j & 1) ? f4[i] : f2[i],
+          i + j < 10 ? f.v[j] : f19[j]
+        );
+        const int kk = i + j < 10 ? i + j : i + j - 10;
+        out[kk] = _mm256_add_epi64(out[kk], cross);
+      }
+    }
+    SEEDED_UNROLL
+    for (int k = 0; k < 10; k++) {
+      h.v[k] = out[k];
+    }
+    fe4_carry(h);
+  }
+
+  SEEDED_AVX2_TARGET static inline void fe4_sqn(fe4& h, const fe4& f, int n) {
+    fe4_sq(h, f);
+    for (int i = 1; i < n; i++) {
+      fe4_sq(h, h);
+    }
+  }
+
+  SEEDED_AVX2_TARGET static inline void fe4_mul_small(fe4& h, const fe4& f, uint32_t small) {
+    const __m256i s = _mm256_set1_epi64x(small);
+    SEEDED_UNROLL
+    for (int i = 0; i < 10; i++) {
+      h.v[i] = _mm256_mul_epu32(f.v[i], s);
+    }
+    fe4_carry(h);
+  }
+
+  // Swap f and g in the lanes where mask is all ones
+  SEEDED_AVX2_TARGET static inline void fe4_cswap(fe4& f, fe4& g, __m256i mask) {
+    SEEDED_UNROLL
+    for (int i = 0; i < 10; i++) {
+      const __m256i t = _mm256_and_si256(mask, _mm256_xor_si256(f.v[i], g.v[i]));
+      f.v[i] = _mm256_xor_si256(f.v[i], t);
+      g.v[i] = _mm256_xor_si256(g.v[i], t);
+    }
+  }
+
+  // z^(p-2) = 1/z, using the addition chain from ref10
+  SEEDED_AVX2_TARGET static void fe4_invert(fe4& out, const fe4& z) {
+    fe4 z2, z9, z11, z2_5_0, z2_10_0, z2_20_0, z2_50_0, z2_100_0, t;
+    fe4_sq(z2, z);
+    fe4_sqn(t, z2, 2);
+    fe4_mul(z9, t, z);
+    fe4_mul(z11, z9, z2);
+    fe4_sq(t, z11);
+    fe4_mul(z2_5_0, t, z9);
+    fe4_sqn(t, z2_5_0, 5);
+    fe4_mul(z2_10_0, t, z2_5_0);
+    fe4_sqn(t, z2_10_0, 10);
+    fe4_mul(z2_20_0, t, z2_10_0);
+    fe4_sqn(t, z2_20_0, 20);
+    fe4_mul(t, t, z2_20_0);
+    fe4_sqn(t, t, 10);
+    fe4_mul(z2_50_0, t, z2_10_0);
+    fe4_sqn(t, z2_50_0, 50);
+    fe4_mul(z2_100_0, t, z2_50_0);
+    fe4_sqn(t, z2_100_0, 100);
+    fe4_mul(t, t, z2_100_0);
+    fe4_sqn(t, t, 50);
+    fe4_mul(t, t, z2_50_0);
+    fe4_sqn(t, t, 5);
+    fe4_mul(out, t, z11);
+  }
+
+  static inline uint64_t load32LittleEndian(const unsigned char* in) {
+    return (uint64_t) in[0] | ((uint64_t) in[1] << 8) | ((uint64_t) in[2] << 16) | ((uint64_t) in[3] << 24);
+  }
+
+  // Unpack a 32-byte u-coordinate, ignoring its top bit, as ref10's fe_frombytes does
+  static void unpackLimbs(uint64_t limbs[10], const unsigned char* s) {
+    limbs[0] = load32LittleEndian(s) & mask26;
+    limbs[1] = (load32LittleEndian(s + 3) >> 2) & mask25;
+    limbs[2] = (load32LittleEndian(s + 6) >> 3) & mask26;
+    limbs[3] = (load32LittleEndian(s + 9) >> 5) & mask25;
+    limbs[4] = (load32LittleEndian(s + 12) >> 6) & mask26;
+    limbs[5] = load32LittleEndian(s + 16) & mask25;
+    limbs[6] = (load32LittleEndian(s + 19) >> 1) & mask26;
+    limbs[7] = (load32LittleEndian(s + 22) >> 3) & mask25;
+    limbs[8] = (load32LittleEndian(s + 25) >> 4) & mask26;
+    limbs[9] = (load32LittleEndian(s + 28) >> 6) & mask25;
+  }
+
+  static void carryLimbs(uint64_t h[10]) {
+    for (int i = 0; i < 9; i++) {
+      const int bits = limbHas26Bits(i) ? 26 : 25;
+      h[i + 1] += h[i] >> bits;
+      h[i] &= bits == 26 ? mask26 : mask25;
+    }
+    h[0] += 19 * (h[9] >> 25);
+    h[9] &= mask25;
+  }
+
+  // Reduce fully mod p and pack as 32 little-endian bytes
+  static void packLimbs(unsigned char* s, const uint64_t limbs[10]) {
+    uint64_t h[10];
+    memcpy(h, limbs, sizeof(h));
+    // Three passes leave every limb within its width (h < 2^255)
+    carryLimbs(h);
+    carryLimbs(h);
+    carryLimbs(h);
+    // Subtract p if h >= p, i.e. if h + 19 >= 2^255
+    uint64_t q = (h[0] + 19) >> 26;
+    for (int i = 1; i < 10; i++) {
+      q = (h[i] + q) >> (limbHas26Bits(i) ? 26 : 25);
+    }
+    h[0] += 19 * q;
+    for (int i = 0; i < 9; i++) {
+      const int bits = limbHas26Bits(i) ? 26 : 25;
+      h[i + 1] += h[i] >> bits;
+      h[i] &= bits == 26 ? mask26 : mask25;
+    }
+    h[9] &= mask25;
+    // Concatenate the limbs' bits
+    uint64_t accumulator = 0;
+    int accumulatedBits = 0;
+    size_t outIndex = 0;
+    for (int i = 0; i < 10; i++) {
+      accumulator |= h[i] << accumulatedBits;
+      accumulatedBits += limbHas26Bits(i) ? 26 : 25;
+      while (accumulatedBits >= 8) {
+        s[outIndex++] = (unsigned char) accumulator;
+        accumulator >>= 8;
+        accumulatedBits -= 8;
+      }
+    }
+    s[outIndex] = (unsigned char) accumulator;
+  }
+
+  // Four X25519 operations: the Montgomery ladder from RFC 7748, section 5
+  SEEDED_AVX2_TARGET static void x25519x4(
+    unsigned char* q[4],
+    const unsigned char* n[4],
+    const unsigned char* p[4]
+  ) {
+    unsigned char e[4][32];
+    uint64_t limbs[4][10];
+    for (int lane = 0; lane < 4; lane++) {
+      memcpy(e[lane], n[lane], 32);
+      e[lane][0] &= 248;
+      e[lane][31] &= 127;
+      e[lane][31] |= 64;
+      unpackLimbs(limbs[lane], p[lane]);
+    }
+
+    fe4 x1, x2, z2, x3, z3;
+    for (int i = 0; i < 10; i++) {
+      x1.v[i] = _mm256_set_epi64x(limbs[3][i], limbs[2][i], limbs[1][i], limbs[0][i]);
+      x2.v[i] = _mm256_set1_epi64x(i == 0 ? 1 : 0);
+      z2.v[i] = _mm256_setzero_si256();
+      z3.v[i] = x2.v[i];
+    }
+    x3 = x1;
+
+    fe4 a, aa, b, bb, e4, c, d, da, cb, t;
+    __m256i swap = _mm256_setzero_si256();
+    for (int pos = 254; pos >= 0; pos--) {
+      const __m256i bit = _mm256_set_epi64x(
+        -(int64_t) ((e[3][pos >> 3] >> (pos & 7)) & 1),
+        -(int64_t) ((e[2][pos >> 3] >> (pos & 7)) & 1),
+        -(int64_t) ((e[1][pos >> 3] >> (pos & 7)) & 1),
+        -(int64_t) ((e[0][pos >> 3] >> (pos & 7)) & 1)
+      );
+      swap = _mm256_xor_si256(swap, bit);
+      fe4_cswap(x2, x3, swap);
+      fe4_cswap(z2, z3, swap);
+      swap = bit;
+
+      fe4_add(a, x2, z2);
+      fe4_sq(aa, a);
+      fe4_sub(b, x2, z2);
+      fe4_sq(bb, b);
+      fe4_sub(e4, aa, bb);
+      fe4_add(c, x3, z3);
+      fe4_sub(d, x3, z3);
+      fe4_mul(da, d, a);
+      fe4_mul(cb, c, b);
+      fe4_add(t, da, cb);
+      fe4_sq(x3, t);
+      fe4_sub(t, da, cb);
+      fe4_sq(t, t);
+      fe4_mul(z3, x1, t);
+      fe4_mul(x2, aa, bb);
+      fe4_mul_small(t, e4, 121665);
+      fe4_add(t, aa, t);
+      fe4_mul(z2, e4, t);
+    }
+    fe4_cswap(x2, x3, swap);
+    fe4_cswap(z2, z3, swap);
+
+    fe4_invert(z2, z2);
+    fe4_mul(x2, x2, z2);
+
+    uint64_t out[10][4];
+    for (int i = 0; i < 10; i++) {
+      _mm256_storeu_si256((__m256i*) out[i], x2.v[i]);
+    }
+    for (int lane = 0; lane < 4; lane++) {
+      for (int i = 0; i < 10; i++) {
+        limbs[lane][i] = out[i][lane];
+      }
+      packLimbs(q[lane], limbs[lane]);
+    }
+    sodium_memzero(e, sizeof(e));
+  }
+
+}
+#endif
+
+bool x25519BatchIsVectorized() {
+#ifdef SEEDED_X25519_AVX2
+  return sodium_runtime_has_avx2() != 0;
+#else
+  return false;
+#endif
+}
+
+void x25519Batch(
+  unsigned char* sharedSecrets,
+  const unsigned char* scalars,
+  const unsigned char* points,
+  const size_t count,
+  int* results
+) {
+  size_t done = 0;
+#ifdef SEEDED_X25519_AVX2
+  if (x25519BatchIsVectorized()) {
+    for (; done < count; done += 4) {
+      // Fill unused lanes of the last group by repeating its first item
+      unsigned char spareOutputs[4][crypto_scalarmult_BYTES];
+      unsigned char* q[4];
+      const unsigned char* n[4];
+      const unsigned char* p[4];
+      for (size_t lane = 0; lane < 4; lane++) {
+        const size_t item = done + lane < count ? done + lane : done;
+        q[lane] = done + lane < count ? sharedSecrets + item * crypto_scalarmult_BYTES : spareOutputs[lane];
+        n[lane] = scalars + item * crypto_scalarmult_SCALARBYTES;
+        p[lane] = points + item * crypto_scalarmult_BYTES;
+      }
+      x25519x4(q, n, p);
+      sodium_memzero(spareOutputs, sizeof(spareOutputs));
+    }
+    for (size_t item = 0; item < count; item++) {
+      // As crypto_scalarmult does, reject all-zero shared secrets
+      // (the result of multiplying a point of small order)
+      results[item] = sodium_is_zero(sharedSecrets + item * crypto_scalarmult_BYTES, crypto_scalarmult_BYTES) ? -1 : 0;
+    }
+    return;
+  }
+#endif
+  for (; done < count; done++) {
+    results[done] = crypto_scalarmult(
+      sharedSecrets + done * crypto_scalarmult_BYTES,
+      scalars + done * crypto_scalarmult_SCALARBYTES,
+      points + done * crypto_scalarmult_BYTES
+    );
+  }
+}
+
+void boxBeforenmBatch(
+  unsigned char* keys,
+  const unsigned char* publicKeys,
+  const unsigned char* secretKeys,
+  const size_t count,
+  int* results
+) {
+  static const unsigned char zeroNonce[16] = {0};
+  unsigned char sharedSecret[crypto_scalarmult_BYTES];
+  // The shared secrets are replaced by the keys derived from them,
+  // as in crypto_box_curve25519xsalsa20poly1305_beforenm
+  x25519Batch(keys, secretKeys, publicKeys, count, results);
+  for (size_t item = 0; item < count; item++) {
+    unsigned char* key = keys + item * crypto_box_BEFORENMBYTES;
+    memcpy(sharedSecret, key, sizeof sharedSecret);
+    crypto_core_hsalsa20(key, zeroNonce, sharedSecret, NULL);
+  }
+  sodium_memzero(sharedSecret, sizeof sharedSecret);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * @brief Compute count X25519 scalar multiplications,
+ * sharedSecrets[i] = X25519(scalars[i], points[i]),
+ * the same operation as libsodium's crypto_scalarmult.
+ * 
+ * On x86 processors with AVX2 this runs four multiplications at once,
+ * one per 64-bit lane, with a vectorized Montgomery ladder.  Otherwise
+ * it calls crypto_scalarmult for each item.  Either way the outputs
+ * are bit-identical to crypto_scalarmult's, including its rejection
+ * of points that yield an all-zero shared secret.
+ * 
+ * @param sharedSecrets Output, count * crypto_scalarmult_BYTES bytes
+ * @param scalars count * crypto_scalarmult_SCALARBYTES bytes of (unclamped) secret keys
+ * @param points count * crypto_scalarmult_BYTES bytes of public keys
+ * @param count The number of scalar multiplications
+ * @param results Output, count ints, set to 0 on success or -1 if the
+ * shared secret is all zeros (as crypto_scalarmult would return)
+ * 
+ * @ingroup BuildingBlocks
+ */
+void x25519Batch(
+  unsigned char* sharedSecrets,
+  const unsigned char* scalars,
+  const unsigned char* points,
+  const size_t count,
+  int* results
+);
+
+/**
+ * @brief true if x25519Batch will use the vectorized (AVX2) implementation
+ * on this processor.
+ */
+bool x25519BatchIsVectorized();
+
+/**
+ * @brief Compute count crypto_box_beforenm keys,
+ * keys[i] = crypto_box_beforenm(publicKeys[i], secretKeys[i]),
+ * using x25519Batch for the scalar multiplications.
+ * 
+ * @param keys Output, count * crypto_box_BEFORENMBYTES bytes
+ * @param publicKeys count * crypto_box_PUBLICKEYBYTES bytes
+ * @param secretKeys count * crypto_box_SECRETKEYBYTES bytes
+ * @param count The number of keys to compute
+ * @param results Output, count ints, set to 0 on success or -1 where
+ * crypto_box_beforenm would fail
+ */
+void boxBeforenmBatch(
+  unsigned char* keys,
+  const unsigned char* publicKeys,
+  const unsigned char* secretKeys,
+  const size_t count,
+  int* results
+);
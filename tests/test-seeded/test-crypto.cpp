@@ -1,8 +1,18 @@
 #include "gtest/gtest.h"
 #include <string>
 #include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#ifndef _WIN32
+	#include <signal.h>
+	#include <sys/resource.h>
+#endif
 #include "lib-seeded.hpp"
 #include "../lib-seeded/convert.hpp"
+#include "../lib-seeded/crypto_box_seal_salted.h"
 
 
 const std::string orderedTestKey = "A1tB2rC3bD4lE5tF6bG1tH1tI1tJ1tK1tL1tM1tN1tO1tP1tR1tS1tT1tU1tV1tW1tX1tY1tZ1t";
@@ -178,6 +188,31 @@ TEST(SealingKey, EncryptsAndDecryptsPackaged) {
 	ASSERT_EQ(messageVector, unsealedPlaintext);
 }
 
+TEST(SealingKey, EncryptsAndDecryptsWithEphemeralKeyPool) {
+	const UnsealingKey testUnsealingKey(orderedTestKey, defaultTestPublicDerivationOptionsJson);
+	const SealingKey testSealingKey = testUnsealingKey.getSealingKey();
+
+	std::shared_ptr<EphemeralKeyPool> pool = std::make_shared<EphemeralKeyPool>(8);
+	pool->fill();
+	ASSERT_EQ(pool->available(), pool->getCapacity());
+	EphemeralKeyPool::setDefault(pool);
+
+	const std::vector<unsigned char> messageVector = { 'y', 'o', 't', 'o' };
+	const std::string unsealingInstructions = "{}";
+	const auto sealedMessage = testSealingKey.sealToCiphertextOnly(messageVector.data(), messageVector.size(), unsealingInstructions);
+	const auto secondSealedMessage = testSealingKey.sealToCiphertextOnly(messageVector.data(), messageVector.size(), unsealingInstructions);
+	EphemeralKeyPool::setDefault(std::shared_ptr<EphemeralKeyPool>());
+
+	ASSERT_EQ(pool->getHits(), 2);
+	// Each seal must use a different ephemeral public key
+	ASSERT_NE(
+		toHexStr(std::vector<unsigned char>(sealedMessage.begin(), sealedMessage.begin() + crypto_box_PUBLICKEYBYTES)),
+		toHexStr(std::vector<unsigned char>(secondSealedMessage.begin(), secondSealedMessage.begin() + crypto_box_PUBLICKEYBYTES))
+	);
+	ASSERT_EQ(messageVector, testUnsealingKey.unseal(sealedMessage, unsealingInstructions).toVector());
+	ASSERT_EQ(messageVector, testUnsealingKey.unseal(secondSealedMessage, unsealingInstructions).toVector());
+}
+
 
 TEST(SigningKey, GetsSigningKey) {
 	SigningKey testSigningKey(orderedTestKey, defaultTestSigningDerivationOptionsJson);
@@ -254,6 +289,525 @@ TEST(SigningKey, Verification) {
 	ASSERT_FALSE(shouldVerifyAsFalse);
 }
 
+TEST(SigningKey, SignaturesMatchLibsodium) {
+	const SigningKey testSigningKey(orderedTestKey, defaultTestSigningDerivationOptionsJson);
+	const SigningKey copy(testSigningKey);
+	const SigningKey fromBinary = SigningKey::fromSerializedBinaryForm(testSigningKey.toSerializedBinaryForm());
+	for (size_t length : { 0, 1, 63, 64, 111, 112, 128, 1024, 5000 }) {
+		std::vector<unsigned char> message(length);
+		randombytes_buf(message.data(), message.size());
+		std::vector<unsigned char> expected(crypto_sign_BYTES);
+		crypto_sign_detached(expected.data(), NULL, message.data(), message.size(), testSigningKey.signingKeyBytes.data);
+		ASSERT_EQ(testSigningKey.generateSignature(message), expected);
+		ASSERT_EQ(copy.generateSignature(message), expected);
+		ASSERT_EQ(fromBinary.generateSignature(message), expected);
+	}
+}
+
+TEST(SignatureVerificationKey, PreparedVerifierMatchesLibsodium) {
+	SigningKey testSigningKey(orderedTestKey, defaultTestSigningDerivationOptionsJson);
+	const std::vector<unsigned char> key = testSigningKey.getSignatureVerificationKeyBytes();
+	const PreparedSignatureVerifier prepared(key);
+	const auto agreesWithLibsodium = [&](
+		const std::vector<unsigned char>& verifierKey,
+		const PreparedSignatureVerifier& verifier,
+		const std::vector<unsigned char>& message,
+		const std::vector<unsigned char>& signature
+	) {
+		const bool expected = crypto_sign_verify_detached(
+			signature.data(), message.data(), message.size(), verifierKey.data()) == 0;
+		return verifier.verify(message.data(), message.size(), signature.data(), signature.size()) == expected;
+	};
+	for (size_t length : { 0, 1, 64, 1000 }) {
+		std::vector<unsigned char> message(length);
+		randombytes_buf(message.data(), message.size());
+		const std::vector<unsigned char> signature = testSigningKey.generateSignature(message);
+		ASSERT_TRUE(prepared.verify(message.data(), message.size(), signature.data(), signature.size()));
+		// Every single-bit change to the signature
+		for (size_t bit = 0; bit < 8 * signature.size(); bit++) {
+			std::vector<unsigned char> tampered(signature);
+			tampered[bit / 8] ^= (unsigned char) (1 << (bit % 8));
+			ASSERT_TRUE(agreesWithLibsodium(key, prepared, message, tampered));
+		}
+		if (length > 0) {
+			std::vector<unsigned char> tamperedMessage(message);
+			tamperedMessage[0] ^= 1;
+			ASSERT_FALSE(prepared.verify(tamperedMessage.data(), tamperedMessage.size(), signature.data(), signature.size()));
+		}
+	}
+	// A non-canonical S (S + L) and small-order R and keys are rejected as libsodium rejects them
+	const std::vector<unsigned char> message = { 'y', 'o', 't', 'o' };
+	const std::vector<unsigned char> signature = testSigningKey.generateSignature(message);
+	const std::vector<unsigned char> groupOrder = hexStrToByteVector(
+		"edd3f55c1a631258d69cf7a2def9de1400000000000000000000000000000010");
+	std::vector<unsigned char> nonCanonical(signature);
+	unsigned int carry = 0;
+	for (size_t i = 0; i < 32; i++) {
+		carry += signature[32 + i] + groupOrder[i];
+		nonCanonical[32 + i] = (unsigned char) carry;
+		carry >>= 8;
+	}
+	ASSERT_TRUE(agreesWithLibsodium(key, prepared, message, nonCanonical));
+	ASSERT_FALSE(prepared.verify(message.data(), message.size(), nonCanonical.data(), nonCanonical.size()));
+	const char* smallOrderPoints[] = {
+		"0000000000000000000000000000000000000000000000000000000000000000",
+		"0100000000000000000000000000000000000000000000000000000000000000",
+		"26e8958fc2b227b045c3f489f2ef98f0d5dfac05d3c63339b13802886d53fc05",
+		"c7176a703d4dd84fba3c0b760d10670f2a2053fa2c39ccc64ec7fd7792ac037a",
+		"ecffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff7f",
+		"edffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff7f"
+	};
+	for (const char* point : smallOrderPoints) {
+		const std::vector<unsigned char> smallOrder = hexStrToByteVector(point);
+		std::vector<unsigned char> smallOrderR(signature);
+		std::copy(smallOrder.begin(), smallOrder.end(), smallOrderR.begin());
+		ASSERT_TRUE(agreesWithLibsodium(key, prepared, message, smallOrderR));
+		const PreparedSignatureVerifier smallOrderKey(smallOrder);
+		ASSERT_TRUE(agreesWithLibsodium(smallOrder, smallOrderKey, message, signature));
+	}
+	ASSERT_THROW(PreparedSignatureVerifier(std::vector<unsigned char>(31)), KeyLengthException);
+}
+
+TEST(SignatureVerificationKey, PreparedForRepeatedVerification) {
+	SigningKey testSigningKey(orderedTestKey, defaultTestSigningDerivationOptionsJson);
+	const SignatureVerificationKey key = testSigningKey.getSignatureVerificationKey();
+	const std::vector<unsigned char> message = { 'y', 'o', 't', 'o' };
+	const std::vector<unsigned char> signature = testSigningKey.generateSignature(message);
+	const std::vector<unsigned char> otherMessage = { 'y', 'o', 'l', 'o' };
+
+	ASSERT_FALSE(key.isPreparedForRepeatedVerification());
+	key.prepareForRepeatedVerification();
+	ASSERT_TRUE(key.isPreparedForRepeatedVerification());
+	ASSERT_TRUE(key.verify(message, signature));
+	ASSERT_FALSE(key.verify(otherMessage, signature));
+	const SignatureVerificationKey copy(key);
+	ASSERT_TRUE(copy.isPreparedForRepeatedVerification());
+	ASSERT_TRUE(copy.verify(message, signature));
+
+	// The static methods find the prepared key in the process-wide cache
+	ASSERT_TRUE(PreparedSignatureVerifier::findPrepared(key.signatureVerificationKeyBytes.data(), key.signatureVerificationKeyBytes.size()) != nullptr);
+	ASSERT_TRUE(SignatureVerificationKey::verify(key.signatureVerificationKeyBytes, message.data(), message.size(), signature));
+	ASSERT_FALSE(SignatureVerificationKey::verify(key.signatureVerificationKeyBytes, otherMessage.data(), otherMessage.size(), signature));
+	PreparedSignatureVerifier::forgetAll();
+	ASSERT_TRUE(PreparedSignatureVerifier::findPrepared(key.signatureVerificationKeyBytes.data(), key.signatureVerificationKeyBytes.size()) == nullptr);
+	ASSERT_TRUE(key.verify(message, signature));
+}
+
+TEST(PreparedSignatureVerifier, BoundsTheProcessWideCache) {
+	PreparedSignatureVerifier::forgetAll();
+	// One key per shard, so preparing more keys than there are shards must evict
+	PreparedSignatureVerifier::setCacheCapacity(1);
+	std::vector<SignatureVerificationKey> keys;
+	for (int i = 0; i < 17; i++) {
+		keys.push_back(SigningKey(orderedTestKey + std::to_string(i), "{}").getSignatureVerificationKey());
+		PreparedSignatureVerifier::prepare(keys.back().signatureVerificationKeyBytes.data(), keys.back().signatureVerificationKeyBytes.size());
+	}
+	ASSERT_LE(PreparedSignatureVerifier::getCacheSize(), 16);
+	ASSERT_TRUE(PreparedSignatureVerifier::findPrepared(keys.back().signatureVerificationKeyBytes.data(), keys.back().signatureVerificationKeyBytes.size()) != nullptr);
+	size_t found = 0;
+	for (const SignatureVerificationKey& key : keys) {
+		if (PreparedSignatureVerifier::findPrepared(key.signatureVerificationKeyBytes.data(), key.signatureVerificationKeyBytes.size())) {
+			found++;
+		}
+	}
+	ASSERT_EQ(found, PreparedSignatureVerifier::getCacheSize());
+	// Lookups by keys of the wrong length find nothing rather than throwing
+	ASSERT_TRUE(PreparedSignatureVerifier::findPrepared(keys.back().signatureVerificationKeyBytes.data(), 31) == nullptr);
+
+	PreparedSignatureVerifier::setCacheCapacity(256);
+	PreparedSignatureVerifier::forgetAll();
+	ASSERT_EQ(PreparedSignatureVerifier::getCacheSize(), 0);
+}
+
+TEST(VerificationCache, CachesOnlyValidSignatures) {
+	SigningKey testSigningKey(orderedTestKey, defaultTestSigningDerivationOptionsJson);
+	const SignatureVerificationKey key = testSigningKey.getSignatureVerificationKey();
+	const std::vector<unsigned char> message = { 'y', 'o', 't', 'o' };
+	const std::vector<unsigned char> signature = testSigningKey.generateSignature(message);
+	const std::vector<unsigned char> otherMessage = { 'y', 'o', 'l', 'o' };
+
+	const std::shared_ptr<VerificationCache> cache = std::make_shared<VerificationCache>(64, std::chrono::hours(1), 4);
+	VerificationCache::setDefault(cache);
+	ASSERT_TRUE(key.verify(message, signature));
+	ASSERT_TRUE(key.verify(message, signature));
+	ASSERT_EQ(cache->getMisses(), 1);
+	ASSERT_EQ(cache->getHits(), 1);
+	// Failures are never cached
+	ASSERT_FALSE(key.verify(otherMessage, signature));
+	ASSERT_FALSE(key.verify(otherMessage, signature));
+	ASSERT_EQ(cache->getHits(), 1);
+	ASSERT_EQ(cache->size(), 1);
+
+	// Invalidation by key
+	ASSERT_EQ(cache->invalidateKey(key.signatureVerificationKeyBytes.data(), key.signatureVerificationKeyBytes.size()), 1);
+	ASSERT_EQ(cache->size(), 0);
+	ASSERT_TRUE(key.verify(message, signature));
+	ASSERT_EQ(cache->getMisses(), 4);
+
+	// The size bound evicts the least recently used entries
+	for (size_t i = 0; i < 200; i++) {
+		const std::vector<unsigned char> m(1, (unsigned char) i);
+		ASSERT_TRUE(key.verify(m, testSigningKey.generateSignature(m)));
+	}
+	ASSERT_LE(cache->size(), 64);
+	ASSERT_GT(cache->getEvictions(), 0);
+	VerificationCache::setDefault(nullptr);
+
+	// Entries expire after their time-to-live
+	const std::shared_ptr<VerificationCache> shortLived = std::make_shared<VerificationCache>(64, std::chrono::milliseconds(20));
+	VerificationCache::setDefault(shortLived);
+	ASSERT_TRUE(key.verify(message, signature));
+	std::this_thread::sleep_for(std::chrono::milliseconds(40));
+	ASSERT_TRUE(key.verify(message, signature));
+	ASSERT_EQ(shortLived->getHits(), 0);
+	ASSERT_EQ(shortLived->getExpirations(), 1);
+	VerificationCache::setDefault(nullptr);
+	ASSERT_TRUE(key.verify(message, signature));
+	ASSERT_EQ(shortLived->getMisses(), 2);
+}
+
+TEST(VerificationCache, InvalidationDuringVerificationIsNotLost) {
+	SigningKey testSigningKey(orderedTestKey, defaultTestSigningDerivationOptionsJson);
+	const SignatureVerificationKey key = testSigningKey.getSignatureVerificationKey();
+	const std::vector<unsigned char> message = { 'y', 'o', 't', 'o' };
+	const std::vector<unsigned char> signature = testSigningKey.generateSignature(message);
+
+	VerificationCache cache(64, std::chrono::hours(1), 4);
+	// The key is revoked while its signature is being verified
+	const auto verifyThenRevoke = [&]() -> bool {
+		cache.invalidateKey(key.signatureVerificationKeyBytes.data(), key.signatureVerificationKeyBytes.size());
+		return true;
+	};
+	ASSERT_TRUE(cache.verify(
+		key.signatureVerificationKeyBytes.data(), key.signatureVerificationKeyBytes.size(),
+		message.data(), message.size(), signature.data(), signature.size(),
+		verifyThenRevoke
+	));
+	ASSERT_EQ(cache.size(), 0);
+	// So the next presentation is verified afresh
+	size_t uncachedVerifications = 0;
+	const auto countVerification = [&]() -> bool {
+		uncachedVerifications++;
+		return true;
+	};
+	ASSERT_TRUE(cache.verify(
+		key.signatureVerificationKeyBytes.data(), key.signatureVerificationKeyBytes.size(),
+		message.data(), message.size(), signature.data(), signature.size(),
+		countVerification
+	));
+	ASSERT_EQ(uncachedVerifications, 1);
+	ASSERT_EQ(cache.size(), 1);
+}
+
+TEST(StreamingSigner, SignsAndVerifiesInPiecesAndFromFiles) {
+	SigningKey testSigningKey(orderedTestKey, defaultTestSigningDerivationOptionsJson);
+	const SignatureVerificationKey testSignatureVerificationKey = testSigningKey.getSignatureVerificationKey();
+	std::vector<unsigned char> message(300000);
+	randombytes_buf(message.data(), message.size());
+
+	StreamingSigner signer(testSigningKey);
+	signer.update(message.data(), 1);
+	signer.update(message.data() + 1, 99999);
+	signer.update(std::vector<unsigned char>(message.begin() + 100000, message.end()));
+	const std::vector<unsigned char> signature = signer.finalize();
+	ASSERT_THROW(signer.finalize(), std::logic_error);
+
+	// Matches libsodium's one-shot Ed25519ph signature of the whole message
+	crypto_sign_state state;
+	crypto_sign_init(&state);
+	crypto_sign_update(&state, message.data(), message.size());
+	std::vector<unsigned char> expected(crypto_sign_BYTES);
+	crypto_sign_final_create(&state, expected.data(), NULL, testSigningKey.signingKeyBytes.data);
+	ASSERT_EQ(signature, expected);
+
+	StreamingSignatureVerifier verifier(testSignatureVerificationKey);
+	verifier.update(message);
+	ASSERT_TRUE(verifier.verify(signature));
+	StreamingSignatureVerifier tamperedVerifier(testSignatureVerificationKey);
+	message[12345] ^= 1;
+	tamperedVerifier.update(message);
+	ASSERT_FALSE(tamperedVerifier.verify(signature));
+	message[12345] ^= 1;
+
+	const std::string path = "test-streaming-signer.tmp";
+	FILE* file = fopen(path.c_str(), "wb");
+	ASSERT_TRUE(file != NULL);
+	fwrite(message.data(), 1, message.size(), file);
+	fclose(file);
+	StreamingSigner fileSigner(testSigningKey);
+	fileSigner.updateFromFile(path, 4096);
+	ASSERT_EQ(fileSigner.finalize(), signature);
+	// A window size that is not a multiple of the page size exercises unaligned offsets
+	StreamingSigner mappedFileSigner(testSigningKey);
+	mappedFileSigner.updateFromMemoryMappedFile(path, 70000);
+	ASSERT_EQ(mappedFileSigner.finalize(), signature);
+	StreamingSignatureVerifier mappedFileVerifier(testSignatureVerificationKey);
+	mappedFileVerifier.updateFromMemoryMappedFile(path);
+	ASSERT_TRUE(mappedFileVerifier.verify(signature));
+
+	const MemoryMappedFile window(path, 5000, 100);
+	ASSERT_EQ(window.getFileSize(), message.size());
+	ASSERT_EQ(std::vector<unsigned char>(window.data(), window.data() + window.size()),
+		std::vector<unsigned char>(message.begin() + 5000, message.begin() + 5100));
+	remove(path.c_str());
+	StreamingSigner missingFileSigner(testSigningKey);
+	ASSERT_THROW(missingFileSigner.updateFromFile(path), FileAccessException);
+}
+
+TEST(ChunkManifest, ProvesAndVerifiesChunkRanges) {
+	SigningKey testSigningKey(orderedTestKey, defaultTestSigningDerivationOptionsJson);
+	const SignatureVerificationKey testSignatureVerificationKey = testSigningKey.getSignatureVerificationKey();
+	SigningKey otherSigningKey(orderedTestKey, "{}");
+	const SignatureVerificationKey otherSignatureVerificationKey = otherSigningKey.getSignatureVerificationKey();
+	// 11 chunks, the last of them partial, so that some levels have an odd node
+	std::vector<unsigned char> blob(10500);
+	randombytes_buf(blob.data(), blob.size());
+	const ChunkManifest manifest = ChunkManifest::build(blob.data(), blob.size(), testSigningKey, 1000);
+	ASSERT_EQ(manifest.getChunkCount(), 11);
+	ASSERT_TRUE(manifest.verify(testSignatureVerificationKey));
+	ASSERT_FALSE(manifest.verify(otherSignatureVerificationKey));
+
+	for (uint64_t first = 0; first < 11; first++) {
+		for (uint64_t count = 1; first + count <= 11; count++) {
+			const ChunkRangeProof proof = ChunkRangeProof::fromSerializedBinaryForm(
+				manifest.proveRange(first, count).toSerializedBinaryForm());
+			const unsigned char* range = blob.data() + proof.getRangeOffset();
+			const size_t rangeLength = (size_t) proof.getRangeLength();
+			ASSERT_TRUE(proof.verify(testSignatureVerificationKey, range, rangeLength));
+			ASSERT_FALSE(proof.verify(otherSignatureVerificationKey, range, rangeLength));
+			std::vector<unsigned char> tampered(range, range + rangeLength);
+			tampered[rangeLength - 1] ^= 1;
+			ASSERT_FALSE(proof.verify(testSignatureVerificationKey, tampered.data(), tampered.size()));
+		}
+	}
+	const ChunkRangeProof byteRangeProof = manifest.proveByteRange(2500, 1000);
+	ASSERT_EQ(byteRangeProof.firstChunk, 2);
+	ASSERT_EQ(byteRangeProof.chunkCount, 2);
+	ASSERT_THROW(manifest.proveRange(10, 2), std::out_of_range);
+
+	// The serialized form round-trips, including through a memory-mapped file
+	const std::string path = "test-chunk-manifest.tmp";
+	FILE* file = fopen(path.c_str(), "wb");
+	ASSERT_TRUE(file != NULL);
+	fwrite(manifest.getSerializedBytes(), 1, manifest.getSerializedLength(), file);
+	fclose(file);
+	{
+		const ChunkManifest mapped = ChunkManifest::fromFile(path);
+		ASSERT_EQ(mapped.getRootHash(), manifest.getRootHash());
+		ASSERT_TRUE(mapped.verify(testSignatureVerificationKey));
+	}
+	file = fopen(path.c_str(), "wb");
+	fwrite(blob.data(), 1, blob.size(), file);
+	fclose(file);
+	ASSERT_EQ(ChunkManifest::buildFromFile(path, testSigningKey, 1000).toSerializedBinaryForm(),
+		manifest.toSerializedBinaryForm());
+	remove(path.c_str());
+	ASSERT_THROW(ChunkManifest::fromSerializedBinaryForm(std::vector<unsigned char>(
+		manifest.getSerializedBytes(), manifest.getSerializedBytes() + manifest.getSerializedLength() - 1)),
+		std::invalid_argument);
+
+	const ChunkManifest empty = ChunkManifest::build(NULL, 0, testSigningKey);
+	ASSERT_EQ(empty.getChunkCount(), 1);
+	ASSERT_TRUE(empty.proveRange(0, 1).verify(testSignatureVerificationKey, NULL, 0));
+}
+
+TEST(ChunkManifest, RejectsHeadersClaimingMoreChunksThanTheBodyHolds) {
+	SigningKey testSigningKey(orderedTestKey, defaultTestSigningDerivationOptionsJson);
+	const ChunkManifest genuine = ChunkManifest::build(NULL, 0, testSigningKey);
+	// One-byte chunks of a 2^63 + 1 byte blob, with a body of 64 hashes:
+	// summing the tree's level sizes would wrap around to a small count
+	std::vector<unsigned char> crafted(ChunkManifest::headerBytes + 64 * ChunkManifest::hashBytes, 0);
+	memcpy(crafted.data(), genuine.getSerializedBytes(), 8);
+	const uint64_t count = (uint64_t(1) << 63) + 1;
+	crafted[8] = 1;
+	for (size_t i = 0; i < 8; i++) {
+		crafted[16 + i] = (unsigned char) (count >> (8 * i));
+		crafted[24 + i] = (unsigned char) (count >> (8 * i));
+	}
+	ASSERT_THROW(ChunkManifest::fromSerializedBinaryForm(crafted), std::invalid_argument);
+
+	const std::string path = "test-crafted-chunk-manifest.tmp";
+	FILE* file = fopen(path.c_str(), "wb");
+	ASSERT_TRUE(file != NULL);
+	fwrite(crafted.data(), 1, crafted.size(), file);
+	fclose(file);
+	ASSERT_THROW(ChunkManifest::fromFile(path), std::invalid_argument);
+	remove(path.c_str());
+}
+
+TEST(SigningAndUnsealingKey, SignsAndUnsealsFromOneDerivation) {
+	const std::string derivationOptionsJson = R"KGO({
+	"type": "SigningAndUnsealingKey",
+	"additionalSalt": "1"
+})KGO";
+	const SigningAndUnsealingKey key(orderedTestKey, derivationOptionsJson);
+	const std::vector<unsigned char> message = { 'y', 'o', 't', 'o' };
+
+	SigningKey signingKey = key.getSigningKey();
+	ASSERT_TRUE(key.getSignatureVerificationKey().verify(message, signingKey.generateSignature(message)));
+	ASSERT_EQ(toHexStr(signingKey.getSignatureVerificationKeyBytes()), toHexStr(key.signatureVerificationKeyBytes));
+
+	// The X25519 pair is consistent, and unseals what its SealingKey seals
+	std::vector<unsigned char> expectedSealingKey(crypto_scalarmult_BYTES);
+	crypto_scalarmult_base(expectedSealingKey.data(), key.unsealingKeyBytes.data);
+	ASSERT_EQ(toHexStr(key.sealingKeyBytes), toHexStr(expectedSealingKey));
+	const auto sealedMessage = key.getSealingKey().seal(message, "{}");
+	ASSERT_EQ(key.getUnsealingKey().unseal(sealedMessage).toVector(), message);
+
+	const SigningAndUnsealingKey fromJson = SigningAndUnsealingKey::fromJson(key.toJson());
+	ASSERT_EQ(fromJson.derivationOptionsJson, key.derivationOptionsJson);
+	ASSERT_EQ(fromJson.unsealingKeyBytes.toHexString(), key.unsealingKeyBytes.toHexString());
+	ASSERT_EQ(toHexStr(fromJson.sealingKeyBytes), toHexStr(key.sealingKeyBytes));
+	const SigningAndUnsealingKey fromBinary = SigningAndUnsealingKey::fromSerializedBinaryForm(key.toSerializedBinaryForm());
+	ASSERT_EQ(fromBinary.signingKeyBytes.toHexString(), key.signingKeyBytes.toHexString());
+	ASSERT_EQ(toHexStr(fromBinary.signatureVerificationKeyBytes), toHexStr(key.signatureVerificationKeyBytes));
+
+	// The type is part of the derivation, and a conflicting type is rejected
+	ASSERT_NE(toHexStr(key.signatureVerificationKeyBytes),
+		toHexStr(SigningKey(orderedTestKey, "{}").getSignatureVerificationKeyBytes()));
+	ASSERT_ANY_THROW(SigningAndUnsealingKey(orderedTestKey, defaultTestSigningDerivationOptionsJson));
+	ASSERT_ANY_THROW(SigningAndUnsealingKey(orderedTestKey, R"KGO({"algorithm": "X25519"})KGO"));
+	ASSERT_THROW(SigningAndUnsealingKey(SodiumBuffer(crypto_sign_SECRETKEYBYTES - 1), std::string("{}")), KeyLengthException);
+	ASSERT_THROW(SigningKey::signingKeyBytesFromSeed(SodiumBuffer(crypto_sign_SEEDBYTES + 1)), KeyLengthException);
+	// The signing key is the seed followed by the signature-verification key
+	const std::vector<unsigned char> seed(crypto_sign_SEEDBYTES, 7);
+	const std::vector<unsigned char> signingKeyBytes = SigningKey::signingKeyBytesFromSeed(SodiumBuffer(seed)).toVector();
+	ASSERT_EQ(std::vector<unsigned char>(signingKeyBytes.begin(), signingKeyBytes.begin() + crypto_sign_SEEDBYTES), seed);
+	ASSERT_EQ(SigningKey(SodiumBuffer(signingKeyBytes), std::string("{}")).getSignatureVerificationKeyBytes(),
+		std::vector<unsigned char>(signingKeyBytes.begin() + crypto_sign_SEEDBYTES, signingKeyBytes.end()));
+}
+
+TEST(SigningAndUnsealingKey, UnsealsFromSeed) {
+	const std::vector<unsigned char> message = { 'y', 'o', 't', 'o' };
+	for (const std::string& derivationOptionsJson : { std::string("{}"), std::string(R"({"type": "SigningAndUnsealingKey"})") }) {
+		const PackagedSealedMessage sealed = SigningAndUnsealingKey::deriveFromSeed(orderedTestKey, derivationOptionsJson)
+			.getSealingKey().seal(message, "{}");
+		ASSERT_EQ(sealed.derivationOptionsJson, derivationOptionsJson);
+		ASSERT_EQ(SigningAndUnsealingKey::unseal(sealed, orderedTestKey).toVector(), message);
+		const PackagedSealedMessage fromJson = PackagedSealedMessage::fromJson(sealed.toJson());
+		ASSERT_EQ(SigningAndUnsealingKey::unseal(fromJson, orderedTestKey).toVector(), message);
+		ASSERT_ANY_THROW(SigningAndUnsealingKey::unseal(sealed, "another seed"));
+	}
+}
+
+TEST(Secret, DerivesChildKeysFromRootSecret) {
+	const Secret root(orderedTestKey, R"KDO({"hashFunction": "SHA256", "lengthInBytes": 32})KDO");
+	const std::vector<unsigned char> message = { 'y', 'o', 't', 'o' };
+
+	// Children are deterministic and labelled by their derivation options
+	const Secret child = Secret::deriveFromRootSecret(root, R"KDO({"lengthInBytes": 96, "purpose": "a"})KDO");
+	ASSERT_EQ(child.secretBytes.length, 96);
+	ASSERT_EQ(child.secretBytes.toHexString(), Secret::deriveFromRootSecret(root, child.derivationOptionsJson).secretBytes.toHexString());
+	ASSERT_NE(child.secretBytes.toHexString(),
+		Secret::deriveFromRootSecret(root, R"KDO({"lengthInBytes": 96, "purpose": "b"})KDO").secretBytes.toHexString());
+	ASSERT_NE(child.secretBytes.toHexString().substr(0, 64),
+		Secret::deriveFromRootSecret(root, R"KDO({"lengthInBytes": 32, "purpose": "a"})KDO").secretBytes.toHexString());
+	// ...and differ from the flat derivation with the same options
+	ASSERT_NE(child.secretBytes.toHexString(), Secret(orderedTestKey, child.derivationOptionsJson).secretBytes.toHexString());
+
+	const SymmetricKey symmetricKey = SymmetricKey::deriveFromRootSecret(root, "{}");
+	ASSERT_EQ(symmetricKey.unseal(symmetricKey.seal(message)).toVector(), message);
+	const UnsealingKey unsealingKey = UnsealingKey::deriveFromRootSecret(root, "{}");
+	ASSERT_EQ(unsealingKey.unseal(unsealingKey.getSealingKey().seal(message)).toVector(), message);
+	SigningKey signingKey = SigningKey::deriveFromRootSecret(root, "{}");
+	ASSERT_TRUE(signingKey.getSignatureVerificationKey().verify(message, signingKey.generateSignature(message)));
+	const SigningAndUnsealingKey signingAndUnsealingKey = SigningAndUnsealingKey::deriveFromRootSecret(root, "{}");
+	// The type is part of the label
+	ASSERT_NE(toHexStr(signingAndUnsealingKey.signatureVerificationKeyBytes), toHexStr(signingKey.getSignatureVerificationKeyBytes()));
+
+	ASSERT_ANY_THROW(SigningKey::deriveFromRootSecret(root, defaultTestPublicDerivationOptionsJson));
+	const Secret tooLongForARoot(orderedTestKey, fastSeedJsonDerivationOptions);
+	ASSERT_ANY_THROW(SigningKey::deriveFromRootSecret(tooLongForARoot, "{}"));
+}
+
+TEST(UnsealingKey, RejectsWithoutThrowing) {
+	const std::vector<unsigned char> message = { 'y', 'o', 't', 'o' };
+
+	const UnsealingKey unsealingKey(orderedTestKey, defaultTestPublicDerivationOptionsJson);
+	const PackagedSealedMessage sealed = unsealingKey.getSealingKey().seal(message, "{}");
+	const Result<SodiumBuffer> unsealed = unsealingKey.tryUnseal(sealed);
+	ASSERT_TRUE(unsealed.ok());
+	ASSERT_EQ(unsealed.getValue().toVector(), unsealingKey.unseal(sealed).toVector());
+	std::vector<unsigned char> corrupted(sealed.ciphertext);
+	corrupted[corrupted.size() - 1] ^= 1;
+	ASSERT_EQ(unsealingKey.tryUnseal(corrupted.data(), corrupted.size(), "{}").getStatus(), ResultStatus::CryptographicVerificationFailure);
+	ASSERT_EQ(unsealingKey.tryUnseal(sealed.ciphertext.data(), sealed.ciphertext.size(), "").getStatus(), ResultStatus::CryptographicVerificationFailure);
+	ASSERT_EQ(unsealingKey.tryUnseal(sealed.ciphertext.data(), crypto_box_SEALBYTES, "{}").getStatus(), ResultStatus::InvalidInput);
+
+	const SymmetricKey symmetricKey(orderedTestKey, defaultTestSymmetricDerivationOptionsJson);
+	const PackagedSealedMessage symmetricallySealed = symmetricKey.seal(message, "{}");
+	ASSERT_EQ(symmetricKey.tryUnseal(symmetricallySealed).getValue().toVector(), message);
+	corrupted = symmetricallySealed.ciphertext;
+	corrupted[crypto_secretbox_NONCEBYTES] ^= 1;
+	ASSERT_EQ(symmetricKey.tryUnseal(corrupted.data(), corrupted.size(), "{}").getStatus(), ResultStatus::CryptographicVerificationFailure);
+	ASSERT_EQ(symmetricKey.tryUnseal(symmetricallySealed.ciphertext.data(), symmetricallySealed.ciphertext.size(), "").getStatus(), ResultStatus::CryptographicVerificationFailure);
+	ASSERT_EQ(symmetricKey.tryUnseal(symmetricallySealed.ciphertext.data(), 8, "{}").getStatus(), ResultStatus::InvalidInput);
+
+	SigningKey signingKey(orderedTestKey, defaultTestSigningDerivationOptionsJson);
+	const SignatureVerificationKey verificationKey = signingKey.getSignatureVerificationKey();
+	std::vector<unsigned char> signature = signingKey.generateSignature(message);
+	ASSERT_EQ(verificationKey.tryVerify(message.data(), message.size(), signature.data(), signature.size()), ResultStatus::Success);
+	ASSERT_EQ(verificationKey.tryVerify(message.data(), message.size(), signature.data(), signature.size() - 1), ResultStatus::InvalidInput);
+	ASSERT_EQ(SignatureVerificationKey::tryVerify(verificationKey.signatureVerificationKeyBytes.data(), 31, message.data(), message.size(), signature.data(), signature.size()), ResultStatus::InvalidInput);
+	signature[0] ^= 1;
+	ASSERT_EQ(SignatureVerificationKey::tryVerify(verificationKey.signatureVerificationKeyBytes.data(), 32, message.data(), message.size(), signature.data(), signature.size()), ResultStatus::CryptographicVerificationFailure);
+
+	// Parsing untrusted input
+	ASSERT_EQ(PackagedSealedMessage::tryFromJson(sealed.toJson()).getValue().toJson(), sealed.toJson());
+	ASSERT_EQ(PackagedSealedMessage::tryFromSerializedBinaryForm(sealed.toSerializedBinaryForm()).getValue().toJson(), sealed.toJson());
+	ASSERT_EQ(PackagedSealedMessage::tryFromJson("{\"ciphertext\": \"0xzz\"}").getStatus(), ResultStatus::InvalidInput);
+	ASSERT_EQ(PackagedSealedMessage::tryFromJson("{\"ciphertext\": \"00\", \"unsealingInstructions\": 7}").getStatus(), ResultStatus::InvalidInput);
+	ASSERT_EQ(PackagedSealedMessage::tryFromJson("[").getStatus(), ResultStatus::InvalidInput);
+	const unsigned char overrun[] = { 0, 0, 1, 0, 'x' };
+	ASSERT_EQ(PackagedSealedMessage::tryFromSerializedBinaryForm(SodiumBuffer(sizeof overrun, overrun)).getStatus(), ResultStatus::InvalidInput);
+	ASSERT_EQ(SealingKey::tryFromJson(unsealingKey.getSealingKey().toJson()).getValue().toJson(), unsealingKey.getSealingKey().toJson());
+	ASSERT_EQ(SealingKey::tryFromSerializedBinaryForm(unsealingKey.getSealingKey().toSerializedBinaryForm()).getValue().toJson(), unsealingKey.getSealingKey().toJson());
+	ASSERT_EQ(SealingKey::tryFromJson("{\"keyBytes\": \"0011\"}").getStatus(), ResultStatus::InvalidInput);
+	ASSERT_EQ(SignatureVerificationKey::tryFromJson(verificationKey.toJson()).getValue().toJson(), verificationKey.toJson());
+	ASSERT_EQ(SignatureVerificationKey::tryFromSerializedBinaryForm(verificationKey.toSerializedBinaryForm()).getValue().toJson(), verificationKey.toJson());
+	ASSERT_EQ(SignatureVerificationKey::tryFromSerializedBinaryForm(SodiumBuffer(sizeof overrun, overrun)).getStatus(), ResultStatus::InvalidInput);
+}
+
+TEST(SignatureVerificationKey, VerifiesBatchWithPerSignatureResults) {
+	SigningKey firstSigningKey(orderedTestKey, defaultTestSigningDerivationOptionsJson);
+	SigningKey secondSigningKey(orderedTestKey, "{}");
+	const SignatureVerificationKey firstKey = firstSigningKey.getSignatureVerificationKey();
+	const SignatureVerificationKey secondKey = secondSigningKey.getSignatureVerificationKey();
+
+	std::vector<std::vector<unsigned char>> messages;
+	std::vector<std::vector<unsigned char>> signatures;
+	for (size_t i = 0; i < 40; i++) {
+		messages.push_back(std::vector<unsigned char>(i, (unsigned char) i));
+		signatures.push_back((i % 2 ? firstSigningKey : secondSigningKey).generateSignature(messages[i]));
+	}
+	// Corrupt a message, a signature, and a signature's length
+	messages[7][0] ^= 1;
+	signatures[12][40] ^= 1;
+	signatures[21].pop_back();
+
+	std::vector<SignatureVerificationKey::BatchVerificationItem> items;
+	for (size_t i = 0; i < messages.size(); i++) {
+		const SignatureVerificationKey& key = i % 2 ? firstKey : secondKey;
+		items.push_back({
+			key.signatureVerificationKeyBytes.data(), key.signatureVerificationKeyBytes.size(),
+			messages[i].data(), messages[i].size(),
+			signatures[i].data(), signatures[i].size()
+		});
+	}
+	const std::vector<bool> results = SignatureVerificationKey::verifyBatch(items);
+	ASSERT_EQ(results.size(), messages.size());
+	for (size_t i = 0; i < messages.size(); i++) {
+		const SignatureVerificationKey& key = i % 2 ? firstKey : secondKey;
+		ASSERT_EQ(results[i], key.verify(messages[i], signatures[i]));
+		ASSERT_EQ(results[i], i != 7 && i != 12 && i != 21);
+	}
+
+	const std::vector<bool> firstKeyResults = firstKey.verifyBatch(messages, signatures);
+	ASSERT_TRUE(firstKeyResults[1]);
+	ASSERT_FALSE(firstKeyResults[0]);
+	ASSERT_FALSE(firstKeyResults[7]);
+}
+
 
 TEST(SymmetricKey, EncryptsAndDecryptsWithoutUnsealingInstructions) {
 	const SymmetricKey testSymmetricKey(orderedTestKey, defaultTestSymmetricDerivationOptionsJson);
@@ -355,3 +909,864 @@ TEST(PackagedSealedMessage, ConvertsToJsonAndBack) {
 	ASSERT_STREQ(replica.derivationOptionsJson.c_str(), message.derivationOptionsJson.c_str());
 	ASSERT_STREQ(replica.unsealingInstructions.c_str(), message.unsealingInstructions.c_str());
 }
+
+TEST(MultiRecipientSealedMessage, EncryptsAndDecryptsForEachRecipient) {
+	const UnsealingKey firstUnsealingKey(orderedTestKey, defaultTestPublicDerivationOptionsJson);
+	const UnsealingKey secondUnsealingKey(orderedTestKey, "{}");
+	const UnsealingKey nonRecipientUnsealingKey("not the seed", "{}");
+
+	const std::vector<unsigned char> messageVector = { 'y', 'o', 't', 'o' };
+	const std::string unsealingInstructions = "{\"userMustAcknowledgeThisMessage\": \"yolo\"}";
+	const MultiRecipientSealedMessage sealedMessage = MultiRecipientSealedMessage::seal(
+		messageVector,
+		{ firstUnsealingKey.getSealingKey(), secondUnsealingKey.getSealingKey(), firstUnsealingKey.getSealingKey() },
+		unsealingInstructions
+	);
+
+	ASSERT_EQ(sealedMessage.recipients.size(), 2);
+	ASSERT_EQ(firstUnsealingKey.unseal(sealedMessage).toVector(), messageVector);
+	ASSERT_EQ(secondUnsealingKey.unseal(sealedMessage).toVector(), messageVector);
+	ASSERT_THROW(nonRecipientUnsealingKey.unseal(sealedMessage), CryptographicVerificationFailureException);
+}
+
+TEST(MultiRecipientSealedMessage, ConvertsToSerializedFormAndJsonAndBack) {
+	const UnsealingKey firstUnsealingKey(orderedTestKey, defaultTestPublicDerivationOptionsJson);
+	const UnsealingKey secondUnsealingKey(orderedTestKey, "{}");
+
+	const std::vector<unsigned char> messageVector = { 'y', 'o', 't', 'o' };
+	const MultiRecipientSealedMessage sealedMessage = MultiRecipientSealedMessage::seal(
+		messageVector,
+		{ firstUnsealingKey.getSealingKey(), secondUnsealingKey.getSealingKey() },
+		"{}"
+	);
+
+	const MultiRecipientSealedMessage fromBinary = MultiRecipientSealedMessage::fromSerializedBinaryForm(sealedMessage.toSerializedBinaryForm());
+	ASSERT_EQ(secondUnsealingKey.unseal(fromBinary).toVector(), messageVector);
+	ASSERT_EQ(fromBinary.unsealingInstructions, "{}");
+
+	const MultiRecipientSealedMessage fromJson = MultiRecipientSealedMessage::fromJson(sealedMessage.toJson());
+	ASSERT_EQ(firstUnsealingKey.unseal(fromJson).toVector(), messageVector);
+	ASSERT_EQ(toHexStr(fromJson.ciphertext), toHexStr(sealedMessage.ciphertext));
+}
+
+TEST(Convert, HexCodecsMatchScalar) {
+	std::vector<unsigned char> bytes(200);
+	randombytes_buf(bytes.data(), bytes.size());
+	for (HexCodec codec : { HexCodec::Scalar, HexCodec::Ssse3, HexCodec::Avx2 }) {
+		if (!hexCodecIsSupported(codec)) {
+			continue;
+		}
+		for (size_t length = 0; length <= bytes.size(); length += 7) {
+			std::string hex(2 * length, ' ');
+			hexEncode(&hex[0], bytes.data(), length, codec);
+			std::string expected;
+			for (size_t i = 0; i < length; i++) {
+				const char digits[] = "0123456789abcdef";
+				expected += digits[bytes[i] >> 4];
+				expected += digits[bytes[i] & 0xf];
+			}
+			ASSERT_EQ(hex, expected);
+			std::vector<unsigned char> decoded(length);
+			ASSERT_TRUE(hexDecode(decoded.data(), hex.data(), length, codec));
+			ASSERT_EQ(decoded, std::vector<unsigned char>(bytes.begin(), bytes.begin() + length));
+			// Upper case decodes the same; every non-hex character is caught
+			for (char& c : hex) { c = (char) toupper(c); }
+			ASSERT_TRUE(hexDecode(decoded.data(), hex.data(), length, codec));
+			ASSERT_EQ(decoded, std::vector<unsigned char>(bytes.begin(), bytes.begin() + length));
+			for (size_t i = 0; i < hex.size(); i += 5) {
+				for (char bad : { 'g', '/', ':', '@', 'G', '`', (char) 0x80, (char) 0xb0 }) {
+					std::string corrupted(hex);
+					corrupted[i] = bad;
+					ASSERT_FALSE(hexDecode(decoded.data(), corrupted.data(), length, codec));
+				}
+			}
+		}
+	}
+	ASSERT_EQ(toHexStr(hexStrToByteVector("0x00ff10")), "00ff10");
+	ASSERT_THROW(hexStrToByteVector("0f0"), std::invalid_argument);
+	ASSERT_THROW(hexStrToByteVector("0g"), InvalidHexCharacterException);
+}
+
+TEST(PackagedSealedMessage, ConvertsToBase64UrlJsonAndBack) {
+	const UnsealingKey unsealingKey(orderedTestKey, defaultTestPublicDerivationOptionsJson);
+	const std::vector<unsigned char> message(1000, 'y');
+	const PackagedSealedMessage sealed = unsealingKey.getSealingKey().seal(message, "{}");
+
+	const std::string asBase64Url = sealed.toJson(-1, ' ', BinaryEncoding::Base64Url);
+	ASSERT_LT(asBase64Url.size(), sealed.toJson().size() * 3 / 4);
+	ASSERT_NE(asBase64Url.find("\"binaryEncoding\":\"base64url\""), std::string::npos);
+	// JSON without a binaryEncoding field is still read as hex
+	ASSERT_EQ(sealed.toJson().find("binaryEncoding"), std::string::npos);
+	ASSERT_EQ(PackagedSealedMessage::fromJson(asBase64Url).toJson(), sealed.toJson());
+	ASSERT_EQ(PackagedSealedMessage::tryFromJson(asBase64Url).getValue().toJson(), sealed.toJson());
+	ASSERT_EQ(unsealingKey.unseal(PackagedSealedMessage::fromJson(asBase64Url)).toVector(), message);
+
+	const UnsealingKey unsealingKeyReplica = UnsealingKey::fromJson(unsealingKey.toJson(-1, ' ', BinaryEncoding::Base64Url));
+	ASSERT_EQ(unsealingKeyReplica.toJson(), unsealingKey.toJson());
+	const SealingKey sealingKey = unsealingKey.getSealingKey();
+	ASSERT_EQ(SealingKey::tryFromJson(sealingKey.toJson(-1, ' ', BinaryEncoding::Base64Url)).getValue().toJson(), sealingKey.toJson());
+	const Secret secret(orderedTestKey, "{}");
+	ASSERT_EQ(Secret::fromJson(secret.toJson(-1, ' ', BinaryEncoding::Base64Url)).toJson(), secret.toJson());
+
+	ASSERT_EQ(base64UrlStrToByteVector(toBase64UrlStr(message.data(), 5)), std::vector<unsigned char>(message.begin(), message.begin() + 5));
+	ASSERT_THROW(base64UrlStrToByteVector("eXl5e+=="), std::invalid_argument);
+	for (const char* encodingName : { "base32", "", "HEX" }) {
+		const std::string json = R"({"ciphertext": "00", "binaryEncoding": ")" + std::string(encodingName) + "\"}";
+		ASSERT_THROW(PackagedSealedMessage::fromJson(json), JsonParsingException) << json;
+		ASSERT_EQ(PackagedSealedMessage::tryFromJson(json).getStatus(), ResultStatus::InvalidInput) << json;
+	}
+}
+
+TEST(PackagedSealedMessage, StreamsJsonWithoutADocument) {
+	const UnsealingKey unsealingKey(orderedTestKey, defaultTestPublicDerivationOptionsJson);
+	const std::vector<unsigned char> message(50000, 'z');
+	const PackagedSealedMessage sealed = unsealingKey.getSealingKey().seal(message, "{\"note\": \"\u00e9\\n\"}");
+
+	for (BinaryEncoding binaryEncoding : { BinaryEncoding::Hex, BinaryEncoding::Base64Url }) {
+		// The streamed form is exactly what a JSON document would produce
+		const std::string asJson = sealed.toJson(-1, ' ', binaryEncoding);
+		ASSERT_EQ(asJson, nlohmann::json::parse(asJson).dump());
+		ASSERT_EQ(asJson, nlohmann::json::parse(sealed.toJson(1, '\t', binaryEncoding)).dump());
+		std::stringstream stream;
+		sealed.writeJson(stream, binaryEncoding);
+		ASSERT_EQ(stream.str(), asJson);
+
+		// readJson stops at the end of each object
+		sealed.writeJson(stream, binaryEncoding);
+		const PackagedSealedMessage first = PackagedSealedMessage::readJson(stream);
+		const PackagedSealedMessage second = PackagedSealedMessage::readJson(stream);
+		ASSERT_EQ(first.toJson(), sealed.toJson());
+		ASSERT_EQ(second.toJson(), sealed.toJson());
+		ASSERT_EQ(unsealingKey.unseal(second).toVector(), message);
+	}
+
+	// binaryEncoding may follow the ciphertext
+	const std::string reordered = R"({"ciphertext": ")" + toBase64UrlStr(sealed.ciphertext.data(), sealed.ciphertext.size()) +
+		R"(", "extra": [1, {"a": "}"}], "unsealingInstructions": "{}", "binaryEncoding": "base64url"})";
+	ASSERT_EQ(PackagedSealedMessage::fromJson(reordered).ciphertext, sealed.ciphertext);
+	ASSERT_EQ(PackagedSealedMessage::fromJson(R"({"ciphertext": "0x0aff"})").ciphertext, std::vector<unsigned char>({0x0a, 0xff}));
+	ASSERT_THROW(PackagedSealedMessage::fromJson(R"({"ciphertext": "0g"})"), InvalidHexCharacterException);
+	ASSERT_THROW(PackagedSealedMessage::fromJson(R"({"ciphertext": "00"} x)"), JsonParsingException);
+	ASSERT_THROW(PackagedSealedMessage::fromJson(R"({"ciphertext": "00")"), JsonParsingException);
+	ASSERT_THROW(PackagedSealedMessage::fromJson(R"({"unsealingInstructions": "{}"})"), JsonParsingException);
+	ASSERT_THROW(PackagedSealedMessage::fromJson(R"({"ciphertext": "00", "binaryEncoding": "base32"})"), JsonParsingException);
+
+	// Fields the reader skips are validated as strictly as tryFromJson validates them
+	for (const char* extra : {
+		"tru", "nul", "{]", "[}", "[1,]", "{\"a\"}", "{\"a\": 1,}", "1-2-3", "01", "1.", "-", "1e", "+1", "[[1]", "\"\\x\""
+	}) {
+		const std::string json = R"({"ciphertext": "00", "x": )" + std::string(extra) + "}";
+		ASSERT_THROW(PackagedSealedMessage::fromJson(json), JsonParsingException) << json;
+		ASSERT_EQ(PackagedSealedMessage::tryFromJson(json).getStatus(), ResultStatus::InvalidInput) << json;
+	}
+	for (const char* extra : {
+		"true", "false", "null", "0", "-0.5e+10", "12E3", "[]", "{}", "[1, [2, {\"a\": [null]}], \"]\"]", "{\"a\": {\"b\": {}}, \"c\": []}"
+	}) {
+		const std::string json = R"({"ciphertext": "00", "x": )" + std::string(extra) + "}";
+		ASSERT_EQ(PackagedSealedMessage::fromJson(json).ciphertext, std::vector<unsigned char>({0})) << json;
+		ASSERT_EQ(PackagedSealedMessage::tryFromJson(json).getStatus(), ResultStatus::Success) << json;
+	}
+
+	// A short message read from a long stream holds only its own ciphertext
+	std::stringstream longStream;
+	const PackagedSealedMessage shortMessage(std::vector<unsigned char>(16, 1), "{}", "");
+	shortMessage.writeJson(longStream);
+	for (size_t i = 0; i < 20; i++) {
+		sealed.writeJson(longStream);
+	}
+	ASSERT_LE(PackagedSealedMessage::readJson(longStream).ciphertext.capacity(), 4096);
+}
+
+TEST(PackagedSealedMessage, ConvertsToEnvelopeAndBack) {
+	const UnsealingKey unsealingKey(orderedTestKey, defaultTestPublicDerivationOptionsJson);
+	const std::vector<unsigned char> message = { 'y', 'o', 't', 'o' };
+	const PackagedSealedMessage sealed = unsealingKey.getSealingKey().seal(message, "{\"userMustAcknowledgeThisMessage\": \"yoto mofo\"}");
+	const std::vector<unsigned char> keyIdHint = { 1, 2, 3, 4, 5, 6, 7, 8 };
+
+	const SodiumBuffer envelopeBytes = sealed.toEnvelopeBinaryForm(SealingAlgorithm::Unspecified, keyIdHint);
+	ASSERT_EQ(envelopeBytes.length, SealedMessageEnvelope::encodedLength(keyIdHint.size(), false, 0,
+		sealed.derivationOptionsJson.size(), sealed.unsealingInstructions.size(), sealed.ciphertext.size()));
+	SealedMessageEnvelope envelope;
+	ASSERT_TRUE(SealedMessageEnvelope::parse(envelopeBytes.data, envelopeBytes.length, envelope));
+	// The algorithm was inferred from the derivation options' type, and fields point into the buffer
+	ASSERT_EQ(envelope.algorithm, SealingAlgorithm::X25519XSalsa20Poly1305);
+	ASSERT_EQ(std::vector<unsigned char>(envelope.keyIdHint, envelope.keyIdHint + envelope.keyIdHintLength), keyIdHint);
+	ASSERT_TRUE(envelope.ciphertext > envelopeBytes.data && envelope.ciphertext + envelope.ciphertextLength == envelopeBytes.data + envelopeBytes.length);
+	ASSERT_EQ(std::string(envelope.derivationOptionsJson, envelope.derivationOptionsJsonLength), sealed.derivationOptionsJson);
+	// The key ID hint becomes the message's keyId
+	const PackagedSealedMessage sealedWithKeyId(sealed.ciphertext, sealed.derivationOptionsJson, sealed.unsealingInstructions, keyIdHint);
+	ASSERT_EQ(PackagedSealedMessage::fromSerializedBinaryForm(envelopeBytes).toJson(), sealedWithKeyId.toJson());
+	ASSERT_EQ(unsealingKey.unseal(PackagedSealedMessage::fromSerializedBinaryForm(envelopeBytes)).toVector(), message);
+	// The older format is still read
+	ASSERT_EQ(PackagedSealedMessage::fromSerializedBinaryForm(sealed.toSerializedBinaryForm()).toJson(), sealed.toJson());
+
+	// Derivation options known to both sides are sent as a table ID
+	const DerivationOptionsTable table({ "{}", defaultTestPublicDerivationOptionsJson });
+	const SodiumBuffer compactBytes = sealed.toEnvelopeBinaryForm(SealingAlgorithm::Unspecified, keyIdHint, &table);
+	ASSERT_EQ(compactBytes.length, envelopeBytes.length - defaultTestPublicDerivationOptionsJson.size());
+	ASSERT_TRUE(SealedMessageEnvelope::parse(compactBytes.data, compactBytes.length, envelope));
+	ASSERT_TRUE(envelope.hasDerivationOptionsTableId);
+	ASSERT_EQ(envelope.derivationOptionsTableId, 1);
+	ASSERT_EQ(PackagedSealedMessage::fromSerializedBinaryForm(compactBytes, &table).toJson(), sealedWithKeyId.toJson());
+	ASSERT_THROW(PackagedSealedMessage::fromSerializedBinaryForm(compactBytes), std::invalid_argument);
+	ASSERT_EQ(PackagedSealedMessage::tryFromSerializedBinaryForm(compactBytes).getStatus(), ResultStatus::InvalidInput);
+
+	// Every truncation is rejected
+	for (size_t length = 0; length < envelopeBytes.length; length++) {
+		ASSERT_FALSE(SealedMessageEnvelope::parse(envelopeBytes.data, length, envelope));
+		ASSERT_FALSE(PackagedSealedMessage::tryFromSerializedBinaryForm(SodiumBuffer(length, envelopeBytes.data)).ok());
+	}
+	SodiumBuffer futureVersion(envelopeBytes.length, envelopeBytes.data);
+	futureVersion.data[4] = SealedMessageEnvelope::currentVersion + 1;
+	ASSERT_FALSE(PackagedSealedMessage::tryFromSerializedBinaryForm(futureVersion).ok());
+
+	for (uint64_t value : { uint64_t(0), uint64_t(127), uint64_t(128), uint64_t(300), ~uint64_t(0) }) {
+		unsigned char varint[10];
+		const size_t length = SealedMessageEnvelope::writeVarint(varint, value);
+		ASSERT_EQ(length, SealedMessageEnvelope::varintLength(value));
+		const unsigned char* position = varint;
+		uint64_t decoded;
+		ASSERT_TRUE(SealedMessageEnvelope::readVarint(&position, varint + length, decoded));
+		ASSERT_EQ(decoded, value);
+		ASSERT_EQ(position, varint + length);
+	}
+	ASSERT_EQ(PackagedSealedMessage::sealingAlgorithmFor(R"({"type": "SymmetricKey"})"), SealingAlgorithm::XSalsa20Poly1305);
+	ASSERT_EQ(PackagedSealedMessage::sealingAlgorithmFor("{}"), SealingAlgorithm::Unspecified);
+}
+
+TEST(KeyRegistry, RoutesMessagesByKeyId) {
+	KeyRegistry registry;
+	std::vector<UnsealingKey> unsealingKeys;
+	for (int i = 0; i < 4; i++) {
+		unsealingKeys.push_back(UnsealingKey(orderedTestKey, R"({"type": "UnsealingKey", "additionalSalt": ")" + std::to_string(i % 2) + "\"}"));
+	}
+	// Two keys with the same derivation options, derived from different seeds
+	unsealingKeys.push_back(UnsealingKey("another seed", unsealingKeys[0].derivationOptionsJson));
+	for (const UnsealingKey& unsealingKey : unsealingKeys) {
+		registry.add(unsealingKey);
+	}
+	const SymmetricKey symmetricKey(orderedTestKey, defaultTestSymmetricDerivationOptionsJson);
+	ASSERT_TRUE(registry.add(symmetricKey));
+	ASSERT_FALSE(registry.add(symmetricKey));
+	// Keys 0 and 2 (and 1 and 3) are the same key
+	ASSERT_EQ(registry.size(), 4);
+
+	const std::vector<unsigned char> message = { 'y', 'o', 't', 'o' };
+	const PackagedSealedMessage routed = unsealingKeys[4].getSealingKey().sealWithKeyId(message, "{}");
+	ASSERT_EQ(routed.keyId, unsealingKeys[4].getKeyId());
+	ASSERT_EQ(registry.findUnsealingKey(routed.keyId.data(), routed.keyId.size())->sealingKeyBytes, unsealingKeys[4].sealingKeyBytes);
+	ASSERT_EQ(registry.unseal(routed).toVector(), message);
+	// The key ID survives the JSON and envelope forms
+	ASSERT_EQ(registry.unseal(PackagedSealedMessage::fromJson(routed.toJson())).toVector(), message);
+	ASSERT_EQ(PackagedSealedMessage::fromJson(routed.toJson(-1, ' ', BinaryEncoding::Base64Url)).keyId, routed.keyId);
+	ASSERT_EQ(PackagedSealedMessage::tryFromJson(routed.toJson()).getValue().keyId, routed.keyId);
+	const SodiumBuffer envelopeBytes = routed.toEnvelopeBinaryForm();
+	SealedMessageEnvelope envelope;
+	ASSERT_TRUE(SealedMessageEnvelope::parse(envelopeBytes.data, envelopeBytes.length, envelope));
+	ASSERT_EQ(registry.tryUnseal(envelope).getValue().toVector(), message);
+	ASSERT_EQ(PackagedSealedMessage::fromSerializedBinaryForm(envelopeBytes).keyId, routed.keyId);
+
+	// Without a key ID, keys with matching derivation options are tried
+	const PackagedSealedMessage unrouted = unsealingKeys[4].getSealingKey().seal(message, "{}");
+	ASSERT_TRUE(unrouted.keyId.empty());
+	ASSERT_EQ(registry.unseal(unrouted).toVector(), message);
+	const PackagedSealedMessage symmetricRouted = symmetricKey.sealWithKeyId(message);
+	ASSERT_EQ(registry.unseal(symmetricRouted).toVector(), message);
+	ASSERT_EQ(registry.unseal(symmetricKey.seal(message)).toVector(), message);
+
+	// Unknown keys, and forgeries
+	const UnsealingKey stranger("stranger", unsealingKeys[0].derivationOptionsJson);
+	ASSERT_EQ(registry.tryUnseal(stranger.getSealingKey().sealWithKeyId(message)).getStatus(), ResultStatus::InvalidInput);
+	ASSERT_EQ(registry.tryUnseal(stranger.getSealingKey().seal(message)).getStatus(), ResultStatus::CryptographicVerificationFailure);
+	ASSERT_EQ(registry.tryUnseal(PackagedSealedMessage(unrouted.ciphertext, "{}", "{}")).getStatus(), ResultStatus::InvalidInput);
+	ASSERT_THROW(registry.unseal(PackagedSealedMessage(routed.ciphertext, routed.derivationOptionsJson, "other", routed.keyId)), CryptographicVerificationFailureException);
+	ASSERT_NE(symmetricKey.getKeyId(), SymmetricKey("another seed", defaultTestSymmetricDerivationOptionsJson).getKeyId());
+}
+
+TEST(SealedMessageArchive, AppendsReadsAndUnsealsInParallel) {
+	const std::string path = "test-sealed-message-archive.tmp";
+	const UnsealingKey unsealingKey(orderedTestKey, defaultTestPublicDerivationOptionsJson);
+	KeyRegistry registry;
+	registry.add(unsealingKey);
+	const size_t messageCount = 600;
+	std::vector<PackagedSealedMessage> messages;
+	for (size_t i = 0; i < messageCount; i++) {
+		const std::vector<unsigned char> plaintext(1 + i % 50, (unsigned char) i);
+		// Alternate records with and without key IDs (stored as envelopes and as fixed-length lists)
+		messages.push_back(i % 2 == 0 ?
+			unsealingKey.getSealingKey().sealWithKeyId(plaintext, "{}") :
+			unsealingKey.getSealingKey().seal(plaintext, "{}"));
+	}
+	{
+		// Small segments, so that the archive spans several
+		SealedMessageArchive archive(path, 8192);
+		for (size_t i = 0; i < messageCount; i++) {
+			ASSERT_EQ(archive.append(messages[i]), i);
+		}
+		ASSERT_GT(archive.getSegmentCount(), 2);
+		ASSERT_EQ(archive.read(1).toJson(), messages[1].toJson());
+		// Appends after a read are visible to the next read
+		archive.append(messages[0]);
+		ASSERT_EQ(archive.read(messageCount).toJson(), messages[0].toJson());
+	}
+	{
+		SealedMessageArchive archive(path, 8192);
+		ASSERT_EQ(archive.size(), messageCount + 1);
+		for (size_t i = 0; i < messageCount; i += 37) {
+			ASSERT_EQ(archive.read(i).toJson(), messages[i].toJson());
+		}
+		ASSERT_THROW(archive.read(messageCount + 1), std::out_of_range);
+
+		std::atomic<size_t> unsealed(0);
+		std::atomic<size_t> mismatched(0);
+		archive.parallelUnseal(registry, [&](uint64_t recordNumber, Result<SodiumBuffer>& plaintext) {
+			const size_t i = recordNumber % messageCount;
+			if (plaintext.ok() && plaintext.getValue().toVector() == std::vector<unsigned char>(1 + i % 50, (unsigned char) i)) {
+				unsealed++;
+			} else {
+				mismatched++;
+			}
+		});
+		ASSERT_EQ(unsealed.load(), messageCount + 1);
+		ASSERT_EQ(mismatched.load(), 0);
+	}
+
+	// An interrupted append, which left a partial record and index entry, is ignored and overwritten
+	{
+		SealedMessageArchive archive(path, 1 << 20);
+		const size_t lastSegment = archive.getSegmentCount() - 1;
+		FILE* file = fopen((path + "." + std::to_string(lastSegment) + ".records").c_str(), "ab");
+		fwrite("partial", 1, 7, file);
+		fclose(file);
+		file = fopen((path + "." + std::to_string(lastSegment) + ".index").c_str(), "ab");
+		fwrite("\xff\xff\xff", 1, 3, file);
+		fclose(file);
+	}
+	size_t segmentCount;
+	{
+		SealedMessageArchive archive(path, 1 << 20);
+		ASSERT_EQ(archive.size(), messageCount + 1);
+		ASSERT_EQ(archive.append(messages[5]), messageCount + 1);
+		ASSERT_EQ(archive.read(messageCount + 1).toJson(), messages[5].toJson());
+		segmentCount = archive.getSegmentCount();
+	}
+
+	// An append torn after its index entries reached the disk but before its
+	// records did leaves entries past the end of the records file.  Appending
+	// a shorter record must not let a stale entry come back into range.
+	const std::string lastIndexPath = path + "." + std::to_string(segmentCount - 1) + ".index";
+	const std::string lastRecordsPath = path + "." + std::to_string(segmentCount - 1) + ".records";
+	const uint64_t indexLength = MemoryMappedFile(lastIndexPath, 0, 0).getFileSize();
+	{
+		const uint64_t recordsLength = MemoryMappedFile(lastRecordsPath, 0, 0).getFileSize();
+		FILE* file = fopen(lastIndexPath.c_str(), "ab");
+		for (uint64_t staleEnd : { recordsLength + 4096, recordsLength + 8 }) {
+			unsigned char entry[8];
+			for (size_t i = 0; i < 8; i++) {
+				entry[i] = (unsigned char) (staleEnd >> (8 * i));
+			}
+			fwrite(entry, 1, 8, file);
+		}
+		fclose(file);
+	}
+	{
+		SealedMessageArchive archive(path, 1 << 20);
+		ASSERT_EQ(archive.size(), messageCount + 2);
+		ASSERT_EQ(archive.append(messages[7]), messageCount + 2);
+	}
+	{
+		SealedMessageArchive archive(path, 1 << 20);
+		ASSERT_EQ(archive.size(), messageCount + 3);
+		ASSERT_EQ(archive.read(messageCount + 2).toJson(), messages[7].toJson());
+	}
+	// Opening for append cut the stale entries off the index
+	ASSERT_EQ(MemoryMappedFile(lastIndexPath, 0, 0).getFileSize(), indexLength + 8);
+	for (size_t segment = 0; segment < segmentCount; segment++) {
+		remove((path + "." + std::to_string(segment) + ".records").c_str());
+		remove((path + "." + std::to_string(segment) + ".index").c_str());
+	}
+}
+
+#ifndef _WIN32
+TEST(SealedMessageArchive, RollsBackAFailedAppend) {
+	const std::string path = "test-sealed-message-archive-failure.tmp";
+	const UnsealingKey unsealingKey(orderedTestKey, defaultTestPublicDerivationOptionsJson);
+	const PackagedSealedMessage small = unsealingKey.getSealingKey().seal(std::vector<unsigned char>(10, 's'), "{}");
+	const PackagedSealedMessage large = unsealingKey.getSealingKey().seal(std::vector<unsigned char>(65536, 'l'), "{}");
+	{
+		SealedMessageArchive archive(path);
+		archive.append(small);
+		archive.flush();
+		// Make the records file's next write fail partway through the large record
+		struct rlimit originalLimit;
+		getrlimit(RLIMIT_FSIZE, &originalLimit);
+		struct rlimit limit = originalLimit;
+		limit.rlim_cur = 1024;
+		void (*originalHandler)(int) = signal(SIGXFSZ, SIG_IGN);
+		setrlimit(RLIMIT_FSIZE, &limit);
+		ASSERT_THROW(archive.append(large), FileAccessException);
+		setrlimit(RLIMIT_FSIZE, &originalLimit);
+		signal(SIGXFSZ, originalHandler);
+
+		ASSERT_EQ(archive.size(), 1);
+		ASSERT_EQ(archive.append(small), 1);
+		ASSERT_EQ(archive.append(large), 2);
+		ASSERT_EQ(archive.read(2).toJson(), large.toJson());
+	}
+	{
+		SealedMessageArchive archive(path);
+		ASSERT_EQ(archive.size(), 3);
+		ASSERT_EQ(archive.read(0).toJson(), small.toJson());
+		ASSERT_EQ(archive.read(1).toJson(), small.toJson());
+		ASSERT_EQ(archive.read(2).toJson(), large.toJson());
+	}
+	remove((path + ".0.records").c_str());
+	remove((path + ".0.index").c_str());
+}
+#endif
+
+TEST(SealingSession, EncryptsAndDecryptsBetweenPeers) {
+	const UnsealingKey aliceKey(orderedTestKey, defaultTestPublicDerivationOptionsJson);
+	const UnsealingKey bobKey(orderedTestKey, "{}");
+	const SealingSession aliceToBob(aliceKey, bobKey.getSealingKey());
+	const SealingSession bobToAlice(bobKey, aliceKey.getSealingKey());
+
+	const std::vector<unsigned char> messageVector = { 'y', 'o', 't', 'o' };
+	const std::string unsealingInstructions = "{}";
+	const PackagedSealedMessage sealedMessage = aliceToBob.seal(messageVector, unsealingInstructions);
+	ASSERT_EQ(sealedMessage.ciphertext.size(), messageVector.size() + SealingSession::overheadBytes);
+	ASSERT_EQ(sealedMessage.derivationOptionsJson, "{}");
+	ASSERT_EQ(bobToAlice.unseal(sealedMessage).toVector(), messageVector);
+	ASSERT_EQ(aliceToBob.unseal(bobToAlice.sealToCiphertextOnly(messageVector.data(), messageVector.size())).toVector(), messageVector);
+}
+
+TEST(SealingSession, RejectsReflectedMessagesAndWrongInstructions) {
+	const UnsealingKey aliceKey(orderedTestKey, defaultTestPublicDerivationOptionsJson);
+	const UnsealingKey bobKey(orderedTestKey, "{}");
+	const SealingSession aliceToBob(aliceKey, bobKey.getSealingKey());
+	const SealingSession bobToAlice(bobKey, aliceKey.getSealingKey());
+
+	const std::vector<unsigned char> messageVector = { 'y', 'o', 't', 'o' };
+	const std::vector<unsigned char> ciphertext = aliceToBob.sealToCiphertextOnly(messageVector.data(), messageVector.size(), "yes");
+	ASSERT_THROW(aliceToBob.unseal(ciphertext, "yes"), CryptographicVerificationFailureException);
+	ASSERT_THROW(bobToAlice.unseal(ciphertext, "no"), CryptographicVerificationFailureException);
+	ASSERT_EQ(bobToAlice.unseal(ciphertext, "yes").toVector(), messageVector);
+}
+
+TEST(UnsealingKey, UnsealsBatchWithPerMessageResults) {
+	const UnsealingKey testUnsealingKey(orderedTestKey, defaultTestPublicDerivationOptionsJson);
+	const SealingKey testSealingKey = testUnsealingKey.getSealingKey();
+
+	std::vector<PackagedSealedMessage> messages;
+	for (size_t i = 0; i < 50; i++) {
+		messages.push_back(testSealingKey.seal(std::string(1 + i * 97, 'a' + (i % 26)), std::to_string(i)));
+	}
+	// Wrong unsealing instructions, and a ciphertext too short to be valid
+	messages.push_back(PackagedSealedMessage(messages[0].ciphertext, "", "not 0"));
+	messages.push_back(PackagedSealedMessage(std::vector<unsigned char>(3), "", ""));
+
+	const auto results = testUnsealingKey.unsealBatch(messages);
+	ASSERT_EQ(results.size(), messages.size());
+	for (size_t i = 0; i < 50; i++) {
+		ASSERT_TRUE(results[i].ok());
+		ASSERT_EQ(results[i].getValue().toUtf8String(), std::string(1 + i * 97, 'a' + (i % 26)));
+	}
+	ASSERT_EQ(results[50].getStatus(), ResultStatus::CryptographicVerificationFailure);
+	ASSERT_EQ(results[51].getStatus(), ResultStatus::InvalidInput);
+	ASSERT_THROW(results[51].getValue(), std::logic_error);
+}
+
+TEST(SymmetricKey, UnsealsBatchWithPerMessageResults) {
+	const SymmetricKey testSymmetricKey(orderedTestKey, defaultTestSymmetricDerivationOptionsJson);
+
+	std::vector<PackagedSealedMessage> messages;
+	for (size_t i = 0; i < 50; i++) {
+		messages.push_back(testSymmetricKey.seal(std::string(1 + i * 97, 'a' + (i % 26)), std::to_string(i)));
+	}
+	messages.push_back(PackagedSealedMessage(messages[0].ciphertext, "", "not 0"));
+
+	const auto results = testSymmetricKey.unsealBatch(messages);
+	ASSERT_EQ(results.size(), messages.size());
+	for (size_t i = 0; i < 50; i++) {
+		ASSERT_TRUE(results[i].ok());
+		ASSERT_EQ(results[i].getValue().toUtf8String(), std::string(1 + i * 97, 'a' + (i % 26)));
+	}
+	ASSERT_EQ(results[50].getStatus(), ResultStatus::CryptographicVerificationFailure);
+}
+
+TEST(WorkStealingPool, RunsEveryIndexOnceWithUnevenWork) {
+	WorkStealingPool pool(4);
+	std::vector<std::atomic<int>> calls(1000);
+	for (auto& count : calls) {
+		count = 0;
+	}
+	pool.parallelFor(calls.size(), [&calls](size_t index) {
+		// Front-load the work so that threads must steal to balance it
+		if (index < 10) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		}
+		calls[index]++;
+	});
+	for (auto& count : calls) {
+		ASSERT_EQ(count, 1);
+	}
+	ASSERT_THROW(pool.parallelFor(100, [](size_t index) {
+		if (index == 42) {
+			throw std::runtime_error("42");
+		}
+	}), std::runtime_error);
+}
+
+TEST(X25519Batch, MatchesCryptoScalarmult) {
+	const size_t count = 23;
+	std::vector<unsigned char> scalars(count * crypto_scalarmult_SCALARBYTES);
+	std::vector<unsigned char> points(count * crypto_scalarmult_BYTES);
+	randombytes_buf(scalars.data(), scalars.size());
+	randombytes_buf(points.data(), points.size());
+	// A point of small order, and a non-canonical encoding (u >= p, top bit set)
+	std::fill(points.begin() + 5 * crypto_scalarmult_BYTES, points.begin() + 6 * crypto_scalarmult_BYTES, 0);
+	std::fill(points.begin() + 6 * crypto_scalarmult_BYTES, points.begin() + 7 * crypto_scalarmult_BYTES, 0xff);
+
+	std::vector<unsigned char> sharedSecrets(count * crypto_scalarmult_BYTES);
+	std::vector<int> results(count);
+	x25519Batch(sharedSecrets.data(), scalars.data(), points.data(), count, results.data());
+	for (size_t i = 0; i < count; i++) {
+		std::vector<unsigned char> expected(crypto_scalarmult_BYTES);
+		const int expectedResult = crypto_scalarmult(expected.data(), &scalars[i * crypto_scalarmult_SCALARBYTES], &points[i * crypto_scalarmult_BYTES]);
+		ASSERT_EQ(results[i], expectedResult);
+		if (expectedResult == 0) {
+			ASSERT_EQ(toHexStr(std::vector<unsigned char>(sharedSecrets.begin() + i * crypto_scalarmult_BYTES, sharedSecrets.begin() + (i + 1) * crypto_scalarmult_BYTES)), toHexStr(expected));
+		}
+	}
+	ASSERT_EQ(results[5], -1);
+}
+
+TEST(SealingKey, SealsBatch) {
+	const UnsealingKey testUnsealingKey(orderedTestKey, defaultTestPublicDerivationOptionsJson);
+	const SealingKey testSealingKey = testUnsealingKey.getSealingKey();
+
+	std::vector<std::vector<unsigned char>> messages;
+	for (size_t i = 0; i < 21; i++) {
+		messages.push_back(std::vector<unsigned char>(1 + i * 31, (unsigned char) i));
+	}
+	const std::vector<PackagedSealedMessage> sealedMessages = testSealingKey.sealBatch(messages, "{}");
+	ASSERT_EQ(sealedMessages.size(), messages.size());
+	const auto results = testUnsealingKey.unsealBatch(sealedMessages);
+	for (size_t i = 0; i < messages.size(); i++) {
+		ASSERT_EQ(testUnsealingKey.unseal(sealedMessages[i]).toVector(), messages[i]);
+		ASSERT_TRUE(results[i].ok());
+		ASSERT_EQ(results[i].getValue().toVector(), messages[i]);
+	}
+}
+
+template <typename Serializable>
+static void expectSerializeIntoMatchesSerializedBinaryForm(const Serializable& serializable) {
+	const SodiumBuffer serialized = serializable.toSerializedBinaryForm();
+	ASSERT_EQ(serializable.serializedSize(), serialized.length);
+	std::vector<unsigned char> out(serialized.length + 1, 0xee);
+	ASSERT_EQ(serializable.serializeInto(out.data(), out.size()), serialized.length);
+	ASSERT_EQ(toHexStr(std::vector<unsigned char>(out.begin(), out.begin() + serialized.length)), serialized.toHexString());
+	ASSERT_EQ(out.back(), 0xee);
+	ASSERT_THROW(serializable.serializeInto(out.data(), serialized.length - 1), std::invalid_argument);
+}
+
+TEST(SodiumBuffer, SerializesIntoCallerStorage) {
+	const SodiumBuffer first(std::vector<unsigned char>({ 1, 2, 3 }));
+	const SodiumBuffer second(std::string("four"));
+	const std::vector<unsigned char> third({ 5 });
+	const SodiumBuffer thirdBuffer(third);
+	ASSERT_EQ(
+		SodiumBuffer::combineFixedLengthList(first, std::string("four"), third).toHexString(),
+		SodiumBuffer::combineFixedLengthList({ &first, &second, &thirdBuffer }).toHexString()
+	);
+	const SodiumBuffer* noBuffer = NULL;
+	ASSERT_EQ(
+		SodiumBuffer::combineFixedLengthList(first, noBuffer, second).toHexString(),
+		SodiumBuffer::combineFixedLengthList({ &first, NULL, &second }).toHexString()
+	);
+	ASSERT_EQ(SodiumBuffer::fixedLengthListSize(first, second), 4 + 3 + 4);
+
+	const UnsealingKey unsealingKey(orderedTestKey, defaultTestPublicDerivationOptionsJson);
+	const SymmetricKey symmetricKey(orderedTestKey, defaultTestSymmetricDerivationOptionsJson);
+	SigningKey signingKey(orderedTestKey, defaultTestSigningDerivationOptionsJson);
+	expectSerializeIntoMatchesSerializedBinaryForm(Secret(orderedTestKey, fastSeedJsonDerivationOptions));
+	expectSerializeIntoMatchesSerializedBinaryForm(symmetricKey);
+	expectSerializeIntoMatchesSerializedBinaryForm(unsealingKey);
+	expectSerializeIntoMatchesSerializedBinaryForm(unsealingKey.getSealingKey());
+	expectSerializeIntoMatchesSerializedBinaryForm(signingKey.getSignatureVerificationKey());
+	expectSerializeIntoMatchesSerializedBinaryForm(SigningAndUnsealingKey(orderedTestKey, "{}"));
+	expectSerializeIntoMatchesSerializedBinaryForm(symmetricKey.seal(std::vector<unsigned char>({ 'h', 'i' }), "{}"));
+	expectSerializeIntoMatchesSerializedBinaryForm(MultiRecipientSealedMessage::seal(
+		std::vector<unsigned char>({ 'h', 'i' }),
+		{ unsealingKey.getSealingKey(), SigningAndUnsealingKey(orderedTestKey, "{}").getSealingKey() },
+		"{}"
+	));
+
+	for (bool minimize : { true, false }) {
+		const SodiumBuffer serialized = signingKey.toSerializedBinaryForm(minimize);
+		ASSERT_EQ(signingKey.serializedSize(minimize), serialized.length);
+		SodiumBuffer out(serialized.length);
+		ASSERT_EQ(signingKey.serializeInto(out.data, out.length, minimize), serialized.length);
+		ASSERT_EQ(out.toHexString(), serialized.toHexString());
+	}
+
+	// The archive's reused buffer must produce the same envelope
+	const PackagedSealedMessage withKeyId = unsealingKey.getSealingKey().sealWithKeyId(third, "{}");
+	const SealedMessageEnvelope envelope = withKeyId.toEnvelope();
+	ASSERT_EQ(envelope.encodedLength(), withKeyId.toEnvelopeBinaryForm().length);
+}
+
+// Split message at each of cuts (offsets in increasing order, which may repeat
+// to produce empty fragments)
+static std::vector<MessageFragment> fragmentsOf(const std::vector<unsigned char>& message, const std::vector<size_t>& cuts) {
+	std::vector<MessageFragment> fragments;
+	size_t start = 0;
+	for (size_t cut : cuts) {
+		fragments.push_back(MessageFragment(message.data() + start, cut - start));
+		start = cut;
+	}
+	fragments.push_back(MessageFragment(message.data() + start, message.size() - start));
+	return fragments;
+}
+
+TEST(MessageFragment, SealsSignsAndVerifiesFragmentsAsIfConcatenated) {
+	std::vector<unsigned char> message(300);
+	for (size_t i = 0; i < message.size(); i++) {
+		message[i] = (unsigned char) (i * 7 + 3);
+	}
+	std::vector<size_t> everyByte;
+	for (size_t i = 1; i < message.size(); i++) {
+		everyByte.push_back(i);
+	}
+	const std::vector<std::vector<size_t>> splits = {
+		{}, { 0 }, { 1 }, { 31, 32 }, { 32, 33, 64 }, { 0, 0, 200 }, { 63, 65, 128, 299 }, everyByte
+	};
+
+	const SymmetricKey symmetricKey(orderedTestKey, defaultTestSymmetricDerivationOptionsJson);
+	const UnsealingKey unsealingKey(orderedTestKey, defaultTestPublicDerivationOptionsJson);
+	const SealingKey sealingKey = unsealingKey.getSealingKey();
+	SigningKey signingKey(orderedTestKey, defaultTestSigningDerivationOptionsJson);
+	const SignatureVerificationKey verificationKey = signingKey.getSignatureVerificationKey();
+
+	const std::vector<unsigned char> symmetricCiphertext = symmetricKey.sealToCiphertextOnly(message, "instructions");
+	const std::vector<unsigned char> signature = signingKey.generateSignature(message);
+	unsigned char ephemeralPublicKey[crypto_box_PUBLICKEYBYTES];
+	unsigned char ephemeralSecretKey[crypto_box_SECRETKEYBYTES];
+	crypto_box_keypair(ephemeralPublicKey, ephemeralSecretKey);
+	std::vector<unsigned char> sealedCiphertext(message.size() + crypto_box_SEALBYTES);
+	crypto_box_salted_seal_with_ephemeral_keypair(
+		sealedCiphertext.data(), message.data(), message.size(), sealingKey.sealingKeyBytes.data(),
+		ephemeralPublicKey, ephemeralSecretKey, "instructions", 12
+	);
+
+	for (const std::vector<size_t>& cuts : splits) {
+		const std::vector<MessageFragment> fragments = fragmentsOf(message, cuts);
+		ASSERT_EQ(toHexStr(symmetricKey.sealToCiphertextOnly(fragments, "instructions")), toHexStr(symmetricCiphertext));
+		ASSERT_EQ(symmetricKey.unseal(symmetricKey.seal(fragments, "instructions")).toVector(), message);
+
+		std::vector<unsigned char> sealedFromFragments(message.size() + crypto_box_SEALBYTES);
+		crypto_box_salted_seal_fragments_with_ephemeral_keypair(
+			sealedFromFragments.data(), fragments.data(), fragments.size(), sealingKey.sealingKeyBytes.data(),
+			ephemeralPublicKey, ephemeralSecretKey, "instructions", 12
+		);
+		ASSERT_EQ(toHexStr(sealedFromFragments), toHexStr(sealedCiphertext));
+		ASSERT_EQ(unsealingKey.unseal(sealingKey.seal(fragments, "instructions")).toVector(), message);
+
+		ASSERT_EQ(toHexStr(signingKey.generateSignature(fragments)), toHexStr(signature));
+	}
+
+	// Verify without, then with, a prepared verifier; tampering with a
+	// fragment or the signature must fail verification
+	std::vector<unsigned char> tamperedMessage(message);
+	tamperedMessage[150] ^= 1;
+	std::vector<unsigned char> tamperedSignature(signature);
+	tamperedSignature[5] ^= 1;
+	// Large enough to be hashed in place rather than copied
+	std::vector<unsigned char> largeMessage(300 * 1024, 'x');
+	const std::vector<unsigned char> largeSignature = signingKey.generateSignature(largeMessage);
+	const std::vector<size_t> largeCuts = { 100, 200 * 1024 };
+	for (bool prepared : { false, true }) {
+		if (prepared) {
+			verificationKey.prepareForRepeatedVerification();
+		}
+		for (const std::vector<size_t>& cuts : splits) {
+			const std::vector<MessageFragment> fragments = fragmentsOf(message, cuts);
+			ASSERT_TRUE(verificationKey.verify(fragments, signature));
+			ASSERT_FALSE(verificationKey.verify(fragments, tamperedSignature));
+			ASSERT_FALSE(verificationKey.verify(fragmentsOf(tamperedMessage, cuts), signature));
+		}
+		ASSERT_EQ(toHexStr(signingKey.generateSignature(fragmentsOf(largeMessage, largeCuts))), toHexStr(largeSignature));
+		ASSERT_TRUE(verificationKey.verify(fragmentsOf(largeMessage, largeCuts), largeSignature));
+		ASSERT_FALSE(verificationKey.verify(fragmentsOf(largeMessage, largeCuts), signature));
+		largeMessage[150 * 1024] ^= 1;
+		ASSERT_FALSE(verificationKey.verify(fragmentsOf(largeMessage, largeCuts), largeSignature));
+		largeMessage[150 * 1024] ^= 1;
+	}
+}
+
+TEST(InternedString, SharesDerivationOptionsAcrossKeys) {
+	const SymmetricKey symmetricKey(orderedTestKey, defaultTestSymmetricDerivationOptionsJson);
+	const SymmetricKey sameOptions("another seed", std::string(defaultTestSymmetricDerivationOptionsJson));
+	ASSERT_TRUE(symmetricKey.derivationOptionsJson.sharesStorageWith(sameOptions.derivationOptionsJson));
+	ASSERT_TRUE(symmetricKey.derivationOptionsJson.sharesStorageWith(
+		SymmetricKey::fromSerializedBinaryForm(symmetricKey.toSerializedBinaryForm()).derivationOptionsJson));
+	ASSERT_TRUE(symmetricKey.derivationOptionsJson.sharesStorageWith(
+		SymmetricKey::fromJson(symmetricKey.toJson()).derivationOptionsJson));
+	ASSERT_TRUE(symmetricKey.derivationOptionsJson.sharesStorageWith(
+		symmetricKey.seal(std::vector<unsigned char>({ 'h', 'i' })).derivationOptionsJson));
+
+	const UnsealingKey unsealingKey(orderedTestKey, defaultTestPublicDerivationOptionsJson);
+	const SealingKey sealingKey = unsealingKey.getSealingKey();
+	ASSERT_TRUE(sealingKey.derivationOptionsJson.sharesStorageWith(unsealingKey.derivationOptionsJson));
+	ASSERT_TRUE(sealingKey.derivationOptionsJson.sharesStorageWith(
+		SealingKey::fromJson(sealingKey.toJson()).derivationOptionsJson));
+	const PackagedSealedMessage sealed = sealingKey.seal(std::string("hi"));
+	ASSERT_TRUE(sealed.derivationOptionsJson.sharesStorageWith(
+		PackagedSealedMessage::fromSerializedBinaryForm(sealed.toSerializedBinaryForm()).derivationOptionsJson));
+	ASSERT_FALSE(sealed.derivationOptionsJson.sharesStorageWith(symmetricKey.derivationOptionsJson));
+
+	// Compares with strings as a std::string would
+	const InternedString interned("{}");
+	ASSERT_EQ(interned, "{}");
+	ASSERT_EQ(interned, std::string("{}"));
+	ASSERT_NE(interned, symmetricKey.derivationOptionsJson);
+	ASSERT_EQ(interned.size(), 2);
+	ASSERT_TRUE(InternedString().empty());
+	ASSERT_TRUE(InternedString("").sharesStorageWith(InternedString()));
+
+	// A table of one's own
+	InternTable table;
+	const InternedString inTable("{}", table);
+	ASSERT_TRUE(inTable.sharesStorageWith(InternedString("{}", table)));
+	ASSERT_FALSE(inTable.sharesStorageWith(interned));
+	ASSERT_EQ(inTable, interned);
+	ASSERT_EQ(table.size(), 1);
+
+	// With interning turned off, each string has its own copy
+	const std::shared_ptr<InternTable> defaultTable = InternTable::getDefault();
+	InternTable::setDefault(std::shared_ptr<InternTable>());
+	const InternedString uninterned("{}");
+	InternTable::setDefault(defaultTable);
+	ASSERT_FALSE(uninterned.sharesStorageWith(interned));
+	ASSERT_EQ(uninterned, interned);
+}
+
+TEST(PublicKeyStore, FindsKeysByBytesAndKeyId) {
+	PublicKeyStore store;
+	std::vector<SealingKey> sealingKeys;
+	std::vector<SigningKey> signingKeys;
+	for (size_t i = 0; i < 50; i++) {
+		const std::string options = "{\"additionalSalt\": \"" + std::to_string(i % 3) + "\"}";
+		sealingKeys.push_back(UnsealingKey(orderedTestKey + std::to_string(i), options).getSealingKey());
+		signingKeys.push_back(SigningKey(orderedTestKey + std::to_string(i), options));
+	}
+	// Half the keys are added as objects and half loaded from their serialized forms
+	std::vector<SodiumBuffer> serializedSealingKeys;
+	for (size_t i = 0; i < sealingKeys.size(); i++) {
+		if (i % 2 == 0) {
+			ASSERT_TRUE(store.add(sealingKeys[i]));
+			ASSERT_TRUE(store.add(signingKeys[i].getSignatureVerificationKey()));
+		} else {
+			serializedSealingKeys.push_back(sealingKeys[i].toSerializedBinaryForm());
+			const SodiumBuffer serialized = signingKeys[i].getSignatureVerificationKey().toSerializedBinaryForm();
+			ASSERT_TRUE(store.addSerialized(PublicKeyType::SignatureVerificationKey, serialized.data, serialized.length));
+		}
+	}
+	ASSERT_EQ(store.bulkLoad(PublicKeyType::SealingKey, serializedSealingKeys), serializedSealingKeys.size());
+	ASSERT_EQ(store.size(), 100);
+	ASSERT_EQ(store.getDerivationOptionsCount(), 3);
+	ASSERT_FALSE(store.add(sealingKeys[1]));
+	ASSERT_EQ(store.bulkLoad(PublicKeyType::SealingKey, serializedSealingKeys), 0);
+	ASSERT_EQ(store.size(), 100);
+
+	const std::vector<unsigned char> message = { 'h', 'i' };
+	for (size_t i = 0; i < sealingKeys.size(); i++) {
+		const SealingKeyView sealingKey = store.findSealingKey(sealingKeys[i].sealingKeyBytes.data());
+		ASSERT_TRUE(sealingKey.exists());
+		ASSERT_EQ(sealingKey.getDerivationOptionsJson(), sealingKeys[i].derivationOptionsJson);
+		ASSERT_EQ(sealingKey.toSealingKey().toJson(), sealingKeys[i].toJson());
+		const std::vector<unsigned char> keyId = sealingKeys[i].getKeyId();
+		ASSERT_EQ(toHexStr(std::vector<unsigned char>(sealingKey.getKeyId(), sealingKey.getKeyId() + keyId.size())), toHexStr(keyId));
+		ASSERT_EQ(store.findSealingKeyById(keyId.data(), keyId.size()).getSealingKeyBytes(), sealingKey.getSealingKeyBytes());
+
+		const std::vector<unsigned char> verificationKeyBytes = signingKeys[i].getSignatureVerificationKeyBytes();
+		const SignatureVerificationKeyView verificationKey = store.findSignatureVerificationKey(verificationKeyBytes.data());
+		ASSERT_TRUE(verificationKey.exists());
+		ASSERT_EQ(toHexStr(verificationKey.toSignatureVerificationKey().signatureVerificationKeyBytes), toHexStr(verificationKeyBytes));
+		const std::vector<unsigned char> signature = signingKeys[i].generateSignature(message);
+		ASSERT_TRUE(verificationKey.verify(message.data(), message.size(), signature.data(), signature.size()));
+		ASSERT_FALSE(verificationKey.verify(message.data(), 1, signature.data(), signature.size()));
+
+		// Keys are found only as the type they were added as
+		ASSERT_FALSE(store.findSignatureVerificationKey(sealingKeys[i].sealingKeyBytes.data()).exists());
+		ASSERT_FALSE(store.findSealingKey(verificationKeyBytes.data()).exists());
+	}
+	const std::vector<unsigned char> unknown(32, 0);
+	ASSERT_FALSE(store.findSealingKey(unknown.data()).exists());
+	ASSERT_FALSE(store.findSealingKeyById(unknown.data(), SealingKey::keyIdBytes).exists());
+	ASSERT_FALSE(store.findSealingKeyById(unknown.data(), 3).exists());
+
+	const std::vector<unsigned char> truncated = { 0, 0, 0, 2, 1, 2 };
+	ASSERT_THROW(store.addSerialized(PublicKeyType::SealingKey, truncated.data(), truncated.size()), std::invalid_argument);
+	ASSERT_THROW(store.addSerialized(PublicKeyType::SealingKey, truncated.data(), 3), std::invalid_argument);
+}
+
+TEST(FixedLengthBytes, HoldsKeysAndSignaturesInline) {
+	const std::string derivationOptionsJson = R"({"algorithm": "Ed25519"})";
+	const SigningKey signingKey("yo", derivationOptionsJson);
+	const SignatureVerificationKey verificationKey = SigningKey(signingKey).getSignatureVerificationKey();
+	const UnsealingKey unsealingKey("yo", R"({"algorithm": "X25519"})");
+	const SealingKey sealingKey = unsealingKey.getSealingKey();
+
+	// The arrays convert to, and compare equal with, the vectors they replaced
+	const std::vector<unsigned char> sealingKeyBytes = sealingKey.sealingKeyBytes;
+	ASSERT_EQ(sealingKeyBytes, sealingKey.getSealingKeyBytes());
+	ASSERT_TRUE(sealingKey.sealingKeyBytes == sealingKeyBytes);
+	ASSERT_TRUE(sealingKeyBytes == unsealingKey.getSealingKeyByteArray());
+	ASSERT_EQ(&sealingKey.getSealingKeyByteArray(), &sealingKey.sealingKeyBytes);
+	ASSERT_EQ(verificationKey.getKeyByteArray(), verificationKey.signatureVerificationKeyBytes);
+	ASSERT_TRUE(verificationKey.getKeyBytes() == verificationKey.getKeyByteArray());
+	ASSERT_FALSE(std::vector<unsigned char>(32, 0) == sealingKey.sealingKeyBytes);
+	ASSERT_TRUE(std::vector<unsigned char>(31, 0) != sealingKey.sealingKeyBytes);
+
+	// Serialization is unchanged
+	ASSERT_EQ(SealingKey::fromSerializedBinaryForm(sealingKey.toSerializedBinaryForm()).toJson(), sealingKey.toJson());
+	ASSERT_EQ(UnsealingKey::fromJson(unsealingKey.toJson()).sealingKeyBytes, unsealingKey.sealingKeyBytes);
+
+	// Keys of the wrong length are still rejected with the exceptions they were
+	ASSERT_THROW(SealingKey(std::vector<unsigned char>(31), derivationOptionsJson), InvalidDerivationOptionValueException);
+	ASSERT_THROW(UnsealingKey(SodiumBuffer(crypto_box_SECRETKEYBYTES), std::vector<unsigned char>(33), derivationOptionsJson), InvalidDerivationOptionValueException);
+	ASSERT_THROW(SignatureVerificationKey(std::vector<unsigned char>(31), derivationOptionsJson), std::invalid_argument);
+
+	const std::vector<unsigned char> message = { 'h', 'i' };
+	const SignatureBytes signature = signingKey.generateSignatureBytes(message);
+	ASSERT_EQ(signature, signingKey.generateSignature(message));
+	ASSERT_EQ(signingKey.generateSignatureBytes(message.data(), message.size()), signature);
+	ASSERT_EQ(signingKey.generateSignatureBytes(std::vector<MessageFragment>({ MessageFragment(message.data(), 1), MessageFragment(message.data() + 1, 1) })), signature);
+	ASSERT_TRUE(verificationKey.verify(message, signature));
+	ASSERT_TRUE(verificationKey.verify(message.data(), message.size(), signature));
+	ASSERT_TRUE(verificationKey.verify(std::vector<MessageFragment>({ MessageFragment(message) }), signature));
+	ASSERT_TRUE(verificationKey.verify(message, signature.toVector()));
+	ASSERT_FALSE(verificationKey.verify(message.data(), 1, signature));
+	SignatureBytes forged = signature;
+	forged[0] ^= 1;
+	ASSERT_FALSE(verificationKey.verify(message, forged));
+}
+
+TEST(SodiumImplementations, FollowsLibsodiumSalsa20Dispatch) {
+	const SodiumImplementations implementations = getActiveSodiumImplementations();
+	const std::string summary = implementations.toString();
+	ASSERT_NE(summary.find("salsa20=" + implementations.salsa20 + " "), std::string::npos);
+#ifdef SEEDED_SODIUM_HAVE_SIMD_KERNELS
+	if (sodium_runtime_has_avx2()) {
+		ASSERT_EQ(implementations.salsa20, "avx2") << summary;
+	} else if (sodium_runtime_has_sse2()) {
+#ifdef SEEDED_SODIUM_HAVE_AMD64_ASM
+		// libsodium 1.0.18 never picks the SSE2 kernel over the amd64 assembly
+		ASSERT_EQ(implementations.salsa20, "amd64-asm") << summary;
+#else
+		ASSERT_EQ(implementations.salsa20, "sse2") << summary;
+#endif
+	}
+#endif
+}